@@ -0,0 +1,1151 @@
+/*
+ * Copyright © 2026 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+//
+// Runs the EXA hooks of the driver the way the EXA core calls them,
+// without an X server or a GPU: the server calls come from stubs.c and
+// the DRM device from fake_drm.c. Every case is a pixmap set up with
+// CreatePixmap2(), then Prepare/op/Done and the end of a frame (the
+// queue drained, the dma-buf windows closed) per run. One JSON object
+// per case is printed to stdout, the driver log goes to stderr.
+//
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xf86.h>
+#include <exa.h>
+#include <picturestr.h>
+
+#include "driver.h"
+#include "dumb_bo.h"
+#include "fake_exa.h"
+#include "loongson_buffer.h"
+#include "loongson_options.h"
+#include "loongson_pixmap.h"
+#include "loongson_simd.h"
+#include "loongson_thread_pool.h"
+
+#include "fake_drm.h"
+#include "stubs.h"
+
+#define BENCH_MIN_RUNS      10
+#define BENCH_MAX_RUNS      10000
+#define BENCH_MAX_LIST      16
+#define BENCH_MAX_OPTIONS   32
+
+// the pixmap upload and download cut their rectangle out of, at least
+#define BENCH_SCREEN_WIDTH  1920
+#define BENCH_SCREEN_HEIGHT 1080
+
+enum bench_op {
+    BENCH_OP_SOLID,
+    BENCH_OP_COPY,
+    BENCH_OP_COMPOSITE,
+    BENCH_OP_UPLOAD,
+    BENCH_OP_DOWNLOAD,
+    BENCH_OP_PIXMAP,
+    BENCH_OP_ALLOC_BUF,
+    BENCH_OP_DUMB_BO,
+    BENCH_OP_BO_CACHE,
+    BENCH_NUM_OPS,
+};
+
+static const char * const benchOpNames[BENCH_NUM_OPS] = {
+    "solid",
+    "copy",
+    "composite",
+    "upload",
+    "download",
+    "pixmap",
+    "alloc_buf",
+    "dumb_bo",
+    "bo_cache",
+};
+
+// the composite fast paths of loongson_composite.c worth timing
+struct bench_format {
+    const char *name;
+    int op;
+    CARD32 src;
+    CARD32 mask;
+    CARD32 dst;
+    // a 1x1 repeating source, the solid colour of the path
+    Bool src_solid;
+};
+
+static const struct bench_format benchFormats[] = {
+    { "over_8888_8888", PictOpOver, PICT_a8r8g8b8, 0, PICT_a8r8g8b8, FALSE },
+    { "over_n_8_8888", PictOpOver, PICT_a8r8g8b8, PICT_a8, PICT_a8r8g8b8, TRUE },
+    { "add_8_8", PictOpAdd, PICT_a8, 0, PICT_a8, FALSE },
+    { "src_x888_8888", PictOpSrc, PICT_x8r8g8b8, 0, PICT_a8r8g8b8, FALSE },
+    { "src_0565_0565", PictOpSrc, PICT_r5g6b5, 0, PICT_r5g6b5, FALSE },
+};
+
+static const struct {
+    const char *name;
+    unsigned usage_hint;
+} benchTargets[] = {
+    { "system", 0 },
+    { "dumb", CREATE_PIXMAP_USAGE_BACKING_PIXMAP },
+};
+
+// the dumb pixmaps XShmPutImage()/XShmGetImage() reach UploadToScreen()
+// and DownloadFromScreen() with; a backing pixmap read back moves to
+// system memory, where the hooks decline
+static const struct {
+    const char *name;
+    unsigned usage_hint;
+} benchTransferTargets[] = {
+    { "shared", CREATE_PIXMAP_USAGE_SHARED },
+    { "scanout", CREATE_PIXMAP_USAGE_SCANOUT },
+};
+
+struct bench_list {
+    int n;
+    int v[BENCH_MAX_LIST];
+};
+
+struct bench_sizes {
+    int n;
+    struct {
+        int width;
+        int height;
+    } v[BENCH_MAX_LIST];
+};
+
+struct bench_ctx {
+    ScrnInfoRec scrn;
+    ScreenRec screen;
+    modesettingPtr ms;
+    ExaDriverPtr pExa;
+
+    // what the current case works on
+    const char *target;
+    unsigned usage_hint;
+    const struct bench_format *pFormat;
+    int width;
+    int height;
+    int bpp;
+    // top left corner of the upload and download rectangle
+    int x;
+    int y;
+    // ExaThreads the worker pool was last set up with
+    int threads;
+
+    PixmapPtr pDst;
+    PixmapPtr pSrc;
+    PixmapPtr pMask;
+    PictureRec dst_pict;
+    PictureRec src_pict;
+    PictureRec mask_pict;
+    void *sys;
+    int sys_pitch;
+
+    // hooks that said no, the EXA core would have done the work itself
+    unsigned long declined;
+
+    uint64_t time_ns;
+};
+
+typedef void (*bench_func)(struct bench_ctx *pCtx);
+
+
+static uint64_t bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+static int bench_cmp(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+
+static unsigned long bench_ioctls(void)
+{
+    unsigned long counts[FAKE_DRM_NUM_IOCTLS];
+    unsigned long sum = 0;
+    int i;
+
+    fake_drm_get_counts(counts);
+
+    for (i = 0; i < FAKE_DRM_NUM_IOCTLS; i++)
+    {
+        sum += counts[i];
+    }
+
+    return sum;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  pixmaps and pictures, the way the EXA core sets them up
+
+static PixmapPtr bench_create_pixmap(struct bench_ctx *pCtx,
+                                     int width, int height,
+                                     int depth, int bpp, unsigned usage_hint)
+{
+    struct bench_pixmap *pBench = calloc(1, sizeof(*pBench));
+    PixmapPtr pPix;
+    int pitch = 0;
+
+    if (pBench == NULL)
+    {
+        return NULL;
+    }
+
+    pBench->driverPriv = pCtx->pExa->CreatePixmap2(&pCtx->screen,
+                                                   width, height, depth,
+                                                   usage_hint, bpp, &pitch);
+    if (pBench->driverPriv == NULL)
+    {
+        free(pBench);
+        return NULL;
+    }
+
+    pPix = &pBench->pixmap;
+    pPix->drawable.type = DRAWABLE_PIXMAP;
+    pPix->drawable.depth = depth;
+    pPix->drawable.bitsPerPixel = bpp;
+    pPix->drawable.width = width;
+    pPix->drawable.height = height;
+    pPix->drawable.pScreen = &pCtx->screen;
+    pPix->drawable.serialNumber = 1;
+    pPix->refcnt = 1;
+    pPix->devKind = pitch;
+    pPix->usage_hint = usage_hint;
+
+    return pPix;
+}
+
+
+static Bool bench_destroy_pixmap(PixmapPtr pPix)
+{
+    struct bench_pixmap *pBench = (struct bench_pixmap *) pPix;
+
+    if (pPix && (--pPix->refcnt == 0))
+    {
+        bench_exa_driver(pPix->drawable.pScreen)->DestroyPixmap(
+                pPix->drawable.pScreen, pBench->driverPriv);
+        free(pBench);
+    }
+
+    return TRUE;
+}
+
+
+static PixmapPtr bench_get_screen_pixmap(ScreenPtr pScreen)
+{
+    return pScreen->devPrivate;
+}
+
+
+// fill like the fb layer would, with the CPU inside an access window
+static void bench_fill_pixmap(struct bench_ctx *pCtx, PixmapPtr pPix,
+                              int value)
+{
+    int y;
+
+    if (!pCtx->pExa->PrepareAccess(pPix, EXA_PREPARE_DEST))
+    {
+        return;
+    }
+
+    for (y = 0; y < pPix->drawable.height; y++)
+    {
+        memset((char *) pPix->devPrivate.ptr + (size_t) y * pPix->devKind,
+               value, pPix->drawable.width * pPix->drawable.bitsPerPixel / 8);
+    }
+
+    pCtx->pExa->FinishAccess(pPix, EXA_PREPARE_DEST);
+}
+
+
+static void bench_init_picture(PicturePtr pPict, PixmapPtr pPix,
+                               CARD32 format, Bool repeat)
+{
+    memset(pPict, 0, sizeof(*pPict));
+    pPict->pDrawable = &pPix->drawable;
+    pPict->format = format;
+    pPict->refcnt = 1;
+    pPict->repeat = repeat;
+    pPict->repeatType = repeat ? RepeatNormal : RepeatNone;
+}
+
+
+static int bench_format_depth(CARD32 format)
+{
+    switch (format)
+    {
+        case PICT_a8r8g8b8:
+        case PICT_a8b8g8r8:
+            return 32;
+        case PICT_x8r8g8b8:
+        case PICT_x8b8g8r8:
+            return 24;
+        case PICT_r5g6b5:
+            return 16;
+        default:
+            return PICT_FORMAT_BPP(format);
+    }
+}
+
+static int bench_bpp_depth(int bpp)
+{
+    return (bpp == 32) ? 24 : bpp;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  the end of a frame, everything queued retires and the dma-buf access
+//  windows close like they do before the flush to the kernel
+
+static void bench_frame(struct bench_ctx *pCtx)
+{
+    pCtx->pExa->WaitMarker(&pCtx->screen, pCtx->pExa->MarkSync(&pCtx->screen));
+    LS_PixmapSyncFlush();
+}
+
+
+static void bench_solid(struct bench_ctx *pCtx)
+{
+    if (pCtx->pExa->PrepareSolid(pCtx->pDst, GXcopy, ~(Pixel) 0, 0x12345678))
+    {
+        pCtx->pExa->Solid(pCtx->pDst, 0, 0, pCtx->width, pCtx->height);
+        pCtx->pExa->DoneSolid(pCtx->pDst);
+    }
+    else
+    {
+        pCtx->declined++;
+    }
+
+    bench_frame(pCtx);
+}
+
+
+static void bench_copy(struct bench_ctx *pCtx)
+{
+    if (pCtx->pExa->PrepareCopy(pCtx->pSrc, pCtx->pDst, 1, 1,
+                                GXcopy, ~(Pixel) 0))
+    {
+        pCtx->pExa->Copy(pCtx->pDst, 0, 0, 0, 0, pCtx->width, pCtx->height);
+        pCtx->pExa->DoneCopy(pCtx->pDst);
+    }
+    else
+    {
+        pCtx->declined++;
+    }
+
+    bench_frame(pCtx);
+}
+
+
+static void bench_composite(struct bench_ctx *pCtx)
+{
+    ExaDriverPtr pExa = pCtx->pExa;
+    PicturePtr pMaskPict = pCtx->pMask ? &pCtx->mask_pict : NULL;
+
+    if (pExa->CheckComposite(pCtx->pFormat->op, &pCtx->src_pict, pMaskPict,
+                             &pCtx->dst_pict) &&
+        pExa->PrepareComposite(pCtx->pFormat->op, &pCtx->src_pict, pMaskPict,
+                               &pCtx->dst_pict, pCtx->pSrc, pCtx->pMask,
+                               pCtx->pDst))
+    {
+        pExa->Composite(pCtx->pDst, 0, 0, 0, 0, 0, 0,
+                        pCtx->width, pCtx->height);
+        pExa->DoneComposite(pCtx->pDst);
+    }
+    else
+    {
+        pCtx->declined++;
+    }
+
+    bench_frame(pCtx);
+}
+
+
+static void bench_upload(struct bench_ctx *pCtx)
+{
+    if (!pCtx->pExa->UploadToScreen(pCtx->pDst, pCtx->x, pCtx->y,
+                                    pCtx->width, pCtx->height,
+                                    pCtx->sys, pCtx->sys_pitch))
+    {
+        pCtx->declined++;
+    }
+
+    bench_frame(pCtx);
+}
+
+
+static void bench_download(struct bench_ctx *pCtx)
+{
+    if (!pCtx->pExa->DownloadFromScreen(pCtx->pDst, pCtx->x, pCtx->y,
+                                        pCtx->width, pCtx->height,
+                                        pCtx->sys, pCtx->sys_pitch))
+    {
+        pCtx->declined++;
+    }
+
+    bench_frame(pCtx);
+}
+
+
+// what creating, filling and destroying a pixmap costs; a fill of the
+// whole pixmap only records the colour, so no pixels are written
+static void bench_pixmap(struct bench_ctx *pCtx)
+{
+    PixmapPtr pPix = bench_create_pixmap(pCtx, pCtx->width, pCtx->height,
+                                         bench_bpp_depth(pCtx->bpp), pCtx->bpp,
+                                         pCtx->usage_hint);
+
+    if (pPix)
+    {
+        pCtx->pDst = pPix;
+        bench_solid(pCtx);
+        pCtx->pDst = NULL;
+        bench_destroy_pixmap(pPix);
+    }
+}
+
+
+static void bench_alloc_buf(struct bench_ctx *pCtx)
+{
+    struct LoongsonBuf buf;
+
+    LS_AllocBuf(pCtx->width, pCtx->height, bench_bpp_depth(pCtx->bpp),
+                pCtx->bpp, 0, &buf);
+    LS_FreeBuf(&buf);
+}
+
+
+static void bench_dumb_bo(struct bench_ctx *pCtx)
+{
+    int fd = pCtx->ms->drmmode.fd;
+    struct dumb_bo *bo = dumb_bo_create(fd, pCtx->width, pCtx->height,
+                                        pCtx->bpp);
+
+    if (bo)
+    {
+        dumb_bo_map(fd, bo);
+        dumb_bo_destroy(fd, bo);
+    }
+}
+
+
+static void bench_bo_cache(struct bench_ctx *pCtx)
+{
+    struct dumb_bo *bo = dumb_bo_cache_alloc(pCtx->ms->bo_cache,
+                                             pCtx->width, pCtx->height,
+                                             pCtx->bpp);
+
+    if (bo)
+    {
+        dumb_bo_cache_release(pCtx->ms->bo_cache, bo);
+    }
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+
+//
+// Run @func until the time budget of the case is spent, print the
+// result. @bytes is the memory traffic of one run, read plus written.
+//
+static void bench_run(struct bench_ctx *pCtx, enum bench_op op,
+                      size_t bytes, bench_func func)
+{
+    static uint64_t samples[BENCH_MAX_RUNS];
+    unsigned long ioctls, fallbacks;
+    uint64_t total = 0;
+    uint64_t t0;
+    int n = 0;
+    int done;
+    int p99;
+
+    // warm the caches, fault the pages in and let pixmaps settle
+    func(pCtx);
+
+    ioctls = bench_ioctls();
+    fallbacks = bench_fallbacks() + pCtx->declined;
+
+    while ((n < BENCH_MAX_RUNS) &&
+           ((n < BENCH_MIN_RUNS) || (total < pCtx->time_ns)))
+    {
+        t0 = bench_now();
+        func(pCtx);
+        samples[n] = bench_now() - t0;
+        total += samples[n++];
+    }
+
+    ioctls = bench_ioctls() - ioctls;
+    fallbacks = bench_fallbacks() + pCtx->declined - fallbacks;
+
+    if (total == 0)
+    {
+        total = 1;
+    }
+
+    // only the runs the driver did the work of moved any bytes
+    done = n - (int) min(fallbacks, (unsigned long) n);
+
+    qsort(samples, n, sizeof(samples[0]), bench_cmp);
+
+    p99 = min(n - 1, (n * 99) / 100);
+
+    printf("{\"op\":\"%s\",\"impl\":\"%s\",\"target\":\"%s\","
+           "\"format\":\"%s\",\"bpp\":%d,\"width\":%d,\"height\":%d,"
+           "\"threads\":%d,\"runs\":%d,\"ops_per_s\":%.1f,\"gb_per_s\":%.3f,"
+           "\"p50_us\":%.2f,\"p99_us\":%.2f,"
+           "\"ioctls_per_op\":%.2f,\"fallbacks\":%lu}\n",
+           benchOpNames[op], lsSimd.name, pCtx->target,
+           pCtx->pFormat ? pCtx->pFormat->name : "",
+           pCtx->bpp, pCtx->width, pCtx->height, pCtx->threads, n,
+           n * 1e9 / total, (double) bytes * done / total,
+           samples[n / 2] / 1e3, samples[p99] / 1e3,
+           (double) ioctls / n, fallbacks);
+    fflush(stdout);
+}
+
+
+static void bench_release(struct bench_ctx *pCtx)
+{
+    bench_destroy_pixmap(pCtx->pDst);
+    bench_destroy_pixmap(pCtx->pSrc);
+    bench_destroy_pixmap(pCtx->pMask);
+    free(pCtx->sys);
+
+    pCtx->pDst = pCtx->pSrc = pCtx->pMask = NULL;
+    pCtx->sys = NULL;
+    pCtx->pFormat = NULL;
+}
+
+
+static void bench_pixmap_case(struct bench_ctx *pCtx, enum bench_op op)
+{
+    int depth = bench_bpp_depth(pCtx->bpp);
+    size_t size = (size_t) pCtx->width * pCtx->height * pCtx->bpp / 8;
+    struct LoongsonSimdFuncs native;
+
+    // one spare row, a fill covering the whole pixmap would only record
+    // the colour
+    pCtx->pDst = bench_create_pixmap(pCtx, pCtx->width, pCtx->height + 1,
+                                     depth, pCtx->bpp, pCtx->usage_hint);
+    if (pCtx->pDst == NULL)
+    {
+        return;
+    }
+
+    bench_fill_pixmap(pCtx, pCtx->pDst, 0x80);
+
+    switch (op)
+    {
+        case BENCH_OP_SOLID:
+            // the generic kernel stores whole words like fbSolid(), the
+            // baseline of the fbFill() path Solid() took before
+            native = lsSimd;
+            LS_SimdSetupGeneric(&lsSimd);
+            bench_run(pCtx, op, size, bench_solid);
+
+            if (strcmp(native.name, lsSimd.name) != 0)
+            {
+                lsSimd = native;
+                bench_run(pCtx, op, size, bench_solid);
+            }
+
+            lsSimd = native;
+            break;
+
+        case BENCH_OP_COPY:
+            pCtx->pSrc = bench_create_pixmap(pCtx, pCtx->width, pCtx->height,
+                                             depth, pCtx->bpp,
+                                             pCtx->usage_hint);
+            if (pCtx->pSrc)
+            {
+                bench_fill_pixmap(pCtx, pCtx->pSrc, 0x40);
+                bench_run(pCtx, op, 2 * size, bench_copy);
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    bench_release(pCtx);
+}
+
+
+//
+// A width x height rectangle moved between a client's shared memory
+// segment and the middle of a screen sized pixmap, what XShmPutImage()
+// and XShmGetImage() of a window that size cost. The pixmap is exported
+// the way DRI3 and PRIME do it, which pins it to its BO: it neither
+// moves to system memory nor gets a mirror, so every run goes through
+// UploadRow()/DownloadRow() on the write-combined mapping.
+//
+static void bench_transfer_case(struct bench_ctx *pCtx, enum bench_op op)
+{
+    int width = max(pCtx->width, BENCH_SCREEN_WIDTH);
+    int height = max(pCtx->height, BENCH_SCREEN_HEIGHT);
+    size_t size = (size_t) pCtx->width * pCtx->height * pCtx->bpp / 8;
+
+    pCtx->pDst = bench_create_pixmap(pCtx, width, height,
+                                     bench_bpp_depth(pCtx->bpp), pCtx->bpp,
+                                     pCtx->usage_hint);
+    if (pCtx->pDst == NULL)
+    {
+        return;
+    }
+
+    bench_fill_pixmap(pCtx, pCtx->pDst, 0x80);
+
+    pCtx->sys_pitch = (pCtx->width * pCtx->bpp / 8 + 63) & ~63;
+    pCtx->sys = calloc(pCtx->height, pCtx->sys_pitch);
+
+    if (pCtx->sys &&
+        ms_exa_bo_from_pixmap(&pCtx->screen, pCtx->pDst) != NULL)
+    {
+        pCtx->x = (width - pCtx->width) / 2;
+        pCtx->y = (height - pCtx->height) / 2;
+
+        bench_run(pCtx, op, 2 * size, (op == BENCH_OP_UPLOAD) ?
+                  bench_upload : bench_download);
+    }
+
+    pCtx->x = pCtx->y = 0;
+
+    bench_release(pCtx);
+}
+
+
+//
+// The source and mask stay in system memory, where the EXA core keeps
+// pictures the client uploads; @pCtx->target says where the destination
+// lives.
+//
+static void bench_composite_case(struct bench_ctx *pCtx,
+                                 const struct bench_format *pFormat)
+{
+    int dst_depth = bench_format_depth(pFormat->dst);
+    int dst_bpp = PICT_FORMAT_BPP(pFormat->dst);
+    int src_w = pFormat->src_solid ? 1 : pCtx->width;
+    int src_h = pFormat->src_solid ? 1 : pCtx->height;
+    size_t bytes;
+
+    pCtx->pFormat = pFormat;
+    pCtx->bpp = dst_bpp;
+
+    pCtx->pDst = bench_create_pixmap(pCtx, pCtx->width, pCtx->height,
+                                     dst_depth, dst_bpp, pCtx->usage_hint);
+    pCtx->pSrc = bench_create_pixmap(pCtx, src_w, src_h,
+                                     bench_format_depth(pFormat->src),
+                                     PICT_FORMAT_BPP(pFormat->src), 0);
+    if (pFormat->mask)
+    {
+        pCtx->pMask = bench_create_pixmap(pCtx, pCtx->width, pCtx->height,
+                                          bench_format_depth(pFormat->mask),
+                                          PICT_FORMAT_BPP(pFormat->mask), 0);
+    }
+
+    if ((pCtx->pDst == NULL) || (pCtx->pSrc == NULL) ||
+        (pFormat->mask && (pCtx->pMask == NULL)))
+    {
+        bench_release(pCtx);
+        return;
+    }
+
+    // half transparent everything, so blending has real work to do
+    bench_fill_pixmap(pCtx, pCtx->pDst, 0x80);
+    bench_fill_pixmap(pCtx, pCtx->pSrc, 0x80);
+    bench_init_picture(&pCtx->dst_pict, pCtx->pDst, pFormat->dst, FALSE);
+    bench_init_picture(&pCtx->src_pict, pCtx->pSrc, pFormat->src,
+                       pFormat->src_solid);
+
+    bytes = (size_t) pCtx->width * pCtx->height *
+            (2 * dst_bpp + (pFormat->src_solid ? 0 :
+                            PICT_FORMAT_BPP(pFormat->src))) / 8;
+
+    if (pCtx->pMask)
+    {
+        bench_fill_pixmap(pCtx, pCtx->pMask, 0x80);
+        bench_init_picture(&pCtx->mask_pict, pCtx->pMask, pFormat->mask,
+                           FALSE);
+        bytes += (size_t) pCtx->width * pCtx->height *
+                 PICT_FORMAT_BPP(pFormat->mask) / 8;
+    }
+
+    bench_run(pCtx, BENCH_OP_COMPOSITE, bytes, bench_composite);
+
+    bench_release(pCtx);
+}
+
+
+//
+// Restart the worker pool with @threads threads, the way the server
+// would come up with Option "ExaThreads". Nothing may be queued.
+//
+static void bench_set_threads(struct bench_ctx *pCtx, int threads)
+{
+    OptionInfoPtr pOpt;
+
+    for (pOpt = pCtx->ms->drmmode.Options; pOpt->token >= 0; pOpt++)
+    {
+        if (pOpt->token == OPTION_EXA_THREADS)
+        {
+            pOpt->value.num = threads;
+            pOpt->found = TRUE;
+        }
+    }
+
+    LS_ThreadPoolFini(&pCtx->scrn);
+    LS_ThreadPoolInit(&pCtx->scrn);
+
+    pCtx->threads = threads;
+}
+
+
+// the pixel ops at the current size, for every target
+static void bench_sweep_targets(struct bench_ctx *pCtx, unsigned int ops,
+                                const struct bench_list *pBpps)
+{
+    unsigned int t, f;
+    int b;
+
+    for (t = 0; t < ARRAY_SIZE(benchTargets); t++)
+    {
+        pCtx->target = benchTargets[t].name;
+        pCtx->usage_hint = benchTargets[t].usage_hint;
+
+        for (b = 0; b < pBpps->n; b++)
+        {
+            enum bench_op op;
+
+            pCtx->bpp = pBpps->v[b];
+
+            for (op = BENCH_OP_SOLID; op <= BENCH_OP_COPY; op++)
+            {
+                if (ops & (1u << op))
+                {
+                    bench_pixmap_case(pCtx, op);
+                }
+            }
+
+            if (ops & (1u << BENCH_OP_PIXMAP))
+            {
+                bench_run(pCtx, BENCH_OP_PIXMAP, 0, bench_pixmap);
+            }
+        }
+
+        if (ops & (1u << BENCH_OP_COMPOSITE))
+        {
+            for (f = 0; f < ARRAY_SIZE(benchFormats); f++)
+            {
+                bench_composite_case(pCtx, &benchFormats[f]);
+            }
+        }
+    }
+
+    // UploadToScreen() and DownloadFromScreen() only take dumb pixmaps,
+    // EXA copies the rest itself
+    for (t = 0; t < ARRAY_SIZE(benchTransferTargets); t++)
+    {
+        pCtx->target = benchTransferTargets[t].name;
+        pCtx->usage_hint = benchTransferTargets[t].usage_hint;
+
+        for (b = 0; b < pBpps->n; b++)
+        {
+            enum bench_op op;
+
+            pCtx->bpp = pBpps->v[b];
+
+            for (op = BENCH_OP_UPLOAD; op <= BENCH_OP_DOWNLOAD; op++)
+            {
+                if (ops & (1u << op))
+                {
+                    bench_transfer_case(pCtx, op);
+                }
+            }
+        }
+    }
+}
+
+
+static void bench_sweep(struct bench_ctx *pCtx, unsigned int ops,
+                        const struct bench_sizes *pSizes,
+                        const struct bench_list *pBpps,
+                        const struct bench_list *pThreads)
+{
+    int s, b, p;
+
+    for (s = 0; s < pSizes->n; s++)
+    {
+        pCtx->width = pSizes->v[s].width;
+        pCtx->height = pSizes->v[s].height;
+
+        // the pixel ops once per pool size, to show how they scale
+        for (p = 0; p < pThreads->n; p++)
+        {
+            bench_set_threads(pCtx, pThreads->v[p]);
+            bench_sweep_targets(pCtx, ops, pBpps);
+        }
+
+        // the allocators below the pixmaps, no pixels are touched
+        for (b = 0; b < pBpps->n; b++)
+        {
+            pCtx->bpp = pBpps->v[b];
+
+            if (ops & (1u << BENCH_OP_ALLOC_BUF))
+            {
+                pCtx->target = "system";
+                bench_run(pCtx, BENCH_OP_ALLOC_BUF, 0, bench_alloc_buf);
+            }
+
+            pCtx->target = "dumb";
+
+            if (ops & (1u << BENCH_OP_DUMB_BO))
+            {
+                bench_run(pCtx, BENCH_OP_DUMB_BO, 0, bench_dumb_bo);
+            }
+
+            if (ops & (1u << BENCH_OP_BO_CACHE))
+            {
+                bench_run(pCtx, BENCH_OP_BO_CACHE, 0, bench_bo_cache);
+            }
+        }
+    }
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+
+static Bool bench_setup(struct bench_ctx *pCtx, const char **options)
+{
+    ScrnInfoPtr pScrn = &pCtx->scrn;
+    ScreenPtr pScreen = &pCtx->screen;
+    modesettingPtr ms;
+
+    ms = pCtx->ms = calloc(1, sizeof(*ms));
+    if (ms == NULL)
+    {
+        return FALSE;
+    }
+
+    pScrn->driverPrivate = ms;
+    pScrn->options = options;
+    pScrn->bitsPerPixel = 32;
+    pScrn->depth = 24;
+    pScrn->virtualX = pScrn->displayWidth = 1920;
+    pScrn->virtualY = 1080;
+    pScrn->vtSema = TRUE;
+
+    pScreen->width = pScrn->virtualX;
+    pScreen->height = pScrn->virtualY;
+    pScreen->rootDepth = pScrn->depth;
+    pScreen->DestroyPixmap = bench_destroy_pixmap;
+    pScreen->GetScreenPixmap = bench_get_screen_pixmap;
+
+    bench_add_screen(pScrn, pScreen);
+
+    ms->fd = ms->drmmode.fd = fake_drm_open();
+    if (ms->fd < 0)
+    {
+        perror("fake_drm_open");
+        return FALSE;
+    }
+
+    // what PreInit() and ScreenInit() do for EXA
+    LS_ProcessOptions(pScrn, &ms->drmmode.Options);
+    try_enable_exa(pScrn);
+    LS_SimdInit();
+
+    if (!ms->drmmode.exa_enabled || !LS_InitExaLayer(pScreen))
+    {
+        fprintf(stderr, "EXA did not come up\n");
+        return FALSE;
+    }
+
+    pCtx->pExa = bench_exa_driver(pScreen);
+
+    pScreen->devPrivate = bench_create_pixmap(pCtx, pScreen->width,
+                                              pScreen->height, pScrn->depth,
+                                              pScrn->bitsPerPixel,
+                                              CREATE_PIXMAP_USAGE_SCANOUT);
+
+    return pScreen->devPrivate != NULL;
+}
+
+
+static void bench_teardown(struct bench_ctx *pCtx)
+{
+    unsigned long counts[FAKE_DRM_NUM_IOCTLS];
+    unsigned long bos;
+    uint64_t bytes;
+    int i;
+
+    LS_DestroyExaLayer(&pCtx->screen);
+
+    fake_drm_get_counts(counts);
+    fake_drm_get_usage(&bos, &bytes);
+
+    for (i = 0; i < FAKE_DRM_NUM_IOCTLS; i++)
+    {
+        fprintf(stderr, "fake drm: %-20s %lu\n",
+                fake_drm_ioctl_name(i), counts[i]);
+    }
+
+    // everything should have been given back by now
+    fprintf(stderr, "fake drm: %lu BOs with %llu bytes left\n",
+            bos, (unsigned long long) bytes);
+
+    fake_drm_close(pCtx->ms->drmmode.fd);
+    free(pCtx->ms->drmmode.Options);
+    free(pCtx->ms);
+}
+
+
+static Bool bench_parse_list(const char *str, struct bench_list *pList)
+{
+    char *end;
+
+    pList->n = 0;
+
+    do
+    {
+        long v = strtol(str, &end, 10);
+
+        if ((end == str) || (v <= 0) || (v > 8192) ||
+            (pList->n == BENCH_MAX_LIST))
+        {
+            return FALSE;
+        }
+
+        pList->v[pList->n++] = v;
+        str = end + 1;
+    } while (*end == ',');
+
+    return *end == '\0';
+}
+
+
+// square sizes like 256 or WxH like 1920x1080
+static Bool bench_parse_sizes(const char *str, struct bench_sizes *pSizes)
+{
+    char *end;
+
+    pSizes->n = 0;
+
+    do
+    {
+        long w = strtol(str, &end, 10);
+        long h = w;
+
+        if (*end == 'x')
+        {
+            str = end + 1;
+            h = strtol(str, &end, 10);
+        }
+
+        if ((end == str) || (w <= 0) || (w > 8192) || (h <= 0) ||
+            (h > 8192) || (pSizes->n == BENCH_MAX_LIST))
+        {
+            return FALSE;
+        }
+
+        pSizes->v[pSizes->n].width = w;
+        pSizes->v[pSizes->n].height = h;
+        pSizes->n++;
+        str = end + 1;
+    } while (*end == ',');
+
+    return *end == '\0';
+}
+
+
+static Bool bench_parse_ops(char *str, unsigned int *pOps)
+{
+    char *tok;
+    int i;
+
+    *pOps = 0;
+
+    for (tok = strtok(str, ","); tok; tok = strtok(NULL, ","))
+    {
+        for (i = 0; i < BENCH_NUM_OPS; i++)
+        {
+            if (strcmp(tok, benchOpNames[i]) == 0)
+            {
+                break;
+            }
+        }
+
+        if (i == BENCH_NUM_OPS)
+        {
+            return FALSE;
+        }
+
+        *pOps |= 1u << i;
+    }
+
+    return *pOps != 0;
+}
+
+
+static void bench_usage(const char *prog)
+{
+    int i;
+
+    fprintf(stderr,
+            "usage: %s [-s sizes] [-b bpps] [-k ops] [-p threads] [-t ms]"
+            " [-o Option=value]...\n"
+            "  -s  pixmap sizes, N for NxN or WxH,"
+            " default 16,64,256,1024,1920x1080,3840x2160\n"
+            "  -b  bits per pixel of solid, copy, upload and download,"
+            " default 8,16,32\n"
+            "  -k  ops to run, default all of:",
+            prog);
+
+    for (i = 0; i < BENCH_NUM_OPS; i++)
+    {
+        fprintf(stderr, "%s%s", i ? "," : " ", benchOpNames[i]);
+    }
+
+    fprintf(stderr,
+            "\n"
+            "  -p  ExaThreads to run the pixel ops with,"
+            " default 1 up to the CPUs online\n"
+            "  -t  time spent on each case in milliseconds, default 50\n"
+            "  -o  driver option as in xorg.conf, e.g. -o ExaAsync=on\n");
+}
+
+
+int main(int argc, char **argv)
+{
+    static const char *options[BENCH_MAX_OPTIONS + 3] = {
+        "AccelMethod=exa",
+        "ExaType=software",
+    };
+    struct bench_sizes sizes = { 6, {
+        { 16, 16 }, { 64, 64 }, { 256, 256 }, { 1024, 1024 },
+        { 1920, 1080 }, { 3840, 2160 },
+    } };
+    struct bench_list bpps = { 3, { 8, 16, 32 } };
+    struct bench_list threads = { 0 };
+    unsigned int ops = (1u << BENCH_NUM_OPS) - 1;
+    int nOptions = 2;
+    struct bench_ctx ctx;
+    long ncpu;
+    int c;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.time_ns = 50 * 1000000ull;
+
+    while ((c = getopt(argc, argv, "s:b:k:p:t:o:h")) != -1)
+    {
+        switch (c)
+        {
+            case 's':
+                if (!bench_parse_sizes(optarg, &sizes))
+                {
+                    bench_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'b':
+                if (!bench_parse_list(optarg, &bpps))
+                {
+                    bench_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'k':
+                if (!bench_parse_ops(optarg, &ops))
+                {
+                    bench_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'p':
+                if (!bench_parse_list(optarg, &threads))
+                {
+                    bench_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 't':
+                ctx.time_ns = strtoull(optarg, NULL, 10) * 1000000ull;
+                break;
+            case 'o':
+                if (nOptions == BENCH_MAX_OPTIONS)
+                {
+                    bench_usage(argv[0]);
+                    return 1;
+                }
+                // later options override the defaults above
+                options[nOptions++] = optarg;
+                break;
+            default:
+                bench_usage(argv[0]);
+                return (c == 'h') ? 0 : 1;
+        }
+    }
+
+    // every pool size from a single thread up to one per CPU
+    if (threads.n == 0)
+    {
+        ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+        for (threads.n = 0; threads.n < min(max(ncpu, 1), BENCH_MAX_LIST);
+             threads.n++)
+        {
+            threads.v[threads.n] = threads.n + 1;
+        }
+    }
+
+    if (!bench_setup(&ctx, options))
+    {
+        return 1;
+    }
+
+    bench_sweep(&ctx, ops, &sizes, &bpps, &threads);
+
+    bench_teardown(&ctx);
+
+    return 0;
+}
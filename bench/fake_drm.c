@@ -0,0 +1,1836 @@
+/*
+ * Copyright © 2026 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/dma-buf.h>
+
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include "fake_drm.h"
+
+#define FAKE_DRM_PAGE       4096
+#define FAKE_DRM_PITCH      64
+
+#define FAKE_DRM_CRTC_BASE  0x40
+#define FAKE_DRM_PLANE_BASE 0x50
+#define FAKE_DRM_FB_BASE    0x100
+
+// what the kernel lets a file have in events not read yet
+#define FAKE_DRM_EVENT_SPACE    4096
+
+struct fake_drm_bo {
+    uint64_t offset;
+    // the range reserved at @offset, may be more than the BO uses
+    uint64_t reserved;
+    uint64_t size;
+    int live;
+};
+
+struct fake_drm_fb {
+    uint32_t handle;
+    int live;
+};
+
+struct fake_drm_crtc {
+    uint32_t fb;
+    // the flip latched at the next vblank, 0 if none
+    uint32_t flip_fb;
+    int flip_pending;
+};
+
+// an event or flip waiting for vblank @msc of crtc @pipe
+struct fake_drm_event {
+    uint32_t type;
+    int pipe;
+    uint64_t msc;
+    uint64_t user_data;
+    // DRM_EVENT_FLIP_COMPLETE without DRM_MODE_PAGE_FLIP_EVENT
+    int silent;
+};
+
+struct _drmModeAtomicReq {
+    uint32_t cursor;
+    uint32_t size;
+    struct fake_drm_atomic_item {
+        uint32_t object_id;
+        uint32_t property_id;
+        uint64_t value;
+        uint32_t cursor;
+    } *items;
+};
+
+static struct {
+    pthread_mutex_t lock;
+
+    int fd;
+    int write_fd;
+    int aperture;
+    uint64_t aperture_end;
+
+    struct fake_drm_bo *bos;
+    uint32_t nbos;
+    uint32_t live;
+    uint64_t live_bytes;
+
+    // handle of each PRIME fd we handed out, indexed by fd
+    uint32_t *prime;
+    int nprime;
+
+    struct fake_drm_fb *fbs;
+    uint32_t nfbs;
+
+    // where DMA_BUF_IOCTL_SYNC is recorded, if anywhere
+    struct fake_drm_sync *syncs;
+    int max_syncs;
+    int nsyncs;
+
+    // the display and its vblank clock: vblank @msc was at @msc_ns, the
+    // clock runs from @base_msc at @base_ns in steps of frame_ns
+    struct fake_drm_display display;
+    struct fake_drm_crtc crtcs[FAKE_DRM_MAX_CRTCS];
+    pthread_t clock;
+    int clock_running;
+    int clock_stop;
+    pthread_cond_t clock_cond;
+    pthread_cond_t vblank_cond;
+    uint64_t base_ns;
+    uint64_t base_msc;
+    uint64_t msc;
+    uint64_t msc_ns;
+    uint64_t delay_ns;
+    unsigned int seed;
+
+    struct fake_drm_event *events;
+    int nevents;
+    int size_events;
+    int event_space;
+
+    unsigned long counts[FAKE_DRM_NUM_IOCTLS];
+} fakeDrm = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .vblank_cond = PTHREAD_COND_INITIALIZER,
+    .fd = -1,
+    .write_fd = -1,
+    .aperture = -1,
+};
+
+static const char * const fakeDrmIoctlNames[FAKE_DRM_NUM_IOCTLS] = {
+    "CREATE_DUMB",
+    "MAP_DUMB",
+    "DESTROY_DUMB",
+    "PRIME_HANDLE_TO_FD",
+    "PRIME_FD_TO_HANDLE",
+    "DMA_BUF_SYNC",
+    "GET_CAP",
+    "ADDFB",
+    "ADDFB2",
+    "RMFB",
+    "PAGE_FLIP",
+    "ATOMIC",
+    "CRTC_GET_SEQUENCE",
+    "CRTC_QUEUE_SEQUENCE",
+    "WAIT_VBLANK",
+};
+
+
+void *__real_mmap(void *addr, size_t length, int prot, int flags,
+                  int fd, off_t offset);
+void *__wrap_mmap(void *addr, size_t length, int prot, int flags,
+                  int fd, off_t offset);
+
+
+static struct fake_drm_bo * fake_drm_lookup(uint32_t handle)
+{
+    if ((handle == 0) || (handle > fakeDrm.nbos) ||
+        !fakeDrm.bos[handle - 1].live)
+    {
+        return NULL;
+    }
+
+    return &fakeDrm.bos[handle - 1];
+}
+
+// handle of the PRIME fd @fd, 0 if it isn't one of ours
+static uint32_t fake_drm_prime_handle(int fd)
+{
+    if ((fd < 0) || (fd >= fakeDrm.nprime))
+    {
+        return 0;
+    }
+
+    return fakeDrm.prime[fd];
+}
+
+
+int fake_drm_open(void)
+{
+    int fds[2];
+
+    if (fakeDrm.fd >= 0)
+    {
+        errno = EBUSY;
+        return -1;
+    }
+
+    fakeDrm.aperture = memfd_create("fake-drm", MFD_CLOEXEC);
+    if (fakeDrm.aperture < 0)
+    {
+        return -1;
+    }
+
+    // the read end stands for the device, it polls readable when an
+    // event is pending like a real DRM fd does
+    if (pipe2(fds, O_CLOEXEC | O_NONBLOCK))
+    {
+        close(fakeDrm.aperture);
+        fakeDrm.aperture = -1;
+        return -1;
+    }
+
+    fakeDrm.fd = fds[0];
+    fakeDrm.write_fd = fds[1];
+    fakeDrm.aperture_end = 0;
+    fakeDrm.event_space = FAKE_DRM_EVENT_SPACE;
+
+    return fakeDrm.fd;
+}
+
+
+void fake_drm_close(int fd)
+{
+    if (fd != fakeDrm.fd)
+    {
+        return;
+    }
+
+    if (fakeDrm.clock_running)
+    {
+        pthread_mutex_lock(&fakeDrm.lock);
+        fakeDrm.clock_stop = 1;
+        pthread_cond_signal(&fakeDrm.clock_cond);
+        pthread_mutex_unlock(&fakeDrm.lock);
+
+        pthread_join(fakeDrm.clock, NULL);
+        pthread_cond_destroy(&fakeDrm.clock_cond);
+        fakeDrm.clock_running = fakeDrm.clock_stop = 0;
+    }
+
+    close(fakeDrm.fd);
+    close(fakeDrm.write_fd);
+    close(fakeDrm.aperture);
+
+    free(fakeDrm.bos);
+    free(fakeDrm.prime);
+    free(fakeDrm.fbs);
+    free(fakeDrm.events);
+
+    fakeDrm.fd = fakeDrm.write_fd = fakeDrm.aperture = -1;
+    fakeDrm.bos = NULL;
+    fakeDrm.nbos = fakeDrm.live = 0;
+    fakeDrm.live_bytes = 0;
+    fakeDrm.prime = NULL;
+    fakeDrm.nprime = 0;
+    fakeDrm.fbs = NULL;
+    fakeDrm.nfbs = 0;
+    fakeDrm.events = NULL;
+    fakeDrm.nevents = fakeDrm.size_events = 0;
+    memset(&fakeDrm.display, 0, sizeof(fakeDrm.display));
+    memset(fakeDrm.crtcs, 0, sizeof(fakeDrm.crtcs));
+}
+
+
+const char * fake_drm_ioctl_name(enum fake_drm_ioctl ioctl)
+{
+    return fakeDrmIoctlNames[ioctl];
+}
+
+
+void fake_drm_get_counts(unsigned long counts[FAKE_DRM_NUM_IOCTLS])
+{
+    pthread_mutex_lock(&fakeDrm.lock);
+    memcpy(counts, fakeDrm.counts, sizeof(fakeDrm.counts));
+    pthread_mutex_unlock(&fakeDrm.lock);
+}
+
+
+void fake_drm_reset_counts(void)
+{
+    pthread_mutex_lock(&fakeDrm.lock);
+    memset(fakeDrm.counts, 0, sizeof(fakeDrm.counts));
+    pthread_mutex_unlock(&fakeDrm.lock);
+}
+
+
+void fake_drm_get_usage(unsigned long *bos, uint64_t *bytes)
+{
+    pthread_mutex_lock(&fakeDrm.lock);
+    *bos = fakeDrm.live;
+    *bytes = fakeDrm.live_bytes;
+    pthread_mutex_unlock(&fakeDrm.lock);
+}
+
+
+void fake_drm_record_syncs(struct fake_drm_sync *log, int max)
+{
+    pthread_mutex_lock(&fakeDrm.lock);
+    fakeDrm.syncs = log;
+    fakeDrm.max_syncs = log ? max : 0;
+    fakeDrm.nsyncs = 0;
+    pthread_mutex_unlock(&fakeDrm.lock);
+}
+
+
+int fake_drm_recorded_syncs(void)
+{
+    int n;
+
+    pthread_mutex_lock(&fakeDrm.lock);
+    n = fakeDrm.nsyncs;
+    pthread_mutex_unlock(&fakeDrm.lock);
+
+    return n;
+}
+
+
+uint32_t fake_drm_crtc_id(int pipe)
+{
+    return FAKE_DRM_CRTC_BASE + pipe;
+}
+
+
+uint32_t fake_drm_plane_id(int pipe)
+{
+    return FAKE_DRM_PLANE_BASE + pipe;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  dumb buffers
+
+//
+// A freed handle keeps its range of the memfd, the next BO that fits
+// in it without wasting more than half takes both. Everything else
+// gets a new range at the end, the memfd is sparse.
+//
+static int fake_drm_create_dumb(struct drm_mode_create_dumb *arg)
+{
+    struct fake_drm_bo *bo = NULL;
+    uint64_t size;
+    uint32_t i;
+
+    if ((arg->width == 0) || (arg->height == 0) || (arg->bpp == 0))
+    {
+        return -EINVAL;
+    }
+
+    arg->pitch = ((arg->width * ((arg->bpp + 7) / 8)) + FAKE_DRM_PITCH - 1) &
+                 ~(FAKE_DRM_PITCH - 1);
+    size = ((uint64_t) arg->pitch * arg->height + FAKE_DRM_PAGE - 1) &
+           ~(uint64_t) (FAKE_DRM_PAGE - 1);
+
+    for (i = 0; i < fakeDrm.nbos; i++)
+    {
+        struct fake_drm_bo *pFree = &fakeDrm.bos[i];
+
+        if (!pFree->live && (pFree->reserved >= size) &&
+            (pFree->reserved <= 2 * size))
+        {
+            bo = pFree;
+            break;
+        }
+    }
+
+    if (bo == NULL)
+    {
+        struct fake_drm_bo *bos;
+
+        bos = realloc(fakeDrm.bos, (fakeDrm.nbos + 1) * sizeof(*bos));
+        if (bos == NULL)
+        {
+            return -ENOMEM;
+        }
+
+        fakeDrm.bos = bos;
+        bo = &bos[fakeDrm.nbos++];
+        bo->offset = fakeDrm.aperture_end;
+        bo->reserved = size;
+
+        if (ftruncate(fakeDrm.aperture, bo->offset + size))
+        {
+            fakeDrm.nbos--;
+            return -ENOMEM;
+        }
+
+        fakeDrm.aperture_end += size;
+    }
+
+    bo->size = size;
+    bo->live = 1;
+
+    fakeDrm.live++;
+    fakeDrm.live_bytes += size;
+
+    arg->handle = (uint32_t) (bo - fakeDrm.bos) + 1;
+    arg->size = size;
+
+    return 0;
+}
+
+static int fake_drm_map_dumb(struct drm_mode_map_dumb *arg)
+{
+    struct fake_drm_bo *bo = fake_drm_lookup(arg->handle);
+
+    if (bo == NULL)
+    {
+        return -ENOENT;
+    }
+
+    arg->offset = bo->offset;
+
+    return 0;
+}
+
+static int fake_drm_destroy_dumb(struct drm_mode_destroy_dumb *arg)
+{
+    struct fake_drm_bo *bo = fake_drm_lookup(arg->handle);
+
+    if (bo == NULL)
+    {
+        return -ENOENT;
+    }
+
+    // the pages go back like the kernel's do, the next user of the
+    // range starts from zeroed memory
+    fallocate(fakeDrm.aperture, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+              bo->offset, bo->reserved);
+
+    bo->live = 0;
+    fakeDrm.live--;
+    fakeDrm.live_bytes -= bo->size;
+
+    return 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  PRIME and dma-buf
+
+static int fake_drm_prime_export(struct drm_prime_handle *arg)
+{
+    int fd;
+
+    if (fake_drm_lookup(arg->handle) == NULL)
+    {
+        return -ENOENT;
+    }
+
+    fd = fcntl(fakeDrm.aperture,
+               (arg->flags & DRM_CLOEXEC) ? F_DUPFD_CLOEXEC : F_DUPFD, 0);
+    if (fd < 0)
+    {
+        return -errno;
+    }
+
+    if (fd >= fakeDrm.nprime)
+    {
+        int n = fd + 64;
+        uint32_t *prime = realloc(fakeDrm.prime, n * sizeof(*prime));
+
+        if (prime == NULL)
+        {
+            close(fd);
+            return -ENOMEM;
+        }
+
+        memset(prime + fakeDrm.nprime, 0,
+               (n - fakeDrm.nprime) * sizeof(*prime));
+        fakeDrm.prime = prime;
+        fakeDrm.nprime = n;
+    }
+
+    // a closed PRIME fd is never reported, its number may have been
+    // recycled for this one
+    fakeDrm.prime[fd] = arg->handle;
+    arg->fd = fd;
+
+    return 0;
+}
+
+static int fake_drm_prime_import(struct drm_prime_handle *arg)
+{
+    uint32_t handle = fake_drm_prime_handle(arg->fd);
+
+    if ((handle == 0) || (fake_drm_lookup(handle) == NULL))
+    {
+        return -EINVAL;
+    }
+
+    arg->handle = handle;
+
+    return 0;
+}
+
+static int fake_drm_dma_buf_sync(int fd, struct dma_buf_sync *arg)
+{
+    if ((arg->flags & ~DMA_BUF_SYNC_VALID_FLAGS_MASK) ||
+        !(arg->flags & DMA_BUF_SYNC_RW))
+    {
+        return -EINVAL;
+    }
+
+    if (fakeDrm.nsyncs < fakeDrm.max_syncs)
+    {
+        fakeDrm.syncs[fakeDrm.nsyncs].handle = fake_drm_prime_handle(fd);
+        fakeDrm.syncs[fakeDrm.nsyncs].flags = arg->flags;
+        fakeDrm.nsyncs++;
+    }
+
+    return 0;
+}
+
+static int fake_drm_get_cap(struct drm_get_cap *arg)
+{
+    switch (arg->capability)
+    {
+        case DRM_CAP_DUMB_BUFFER:
+        case DRM_CAP_TIMESTAMP_MONOTONIC:
+        case DRM_CAP_VBLANK_HIGH_CRTC:
+            arg->value = 1;
+            return 0;
+        case DRM_CAP_PRIME:
+            arg->value = 3;
+            return 0;
+        case DRM_CAP_DUMB_PREFERRED_DEPTH:
+            arg->value = 24;
+            return 0;
+        case DRM_CAP_CURSOR_WIDTH:
+        case DRM_CAP_CURSOR_HEIGHT:
+            arg->value = 64;
+            return 0;
+        case DRM_CAP_CRTC_IN_VBLANK_EVENT:
+            arg->value = 1;
+            return 0;
+        case DRM_CAP_ASYNC_PAGE_FLIP:
+            arg->value = fakeDrm.display.async_flip;
+            return 0;
+        default:
+            arg->value = 0;
+            return 0;
+    }
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  vblank events and the clock driving them, all under fakeDrm.lock
+
+static uint64_t fake_drm_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// how late the next vblank interrupt is handled
+static uint64_t fake_drm_jitter(void)
+{
+    if (fakeDrm.display.jitter_us == 0)
+    {
+        return 0;
+    }
+
+    return (uint64_t) (rand_r(&fakeDrm.seed) %
+                       (fakeDrm.display.jitter_us + 1)) * 1000;
+}
+
+static uint32_t fake_drm_event_size(uint32_t type)
+{
+    return (type == DRM_EVENT_CRTC_SEQUENCE) ?
+           sizeof(struct drm_event_crtc_sequence) :
+           sizeof(struct drm_event_vblank);
+}
+
+//
+// Write the event into the device fd, reporting vblank @msc at @ns like
+// the kernel reports the vblank it sends an event from
+//
+static void fake_drm_send(const struct fake_drm_event *ev, uint64_t msc,
+                          uint64_t ns)
+{
+    union {
+        struct drm_event base;
+        struct drm_event_vblank vbl;
+        struct drm_event_crtc_sequence seq;
+    } e;
+
+    memset(&e, 0, sizeof(e));
+    e.base.type = ev->type;
+    e.base.length = fake_drm_event_size(ev->type);
+
+    if (ev->type == DRM_EVENT_CRTC_SEQUENCE)
+    {
+        e.seq.user_data = ev->user_data;
+        e.seq.time_ns = ns;
+        e.seq.sequence = msc;
+    }
+    else
+    {
+        e.vbl.user_data = ev->user_data;
+        e.vbl.tv_sec = ns / 1000000000ull;
+        e.vbl.tv_usec = (ns % 1000000000ull) / 1000;
+        e.vbl.sequence = (uint32_t) msc;
+        e.vbl.crtc_id = fake_drm_crtc_id(ev->pipe);
+    }
+
+    // the pipe holds far more than the event space, a short write only
+    // happens if the reader went away
+    if (write(fakeDrm.write_fd, &e, e.base.length) != (ssize_t) e.base.length)
+    {
+        fakeDrm.event_space += e.base.length;
+    }
+}
+
+static void fake_drm_complete(const struct fake_drm_event *ev)
+{
+    if (ev->type == DRM_EVENT_FLIP_COMPLETE)
+    {
+        struct fake_drm_crtc *crtc = &fakeDrm.crtcs[ev->pipe];
+
+        crtc->fb = crtc->flip_fb;
+        crtc->flip_pending = 0;
+    }
+
+    if (!ev->silent)
+    {
+        fake_drm_send(ev, fakeDrm.msc, fakeDrm.msc_ns);
+    }
+}
+
+//
+// Queue an event for vblank @msc, or send it right away if that one
+// has been. The space for it in the fd is reserved now, the way the
+// kernel does, and given back by drmHandleEvent().
+//
+static int fake_drm_queue_event(uint32_t type, int pipe, uint64_t msc,
+                                uint64_t user_data, int silent)
+{
+    struct fake_drm_event ev = {
+        .type = type,
+        .pipe = pipe,
+        .msc = msc,
+        .user_data = user_data,
+        .silent = silent,
+    };
+
+    if (!silent)
+    {
+        if (fakeDrm.event_space < (int) fake_drm_event_size(type))
+        {
+            return -ENOMEM;
+        }
+
+        fakeDrm.event_space -= fake_drm_event_size(type);
+    }
+
+    if (msc <= fakeDrm.msc)
+    {
+        fake_drm_complete(&ev);
+        return 0;
+    }
+
+    if (fakeDrm.nevents == fakeDrm.size_events)
+    {
+        int size = fakeDrm.size_events ? 2 * fakeDrm.size_events : 16;
+        struct fake_drm_event *events;
+
+        events = realloc(fakeDrm.events, size * sizeof(*events));
+        if (events == NULL)
+        {
+            if (!silent)
+            {
+                fakeDrm.event_space += fake_drm_event_size(type);
+            }
+
+            return -ENOMEM;
+        }
+
+        fakeDrm.events = events;
+        fakeDrm.size_events = size;
+    }
+
+    fakeDrm.events[fakeDrm.nevents++] = ev;
+
+    return 0;
+}
+
+// the vblank interrupt: flips latch and due events go out in the order
+// they were queued
+static void fake_drm_vblank(void)
+{
+    int i, n = 0;
+
+    for (i = 0; i < fakeDrm.nevents; i++)
+    {
+        if (fakeDrm.events[i].msc <= fakeDrm.msc)
+        {
+            fake_drm_complete(&fakeDrm.events[i]);
+        }
+        else
+        {
+            fakeDrm.events[n++] = fakeDrm.events[i];
+        }
+    }
+
+    fakeDrm.nevents = n;
+
+    pthread_cond_broadcast(&fakeDrm.vblank_cond);
+}
+
+//
+// A vblank every frame_ns, handled delay_ns late. When the delay runs
+// past the next vblank the count jumps, like it does when the interrupt
+// handler of a real device is held off that long.
+//
+static void *fake_drm_clock(void *arg)
+{
+    pthread_mutex_lock(&fakeDrm.lock);
+
+    while (!fakeDrm.clock_stop)
+    {
+        uint64_t frame_ns = fakeDrm.display.frame_ns;
+        uint64_t wake = fakeDrm.base_ns + fakeDrm.delay_ns +
+                        (fakeDrm.msc - fakeDrm.base_msc + 1) * frame_ns;
+        struct timespec ts = {
+            .tv_sec = wake / 1000000000ull,
+            .tv_nsec = wake % 1000000000ull,
+        };
+        uint64_t now, frames;
+
+        pthread_cond_timedwait(&fakeDrm.clock_cond, &fakeDrm.lock, &ts);
+
+        // woken up early, for a new display or to stop
+        now = fake_drm_now();
+        if (fakeDrm.clock_stop || (now < wake))
+        {
+            continue;
+        }
+
+        frames = (now - fakeDrm.base_ns) / frame_ns;
+        fakeDrm.msc = fakeDrm.base_msc + frames;
+        fakeDrm.msc_ns = fakeDrm.base_ns + frames * frame_ns;
+        fakeDrm.delay_ns = fake_drm_jitter();
+
+        fake_drm_vblank();
+    }
+
+    pthread_mutex_unlock(&fakeDrm.lock);
+
+    return NULL;
+}
+
+
+int fake_drm_set_display(const struct fake_drm_display *display)
+{
+    pthread_condattr_t attr;
+    int ret = 0;
+
+    if ((fakeDrm.fd < 0) || (display->num_crtcs < 0) ||
+        (display->num_crtcs > FAKE_DRM_MAX_CRTCS) ||
+        (display->frame_ns == 0))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&fakeDrm.lock);
+
+    if (!fakeDrm.clock_running)
+    {
+        fakeDrm.msc = 0;
+        fakeDrm.msc_ns = fake_drm_now();
+        fakeDrm.seed = 1;
+    }
+
+    // the count goes on from the last vblank, at the new rate
+    fakeDrm.display = *display;
+    fakeDrm.base_ns = fakeDrm.msc_ns;
+    fakeDrm.base_msc = fakeDrm.msc;
+    fakeDrm.delay_ns = fake_drm_jitter();
+
+    if (fakeDrm.clock_running)
+    {
+        pthread_cond_signal(&fakeDrm.clock_cond);
+    }
+    else
+    {
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&fakeDrm.clock_cond, &attr);
+        pthread_condattr_destroy(&attr);
+
+        ret = pthread_create(&fakeDrm.clock, NULL, fake_drm_clock, NULL);
+        if (ret)
+        {
+            pthread_cond_destroy(&fakeDrm.clock_cond);
+        }
+
+        fakeDrm.clock_running = (ret == 0);
+    }
+
+    pthread_mutex_unlock(&fakeDrm.lock);
+
+    if (ret)
+    {
+        errno = ret;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  KMS: framebuffers, flips and vblanks
+
+static int fake_drm_crtc_pipe(uint32_t crtc_id)
+{
+    int pipe = (int) crtc_id - FAKE_DRM_CRTC_BASE;
+
+    return ((pipe >= 0) && (pipe < fakeDrm.display.num_crtcs)) ? pipe : -1;
+}
+
+static int fake_drm_plane_pipe(uint32_t plane_id)
+{
+    int pipe = (int) plane_id - FAKE_DRM_PLANE_BASE;
+
+    return ((pipe >= 0) && (pipe < fakeDrm.display.num_crtcs)) ? pipe : -1;
+}
+
+static struct fake_drm_fb * fake_drm_lookup_fb(uint32_t fb_id)
+{
+    uint32_t i = fb_id - FAKE_DRM_FB_BASE;
+
+    if ((fb_id < FAKE_DRM_FB_BASE) || (i >= fakeDrm.nfbs) ||
+        !fakeDrm.fbs[i].live)
+    {
+        return NULL;
+    }
+
+    return &fakeDrm.fbs[i];
+}
+
+static int fake_drm_add_fb(uint32_t width, uint32_t height, uint32_t handle,
+                           uint32_t pitch, uint32_t *fb_id)
+{
+    struct fake_drm_bo *bo = fake_drm_lookup(handle);
+    uint32_t i;
+
+    if (bo == NULL)
+    {
+        return -ENOENT;
+    }
+
+    if ((width == 0) || (height == 0) || (pitch == 0) ||
+        ((uint64_t) pitch * height > bo->size))
+    {
+        return -EINVAL;
+    }
+
+    for (i = 0; i < fakeDrm.nfbs; i++)
+    {
+        if (!fakeDrm.fbs[i].live)
+        {
+            break;
+        }
+    }
+
+    if (i == fakeDrm.nfbs)
+    {
+        struct fake_drm_fb *fbs;
+
+        fbs = realloc(fakeDrm.fbs, (fakeDrm.nfbs + 1) * sizeof(*fbs));
+        if (fbs == NULL)
+        {
+            return -ENOMEM;
+        }
+
+        fakeDrm.fbs = fbs;
+        fakeDrm.nfbs++;
+    }
+
+    fakeDrm.fbs[i].handle = handle;
+    fakeDrm.fbs[i].live = 1;
+    *fb_id = FAKE_DRM_FB_BASE + i;
+
+    return 0;
+}
+
+static int fake_drm_addfb(struct drm_mode_fb_cmd *arg)
+{
+    if ((arg->bpp == 0) || (arg->depth == 0))
+    {
+        return -EINVAL;
+    }
+
+    return fake_drm_add_fb(arg->width, arg->height, arg->handle, arg->pitch,
+                           &arg->fb_id);
+}
+
+static int fake_drm_addfb2(struct drm_mode_fb_cmd2 *arg)
+{
+    // DRM_CAP_ADDFB2_MODIFIERS is not offered
+    if (arg->flags)
+    {
+        return -EINVAL;
+    }
+
+    return fake_drm_add_fb(arg->width, arg->height, arg->handles[0],
+                           arg->pitches[0], &arg->fb_id);
+}
+
+static int fake_drm_rmfb(uint32_t *fb_id)
+{
+    struct fake_drm_fb *fb = fake_drm_lookup_fb(*fb_id);
+    int pipe;
+
+    if (fb == NULL)
+    {
+        return -ENOENT;
+    }
+
+    // a crtc scanning it out goes dark
+    for (pipe = 0; pipe < fakeDrm.display.num_crtcs; pipe++)
+    {
+        if (fakeDrm.crtcs[pipe].fb == *fb_id)
+        {
+            fakeDrm.crtcs[pipe].fb = 0;
+        }
+    }
+
+    fb->live = 0;
+
+    return 0;
+}
+
+// latch @fb_id at the next vblank, or now for an async flip
+static int fake_drm_flip(int pipe, uint32_t fb_id, uint32_t flags,
+                         uint64_t user_data)
+{
+    struct fake_drm_crtc *crtc = &fakeDrm.crtcs[pipe];
+    int ret;
+
+    crtc->flip_fb = fb_id;
+    crtc->flip_pending = 1;
+
+    ret = fake_drm_queue_event(DRM_EVENT_FLIP_COMPLETE, pipe,
+                               (flags & DRM_MODE_PAGE_FLIP_ASYNC) ?
+                               fakeDrm.msc : fakeDrm.msc + 1,
+                               user_data,
+                               !(flags & DRM_MODE_PAGE_FLIP_EVENT));
+    if (ret)
+    {
+        crtc->flip_pending = 0;
+    }
+
+    return ret;
+}
+
+static int fake_drm_page_flip(struct drm_mode_crtc_page_flip *arg)
+{
+    int pipe = fake_drm_crtc_pipe(arg->crtc_id);
+
+    if ((arg->flags & ~(DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_PAGE_FLIP_ASYNC)) ||
+        ((arg->flags & DRM_MODE_PAGE_FLIP_ASYNC) &&
+         !fakeDrm.display.async_flip))
+    {
+        return -EINVAL;
+    }
+
+    if ((pipe < 0) || (fake_drm_lookup_fb(arg->fb_id) == NULL))
+    {
+        return -ENOENT;
+    }
+
+    if (fakeDrm.crtcs[pipe].flip_pending)
+    {
+        return -EBUSY;
+    }
+
+    return fake_drm_flip(pipe, arg->fb_id, arg->flags, arg->user_data);
+}
+
+static int fake_drm_flips_pending(unsigned int pipes)
+{
+    int pipe;
+
+    for (pipe = 0; pipe < fakeDrm.display.num_crtcs; pipe++)
+    {
+        if ((pipes & (1u << pipe)) && fakeDrm.crtcs[pipe].flip_pending)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+//
+// Commits that only move the primary planes around: every crtc touched
+// by the commit flips, to the plane's new FB_ID or to the one it shows.
+// Crtc properties are taken without a look, plane properties have to be
+// among enum fake_drm_plane_prop.
+//
+static int fake_drm_atomic(struct drm_mode_atomic *arg)
+{
+    const uint32_t valid = DRM_MODE_PAGE_FLIP_EVENT |
+                           DRM_MODE_PAGE_FLIP_ASYNC |
+                           DRM_MODE_ATOMIC_TEST_ONLY |
+                           DRM_MODE_ATOMIC_NONBLOCK |
+                           DRM_MODE_ATOMIC_ALLOW_MODESET;
+    const uint32_t *objs = (const uint32_t *) (uintptr_t) arg->objs_ptr;
+    const uint32_t *count_props =
+        (const uint32_t *) (uintptr_t) arg->count_props_ptr;
+    const uint32_t *props = (const uint32_t *) (uintptr_t) arg->props_ptr;
+    const uint64_t *values =
+        (const uint64_t *) (uintptr_t) arg->prop_values_ptr;
+    uint32_t fbs[FAKE_DRM_MAX_CRTCS];
+    unsigned int touched = 0;
+    unsigned int new_fb = 0;
+    uint32_t i, j, k = 0;
+    int pipe, n = 0;
+
+    if ((arg->flags & ~valid) ||
+        ((arg->flags & DRM_MODE_ATOMIC_TEST_ONLY) &&
+         (arg->flags & DRM_MODE_PAGE_FLIP_EVENT)) ||
+        ((arg->flags & DRM_MODE_PAGE_FLIP_ASYNC) &&
+         !fakeDrm.display.async_flip))
+    {
+        return -EINVAL;
+    }
+
+    for (i = 0; i < arg->count_objs; i++)
+    {
+        int crtc_pipe = fake_drm_crtc_pipe(objs[i]);
+        int plane_pipe = fake_drm_plane_pipe(objs[i]);
+
+        if ((crtc_pipe < 0) && (plane_pipe < 0))
+        {
+            return -ENOENT;
+        }
+
+        if (crtc_pipe >= 0)
+        {
+            touched |= 1u << crtc_pipe;
+            k += count_props[i];
+            continue;
+        }
+
+        for (j = 0; j < count_props[i]; j++, k++)
+        {
+            switch (props[k])
+            {
+                case FAKE_DRM_PLANE_FB_ID:
+                    if (values[k] && (fake_drm_lookup_fb(values[k]) == NULL))
+                    {
+                        return -ENOENT;
+                    }
+                    fbs[plane_pipe] = values[k];
+                    new_fb |= 1u << plane_pipe;
+                    break;
+                case FAKE_DRM_PLANE_CRTC_ID:
+                    // a primary plane stays on its crtc
+                    if (values[k] && (values[k] != fake_drm_crtc_id(plane_pipe)))
+                    {
+                        return -EINVAL;
+                    }
+                    break;
+                case FAKE_DRM_PLANE_SRC_X:
+                case FAKE_DRM_PLANE_SRC_Y:
+                case FAKE_DRM_PLANE_SRC_W:
+                case FAKE_DRM_PLANE_SRC_H:
+                case FAKE_DRM_PLANE_CRTC_X:
+                case FAKE_DRM_PLANE_CRTC_Y:
+                case FAKE_DRM_PLANE_CRTC_W:
+                case FAKE_DRM_PLANE_CRTC_H:
+                    break;
+                default:
+                    return -EINVAL;
+            }
+
+            touched |= 1u << plane_pipe;
+        }
+    }
+
+    if ((arg->flags & DRM_MODE_PAGE_FLIP_EVENT) && (touched == 0))
+    {
+        return -EINVAL;
+    }
+
+    while (fake_drm_flips_pending(touched))
+    {
+        if (arg->flags & DRM_MODE_ATOMIC_NONBLOCK)
+        {
+            return -EBUSY;
+        }
+
+        pthread_cond_wait(&fakeDrm.vblank_cond, &fakeDrm.lock);
+    }
+
+    if (arg->flags & DRM_MODE_ATOMIC_TEST_ONLY)
+    {
+        return 0;
+    }
+
+    // all the events or none
+    for (pipe = 0; pipe < fakeDrm.display.num_crtcs; pipe++)
+    {
+        n += !!(touched & (1u << pipe));
+    }
+
+    if ((arg->flags & DRM_MODE_PAGE_FLIP_EVENT) &&
+        (fakeDrm.event_space <
+         n * (int) sizeof(struct drm_event_vblank)))
+    {
+        return -ENOMEM;
+    }
+
+    for (pipe = 0; pipe < fakeDrm.display.num_crtcs; pipe++)
+    {
+        if (touched & (1u << pipe))
+        {
+            fake_drm_flip(pipe, (new_fb & (1u << pipe)) ?
+                          fbs[pipe] : fakeDrm.crtcs[pipe].fb,
+                          arg->flags, arg->user_data);
+        }
+    }
+
+    // a blocking commit returns once it is on the screen
+    while (!(arg->flags & DRM_MODE_ATOMIC_NONBLOCK) &&
+           fake_drm_flips_pending(touched))
+    {
+        pthread_cond_wait(&fakeDrm.vblank_cond, &fakeDrm.lock);
+    }
+
+    return 0;
+}
+
+static int fake_drm_get_sequence(struct drm_crtc_get_sequence *arg)
+{
+    int pipe = fake_drm_crtc_pipe(arg->crtc_id);
+
+    if (fakeDrm.display.no_crtc_sequence)
+    {
+        return -EINVAL;
+    }
+
+    if (pipe < 0)
+    {
+        return -ENOENT;
+    }
+
+    arg->active = 1;
+    arg->sequence = fakeDrm.msc;
+    arg->sequence_ns = fakeDrm.msc_ns;
+
+    return 0;
+}
+
+static int fake_drm_queue_sequence(struct drm_crtc_queue_sequence *arg)
+{
+    int pipe = fake_drm_crtc_pipe(arg->crtc_id);
+    uint64_t msc = arg->sequence;
+    int ret;
+
+    if (fakeDrm.display.no_crtc_sequence)
+    {
+        return -EINVAL;
+    }
+
+    if (pipe < 0)
+    {
+        return -ENOENT;
+    }
+
+    if (arg->flags & ~(DRM_CRTC_SEQUENCE_RELATIVE |
+                       DRM_CRTC_SEQUENCE_NEXT_ON_MISS))
+    {
+        return -EINVAL;
+    }
+
+    if (arg->flags & DRM_CRTC_SEQUENCE_RELATIVE)
+    {
+        msc += fakeDrm.msc;
+    }
+
+    if ((arg->flags & DRM_CRTC_SEQUENCE_NEXT_ON_MISS) && (msc <= fakeDrm.msc))
+    {
+        msc = fakeDrm.msc + 1;
+    }
+
+    ret = fake_drm_queue_event(DRM_EVENT_CRTC_SEQUENCE, pipe, msc,
+                               arg->user_data, 0);
+    if (ret == 0)
+    {
+        arg->sequence = msc;
+    }
+
+    return ret;
+}
+
+//
+// The 32 bit vblank counter of the old interface, extended to the 64 bit
+// count around the current vblank
+//
+static int fake_drm_wait_vblank(union drm_wait_vblank *arg)
+{
+    const uint32_t valid = _DRM_VBLANK_RELATIVE | _DRM_VBLANK_EVENT |
+                           _DRM_VBLANK_NEXTONMISS | _DRM_VBLANK_SECONDARY |
+                           _DRM_VBLANK_SIGNAL | _DRM_VBLANK_HIGH_CRTC_MASK;
+    uint32_t type = arg->request.type;
+    uint32_t seq = arg->request.sequence;
+    uint64_t user_data = arg->request.signal;
+    uint32_t cur = (uint32_t) fakeDrm.msc;
+    uint64_t msc;
+    int pipe;
+    int ret;
+
+    if (type & ~valid)
+    {
+        return -EINVAL;
+    }
+
+    pipe = (type & _DRM_VBLANK_SECONDARY) ? 1 :
+           (type & _DRM_VBLANK_HIGH_CRTC_MASK) >> _DRM_VBLANK_HIGH_CRTC_SHIFT;
+    if (pipe >= fakeDrm.display.num_crtcs)
+    {
+        return -EINVAL;
+    }
+
+    if (type & _DRM_VBLANK_RELATIVE)
+    {
+        seq += cur;
+    }
+
+    if ((type & _DRM_VBLANK_NEXTONMISS) && ((cur - seq) <= (1u << 23)))
+    {
+        seq = cur + 1;
+    }
+
+    msc = fakeDrm.msc + (int32_t) (seq - cur);
+
+    if (type & _DRM_VBLANK_EVENT)
+    {
+        ret = fake_drm_queue_event(DRM_EVENT_VBLANK, pipe, msc, user_data, 0);
+        if (ret == 0)
+        {
+            arg->reply.sequence = (msc <= fakeDrm.msc) ? cur : seq;
+        }
+
+        return ret;
+    }
+
+    while (fakeDrm.msc < msc)
+    {
+        pthread_cond_wait(&fakeDrm.vblank_cond, &fakeDrm.lock);
+    }
+
+    arg->reply.sequence = (uint32_t) fakeDrm.msc;
+    arg->reply.tval_sec = fakeDrm.msc_ns / 1000000000ull;
+    arg->reply.tval_usec = (fakeDrm.msc_ns % 1000000000ull) / 1000;
+
+    return 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  libdrm entry points
+
+//
+// Requests on the device or on one of its PRIME fds are served here,
+// anything else goes to the kernel.
+//
+int drmIoctl(int fd, unsigned long request, void *arg)
+{
+    enum fake_drm_ioctl which;
+    int ret;
+
+    if ((fd != fakeDrm.fd) && (fake_drm_prime_handle(fd) == 0))
+    {
+        do
+        {
+            ret = ioctl(fd, request, arg);
+        } while ((ret == -1) && ((errno == EINTR) || (errno == EAGAIN)));
+
+        return ret;
+    }
+
+    pthread_mutex_lock(&fakeDrm.lock);
+
+    switch (request)
+    {
+        case DRM_IOCTL_MODE_CREATE_DUMB:
+            which = FAKE_DRM_CREATE_DUMB;
+            ret = fake_drm_create_dumb(arg);
+            break;
+        case DRM_IOCTL_MODE_MAP_DUMB:
+            which = FAKE_DRM_MAP_DUMB;
+            ret = fake_drm_map_dumb(arg);
+            break;
+        case DRM_IOCTL_MODE_DESTROY_DUMB:
+            which = FAKE_DRM_DESTROY_DUMB;
+            ret = fake_drm_destroy_dumb(arg);
+            break;
+        case DRM_IOCTL_PRIME_HANDLE_TO_FD:
+            which = FAKE_DRM_PRIME_HANDLE_TO_FD;
+            ret = fake_drm_prime_export(arg);
+            break;
+        case DRM_IOCTL_PRIME_FD_TO_HANDLE:
+            which = FAKE_DRM_PRIME_FD_TO_HANDLE;
+            ret = fake_drm_prime_import(arg);
+            break;
+        case DMA_BUF_IOCTL_SYNC:
+            which = FAKE_DRM_DMA_BUF_SYNC;
+            ret = fake_drm_dma_buf_sync(fd, arg);
+            break;
+        case DRM_IOCTL_GET_CAP:
+            which = FAKE_DRM_GET_CAP;
+            ret = fake_drm_get_cap(arg);
+            break;
+        case DRM_IOCTL_MODE_ADDFB:
+            which = FAKE_DRM_ADDFB;
+            ret = fake_drm_addfb(arg);
+            break;
+        case DRM_IOCTL_MODE_ADDFB2:
+            which = FAKE_DRM_ADDFB2;
+            ret = fake_drm_addfb2(arg);
+            break;
+        case DRM_IOCTL_MODE_RMFB:
+            which = FAKE_DRM_RMFB;
+            ret = fake_drm_rmfb(arg);
+            break;
+        case DRM_IOCTL_MODE_PAGE_FLIP:
+            which = FAKE_DRM_PAGE_FLIP;
+            ret = fake_drm_page_flip(arg);
+            break;
+        case DRM_IOCTL_MODE_ATOMIC:
+            which = FAKE_DRM_ATOMIC;
+            ret = fake_drm_atomic(arg);
+            break;
+        case DRM_IOCTL_CRTC_GET_SEQUENCE:
+            which = FAKE_DRM_CRTC_GET_SEQUENCE;
+            ret = fake_drm_get_sequence(arg);
+            break;
+        case DRM_IOCTL_CRTC_QUEUE_SEQUENCE:
+            which = FAKE_DRM_CRTC_QUEUE_SEQUENCE;
+            ret = fake_drm_queue_sequence(arg);
+            break;
+        case DRM_IOCTL_WAIT_VBLANK:
+            which = FAKE_DRM_WAIT_VBLANK;
+            ret = fake_drm_wait_vblank(arg);
+            break;
+        default:
+            pthread_mutex_unlock(&fakeDrm.lock);
+            errno = ENOTTY;
+            return -1;
+    }
+
+    fakeDrm.counts[which]++;
+
+    pthread_mutex_unlock(&fakeDrm.lock);
+
+    if (ret)
+    {
+        errno = -ret;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int drmGetCap(int fd, uint64_t capability, uint64_t *value)
+{
+    struct drm_get_cap cap = { .capability = capability };
+    int ret;
+
+    ret = drmIoctl(fd, DRM_IOCTL_GET_CAP, &cap);
+    if (ret)
+    {
+        return ret;
+    }
+
+    *value = cap.value;
+
+    return 0;
+}
+
+
+int drmPrimeHandleToFD(int fd, uint32_t handle, uint32_t flags, int *prime_fd)
+{
+    struct drm_prime_handle args = { .handle = handle, .flags = flags };
+    int ret;
+
+    ret = drmIoctl(fd, DRM_IOCTL_PRIME_HANDLE_TO_FD, &args);
+    if (ret)
+    {
+        return ret;
+    }
+
+    *prime_fd = args.fd;
+
+    return 0;
+}
+
+
+int drmPrimeFDToHandle(int fd, int prime_fd, uint32_t *handle)
+{
+    struct drm_prime_handle args = { .fd = prime_fd };
+    int ret;
+
+    ret = drmIoctl(fd, DRM_IOCTL_PRIME_FD_TO_HANDLE, &args);
+    if (ret)
+    {
+        return ret;
+    }
+
+    *handle = args.handle;
+
+    return 0;
+}
+
+
+char * drmGetDeviceNameFromFd(int fd)
+{
+    return (fd == fakeDrm.fd) ? strdup("/dev/dri/fake") : NULL;
+}
+
+
+int drmSetMaster(int fd)
+{
+    return 0;
+}
+
+
+int drmDropMaster(int fd)
+{
+    return 0;
+}
+
+
+int drmHandleEvent(int fd, drmEventContextPtr evctx)
+{
+    uint64_t buffer[1024 / sizeof(uint64_t)];
+    char *p = (char *) buffer;
+    int len, i;
+
+    len = read(fd, buffer, sizeof(buffer));
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    if (len < (int) sizeof(struct drm_event))
+    {
+        return -1;
+    }
+
+    if (fd == fakeDrm.fd)
+    {
+        pthread_mutex_lock(&fakeDrm.lock);
+        fakeDrm.event_space += len;
+        pthread_mutex_unlock(&fakeDrm.lock);
+    }
+
+    for (i = 0; i < len; i += ((struct drm_event *) (p + i))->length)
+    {
+        struct drm_event *e = (struct drm_event *) (p + i);
+        struct drm_event_vblank *vbl = (struct drm_event_vblank *) e;
+        struct drm_event_crtc_sequence *seq =
+            (struct drm_event_crtc_sequence *) e;
+
+        switch (e->type)
+        {
+            case DRM_EVENT_VBLANK:
+                if ((evctx->version < 1) || (evctx->vblank_handler == NULL))
+                {
+                    break;
+                }
+                evctx->vblank_handler(fd, vbl->sequence, vbl->tv_sec,
+                                      vbl->tv_usec,
+                                      (void *) (uintptr_t) vbl->user_data);
+                break;
+            case DRM_EVENT_FLIP_COMPLETE:
+                if ((evctx->version >= 3) && evctx->page_flip_handler2)
+                {
+                    evctx->page_flip_handler2(fd, vbl->sequence, vbl->tv_sec,
+                                              vbl->tv_usec, vbl->crtc_id,
+                                              (void *) (uintptr_t) vbl->user_data);
+                }
+                else if ((evctx->version >= 2) && evctx->page_flip_handler)
+                {
+                    evctx->page_flip_handler(fd, vbl->sequence, vbl->tv_sec,
+                                             vbl->tv_usec,
+                                             (void *) (uintptr_t) vbl->user_data);
+                }
+                break;
+            case DRM_EVENT_CRTC_SEQUENCE:
+                if ((evctx->version >= 4) && evctx->sequence_handler)
+                {
+                    evctx->sequence_handler(fd, seq->sequence, seq->time_ns,
+                                            seq->user_data);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return 0;
+}
+
+
+int drmWaitVBlank(int fd, drmVBlankPtr vbl)
+{
+    return drmIoctl(fd, DRM_IOCTL_WAIT_VBLANK, vbl);
+}
+
+
+int drmCrtcGetSequence(int fd, uint32_t crtcId, uint64_t *sequence,
+                       uint64_t *ns)
+{
+    struct drm_crtc_get_sequence get_seq = { .crtc_id = crtcId };
+    int ret;
+
+    ret = drmIoctl(fd, DRM_IOCTL_CRTC_GET_SEQUENCE, &get_seq);
+    if (ret)
+    {
+        return ret;
+    }
+
+    if (sequence)
+    {
+        *sequence = get_seq.sequence;
+    }
+
+    if (ns)
+    {
+        *ns = get_seq.sequence_ns;
+    }
+
+    return 0;
+}
+
+
+int drmCrtcQueueSequence(int fd, uint32_t crtcId, uint32_t flags,
+                         uint64_t sequence, uint64_t *sequence_queued,
+                         uint64_t user_data)
+{
+    struct drm_crtc_queue_sequence queue_seq = {
+        .crtc_id = crtcId,
+        .flags = flags,
+        .sequence = sequence,
+        .user_data = user_data,
+    };
+    int ret;
+
+    ret = drmIoctl(fd, DRM_IOCTL_CRTC_QUEUE_SEQUENCE, &queue_seq);
+    if ((ret == 0) && sequence_queued)
+    {
+        *sequence_queued = queue_seq.sequence;
+    }
+
+    return ret;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  libdrm KMS, which returns -errno rather than -1
+
+static int fake_drm_mode_ioctl(int fd, unsigned long request, void *arg)
+{
+    return drmIoctl(fd, request, arg) ? -errno : 0;
+}
+
+
+int drmModeAddFB(int fd, uint32_t width, uint32_t height, uint8_t depth,
+                 uint8_t bpp, uint32_t pitch, uint32_t bo_handle,
+                 uint32_t *buf_id)
+{
+    struct drm_mode_fb_cmd f = {
+        .width = width,
+        .height = height,
+        .pitch = pitch,
+        .bpp = bpp,
+        .depth = depth,
+        .handle = bo_handle,
+    };
+    int ret;
+
+    ret = fake_drm_mode_ioctl(fd, DRM_IOCTL_MODE_ADDFB, &f);
+    if (ret == 0)
+    {
+        *buf_id = f.fb_id;
+    }
+
+    return ret;
+}
+
+
+int drmModeAddFB2(int fd, uint32_t width, uint32_t height,
+                  uint32_t pixel_format, const uint32_t bo_handles[4],
+                  const uint32_t pitches[4], const uint32_t offsets[4],
+                  uint32_t *buf_id, uint32_t flags)
+{
+    struct drm_mode_fb_cmd2 f = {
+        .width = width,
+        .height = height,
+        .pixel_format = pixel_format,
+        .flags = flags,
+    };
+    int ret;
+
+    memcpy(f.handles, bo_handles, sizeof(f.handles));
+    memcpy(f.pitches, pitches, sizeof(f.pitches));
+    memcpy(f.offsets, offsets, sizeof(f.offsets));
+
+    ret = fake_drm_mode_ioctl(fd, DRM_IOCTL_MODE_ADDFB2, &f);
+    if (ret == 0)
+    {
+        *buf_id = f.fb_id;
+    }
+
+    return ret;
+}
+
+
+int drmModeRmFB(int fd, uint32_t bufferId)
+{
+    return fake_drm_mode_ioctl(fd, DRM_IOCTL_MODE_RMFB, &bufferId);
+}
+
+
+int drmModePageFlip(int fd, uint32_t crtc_id, uint32_t fb_id,
+                    uint32_t flags, void *user_data)
+{
+    struct drm_mode_crtc_page_flip flip = {
+        .crtc_id = crtc_id,
+        .fb_id = fb_id,
+        .flags = flags,
+        .user_data = (uintptr_t) user_data,
+    };
+
+    return fake_drm_mode_ioctl(fd, DRM_IOCTL_MODE_PAGE_FLIP, &flip);
+}
+
+
+drmModeAtomicReqPtr drmModeAtomicAlloc(void)
+{
+    return calloc(1, sizeof(drmModeAtomicReq));
+}
+
+
+void drmModeAtomicFree(drmModeAtomicReqPtr req)
+{
+    if (req)
+    {
+        free(req->items);
+        free(req);
+    }
+}
+
+
+int drmModeAtomicAddProperty(drmModeAtomicReqPtr req, uint32_t object_id,
+                             uint32_t property_id, uint64_t value)
+{
+    struct fake_drm_atomic_item *item;
+
+    if (req == NULL)
+    {
+        return -EINVAL;
+    }
+
+    if (req->cursor == req->size)
+    {
+        uint32_t size = req->size ? 2 * req->size : 16;
+
+        item = realloc(req->items, size * sizeof(*item));
+        if (item == NULL)
+        {
+            return -ENOMEM;
+        }
+
+        req->items = item;
+        req->size = size;
+    }
+
+    item = &req->items[req->cursor];
+    item->object_id = object_id;
+    item->property_id = property_id;
+    item->value = value;
+    item->cursor = req->cursor;
+
+    return ++req->cursor;
+}
+
+
+static int fake_drm_item_cmp(const void *a, const void *b)
+{
+    const struct fake_drm_atomic_item *x = a;
+    const struct fake_drm_atomic_item *y = b;
+
+    if (x->object_id != y->object_id)
+    {
+        return (x->object_id > y->object_id) ? 1 : -1;
+    }
+
+    if (x->property_id != y->property_id)
+    {
+        return (x->property_id > y->property_id) ? 1 : -1;
+    }
+
+    return (x->cursor > y->cursor) - (x->cursor < y->cursor);
+}
+
+//
+// Like libdrm: the properties are grouped by object, the last value set
+// for a property wins
+//
+int drmModeAtomicCommit(int fd, drmModeAtomicReqPtr req, uint32_t flags,
+                        void *user_data)
+{
+    struct drm_mode_atomic atomic;
+    struct fake_drm_atomic_item *items;
+    uint32_t *objs, *count_props, *props;
+    uint64_t *values;
+    uint32_t i, nobjs = 0, nprops = 0;
+    int ret = -ENOMEM;
+
+    if (req == NULL)
+    {
+        return -EINVAL;
+    }
+
+    if (req->cursor == 0)
+    {
+        return 0;
+    }
+
+    items = malloc(req->cursor * sizeof(*items));
+    objs = malloc(req->cursor * sizeof(*objs));
+    count_props = malloc(req->cursor * sizeof(*count_props));
+    props = malloc(req->cursor * sizeof(*props));
+    values = malloc(req->cursor * sizeof(*values));
+
+    if (items && objs && count_props && props && values)
+    {
+        memcpy(items, req->items, req->cursor * sizeof(*items));
+        qsort(items, req->cursor, sizeof(*items), fake_drm_item_cmp);
+
+        for (i = 0; i < req->cursor; i++)
+        {
+            if ((i + 1 < req->cursor) &&
+                (items[i + 1].object_id == items[i].object_id) &&
+                (items[i + 1].property_id == items[i].property_id))
+            {
+                continue;
+            }
+
+            if ((nobjs == 0) || (objs[nobjs - 1] != items[i].object_id))
+            {
+                objs[nobjs] = items[i].object_id;
+                count_props[nobjs++] = 0;
+            }
+
+            count_props[nobjs - 1]++;
+            props[nprops] = items[i].property_id;
+            values[nprops++] = items[i].value;
+        }
+
+        memset(&atomic, 0, sizeof(atomic));
+        atomic.flags = flags;
+        atomic.count_objs = nobjs;
+        atomic.objs_ptr = (uintptr_t) objs;
+        atomic.count_props_ptr = (uintptr_t) count_props;
+        atomic.props_ptr = (uintptr_t) props;
+        atomic.prop_values_ptr = (uintptr_t) values;
+        atomic.user_data = (uintptr_t) user_data;
+
+        ret = fake_drm_mode_ioctl(fd, DRM_IOCTL_MODE_ATOMIC, &atomic);
+    }
+
+    free(items);
+    free(objs);
+    free(count_props);
+    free(props);
+    free(values);
+
+    return ret;
+}
+
+
+//
+// mmap() of the device maps the memfd at the fake offset MAP_DUMB gave
+// out, of a PRIME fd the BO it stands for.
+//
+void * __wrap_mmap(void *addr, size_t length, int prot, int flags,
+                   int fd, off_t offset)
+{
+    uint32_t handle;
+
+    if ((fd >= 0) && (fd == fakeDrm.fd))
+    {
+        fd = fakeDrm.aperture;
+    }
+    else if ((handle = fake_drm_prime_handle(fd)) != 0)
+    {
+        struct fake_drm_bo *bo;
+
+        pthread_mutex_lock(&fakeDrm.lock);
+        bo = fake_drm_lookup(handle);
+        offset += bo ? (off_t) bo->offset : 0;
+        pthread_mutex_unlock(&fakeDrm.lock);
+
+        if (bo == NULL)
+        {
+            errno = EINVAL;
+            return MAP_FAILED;
+        }
+    }
+
+    return __real_mmap(addr, length, prot, flags, fd, offset);
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright © 2026 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FAKE_DRM_H_
+#define FAKE_DRM_H_
+
+#include <stdint.h>
+
+//
+// A DRM device living in the benchmark process. Dumb BOs are carved out
+// of one memfd, which mmap() of the DRM fd is redirected to (the
+// benchmarks link with -Wl,--wrap=mmap), PRIME fds are duplicates of it
+// and DMA_BUF_IOCTL_SYNC on them is accepted, counted and, if asked for,
+// recorded.
+//
+// BO memory is plain cached shmem: the cost of write-combined scanout
+// memory is not modelled, only the ioctl, fault and zeroing overhead of
+// creating, mapping and destroying BOs is real.
+//
+// Once fake_drm_set_display() gave it crtcs the device also does KMS:
+// framebuffers, page flips, atomic commits of the primary planes and
+// vblank waits. A thread plays the vblank interrupt on a virtual
+// refresh clock, it latches flips and writes the events that came due
+// into the device fd, from where drmHandleEvent() reads them.
+//
+enum fake_drm_ioctl {
+    FAKE_DRM_CREATE_DUMB,
+    FAKE_DRM_MAP_DUMB,
+    FAKE_DRM_DESTROY_DUMB,
+    FAKE_DRM_PRIME_HANDLE_TO_FD,
+    FAKE_DRM_PRIME_FD_TO_HANDLE,
+    FAKE_DRM_DMA_BUF_SYNC,
+    FAKE_DRM_GET_CAP,
+    FAKE_DRM_ADDFB,
+    FAKE_DRM_ADDFB2,
+    FAKE_DRM_RMFB,
+    FAKE_DRM_PAGE_FLIP,
+    FAKE_DRM_ATOMIC,
+    FAKE_DRM_CRTC_GET_SEQUENCE,
+    FAKE_DRM_CRTC_QUEUE_SEQUENCE,
+    FAKE_DRM_WAIT_VBLANK,
+    FAKE_DRM_NUM_IOCTLS,
+};
+
+#define FAKE_DRM_MAX_CRTCS  4
+
+// property ids of the primary planes, crtc properties are not checked
+enum fake_drm_plane_prop {
+    FAKE_DRM_PLANE_FB_ID = 1,
+    FAKE_DRM_PLANE_CRTC_ID,
+    FAKE_DRM_PLANE_SRC_X,
+    FAKE_DRM_PLANE_SRC_Y,
+    FAKE_DRM_PLANE_SRC_W,
+    FAKE_DRM_PLANE_SRC_H,
+    FAKE_DRM_PLANE_CRTC_X,
+    FAKE_DRM_PLANE_CRTC_Y,
+    FAKE_DRM_PLANE_CRTC_W,
+    FAKE_DRM_PLANE_CRTC_H,
+};
+
+struct fake_drm_display {
+    int num_crtcs;
+    // one refresh, all crtcs run off the same clock
+    uint64_t frame_ns;
+    // the vblank interrupt is handled up to this late, at random; more
+    // than a frame and vblanks go by without one
+    unsigned int jitter_us;
+    // CRTC_GET_SEQUENCE and CRTC_QUEUE_SEQUENCE are refused like before
+    // Linux 4.15, vblanks are only had through WAIT_VBLANK
+    int no_crtc_sequence;
+    // DRM_CAP_ASYNC_PAGE_FLIP
+    int async_flip;
+};
+
+// create the device, returns its fd or -1
+int fake_drm_open(void);
+void fake_drm_close(int fd);
+
+const char *fake_drm_ioctl_name(enum fake_drm_ioctl ioctl);
+
+// ioctls served since the device was opened or the counters reset
+void fake_drm_get_counts(unsigned long counts[FAKE_DRM_NUM_IOCTLS]);
+void fake_drm_reset_counts(void);
+
+// live BOs and the memory they hold
+void fake_drm_get_usage(unsigned long *bos, uint64_t *bytes);
+
+// a DMA_BUF_IOCTL_SYNC the device accepted
+struct fake_drm_sync {
+    // BO of the PRIME fd it was made on
+    uint32_t handle;
+    uint64_t flags;
+};
+
+// record the syncs from now on into @log, the first @max of them; a NULL
+// @log stops recording
+void fake_drm_record_syncs(struct fake_drm_sync *log, int max);
+// syncs recorded into the current log so far
+int fake_drm_recorded_syncs(void);
+
+// set up or change the display, the vblank clock starts with the first
+// call and keeps its count across later ones
+int fake_drm_set_display(const struct fake_drm_display *display);
+
+// KMS object ids of crtc @pipe and its primary plane
+uint32_t fake_drm_crtc_id(int pipe);
+uint32_t fake_drm_plane_id(int pipe);
+
+#endif
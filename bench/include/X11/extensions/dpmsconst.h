@@ -0,0 +1,2 @@
+/* stand-in for the X server header of the same name, see xorg-stubs.h */
+#include "../../xorg-stubs.h"
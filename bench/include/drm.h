@@ -0,0 +1,229 @@
+/*
+ * Copyright © 2026 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _DRM_H_
+#define _DRM_H_
+
+//
+// The subset of the kernel's DRM uapi the driver uses, with the same
+// ioctl numbers and layouts, served by fake_drm.c.
+//
+
+#include <stdint.h>
+#include <sys/ioctl.h>
+
+#define DRM_IOCTL_BASE          'd'
+#define DRM_IO(nr)              _IO(DRM_IOCTL_BASE, nr)
+#define DRM_IOR(nr, type)       _IOR(DRM_IOCTL_BASE, nr, type)
+#define DRM_IOW(nr, type)       _IOW(DRM_IOCTL_BASE, nr, type)
+#define DRM_IOWR(nr, type)      _IOWR(DRM_IOCTL_BASE, nr, type)
+
+#define DRM_CLOEXEC             02000000
+#define DRM_RDWR                02
+
+struct drm_gem_close {
+    uint32_t handle;
+    uint32_t pad;
+};
+
+struct drm_get_cap {
+    uint64_t capability;
+    uint64_t value;
+};
+
+#define DRM_CAP_DUMB_BUFFER             0x1
+#define DRM_CAP_VBLANK_HIGH_CRTC        0x2
+#define DRM_CAP_DUMB_PREFERRED_DEPTH    0x3
+#define DRM_CAP_DUMB_PREFER_SHADOW      0x4
+#define DRM_CAP_PRIME                   0x5
+#define DRM_CAP_TIMESTAMP_MONOTONIC     0x6
+#define DRM_CAP_ASYNC_PAGE_FLIP         0x7
+#define DRM_CAP_CURSOR_WIDTH            0x8
+#define DRM_CAP_CURSOR_HEIGHT           0x9
+#define DRM_CAP_ADDFB2_MODIFIERS        0x10
+#define DRM_CAP_CRTC_IN_VBLANK_EVENT    0x12
+
+struct drm_prime_handle {
+    uint32_t handle;
+    uint32_t flags;
+    int32_t fd;
+};
+
+enum drm_vblank_seq_type {
+    _DRM_VBLANK_ABSOLUTE = 0x0,
+    _DRM_VBLANK_RELATIVE = 0x1,
+    _DRM_VBLANK_HIGH_CRTC_MASK = 0x0000003e,
+    _DRM_VBLANK_EVENT = 0x4000000,
+    _DRM_VBLANK_FLIP = 0x8000000,
+    _DRM_VBLANK_NEXTONMISS = 0x10000000,
+    _DRM_VBLANK_SECONDARY = 0x20000000,
+    _DRM_VBLANK_SIGNAL = 0x40000000,
+};
+
+#define _DRM_VBLANK_HIGH_CRTC_SHIFT     1
+
+struct drm_wait_vblank_request {
+    enum drm_vblank_seq_type type;
+    unsigned int sequence;
+    unsigned long signal;
+};
+
+struct drm_wait_vblank_reply {
+    enum drm_vblank_seq_type type;
+    unsigned int sequence;
+    long tval_sec;
+    long tval_usec;
+};
+
+union drm_wait_vblank {
+    struct drm_wait_vblank_request request;
+    struct drm_wait_vblank_reply reply;
+};
+
+struct drm_crtc_get_sequence {
+    uint32_t crtc_id;
+    uint32_t active;
+    uint64_t sequence;
+    int64_t sequence_ns;
+};
+
+#define DRM_CRTC_SEQUENCE_RELATIVE          0x00000001
+#define DRM_CRTC_SEQUENCE_NEXT_ON_MISS      0x00000002
+
+struct drm_crtc_queue_sequence {
+    uint32_t crtc_id;
+    uint32_t flags;
+    uint64_t sequence;
+    uint64_t user_data;
+};
+
+struct drm_mode_create_dumb {
+    uint32_t height;
+    uint32_t width;
+    uint32_t bpp;
+    uint32_t flags;
+    uint32_t handle;
+    uint32_t pitch;
+    uint64_t size;
+};
+
+struct drm_mode_map_dumb {
+    uint32_t handle;
+    uint32_t pad;
+    uint64_t offset;
+};
+
+struct drm_mode_destroy_dumb {
+    uint32_t handle;
+};
+
+struct drm_mode_fb_cmd {
+    uint32_t fb_id;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint32_t bpp;
+    uint32_t depth;
+    uint32_t handle;
+};
+
+struct drm_mode_fb_cmd2 {
+    uint32_t fb_id;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixel_format;
+    uint32_t flags;
+    uint32_t handles[4];
+    uint32_t pitches[4];
+    uint32_t offsets[4];
+    uint64_t modifier[4];
+};
+
+#define DRM_MODE_PAGE_FLIP_EVENT        0x01
+#define DRM_MODE_PAGE_FLIP_ASYNC        0x02
+
+struct drm_mode_crtc_page_flip {
+    uint32_t crtc_id;
+    uint32_t fb_id;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t user_data;
+};
+
+#define DRM_MODE_ATOMIC_TEST_ONLY       0x0100
+#define DRM_MODE_ATOMIC_NONBLOCK        0x0200
+#define DRM_MODE_ATOMIC_ALLOW_MODESET   0x0400
+
+struct drm_mode_atomic {
+    uint32_t flags;
+    uint32_t count_objs;
+    uint64_t objs_ptr;
+    uint64_t count_props_ptr;
+    uint64_t props_ptr;
+    uint64_t prop_values_ptr;
+    uint64_t reserved;
+    uint64_t user_data;
+};
+
+#define DRM_IOCTL_GEM_CLOSE             DRM_IOW(0x09, struct drm_gem_close)
+#define DRM_IOCTL_GET_CAP               DRM_IOWR(0x0c, struct drm_get_cap)
+#define DRM_IOCTL_PRIME_HANDLE_TO_FD    DRM_IOWR(0x2d, struct drm_prime_handle)
+#define DRM_IOCTL_PRIME_FD_TO_HANDLE    DRM_IOWR(0x2e, struct drm_prime_handle)
+#define DRM_IOCTL_WAIT_VBLANK           DRM_IOWR(0x3a, union drm_wait_vblank)
+#define DRM_IOCTL_CRTC_GET_SEQUENCE     DRM_IOWR(0x3b, struct drm_crtc_get_sequence)
+#define DRM_IOCTL_CRTC_QUEUE_SEQUENCE   DRM_IOWR(0x3c, struct drm_crtc_queue_sequence)
+#define DRM_IOCTL_MODE_ADDFB            DRM_IOWR(0xAE, struct drm_mode_fb_cmd)
+#define DRM_IOCTL_MODE_RMFB             DRM_IOWR(0xAF, unsigned int)
+#define DRM_IOCTL_MODE_PAGE_FLIP        DRM_IOWR(0xB0, struct drm_mode_crtc_page_flip)
+#define DRM_IOCTL_MODE_CREATE_DUMB      DRM_IOWR(0xB2, struct drm_mode_create_dumb)
+#define DRM_IOCTL_MODE_MAP_DUMB         DRM_IOWR(0xB3, struct drm_mode_map_dumb)
+#define DRM_IOCTL_MODE_DESTROY_DUMB     DRM_IOWR(0xB4, struct drm_mode_destroy_dumb)
+#define DRM_IOCTL_MODE_ADDFB2           DRM_IOWR(0xB8, struct drm_mode_fb_cmd2)
+#define DRM_IOCTL_MODE_ATOMIC           DRM_IOWR(0xBC, struct drm_mode_atomic)
+
+struct drm_event {
+    uint32_t type;
+    uint32_t length;
+};
+
+#define DRM_EVENT_VBLANK                0x01
+#define DRM_EVENT_FLIP_COMPLETE         0x02
+#define DRM_EVENT_CRTC_SEQUENCE         0x03
+
+struct drm_event_vblank {
+    struct drm_event base;
+    uint64_t user_data;
+    uint32_t tv_sec;
+    uint32_t tv_usec;
+    uint32_t sequence;
+    uint32_t crtc_id;
+};
+
+struct drm_event_crtc_sequence {
+    struct drm_event base;
+    uint64_t user_data;
+    int64_t time_ns;
+    uint64_t sequence;
+};
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * Copyright © 2026 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _XF86DRM_H_
+#define _XF86DRM_H_
+
+//
+// The libdrm calls the driver makes. fake_drm.c implements them the way
+// libdrm does, as ioctls on the DRM fd, which the fake device serves.
+//
+
+#include <stdint.h>
+
+#include <drm.h>
+
+#define DRM_EVENT_CONTEXT_VERSION   4
+
+typedef struct _drmEventContext {
+    int version;
+
+    void (*vblank_handler)(int fd, unsigned int sequence,
+                           unsigned int tv_sec, unsigned int tv_usec,
+                           void *user_data);
+
+    void (*page_flip_handler)(int fd, unsigned int sequence,
+                              unsigned int tv_sec, unsigned int tv_usec,
+                              void *user_data);
+
+    void (*page_flip_handler2)(int fd, unsigned int sequence,
+                               unsigned int tv_sec, unsigned int tv_usec,
+                               unsigned int crtc_id, void *user_data);
+
+    void (*sequence_handler)(int fd, uint64_t sequence, uint64_t ns,
+                             uint64_t user_data);
+} drmEventContext, *drmEventContextPtr;
+
+typedef enum {
+    DRM_VBLANK_ABSOLUTE = 0x0,
+    DRM_VBLANK_RELATIVE = 0x1,
+    DRM_VBLANK_HIGH_CRTC_MASK = 0x0000003e,
+    DRM_VBLANK_EVENT = 0x4000000,
+    DRM_VBLANK_FLIP = 0x8000000,
+    DRM_VBLANK_NEXTONMISS = 0x10000000,
+    DRM_VBLANK_SECONDARY = 0x20000000,
+    DRM_VBLANK_SIGNAL = 0x40000000,
+} drmVBlankSeqType;
+
+#define DRM_VBLANK_HIGH_CRTC_SHIFT  1
+
+typedef struct _drmVBlankReq {
+    drmVBlankSeqType type;
+    unsigned int sequence;
+    unsigned long signal;
+} drmVBlankReq, *drmVBlankReqPtr;
+
+typedef struct _drmVBlankReply {
+    drmVBlankSeqType type;
+    unsigned int sequence;
+    long tval_sec;
+    long tval_usec;
+} drmVBlankReply, *drmVBlankReplyPtr;
+
+typedef union _drmVBlank {
+    drmVBlankReq request;
+    drmVBlankReply reply;
+} drmVBlank, *drmVBlankPtr;
+
+int drmIoctl(int fd, unsigned long request, void *arg);
+int drmGetCap(int fd, uint64_t capability, uint64_t *value);
+int drmHandleEvent(int fd, drmEventContextPtr evctx);
+int drmWaitVBlank(int fd, drmVBlankPtr vbl);
+int drmCrtcGetSequence(int fd, uint32_t crtcId, uint64_t *sequence,
+                       uint64_t *ns);
+int drmCrtcQueueSequence(int fd, uint32_t crtcId, uint32_t flags,
+                         uint64_t sequence, uint64_t *sequence_queued,
+                         uint64_t user_data);
+int drmPrimeHandleToFD(int fd, uint32_t handle, uint32_t flags,
+                       int *prime_fd);
+int drmPrimeFDToHandle(int fd, int prime_fd, uint32_t *handle);
+char *drmGetDeviceNameFromFd(int fd);
+int drmSetMaster(int fd);
+int drmDropMaster(int fd);
+
+#endif
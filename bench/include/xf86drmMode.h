@@ -0,0 +1,92 @@
+/*
+ * Copyright © 2026 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _XF86DRMMODE_H_
+#define _XF86DRMMODE_H_
+
+//
+// The libdrm KMS calls and types the driver uses, see xf86drm.h.
+//
+
+#include <stdint.h>
+
+#include <drm.h>
+
+#define DRM_DISPLAY_MODE_LEN    32
+
+typedef struct _drmModeModeInfo {
+    uint32_t clock;
+    uint16_t hdisplay, hsync_start, hsync_end, htotal, hskew;
+    uint16_t vdisplay, vsync_start, vsync_end, vtotal, vscan;
+    uint32_t vrefresh;
+    uint32_t flags;
+    uint32_t type;
+    char name[DRM_DISPLAY_MODE_LEN];
+} drmModeModeInfo, *drmModeModeInfoPtr;
+
+typedef struct _drmModeCrtc {
+    uint32_t crtc_id;
+    uint32_t buffer_id;
+    uint32_t x, y;
+    uint32_t width, height;
+    int mode_valid;
+    drmModeModeInfo mode;
+    int gamma_size;
+} drmModeCrtc, *drmModeCrtcPtr;
+
+typedef struct _drmModeFB {
+    uint32_t fb_id;
+    uint32_t width, height;
+    uint32_t pitch;
+    uint32_t bpp;
+    uint32_t depth;
+    uint32_t handle;
+} drmModeFB, *drmModeFBPtr;
+
+typedef struct _drmModeRes *drmModeResPtr;
+typedef struct _drmModeConnector *drmModeConnectorPtr;
+typedef struct _drmModeEncoder *drmModeEncoderPtr;
+typedef struct _drmModePropertyBlob *drmModePropertyBlobPtr;
+typedef struct _drmModeProperty *drmModePropertyPtr;
+
+typedef struct _drmModeAtomicReq drmModeAtomicReq, *drmModeAtomicReqPtr;
+
+int drmModeAddFB(int fd, uint32_t width, uint32_t height, uint8_t depth,
+                 uint8_t bpp, uint32_t pitch, uint32_t bo_handle,
+                 uint32_t *buf_id);
+int drmModeAddFB2(int fd, uint32_t width, uint32_t height,
+                  uint32_t pixel_format, const uint32_t bo_handles[4],
+                  const uint32_t pitches[4], const uint32_t offsets[4],
+                  uint32_t *buf_id, uint32_t flags);
+int drmModeRmFB(int fd, uint32_t bufferId);
+int drmModePageFlip(int fd, uint32_t crtc_id, uint32_t fb_id,
+                    uint32_t flags, void *user_data);
+
+drmModeAtomicReqPtr drmModeAtomicAlloc(void);
+void drmModeAtomicFree(drmModeAtomicReqPtr req);
+int drmModeAtomicAddProperty(drmModeAtomicReqPtr req, uint32_t object_id,
+                             uint32_t property_id, uint64_t value);
+int drmModeAtomicCommit(int fd, drmModeAtomicReqPtr req, uint32_t flags,
+                        void *user_data);
+
+#endif
@@ -0,0 +1,870 @@
+/*
+ * Copyright © 2026 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef XORG_STUBS_H_
+#define XORG_STUBS_H_
+
+//
+// The part of the X server API the driver sources use, enough to build
+// them outside of the server. Every server header the driver includes
+// (xf86.h, exa.h, picturestr.h, ...) is a one line file pulling in this
+// one. Structures only carry the members the driver touches, the
+// functions are implemented in stubs.c.
+//
+// Nothing here has to be binary compatible with a real server, the
+// benchmarks never load into one.
+//
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include <xf86drmMode.h>
+
+#define _X_EXPORT
+#define _X_INTERNAL
+#define _X_UNUSED           __attribute__((unused))
+#define _X_ATTRIBUTE_PRINTF(fmt, args) \
+    __attribute__((format(printf, fmt, args)))
+
+typedef int Bool;
+typedef uint8_t CARD8;
+typedef uint16_t CARD16;
+typedef uint32_t CARD32;
+typedef uint64_t CARD64;
+typedef int16_t INT16;
+typedef int32_t INT32;
+typedef uint32_t XID;
+typedef uint32_t Atom;
+typedef uint32_t RRCrtc;
+typedef uint32_t Window;
+typedef unsigned long Pixel;
+typedef unsigned short Rotation;
+typedef void *pointer;
+
+#ifndef TRUE
+#define TRUE    1
+#define FALSE   0
+#endif
+
+#define Success         0
+#define BadAlloc        11
+#define BadMatch        8
+#define BadValue        2
+#define BadDrawable     9
+
+#define None            0L
+
+#ifndef min
+#define min(a, b)       (((a) < (b)) ? (a) : (b))
+#define max(a, b)       (((a) > (b)) ? (a) : (b))
+#endif
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(a)   (sizeof((a)) / sizeof((a)[0]))
+#endif
+
+#define RR_Rotate_0     1
+#define RR_Rotate_90    2
+#define RR_Rotate_180   4
+#define RR_Rotate_270   8
+
+#define DPMSModeOn      0
+#define DPMSModeStandby 1
+#define DPMSModeSuspend 2
+#define DPMSModeOff     3
+
+
+/////////////////////////////////////////////////////////////////////////
+// os, list
+
+typedef enum {
+    X_PROBED,
+    X_CONFIG,
+    X_DEFAULT,
+    X_CMDLINE,
+    X_NOTICE,
+    X_ERROR,
+    X_WARNING,
+    X_INFO,
+    X_NONE,
+    X_NOT_IMPLEMENTED,
+    X_DEBUG,
+    X_UNKNOWN = -1
+} MessageType;
+
+typedef void (*OsSigHandlerPtr)(int sig);
+typedef struct _OsTimerRec *OsTimerPtr;
+typedef CARD32 (*OsTimerCallback)(OsTimerPtr timer, CARD32 time, void *arg);
+typedef void (*InputHandlerProc)(int fd, void *data);
+typedef void (*NotifyFdProcPtr)(int fd, int ready, void *data);
+
+#define X_NOTIFY_READ   1
+#define X_NOTIFY_WRITE  2
+
+typedef struct _Client *ClientPtr;
+#define NullClient      ((ClientPtr) 0)
+#define serverClient    ((ClientPtr) 0)
+
+OsSigHandlerPtr OsSignal(int sig, OsSigHandlerPtr handler);
+CARD32 GetTimeInMillis(void);
+CARD64 GetTimeInMicros(void);
+OsTimerPtr TimerSet(OsTimerPtr timer, int flags, CARD32 millis,
+                    OsTimerCallback func, void *arg);
+void TimerCancel(OsTimerPtr timer);
+void TimerFree(OsTimerPtr timer);
+Bool SetNotifyFd(int fd, NotifyFdProcPtr notify, int mask, void *data);
+void RemoveNotifyFd(int fd);
+void LogMessage(MessageType type, const char *format, ...)
+    _X_ATTRIBUTE_PRINTF(2, 3);
+void LogMessageVerb(MessageType type, int verb, const char *format, ...)
+    _X_ATTRIBUTE_PRINTF(3, 4);
+void FatalError(const char *format, ...)
+    _X_ATTRIBUTE_PRINTF(1, 2) __attribute__((noreturn));
+
+#define xallocarray(n, s)   calloc((n), (s))
+void *XNFcallocarray(size_t nmemb, size_t size);
+#define xnfcalloc(n, s)     XNFcallocarray((n), (s))
+
+struct xorg_list {
+    struct xorg_list *next, *prev;
+};
+
+static inline void xorg_list_init(struct xorg_list *list)
+{
+    list->next = list->prev = list;
+}
+
+static inline void __xorg_list_add(struct xorg_list *entry,
+                                   struct xorg_list *prev,
+                                   struct xorg_list *next)
+{
+    next->prev = entry;
+    entry->next = next;
+    entry->prev = prev;
+    prev->next = entry;
+}
+
+static inline void xorg_list_add(struct xorg_list *entry,
+                                 struct xorg_list *head)
+{
+    __xorg_list_add(entry, head, head->next);
+}
+
+static inline void xorg_list_append(struct xorg_list *entry,
+                                    struct xorg_list *head)
+{
+    __xorg_list_add(entry, head->prev, head);
+}
+
+static inline void xorg_list_del(struct xorg_list *entry)
+{
+    entry->next->prev = entry->prev;
+    entry->prev->next = entry->next;
+    xorg_list_init(entry);
+}
+
+static inline int xorg_list_is_empty(struct xorg_list *head)
+{
+    return head->next == head;
+}
+
+#ifndef container_of
+#define container_of(ptr, type, member) \
+    ((type *) ((char *) (ptr) - offsetof(type, member)))
+#endif
+
+#define xorg_list_entry(ptr, type, member)  container_of(ptr, type, member)
+
+#define xorg_list_first_entry(ptr, type, member) \
+    xorg_list_entry((ptr)->next, type, member)
+
+#define xorg_list_for_each_entry(pos, head, member)                        \
+    for (pos = xorg_list_entry((head)->next, __typeof__(*pos), member);    \
+         &pos->member != (head);                                           \
+         pos = xorg_list_entry(pos->member.next, __typeof__(*pos), member))
+
+#define xorg_list_for_each_entry_safe(pos, tmp, head, member)              \
+    for (pos = xorg_list_entry((head)->next, __typeof__(*pos), member),    \
+         tmp = xorg_list_entry(pos->member.next, __typeof__(*pos), member);\
+         &pos->member != (head);                                           \
+         pos = tmp,                                                        \
+         tmp = xorg_list_entry(pos->member.next, __typeof__(*tmp), member))
+
+
+/////////////////////////////////////////////////////////////////////////
+// regions
+
+typedef struct _Box {
+    short x1, y1, x2, y2;
+} BoxRec, *BoxPtr;
+
+typedef struct _RegData {
+    long size;
+    long numRects;
+} RegDataRec, *RegDataPtr;
+
+typedef struct _Region {
+    BoxRec extents;
+    RegDataPtr data;
+} RegionRec, *RegionPtr;
+
+//
+// Regions are kept as their extents only, which is all the benchmarks
+// need to route damage around.
+//
+void RegionInit(RegionPtr pReg, BoxPtr rect, int size);
+void RegionUninit(RegionPtr pReg);
+void RegionEmpty(RegionPtr pReg);
+Bool RegionNotEmpty(RegionPtr pReg);
+Bool RegionUnion(RegionPtr newReg, RegionPtr reg1, RegionPtr reg2);
+Bool RegionIntersect(RegionPtr newReg, RegionPtr reg1, RegionPtr reg2);
+Bool RegionCopy(RegionPtr dst, RegionPtr src);
+void RegionTranslate(RegionPtr pReg, int x, int y);
+RegionPtr RegionCreate(BoxPtr rect, int size);
+void RegionDestroy(RegionPtr pReg);
+
+static inline int RegionNumRects(RegionPtr pReg)
+{
+    return (pReg->extents.x1 < pReg->extents.x2) ? 1 : 0;
+}
+
+static inline BoxPtr RegionRects(RegionPtr pReg)
+{
+    return &pReg->extents;
+}
+
+static inline BoxPtr RegionExtents(RegionPtr pReg)
+{
+    return &pReg->extents;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+// privates
+
+typedef struct _Private PrivateRec;
+
+typedef enum {
+    PRIVATE_SCREEN,
+    PRIVATE_PIXMAP,
+    PRIVATE_WINDOW,
+    PRIVATE_DEVICE,
+    PRIVATE_CURSOR,
+    PRIVATE_LAST,
+} DevPrivateType;
+
+typedef struct _DevPrivateKeyRec {
+    int offset;
+    int size;
+    Bool initialized;
+} DevPrivateKeyRec, *DevPrivateKey;
+
+typedef struct _DevScreenPrivateKeyRec {
+    DevPrivateKeyRec screenKey;
+} DevScreenPrivateKeyRec, *DevScreenPrivateKey;
+
+Bool dixRegisterPrivateKey(DevPrivateKey key, DevPrivateType type,
+                           unsigned size);
+void *dixGetPrivateAddr(PrivateRec **privates, const DevPrivateKey key);
+void *dixLookupPrivate(PrivateRec **privates, const DevPrivateKey key);
+void dixSetPrivate(PrivateRec **privates, const DevPrivateKey key, void *val);
+Bool dixPrivateKeyRegistered(DevPrivateKey key);
+void *dixLookupScreenPrivate(PrivateRec **privates,
+                             DevScreenPrivateKey key, void *pScreen);
+
+
+/////////////////////////////////////////////////////////////////////////
+// drawables, pixmaps, GCs
+
+typedef struct _Screen ScreenRec, *ScreenPtr;
+
+#define DRAWABLE_WINDOW         0
+#define DRAWABLE_PIXMAP         1
+
+#define CREATE_PIXMAP_USAGE_SCRATCH             1
+#define CREATE_PIXMAP_USAGE_BACKING_PIXMAP      2
+#define CREATE_PIXMAP_USAGE_GLYPH_PICTURE       3
+#define CREATE_PIXMAP_USAGE_SHARED              4
+
+typedef struct _Drawable {
+    unsigned char type;
+    unsigned char class;
+    unsigned char depth;
+    unsigned char bitsPerPixel;
+    XID id;
+    short x;
+    short y;
+    unsigned short width;
+    unsigned short height;
+    ScreenPtr pScreen;
+    unsigned long serialNumber;
+} DrawableRec, *DrawablePtr;
+
+typedef union _DevUnion {
+    void *ptr;
+    long val;
+    unsigned long uval;
+} DevUnion;
+
+typedef struct _Pixmap {
+    DrawableRec drawable;
+    PrivateRec *devPrivates;
+    int refcnt;
+    int devKind;
+    DevUnion devPrivate;
+    unsigned usage_hint;
+} PixmapRec, *PixmapPtr;
+
+typedef struct _Window {
+    DrawableRec drawable;
+    PrivateRec *devPrivates;
+    struct _Window *parent;
+    RegionRec clipList;
+} WindowRec, *WindowPtr;
+
+typedef struct _PixmapDirtyUpdateRec *PixmapDirtyUpdatePtr;
+
+#define GXclear         0x0
+#define GXcopy          0x3
+#define GXxor           0x6
+
+#define GCFunction      (1L << 0)
+#define GCPlaneMask     (1L << 1)
+#define GCForeground    (1L << 2)
+
+typedef union {
+    CARD32 val;
+    void *ptr;
+} ChangeGCVal;
+
+typedef struct _GC {
+    ScreenPtr pScreen;
+    unsigned char depth;
+    unsigned char alu;
+    unsigned long planemask;
+    unsigned long fgPixel;
+} GC, *GCPtr;
+
+GCPtr GetScratchGC(unsigned depth, ScreenPtr pScreen);
+void FreeScratchGC(GCPtr pGC);
+int ChangeGC(ClientPtr client, GCPtr pGC, unsigned long mask,
+             ChangeGCVal *pval);
+void ValidateGC(DrawablePtr pDraw, GCPtr pGC);
+
+
+/////////////////////////////////////////////////////////////////////////
+// screens
+
+typedef Bool (*CloseScreenProcPtr)(ScreenPtr pScreen);
+typedef Bool (*CreateWindowProcPtr)(WindowPtr pWin);
+typedef Bool (*CreateScreenResourcesProcPtr)(ScreenPtr pScreen);
+typedef void (*ScreenBlockHandlerProcPtr)(ScreenPtr pScreen, void *timeout);
+typedef PixmapPtr (*CreatePixmapProcPtr)(ScreenPtr pScreen, int width,
+                                         int height, int depth,
+                                         unsigned usage_hint);
+typedef Bool (*DestroyPixmapProcPtr)(PixmapPtr pPixmap);
+typedef PixmapPtr (*GetScreenPixmapProcPtr)(ScreenPtr pScreen);
+typedef Bool (*ModifyPixmapHeaderProcPtr)(PixmapPtr pPixmap, int width,
+                                          int height, int depth,
+                                          int bitsPerPixel, int devKind,
+                                          void *pPixData);
+typedef PixmapPtr (*GetWindowPixmapProcPtr)(WindowPtr pWin);
+
+struct _Screen {
+    int myNum;
+    short width;
+    short height;
+    unsigned char rootDepth;
+    void *devPrivate;
+    PrivateRec *devPrivates;
+    WindowPtr root;
+
+    CloseScreenProcPtr CloseScreen;
+    CreateWindowProcPtr CreateWindow;
+    CreateScreenResourcesProcPtr CreateScreenResources;
+    ScreenBlockHandlerProcPtr BlockHandler;
+    CreatePixmapProcPtr CreatePixmap;
+    DestroyPixmapProcPtr DestroyPixmap;
+    GetScreenPixmapProcPtr GetScreenPixmap;
+    ModifyPixmapHeaderProcPtr ModifyPixmapHeader;
+    GetWindowPixmapProcPtr GetWindowPixmap;
+
+    Bool isGPU;
+    Bool is_output_slave;
+    struct xorg_list slave_list;
+    struct xorg_list slave_head;
+};
+
+typedef struct _CursorRec *CursorPtr;
+typedef struct _miPointerSpriteFuncRec {
+    void *dummy;
+} miPointerSpriteFuncRec, *miPointerSpriteFuncPtr;
+
+typedef struct _XF86VideoAdaptor *XF86VideoAdaptorPtr;
+typedef struct _DriverRec *DriverPtr;
+typedef struct _RRCrtc *RRCrtcPtr;
+
+typedef Bool (*GetDrawableModifiersFuncPtr)(DrawablePtr draw,
+                                            uint32_t format,
+                                            uint32_t *num_modifiers,
+                                            uint64_t **modifiers);
+
+int AddTraps(void);
+
+
+/////////////////////////////////////////////////////////////////////////
+// options
+
+typedef enum {
+    OPTV_NONE = 0,
+    OPTV_INTEGER,
+    OPTV_STRING,
+    OPTV_ANYSTR,
+    OPTV_REAL,
+    OPTV_BOOLEAN,
+    OPTV_PERCENT,
+    OPTV_FREQ,
+} OptionValueType;
+
+typedef union {
+    unsigned long num;
+    const char *str;
+    double realnum;
+    Bool bool;
+} ValueUnion;
+
+typedef struct {
+    int token;
+    const char *name;
+    OptionValueType type;
+    ValueUnion value;
+    Bool found;
+} OptionInfoRec, *OptionInfoPtr;
+
+const char *xf86GetOptValString(const OptionInfoRec *table, int token);
+Bool xf86GetOptValInteger(const OptionInfoRec *table, int token, int *value);
+Bool xf86GetOptValBool(const OptionInfoRec *table, int token, Bool *value);
+Bool xf86ReturnOptValBool(const OptionInfoRec *table, int token, Bool def);
+Bool xf86IsOptionSet(const OptionInfoRec *table, int token);
+
+
+/////////////////////////////////////////////////////////////////////////
+// xf86 screen and crtc
+
+typedef struct _EntityInfoRec {
+    int index;
+    int chipset;
+} EntityInfoRec, *EntityInfoPtr;
+
+void xf86SetEntitySharable(int entityIndex);
+int xf86AllocateEntityPrivateIndex(void);
+DevUnion *xf86GetEntityPrivate(int entityIndex, int privIndex);
+int xf86GetNumEntityInstances(int entityIndex);
+
+typedef struct _ScrnInfoRec {
+    int scrnIndex;
+    void *driverPrivate;
+    ScreenPtr pScreen;
+    void *options;
+    int bitsPerPixel;
+    int depth;
+    int displayWidth;
+    int virtualX;
+    int virtualY;
+    Bool vtSema;
+    int *entityList;
+    int numEntities;
+} ScrnInfoRec, *ScrnInfoPtr;
+
+typedef struct _DisplayModeRec {
+    int Clock;
+    int HDisplay;
+    int HTotal;
+    int VDisplay;
+    int VTotal;
+    int VScan;
+    int Flags;
+} DisplayModeRec, *DisplayModePtr;
+
+#define V_INTERLACE     0x0010
+#define V_DBLSCAN       0x0020
+
+typedef enum {
+    XF86OutputStatusConnected,
+    XF86OutputStatusDisconnected,
+    XF86OutputStatusUnknown
+} xf86OutputStatus;
+
+typedef struct _xf86Crtc xf86CrtcRec, *xf86CrtcPtr;
+typedef struct _xf86Output xf86OutputRec, *xf86OutputPtr;
+
+struct _xf86Crtc {
+    ScrnInfoPtr scrn;
+    Bool enabled;
+    DisplayModeRec mode;
+    Rotation rotation;
+    int x;
+    int y;
+    void *driver_private;
+    RRCrtcPtr randr_crtc;
+};
+
+struct _xf86Output {
+    ScrnInfoPtr scrn;
+    xf86CrtcPtr crtc;
+    void *driver_private;
+};
+
+typedef struct _xf86CrtcConfig {
+    int num_output;
+    xf86OutputPtr *output;
+    int num_crtc;
+    xf86CrtcPtr *crtc;
+} xf86CrtcConfigRec, *xf86CrtcConfigPtr;
+
+extern ScrnInfoPtr *xf86Screens;
+extern int xf86NumScreens;
+extern unsigned long serverGeneration;
+
+// the crtc config lives in a private of the ScrnInfo in the server
+xf86CrtcConfigPtr xf86BenchCrtcConfig(ScrnInfoPtr pScrn);
+#define XF86_CRTC_CONFIG_PTR(p)     xf86BenchCrtcConfig(p)
+
+ScrnInfoPtr xf86ScreenToScrn(ScreenPtr pScreen);
+ScreenPtr xf86ScrnToScreen(ScrnInfoPtr pScrn);
+void xf86DrvMsg(int scrnIndex, MessageType type, const char *format, ...)
+    _X_ATTRIBUTE_PRINTF(3, 4);
+void xf86DrvMsgVerb(int scrnIndex, MessageType type, int verb,
+                    const char *format, ...) _X_ATTRIBUTE_PRINTF(4, 5);
+void xf86Msg(MessageType type, const char *format, ...)
+    _X_ATTRIBUTE_PRINTF(2, 3);
+void *xf86LoadSubModule(ScrnInfoPtr pScrn, const char *name);
+void xf86CollectOptions(ScrnInfoPtr pScrn, void *extraOpts);
+void xf86ProcessOptions(int scrnIndex, void *options,
+                        OptionInfoPtr optinfo);
+void xf86SetEntityInstanceForScreen(ScrnInfoPtr pScrn, int entityIndex,
+                                    int instance);
+int xf86ModeWidth(const DisplayModeRec *mode, Rotation rotation);
+int xf86ModeHeight(const DisplayModeRec *mode, Rotation rotation);
+Bool xf86_crtc_on(xf86CrtcPtr crtc);
+int xf86_crtc_box_area(BoxPtr box);
+void xf86_crtc_box(xf86CrtcPtr crtc, BoxPtr crtc_box);
+
+
+/////////////////////////////////////////////////////////////////////////
+// randr
+
+typedef struct {
+    CARD16 width;
+    CARD16 height;
+} xRRModeInfo;
+
+typedef struct _RRMode {
+    xRRModeInfo mode;
+} RRModeRec, *RRModePtr;
+
+struct _RRCrtc {
+    ScreenPtr pScreen;
+    RRModePtr mode;
+    int x;
+    int y;
+    Rotation rotation;
+    void *devPrivate;
+};
+
+typedef struct _RROutput {
+    ScreenPtr pScreen;
+    RRCrtcPtr crtc;
+} RROutputRec, *RROutputPtr;
+
+typedef struct _rrScrPriv {
+    RROutputPtr primaryOutput;
+    int numCrtcs;
+    RRCrtcPtr *crtcs;
+    int numOutputs;
+    RROutputPtr *outputs;
+} rrScrPrivRec, *rrScrPrivPtr;
+
+extern DevPrivateKeyRec rrPrivKeyRec;
+#define rrPrivKey           (&rrPrivKeyRec)
+#define rrGetScrPriv(pScr) \
+    ((rrScrPrivPtr) dixLookupPrivate(&(pScr)->devPrivates, rrPrivKey))
+#define rrScrPriv(pScr)     rrScrPrivPtr pScrPriv = rrGetScrPriv(pScr)
+
+
+/////////////////////////////////////////////////////////////////////////
+// present, only what the driver needs without flips
+
+#define PRESENT_SCREEN_INFO_VERSION     1
+
+#define PresentCapabilityNone           0
+#define PresentCapabilityAsync          1
+
+typedef RRCrtcPtr (*present_get_crtc_ptr)(WindowPtr window);
+typedef int (*present_get_ust_msc_ptr)(RRCrtcPtr crtc, CARD64 *ust,
+                                       CARD64 *msc);
+typedef int (*present_queue_vblank_ptr)(RRCrtcPtr crtc, uint64_t event_id,
+                                        uint64_t msc);
+typedef void (*present_abort_vblank_ptr)(RRCrtcPtr crtc, uint64_t event_id,
+                                         uint64_t msc);
+typedef void (*present_flush_ptr)(WindowPtr window);
+
+typedef struct present_screen_info {
+    uint32_t version;
+
+    present_get_crtc_ptr get_crtc;
+    present_get_ust_msc_ptr get_ust_msc;
+    present_queue_vblank_ptr queue_vblank;
+    present_abort_vblank_ptr abort_vblank;
+    present_flush_ptr flush;
+    uint32_t capabilities;
+} present_screen_info_rec, *present_screen_info_ptr;
+
+Bool present_screen_init(ScreenPtr screen, present_screen_info_ptr info);
+void present_event_notify(uint64_t event_id, uint64_t ust, uint64_t msc);
+
+
+/////////////////////////////////////////////////////////////////////////
+// fb
+
+typedef CARD32 FbBits;
+
+#define FB_SHIFT        5
+#define FB_UNIT         (1 << FB_SHIFT)
+#define FB_MASK         (FB_UNIT - 1)
+#define FB_ALLONES      ((FbBits) -1)
+#define FbFullMask(n)   ((n) == FB_UNIT ? FB_ALLONES : ((((FbBits) 1) << (n)) - 1))
+
+void fbFill(DrawablePtr pDrawable, GCPtr pGC, int x, int y,
+            int width, int height);
+void *fbCopyArea(DrawablePtr pSrcDrawable, DrawablePtr pDstDrawable,
+                 GCPtr pGC, int xIn, int yIn, int widthSrc, int heightSrc,
+                 int xOut, int yOut);
+
+
+/////////////////////////////////////////////////////////////////////////
+// render
+
+#define PICT_FORMAT(bpp, type, a, r, g, b) \
+    (((bpp) << 24) | ((type) << 16) | ((a) << 12) | ((r) << 8) | ((g) << 4) | (b))
+
+#define PICT_TYPE_A     1
+#define PICT_TYPE_ARGB  2
+#define PICT_TYPE_ABGR  3
+
+#define PICT_FORMAT_BPP(f)  (((f) >> 24))
+
+typedef enum {
+    PICT_a8r8g8b8 = PICT_FORMAT(32, PICT_TYPE_ARGB, 8, 8, 8, 8),
+    PICT_x8r8g8b8 = PICT_FORMAT(32, PICT_TYPE_ARGB, 0, 8, 8, 8),
+    PICT_a8b8g8r8 = PICT_FORMAT(32, PICT_TYPE_ABGR, 8, 8, 8, 8),
+    PICT_x8b8g8r8 = PICT_FORMAT(32, PICT_TYPE_ABGR, 0, 8, 8, 8),
+    PICT_r5g6b5 = PICT_FORMAT(16, PICT_TYPE_ARGB, 0, 5, 6, 5),
+    PICT_a8 = PICT_FORMAT(8, PICT_TYPE_A, 8, 0, 0, 0),
+    PICT_a1 = PICT_FORMAT(1, PICT_TYPE_A, 1, 0, 0, 0),
+} PictFormatShort;
+
+#define PictOpClear     0
+#define PictOpSrc       1
+#define PictOpDst       2
+#define PictOpOver      3
+#define PictOpAdd       12
+
+#define RepeatNone      0
+#define RepeatNormal    1
+
+typedef struct _PictFormat {
+    CARD32 id;
+    CARD32 format;
+    unsigned char type;
+    unsigned char depth;
+} PictFormatRec, *PictFormatPtr;
+
+typedef struct _PictTransform *PictTransformPtr;
+
+typedef struct _Picture {
+    DrawablePtr pDrawable;
+    PictFormatPtr pFormat;
+    CARD32 format;
+    int refcnt;
+    unsigned int repeat:1;
+    unsigned int graphicsExposures:1;
+    unsigned int subWindowMode:1;
+    unsigned int polyEdge:1;
+    unsigned int polyMode:1;
+    unsigned int freeCompClip:1;
+    unsigned int componentAlpha:1;
+    unsigned int repeatType:2;
+    struct _Picture *alphaMap;
+    PictTransformPtr transform;
+    RegionPtr pCompositeClip;
+} PictureRec, *PicturePtr;
+
+typedef void (*CompositeProcPtr)(CARD8 op, PicturePtr pSrc, PicturePtr pMask,
+                                 PicturePtr pDst, INT16 xSrc, INT16 ySrc,
+                                 INT16 xMask, INT16 yMask, INT16 xDst,
+                                 INT16 yDst, CARD16 width, CARD16 height);
+
+typedef struct _GlyphList *GlyphListPtr;
+typedef struct _Glyph *GlyphPtr;
+
+typedef void (*GlyphsProcPtr)(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
+                              PictFormatPtr maskFormat, INT16 xSrc,
+                              INT16 ySrc, int nlist, GlyphListPtr lists,
+                              GlyphPtr *glyphs);
+
+void fbComposite(CARD8 op, PicturePtr pSrc, PicturePtr pMask,
+                 PicturePtr pDst, INT16 xSrc, INT16 ySrc, INT16 xMask,
+                 INT16 yMask, INT16 xDst, INT16 yDst, CARD16 width,
+                 CARD16 height);
+
+
+/////////////////////////////////////////////////////////////////////////
+// exa
+
+#define EXA_VERSION_MAJOR       2
+#define EXA_VERSION_MINOR       6
+
+#define EXA_OFFSCREEN_PIXMAPS       (1 << 0)
+#define EXA_OFFSCREEN_ALIGN_POT     (1 << 1)
+#define EXA_TWO_BITBLT_DIRECTIONS   (1 << 2)
+#define EXA_HANDLES_PIXMAPS         (1 << 3)
+#define EXA_SUPPORTS_PREPARE_AUX    (1 << 4)
+#define EXA_SUPPORTS_OFFSCREEN_OVERLAPS (1 << 5)
+#define EXA_MIXED_PIXMAPS           (1 << 6)
+
+#define EXA_PREPARE_DEST        0
+#define EXA_PREPARE_SRC         1
+#define EXA_PREPARE_MASK        2
+#define EXA_PREPARE_AUX_DEST    3
+#define EXA_PREPARE_AUX_SRC     4
+#define EXA_PREPARE_AUX_MASK    5
+#define EXA_NUM_PREPARE_INDICES 6
+
+#define EXA_PM_IS_SOLID(_pDrawable, _pm) \
+    (((_pm) & FbFullMask((_pDrawable)->depth)) == \
+     FbFullMask((_pDrawable)->depth))
+
+typedef struct _ExaDriver {
+    int exa_major, exa_minor;
+
+    CARD8 *memoryBase;
+    unsigned long offScreenBase;
+    unsigned long memorySize;
+    int pixmapOffsetAlign;
+    int pixmapPitchAlign;
+    int flags;
+    int maxX;
+    int maxY;
+
+    Bool (*PrepareSolid)(PixmapPtr pPixmap, int alu, Pixel planemask,
+                         Pixel fg);
+    void (*Solid)(PixmapPtr pPixmap, int x1, int y1, int x2, int y2);
+    void (*DoneSolid)(PixmapPtr pPixmap);
+
+    Bool (*PrepareCopy)(PixmapPtr pSrcPixmap, PixmapPtr pDstPixmap,
+                        int dx, int dy, int alu, Pixel planemask);
+    void (*Copy)(PixmapPtr pDstPixmap, int srcX, int srcY, int dstX,
+                 int dstY, int width, int height);
+    void (*DoneCopy)(PixmapPtr pDstPixmap);
+
+    Bool (*CheckComposite)(int op, PicturePtr pSrcPicture,
+                           PicturePtr pMaskPicture, PicturePtr pDstPicture);
+    Bool (*PrepareComposite)(int op, PicturePtr pSrcPicture,
+                             PicturePtr pMaskPicture,
+                             PicturePtr pDstPicture, PixmapPtr pSrc,
+                             PixmapPtr pMask, PixmapPtr pDst);
+    void (*Composite)(PixmapPtr pDst, int srcX, int srcY, int maskX,
+                      int maskY, int dstX, int dstY, int width, int height);
+    void (*DoneComposite)(PixmapPtr pDst);
+
+    Bool (*UploadToScreen)(PixmapPtr pDst, int x, int y, int w, int h,
+                           char *src, int src_pitch);
+    Bool (*DownloadFromScreen)(PixmapPtr pSrc, int x, int y, int w, int h,
+                               char *dst, int dst_pitch);
+
+    int (*MarkSync)(ScreenPtr pScreen);
+    void (*WaitMarker)(ScreenPtr pScreen, int marker);
+
+    Bool (*PrepareAccess)(PixmapPtr pPix, int index);
+    void (*FinishAccess)(PixmapPtr pPix, int index);
+    Bool (*PixmapIsOffscreen)(PixmapPtr pPix);
+
+    void *(*CreatePixmap)(ScreenPtr pScreen, int size, int align);
+    void (*DestroyPixmap)(ScreenPtr pScreen, void *driverPriv);
+    Bool (*ModifyPixmapHeader)(PixmapPtr pPixmap, int width, int height,
+                               int depth, int bitsPerPixel, int devKind,
+                               void *pPixData);
+    void *(*CreatePixmap2)(ScreenPtr pScreen, int width, int height,
+                           int depth, int usage_hint, int bitsPerPixel,
+                           int *new_fb_pitch);
+} ExaDriverRec, *ExaDriverPtr;
+
+ExaDriverPtr exaDriverAlloc(void);
+Bool exaDriverInit(ScreenPtr pScreen, ExaDriverPtr pScreenInfo);
+void exaDriverFini(ScreenPtr pScreen);
+void *exaGetPixmapDriverPrivate(PixmapPtr p);
+void exaMarkSync(ScreenPtr pScreen);
+void exaWaitSync(ScreenPtr pScreen);
+
+
+/////////////////////////////////////////////////////////////////////////
+// damage, shadow
+
+typedef struct _damage *DamagePtr;
+
+typedef enum _damageReportLevel {
+    DamageReportRawRegion,
+    DamageReportDeltaRegion,
+    DamageReportBoundingBox,
+    DamageReportNonEmpty,
+    DamageReportNone
+} DamageReportLevel;
+
+typedef void (*DamageReportFunc)(DamagePtr pDamage, RegionPtr pRegion,
+                                 void *closure);
+typedef void (*DamageDestroyFunc)(DamagePtr pDamage, void *closure);
+
+DamagePtr DamageCreate(DamageReportFunc damageReport,
+                       DamageDestroyFunc damageDestroy,
+                       DamageReportLevel damageLevel, Bool isInternal,
+                       ScreenPtr pScreen, void *closure);
+void DamageRegister(DrawablePtr pDrawable, DamagePtr pDamage);
+void DamageUnregister(DamagePtr pDamage);
+void DamageDestroy(DamagePtr pDamage);
+RegionPtr DamageRegion(DamagePtr pDamage);
+void DamageEmpty(DamagePtr pDamage);
+void DamageRegionAppend(DrawablePtr pDrawable, RegionPtr pRegion);
+void DamageRegionProcessPending(DrawablePtr pDrawable);
+
+typedef struct _shadowBuf *shadowBufPtr;
+typedef void (*ShadowUpdateProc)(ScreenPtr pScreen, shadowBufPtr pBuf);
+typedef void *(*ShadowWindowProc)(ScreenPtr pScreen, CARD32 row,
+                                  CARD32 offset, int mode, CARD32 *size,
+                                  void *closure);
+
+#endif
@@ -0,0 +1,778 @@
+/*
+ * Copyright © 2026 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+//
+// Presents frames through vblank.c and present.c the way the X server
+// does, against the KMS side of fake_drm.c: a vblank clock of its own
+// refresh rate delivers the events through the DRM fd, which the main
+// loop of stubs.c polls. One JSON object per case is printed to stdout:
+// the latency from queueing a frame to the event that put it on the
+// screen, the frames that came late and the ioctls each frame cost.
+//
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <xf86.h>
+#include <xf86Crtc.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <present.h>
+
+#include "driver.h"
+#include "drmmode_display.h"
+#include "dumb_bo.h"
+#include "loongson_entity.h"
+
+#include "fake_drm.h"
+#include "stubs.h"
+
+#define KMS_MAX_FRAMES      100000
+#define KMS_MAX_LIST        16
+
+// a 1920x1080 mode, the pixel clock sets the refresh rate
+#define KMS_WIDTH           1920
+#define KMS_HEIGHT          1080
+#define KMS_HTOTAL          2200
+#define KMS_VTOTAL          1125
+
+enum kms_mode {
+    // the vblank the copy of a PresentPixmap() waits for
+    KMS_MODE_PRESENT,
+    // a flip after the vblank before the target, legacy or atomic
+    KMS_MODE_FLIP,
+    KMS_MODE_ATOMIC,
+    KMS_NUM_MODES,
+};
+
+static const char * const kmsModeNames[KMS_NUM_MODES] = {
+    "present",
+    "flip",
+    "atomic",
+};
+
+enum kms_vblank {
+    // CRTC_GET_SEQUENCE and CRTC_QUEUE_SEQUENCE
+    KMS_VBLANK_SEQUENCE,
+    // WAIT_VBLANK, the kernel refuses the above
+    KMS_VBLANK_WAIT,
+    KMS_NUM_VBLANKS,
+};
+
+static const char * const kmsVblankNames[KMS_NUM_VBLANKS] = {
+    "sequence",
+    "wait",
+};
+
+struct kms_list {
+    int n;
+    int v[KMS_MAX_LIST];
+};
+
+struct kms_ctx {
+    ScrnInfoRec scrn;
+    ScreenRec screen;
+    EntityInfoRec ent;
+    modesettingPtr ms;
+
+    xf86CrtcRec crtc;
+    xf86CrtcPtr crtcs[1];
+    xf86CrtcConfigRec config;
+    drmmode_crtc_private_rec drmmode_crtc;
+    drmModeCrtc mode_crtc;
+    RRCrtcPtr rr_crtc;
+    RRModeRec rr_mode;
+
+    present_screen_info_ptr present;
+
+    struct dumb_bo *bos[2];
+    uint32_t fbs[2];
+    int front;
+
+    struct fake_drm_display display;
+    double refresh;
+
+    // the case
+    enum kms_mode mode;
+    enum kms_vblank vblank;
+    int work_us;
+    int frames;
+
+    // the frame in flight
+    uint64_t event_id;
+    uint64_t queue_msc;
+    Bool done;
+    Bool failed;
+    uint64_t done_ns;
+    uint64_t done_msc;
+};
+
+static struct kms_ctx *kmsCtx;
+static struct _RRCrtc kmsRRCrtc;
+
+
+static uint64_t kms_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+static int kms_cmp(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  the Present extension, as far as the driver sees it
+
+Bool present_screen_init(ScreenPtr screen, present_screen_info_ptr info)
+{
+    kmsCtx->present = info;
+
+    return TRUE;
+}
+
+
+static void kms_frame_done(uint64_t msc)
+{
+    kmsCtx->done = TRUE;
+    kmsCtx->done_ns = kms_now();
+    kmsCtx->done_msc = msc;
+}
+
+
+static void kms_flip_handler(uint64_t msc, uint64_t usec, void *data)
+{
+    kms_frame_done(msc);
+}
+
+
+static void kms_flip_abort(void *data)
+{
+    kmsCtx->failed = TRUE;
+}
+
+
+//
+// drmmode_crtc_flip() with plane_add_props() of drmmode_display.c,
+// which needs the whole of RandR behind it, against the plane
+// properties of the fake device
+//
+static int kms_crtc_flip(struct kms_ctx *pCtx, uint32_t fb_id,
+                         uint32_t flags, void *data)
+{
+    xf86CrtcPtr crtc = &pCtx->crtc;
+    modesettingPtr ms = pCtx->ms;
+    drmmode_crtc_private_ptr drmmode_crtc = crtc->driver_private;
+    int ret;
+
+    ms->kms_stats.ioctls++;
+
+    if (ms->atomic_modeset)
+    {
+        const uint64_t values[] = {
+            [FAKE_DRM_PLANE_FB_ID] = fb_id,
+            [FAKE_DRM_PLANE_CRTC_ID] = drmmode_crtc->mode_crtc->crtc_id,
+            [FAKE_DRM_PLANE_SRC_X] = (uint64_t) crtc->x << 16,
+            [FAKE_DRM_PLANE_SRC_Y] = (uint64_t) crtc->y << 16,
+            [FAKE_DRM_PLANE_SRC_W] = (uint64_t) crtc->mode.HDisplay << 16,
+            [FAKE_DRM_PLANE_SRC_H] = (uint64_t) crtc->mode.VDisplay << 16,
+            [FAKE_DRM_PLANE_CRTC_X] = 0,
+            [FAKE_DRM_PLANE_CRTC_Y] = 0,
+            [FAKE_DRM_PLANE_CRTC_W] = crtc->mode.HDisplay,
+            [FAKE_DRM_PLANE_CRTC_H] = crtc->mode.VDisplay,
+        };
+        drmModeAtomicReq *req = drmModeAtomicAlloc();
+        uint32_t prop;
+
+        if (!req)
+        {
+            return 1;
+        }
+
+        ret = 1;
+        for (prop = FAKE_DRM_PLANE_FB_ID; prop <= FAKE_DRM_PLANE_CRTC_H; prop++)
+        {
+            ret = drmModeAtomicAddProperty(req, drmmode_crtc->plane_id, prop,
+                                           values[prop]);
+            if (ret <= 0)
+            {
+                break;
+            }
+        }
+
+        flags |= DRM_MODE_ATOMIC_NONBLOCK;
+        ret = (ret > 0) ? drmModeAtomicCommit(ms->fd, req, flags, data) : -1;
+        drmModeAtomicFree(req);
+        return ret;
+    }
+
+    return drmModePageFlip(ms->fd, drmmode_crtc->mode_crtc->crtc_id,
+                           fb_id, flags, data);
+}
+
+
+//
+// The vblank a frame was queued for has come. A copy is done then, a
+// flip is queued now, the way ms_do_pageflip() queues one, and done
+// when its event comes at the next vblank.
+//
+void present_event_notify(uint64_t event_id, uint64_t ust, uint64_t msc)
+{
+    struct kms_ctx *pCtx = kmsCtx;
+    uint32_t seq;
+
+    if (event_id != pCtx->event_id)
+    {
+        return;
+    }
+
+    if (pCtx->mode == KMS_MODE_PRESENT)
+    {
+        // a copy for a vblank that had gone by when it was queued shows
+        // at the next one
+        kms_frame_done(msc + (msc <= pCtx->queue_msc));
+        return;
+    }
+
+    seq = ms_drm_queue_alloc(&pCtx->crtc, pCtx, kms_flip_handler,
+                             kms_flip_abort);
+    if (!seq)
+    {
+        pCtx->failed = TRUE;
+        return;
+    }
+
+    pCtx->front ^= 1;
+
+    if (kms_crtc_flip(pCtx, pCtx->fbs[pCtx->front],
+                      DRM_MODE_PAGE_FLIP_EVENT, (void *) (uintptr_t) seq))
+    {
+        ms_drm_abort_seq(&pCtx->scrn, seq);
+    }
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+
+//
+// One frame: a client that took @work_us to render it asks for the
+// vblank after the one its last frame went out at, like a FIFO swap
+// does. Returns the msc it went out at, 0 if it failed.
+//
+static uint64_t kms_frame(struct kms_ctx *pCtx, uint64_t last_msc,
+                          uint64_t *latency_ns)
+{
+    uint64_t target = last_msc + 1;
+    CARD64 ust, msc;
+    uint64_t t0;
+
+    if (pCtx->work_us)
+    {
+        struct timespec ts = {
+            .tv_sec = pCtx->work_us / 1000000,
+            .tv_nsec = (pCtx->work_us % 1000000) * 1000,
+        };
+
+        nanosleep(&ts, NULL);
+    }
+
+    t0 = kms_now();
+
+    pCtx->event_id++;
+    pCtx->done = pCtx->failed = FALSE;
+
+    // what present_pixmap() asks for every frame
+    if (pCtx->present->get_ust_msc(pCtx->rr_crtc, &ust, &msc) != Success)
+    {
+        return 0;
+    }
+
+    pCtx->queue_msc = msc;
+
+    // a flip is queued at the vblank before the target, it latches at
+    // the next one
+    if (pCtx->present->queue_vblank(pCtx->rr_crtc, pCtx->event_id,
+                                    (pCtx->mode == KMS_MODE_PRESENT) ?
+                                    target : target - 1) != Success)
+    {
+        return 0;
+    }
+
+    while (!pCtx->done && !pCtx->failed)
+    {
+        if (bench_wait_for_something(1000) <= 0)
+        {
+            fprintf(stderr, "no event for a second\n");
+            return 0;
+        }
+    }
+
+    if (pCtx->failed)
+    {
+        return 0;
+    }
+
+    *latency_ns = pCtx->done_ns - t0;
+
+    return pCtx->done_msc;
+}
+
+
+static void kms_run(struct kms_ctx *pCtx)
+{
+    static uint64_t samples[KMS_MAX_FRAMES];
+    unsigned long before[FAKE_DRM_NUM_IOCTLS];
+    unsigned long after[FAKE_DRM_NUM_IOCTLS];
+    struct ms_kms_stats *stats = &pCtx->ms->kms_stats;
+    uint64_t missed = 0;
+    uint64_t last_msc, msc, t0, total, latency;
+    unsigned long ioctls = 0;
+    CARD64 ust;
+    int n, i, p99;
+    const char *sep = "";
+
+    pCtx->display.no_crtc_sequence = (pCtx->vblank == KMS_VBLANK_WAIT);
+    fake_drm_set_display(&pCtx->display);
+
+    // a new server generation finds out what the kernel has again
+    pCtx->ms->has_queue_sequence = FALSE;
+    pCtx->ms->tried_queue_sequence = FALSE;
+    pCtx->ms->atomic_modeset = (pCtx->mode == KMS_MODE_ATOMIC);
+
+    if (pCtx->present->get_ust_msc(pCtx->rr_crtc, &ust, &last_msc) != Success)
+    {
+        fprintf(stderr, "%s/%s: no vblank count\n",
+                kmsModeNames[pCtx->mode], kmsVblankNames[pCtx->vblank]);
+        return;
+    }
+
+    // settle on a vblank first
+    last_msc = kms_frame(pCtx, last_msc, &latency);
+
+    memset(stats, 0, sizeof(*stats));
+    fake_drm_get_counts(before);
+
+    t0 = kms_now();
+
+    for (n = 0; (n < pCtx->frames) && last_msc; n++)
+    {
+        msc = kms_frame(pCtx, last_msc, &samples[n]);
+        if (msc == 0)
+        {
+            break;
+        }
+
+        if (msc > last_msc + 1)
+        {
+            missed += msc - last_msc - 1;
+        }
+
+        last_msc = msc;
+    }
+
+    total = kms_now() - t0;
+
+    fake_drm_get_counts(after);
+
+    if (n < pCtx->frames)
+    {
+        fprintf(stderr, "%s/%s: frame %d failed\n",
+                kmsModeNames[pCtx->mode], kmsVblankNames[pCtx->vblank], n);
+    }
+
+    if (n == 0)
+    {
+        return;
+    }
+
+    qsort(samples, n, sizeof(samples[0]), kms_cmp);
+
+    p99 = min(n - 1, (n * 99) / 100);
+
+    for (i = 0; i < FAKE_DRM_NUM_IOCTLS; i++)
+    {
+        ioctls += after[i] - before[i];
+    }
+
+    printf("{\"mode\":\"%s\",\"vblank\":\"%s\",\"refresh_hz\":%.2f,"
+           "\"work_us\":%d,\"jitter_us\":%u,\"frames\":%d,\"fps\":%.2f,"
+           "\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f,"
+           "\"missed_frames\":%llu,\"driver_missed_frames\":%llu,"
+           "\"driver_queue_us\":%.1f,\"ioctls_per_frame\":%.2f,"
+           "\"ioctls\":{",
+           kmsModeNames[pCtx->mode], kmsVblankNames[pCtx->vblank],
+           pCtx->refresh, pCtx->work_us, pCtx->display.jitter_us, n,
+           n * 1e9 / total,
+           samples[n / 2] / 1e3, samples[p99] / 1e3, samples[n - 1] / 1e3,
+           (unsigned long long) missed,
+           (unsigned long long) stats->missed_frames,
+           stats->events ? stats->queue_ns / 1e3 / stats->events : 0.0,
+           (double) ioctls / n);
+
+    for (i = 0; i < FAKE_DRM_NUM_IOCTLS; i++)
+    {
+        if (after[i] != before[i])
+        {
+            printf("%s\"%s\":%.2f", sep, fake_drm_ioctl_name(i),
+                   (double) (after[i] - before[i]) / n);
+            sep = ",";
+        }
+    }
+
+    printf("}}\n");
+    fflush(stdout);
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+
+static Bool kms_setup(struct kms_ctx *pCtx)
+{
+    ScrnInfoPtr pScrn = &pCtx->scrn;
+    ScreenPtr pScreen = &pCtx->screen;
+    xf86CrtcPtr crtc = &pCtx->crtc;
+    modesettingPtr ms;
+    int i;
+
+    ms = pCtx->ms = calloc(1, sizeof(*ms));
+    if (ms == NULL)
+    {
+        return FALSE;
+    }
+
+    pScrn->driverPrivate = ms;
+    pScrn->bitsPerPixel = 32;
+    pScrn->depth = 24;
+    pScrn->virtualX = pScrn->displayWidth = KMS_WIDTH;
+    pScrn->virtualY = KMS_HEIGHT;
+    pScrn->vtSema = TRUE;
+
+    pScreen->width = KMS_WIDTH;
+    pScreen->height = KMS_HEIGHT;
+    pScreen->rootDepth = pScrn->depth;
+    xorg_list_init(&pScreen->slave_list);
+
+    bench_add_screen(pScrn, pScreen);
+
+    ms->pEnt = &pCtx->ent;
+    LS_SetupEntity(pScrn, pCtx->ent.index);
+
+    ms->fd = ms->drmmode.fd = fake_drm_open();
+    if (ms->fd < 0)
+    {
+        perror("fake_drm_open");
+        return FALSE;
+    }
+
+    // one crtc showing the whole screen, what drmmode_pre_init() and a
+    // modeset leave behind
+    crtc->scrn = pScrn;
+    crtc->enabled = TRUE;
+    crtc->rotation = RR_Rotate_0;
+    crtc->mode.HDisplay = KMS_WIDTH;
+    crtc->mode.VDisplay = KMS_HEIGHT;
+    crtc->mode.HTotal = KMS_HTOTAL;
+    crtc->mode.VTotal = KMS_VTOTAL;
+    crtc->mode.Clock = (int) (KMS_HTOTAL * KMS_VTOTAL * pCtx->refresh / 1000 + 0.5);
+    crtc->driver_private = &pCtx->drmmode_crtc;
+    crtc->randr_crtc = pCtx->rr_crtc = &kmsRRCrtc;
+
+    pCtx->mode_crtc.crtc_id = fake_drm_crtc_id(0);
+    pCtx->drmmode_crtc.drmmode = &ms->drmmode;
+    pCtx->drmmode_crtc.mode_crtc = &pCtx->mode_crtc;
+    pCtx->drmmode_crtc.vblank_pipe = 0;
+    pCtx->drmmode_crtc.dpms_mode = DPMSModeOn;
+    pCtx->drmmode_crtc.plane_id = fake_drm_plane_id(0);
+
+    pCtx->rr_mode.mode.width = KMS_WIDTH;
+    pCtx->rr_mode.mode.height = KMS_HEIGHT;
+    pCtx->rr_crtc->pScreen = pScreen;
+    pCtx->rr_crtc->mode = &pCtx->rr_mode;
+    pCtx->rr_crtc->rotation = RR_Rotate_0;
+    pCtx->rr_crtc->devPrivate = crtc;
+
+    pCtx->crtcs[0] = crtc;
+    pCtx->config.num_crtc = 1;
+    pCtx->config.crtc = pCtx->crtcs;
+    bench_set_crtc_config(pScrn, &pCtx->config);
+
+    // the clock runs at the rate the driver derives from the mode
+    pCtx->display.num_crtcs = 1;
+    pCtx->display.frame_ns = (uint64_t) KMS_HTOTAL * KMS_VTOTAL * 1000000 /
+                             crtc->mode.Clock;
+    if (fake_drm_set_display(&pCtx->display))
+    {
+        perror("fake_drm_set_display");
+        return FALSE;
+    }
+
+    // what ScreenInit() does for vblanks and Present
+    if (!ms_vblank_screen_init(pScreen) || !ms_present_screen_init(pScreen))
+    {
+        fprintf(stderr, "vblank or Present did not come up\n");
+        return FALSE;
+    }
+
+    // the two scanout buffers flips alternate between
+    for (i = 0; i < 2; i++)
+    {
+        pCtx->bos[i] = dumb_bo_create(ms->fd, KMS_WIDTH, KMS_HEIGHT, 32);
+        if ((pCtx->bos[i] == NULL) ||
+            drmModeAddFB(ms->fd, KMS_WIDTH, KMS_HEIGHT, 24, 32,
+                         pCtx->bos[i]->pitch, pCtx->bos[i]->handle,
+                         &pCtx->fbs[i]))
+        {
+            fprintf(stderr, "no scanout buffer\n");
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
+static void kms_teardown(struct kms_ctx *pCtx)
+{
+    unsigned long counts[FAKE_DRM_NUM_IOCTLS];
+    unsigned long bos;
+    uint64_t bytes;
+    int i;
+
+    // logs the vblank statistics of the last case
+    ms_vblank_close_screen(&pCtx->screen);
+
+    for (i = 0; i < 2; i++)
+    {
+        if (pCtx->fbs[i])
+        {
+            drmModeRmFB(pCtx->ms->fd, pCtx->fbs[i]);
+        }
+
+        if (pCtx->bos[i])
+        {
+            dumb_bo_destroy(pCtx->ms->fd, pCtx->bos[i]);
+        }
+    }
+
+    fake_drm_get_counts(counts);
+    fake_drm_get_usage(&bos, &bytes);
+
+    for (i = 0; i < FAKE_DRM_NUM_IOCTLS; i++)
+    {
+        fprintf(stderr, "fake drm: %-20s %lu\n",
+                fake_drm_ioctl_name(i), counts[i]);
+    }
+
+    fprintf(stderr, "fake drm: %lu BOs with %llu bytes left\n",
+            bos, (unsigned long long) bytes);
+
+    fake_drm_close(pCtx->ms->fd);
+    free(pCtx->ms);
+}
+
+
+static Bool kms_parse_list(const char *str, struct kms_list *pList)
+{
+    char *end;
+
+    pList->n = 0;
+
+    do
+    {
+        long v = strtol(str, &end, 10);
+
+        if ((end == str) || (v < 0) || (v > 1000000) ||
+            (pList->n == KMS_MAX_LIST))
+        {
+            return FALSE;
+        }
+
+        pList->v[pList->n++] = v;
+        str = end + 1;
+    } while (*end == ',');
+
+    return *end == '\0';
+}
+
+
+static Bool kms_parse_names(char *str, const char * const *names, int num,
+                            unsigned int *pMask)
+{
+    char *tok;
+    int i;
+
+    *pMask = 0;
+
+    for (tok = strtok(str, ","); tok; tok = strtok(NULL, ","))
+    {
+        for (i = 0; i < num; i++)
+        {
+            if (strcmp(tok, names[i]) == 0)
+            {
+                break;
+            }
+        }
+
+        if (i == num)
+        {
+            return FALSE;
+        }
+
+        *pMask |= 1u << i;
+    }
+
+    return *pMask != 0;
+}
+
+
+static void kms_usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-k modes] [-v vblanks] [-w work] [-n frames] [-r hz] [-j us]\n"
+            "  -k  present, flip, atomic; default all\n"
+            "  -v  sequence (CRTC_QUEUE_SEQUENCE), wait (WAIT_VBLANK);"
+            " default both\n"
+            "  -w  render time of the client per frame in us,"
+            " default 0,20000\n"
+            "  -n  frames per case, default 60\n"
+            "  -r  refresh rate in Hz, default 60\n"
+            "  -j  vblank interrupts are handled up to this many us late,"
+            " default 0\n",
+            prog);
+}
+
+
+int main(int argc, char **argv)
+{
+    struct kms_list work = { 2, { 0, 20000 } };
+    unsigned int modes = (1u << KMS_NUM_MODES) - 1;
+    unsigned int vblanks = (1u << KMS_NUM_VBLANKS) - 1;
+    struct kms_ctx ctx;
+    int c, w;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.frames = 60;
+    ctx.refresh = 60.0;
+    kmsCtx = &ctx;
+
+    while ((c = getopt(argc, argv, "k:v:w:n:r:j:h")) != -1)
+    {
+        switch (c)
+        {
+            case 'k':
+                if (!kms_parse_names(optarg, kmsModeNames, KMS_NUM_MODES,
+                                     &modes))
+                {
+                    kms_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'v':
+                if (!kms_parse_names(optarg, kmsVblankNames,
+                                     KMS_NUM_VBLANKS, &vblanks))
+                {
+                    kms_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'w':
+                if (!kms_parse_list(optarg, &work))
+                {
+                    kms_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'n':
+                ctx.frames = atoi(optarg);
+                if ((ctx.frames <= 0) || (ctx.frames > KMS_MAX_FRAMES))
+                {
+                    kms_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'r':
+                ctx.refresh = atof(optarg);
+                if ((ctx.refresh < 1.0) || (ctx.refresh > 1000.0))
+                {
+                    kms_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'j':
+                ctx.display.jitter_us = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                kms_usage(argv[0]);
+                return (c == 'h') ? 0 : 1;
+        }
+    }
+
+    if (!kms_setup(&ctx))
+    {
+        return 1;
+    }
+
+    for (ctx.mode = 0; ctx.mode < KMS_NUM_MODES; ctx.mode++)
+    {
+        if (!(modes & (1u << ctx.mode)))
+        {
+            continue;
+        }
+
+        for (ctx.vblank = 0; ctx.vblank < KMS_NUM_VBLANKS; ctx.vblank++)
+        {
+            if (!(vblanks & (1u << ctx.vblank)))
+            {
+                continue;
+            }
+
+            for (w = 0; w < work.n; w++)
+            {
+                ctx.work_us = work.v[w];
+                kms_run(&ctx);
+            }
+        }
+    }
+
+    kms_teardown(&ctx);
+
+    return 0;
+}
@@ -0,0 +1,723 @@
+/*
+ * Copyright © 2026 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+//
+// The parts of the X server the EXA layer calls into. Everything the
+// benchmarks do not exercise is either a no-op or counted, see stubs.h.
+//
+
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include <xorg-server.h>
+
+#include "loongson_glyphs.h"
+#include "stubs.h"
+
+#define BENCH_MAX_SCREENS   4
+#define BENCH_MAX_FDS       8
+#define BENCH_MAX_ENTITIES  4
+#define BENCH_MAX_ENTITY_PRIVATES   4
+
+static ScrnInfoPtr benchScreens[BENCH_MAX_SCREENS];
+static ExaDriverPtr benchExaDrivers[BENCH_MAX_SCREENS];
+static xf86CrtcConfigPtr benchCrtcConfigs[BENCH_MAX_SCREENS];
+static unsigned long benchFallbacks;
+
+static struct {
+    int fd;
+    int mask;
+    NotifyFdProcPtr notify;
+    void *data;
+} benchNotifyFds[BENCH_MAX_FDS];
+static int benchNumNotifyFds;
+
+static DevUnion benchEntityPrivates[BENCH_MAX_ENTITIES][BENCH_MAX_ENTITY_PRIVATES];
+static int benchNumEntityPrivates;
+
+ScrnInfoPtr *xf86Screens = benchScreens;
+int xf86NumScreens;
+unsigned long serverGeneration = 1;
+
+
+void bench_add_screen(ScrnInfoPtr pScrn, ScreenPtr pScreen)
+{
+    if (xf86NumScreens == BENCH_MAX_SCREENS)
+    {
+        FatalError("too many screens\n");
+    }
+
+    pScrn->scrnIndex = pScreen->myNum = xf86NumScreens;
+    pScrn->pScreen = pScreen;
+    benchScreens[xf86NumScreens++] = pScrn;
+}
+
+
+void bench_set_crtc_config(ScrnInfoPtr pScrn, xf86CrtcConfigPtr pConfig)
+{
+    benchCrtcConfigs[pScrn->scrnIndex] = pConfig;
+}
+
+
+ExaDriverPtr bench_exa_driver(ScreenPtr pScreen)
+{
+    return benchExaDrivers[pScreen->myNum];
+}
+
+
+unsigned long bench_fallbacks(void)
+{
+    return __atomic_load_n(&benchFallbacks, __ATOMIC_RELAXED);
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  os
+
+OsSigHandlerPtr OsSignal(int sig, OsSigHandlerPtr handler)
+{
+    return signal(sig, handler);
+}
+
+
+CARD32 GetTimeInMillis(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+void *XNFcallocarray(size_t nmemb, size_t size)
+{
+    void *p = calloc(nmemb, size);
+
+    if (p == NULL)
+    {
+        FatalError("out of memory\n");
+    }
+
+    return p;
+}
+
+
+Bool SetNotifyFd(int fd, NotifyFdProcPtr notify, int mask, void *data)
+{
+    int i;
+
+    for (i = 0; i < benchNumNotifyFds; i++)
+    {
+        if (benchNotifyFds[i].fd == fd)
+        {
+            break;
+        }
+    }
+
+    if (i == BENCH_MAX_FDS)
+    {
+        return FALSE;
+    }
+
+    if (i == benchNumNotifyFds)
+    {
+        benchNumNotifyFds++;
+    }
+
+    benchNotifyFds[i].fd = fd;
+    benchNotifyFds[i].mask = mask;
+    benchNotifyFds[i].notify = notify;
+    benchNotifyFds[i].data = data;
+
+    return TRUE;
+}
+
+
+void RemoveNotifyFd(int fd)
+{
+    int i;
+
+    for (i = 0; i < benchNumNotifyFds; i++)
+    {
+        if (benchNotifyFds[i].fd == fd)
+        {
+            benchNotifyFds[i] = benchNotifyFds[--benchNumNotifyFds];
+            return;
+        }
+    }
+}
+
+
+int bench_wait_for_something(int timeout)
+{
+    struct pollfd pfds[BENCH_MAX_FDS];
+    int n = benchNumNotifyFds;
+    int handled = 0;
+    int i, r;
+
+    for (i = 0; i < n; i++)
+    {
+        pfds[i].fd = benchNotifyFds[i].fd;
+        pfds[i].events = ((benchNotifyFds[i].mask & X_NOTIFY_READ) ? POLLIN : 0) |
+                         ((benchNotifyFds[i].mask & X_NOTIFY_WRITE) ? POLLOUT : 0);
+        pfds[i].revents = 0;
+    }
+
+    do
+    {
+        r = poll(pfds, n, timeout);
+    } while ((r == -1) && (errno == EINTR));
+
+    if (r <= 0)
+    {
+        return r;
+    }
+
+    // a handler may remove fds, walk our copy
+    for (i = 0; i < n; i++)
+    {
+        int ready = ((pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) ?
+                     X_NOTIFY_READ : 0) |
+                    ((pfds[i].revents & POLLOUT) ? X_NOTIFY_WRITE : 0);
+        int j;
+
+        if (ready == 0)
+        {
+            continue;
+        }
+
+        for (j = 0; j < benchNumNotifyFds; j++)
+        {
+            if (benchNotifyFds[j].fd == pfds[i].fd)
+            {
+                benchNotifyFds[j].notify(pfds[i].fd, ready,
+                                         benchNotifyFds[j].data);
+                handled++;
+                break;
+            }
+        }
+    }
+
+    return handled;
+}
+
+
+void FatalError(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    fputs("Fatal: ", stderr);
+    vfprintf(stderr, format, args);
+    va_end(args);
+
+    abort();
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  xf86 messages and options
+
+static const char * const benchMsgPrefix[] = {
+    [X_PROBED] = "(--)",
+    [X_CONFIG] = "(**)",
+    [X_DEFAULT] = "(==)",
+    [X_CMDLINE] = "(++)",
+    [X_NOTICE] = "(!!)",
+    [X_ERROR] = "(EE)",
+    [X_WARNING] = "(WW)",
+    [X_INFO] = "(II)",
+    [X_NONE] = "",
+    [X_NOT_IMPLEMENTED] = "(NI)",
+    [X_DEBUG] = "(DB)",
+};
+
+static void bench_vmsg(int scrnIndex, MessageType type,
+                       const char *format, va_list args)
+{
+    const char *prefix = "";
+
+    if ((type >= 0) && (type < (int) ARRAY_SIZE(benchMsgPrefix)) &&
+        benchMsgPrefix[type])
+    {
+        prefix = benchMsgPrefix[type];
+    }
+
+    // the messages go where the X server log would be, stdout is kept
+    // for the results
+    if (scrnIndex >= 0)
+    {
+        fprintf(stderr, "%s loongson(%d): ", prefix, scrnIndex);
+    }
+    else
+    {
+        fprintf(stderr, "%s ", prefix);
+    }
+
+    vfprintf(stderr, format, args);
+}
+
+
+void xf86DrvMsg(int scrnIndex, MessageType type, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    bench_vmsg(scrnIndex, type, format, args);
+    va_end(args);
+}
+
+
+void xf86Msg(MessageType type, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    bench_vmsg(-1, type, format, args);
+    va_end(args);
+}
+
+
+void *xf86LoadSubModule(ScrnInfoPtr pScrn, const char *name)
+{
+    // everything a submodule would bring is linked in
+    return (void *) name;
+}
+
+
+void xf86CollectOptions(ScrnInfoPtr pScrn, void *extraOpts)
+{
+}
+
+
+// option names compare like the server's xf86NameCmp(), ignoring case,
+// spaces and underscores
+static int bench_name_cmp(const char *s1, const char *s2)
+{
+    for (;;)
+    {
+        while ((*s1 == '_') || (*s1 == ' '))
+        {
+            s1++;
+        }
+        while ((*s2 == '_') || (*s2 == ' '))
+        {
+            s2++;
+        }
+
+        if ((*s1 == '\0') || (*s2 == '\0') ||
+            (tolower((unsigned char) *s1) != tolower((unsigned char) *s2)))
+        {
+            return tolower((unsigned char) *s1) - tolower((unsigned char) *s2);
+        }
+
+        s1++;
+        s2++;
+    }
+}
+
+
+static Bool bench_parse_bool(const char *str, Bool *value)
+{
+    static const char * const yes[] = { "1", "on", "true", "yes" };
+    static const char * const no[] = { "0", "off", "false", "no" };
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(yes); i++)
+    {
+        if (strcasecmp(str, yes[i]) == 0)
+        {
+            *value = TRUE;
+            return TRUE;
+        }
+
+        if (strcasecmp(str, no[i]) == 0)
+        {
+            *value = FALSE;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+//
+// @options is the NULL terminated list of "Name=value" strings the
+// benchmark put into pScrn->options, a bare "Name" switches a boolean
+// option on.
+//
+void xf86ProcessOptions(int scrnIndex, void *options, OptionInfoPtr optinfo)
+{
+    const char **ppOpt;
+
+    for (ppOpt = options; ppOpt && *ppOpt; ppOpt++)
+    {
+        const char *eq = strchr(*ppOpt, '=');
+        size_t len = eq ? (size_t) (eq - *ppOpt) : strlen(*ppOpt);
+        char name[64];
+        OptionInfoPtr p;
+
+        snprintf(name, sizeof(name), "%.*s", (int) len, *ppOpt);
+
+        for (p = optinfo; p->name; p++)
+        {
+            if (bench_name_cmp(p->name, name) == 0)
+            {
+                break;
+            }
+        }
+
+        if (p->name == NULL)
+        {
+            xf86DrvMsg(scrnIndex, X_WARNING,
+                       "Option \"%s\" is not used\n", name);
+            continue;
+        }
+
+        switch (p->type)
+        {
+            case OPTV_BOOLEAN:
+                p->found = eq ? bench_parse_bool(eq + 1, &p->value.bool) :
+                                (p->value.bool = TRUE);
+                break;
+            case OPTV_INTEGER:
+                if (eq && eq[1])
+                {
+                    char *end;
+
+                    p->value.num = strtol(eq + 1, &end, 0);
+                    p->found = (*end == '\0');
+                }
+                break;
+            default:
+                p->value.str = eq ? eq + 1 : "";
+                p->found = TRUE;
+                break;
+        }
+
+        if (!p->found)
+        {
+            xf86DrvMsg(scrnIndex, X_WARNING,
+                       "Option \"%s\" has a bad value\n", p->name);
+        }
+        else
+        {
+            xf86DrvMsg(scrnIndex, X_CONFIG, "Option \"%s\" \"%s\"\n",
+                       p->name, eq ? eq + 1 : "on");
+        }
+    }
+}
+
+
+static const OptionInfoRec * bench_find_option(const OptionInfoRec *table,
+                                               int token)
+{
+    for (; table->token >= 0; table++)
+    {
+        if (table->token == token)
+        {
+            return table->found ? table : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+
+const char *xf86GetOptValString(const OptionInfoRec *table, int token)
+{
+    const OptionInfoRec *p = bench_find_option(table, token);
+
+    return p ? p->value.str : NULL;
+}
+
+
+Bool xf86GetOptValInteger(const OptionInfoRec *table, int token, int *value)
+{
+    const OptionInfoRec *p = bench_find_option(table, token);
+
+    if (p)
+    {
+        *value = (int) p->value.num;
+    }
+
+    return p != NULL;
+}
+
+
+Bool xf86ReturnOptValBool(const OptionInfoRec *table, int token, Bool def)
+{
+    const OptionInfoRec *p = bench_find_option(table, token);
+
+    return p ? p->value.bool : def;
+}
+
+
+ScrnInfoPtr xf86ScreenToScrn(ScreenPtr pScreen)
+{
+    return benchScreens[pScreen->myNum];
+}
+
+
+xf86CrtcConfigPtr xf86BenchCrtcConfig(ScrnInfoPtr pScrn)
+{
+    return benchCrtcConfigs[pScrn->scrnIndex];
+}
+
+
+int xf86ModeWidth(const DisplayModeRec *mode, Rotation rotation)
+{
+    switch (rotation & 0xf)
+    {
+        case RR_Rotate_90:
+        case RR_Rotate_270:
+            return mode->VDisplay;
+        default:
+            return mode->HDisplay;
+    }
+}
+
+
+int xf86ModeHeight(const DisplayModeRec *mode, Rotation rotation)
+{
+    switch (rotation & 0xf)
+    {
+        case RR_Rotate_90:
+        case RR_Rotate_270:
+            return mode->HDisplay;
+        default:
+            return mode->VDisplay;
+    }
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  entities and privates, one instance per entity and no sharing
+
+void xf86SetEntitySharable(int entityIndex)
+{
+}
+
+
+int xf86AllocateEntityPrivateIndex(void)
+{
+    if (benchNumEntityPrivates == BENCH_MAX_ENTITY_PRIVATES)
+    {
+        FatalError("too many entity privates\n");
+    }
+
+    return benchNumEntityPrivates++;
+}
+
+
+DevUnion *xf86GetEntityPrivate(int entityIndex, int privIndex)
+{
+    if ((entityIndex < 0) || (entityIndex >= BENCH_MAX_ENTITIES) ||
+        (privIndex < 0) || (privIndex >= benchNumEntityPrivates))
+    {
+        return NULL;
+    }
+
+    return &benchEntityPrivates[entityIndex][privIndex];
+}
+
+
+void xf86SetEntityInstanceForScreen(ScrnInfoPtr pScrn, int entityIndex,
+                                    int instance)
+{
+}
+
+
+int xf86GetNumEntityInstances(int entityIndex)
+{
+    return 1;
+}
+
+
+// no key is ever registered, RandR and the other users of privates are
+// not set up
+DevPrivateKeyRec rrPrivKeyRec;
+
+
+Bool dixPrivateKeyRegistered(DevPrivateKey key)
+{
+    return key->initialized;
+}
+
+
+void *dixGetPrivateAddr(PrivateRec **privates, const DevPrivateKey key)
+{
+    return (char *) *privates + key->offset;
+}
+
+
+void *dixLookupPrivate(PrivateRec **privates, const DevPrivateKey key)
+{
+    return *(void **) dixGetPrivateAddr(privates, key);
+}
+
+
+void dixSetPrivate(PrivateRec **privates, const DevPrivateKey key, void *val)
+{
+    *(void **) dixGetPrivateAddr(privates, key) = val;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  GC and fb, the software fallbacks are counted but not drawn
+
+GCPtr GetScratchGC(unsigned depth, ScreenPtr pScreen)
+{
+    GCPtr pGC = calloc(1, sizeof(*pGC));
+
+    if (pGC)
+    {
+        pGC->pScreen = pScreen;
+        pGC->depth = depth;
+        pGC->alu = GXcopy;
+        pGC->planemask = ~0ul;
+    }
+
+    return pGC;
+}
+
+
+void FreeScratchGC(GCPtr pGC)
+{
+    free(pGC);
+}
+
+
+int ChangeGC(ClientPtr client, GCPtr pGC, unsigned long mask,
+             ChangeGCVal *pval)
+{
+    if (mask & GCFunction)
+    {
+        pGC->alu = (pval++)->val;
+    }
+
+    if (mask & GCPlaneMask)
+    {
+        pGC->planemask = (pval++)->val;
+    }
+
+    if (mask & GCForeground)
+    {
+        pGC->fgPixel = (pval++)->val;
+    }
+
+    return 0;
+}
+
+
+void ValidateGC(DrawablePtr pDraw, GCPtr pGC)
+{
+}
+
+
+void fbFill(DrawablePtr pDrawable, GCPtr pGC, int x, int y,
+            int width, int height)
+{
+    __atomic_add_fetch(&benchFallbacks, 1, __ATOMIC_RELAXED);
+}
+
+
+void *fbCopyArea(DrawablePtr pSrcDrawable, DrawablePtr pDstDrawable,
+                 GCPtr pGC, int xIn, int yIn, int widthSrc, int heightSrc,
+                 int xOut, int yOut)
+{
+    __atomic_add_fetch(&benchFallbacks, 1, __ATOMIC_RELAXED);
+
+    return NULL;
+}
+
+
+void fbComposite(CARD8 op, PicturePtr pSrc, PicturePtr pMask,
+                 PicturePtr pDst, INT16 xSrc, INT16 ySrc, INT16 xMask,
+                 INT16 yMask, INT16 xDst, INT16 yDst, CARD16 width,
+                 CARD16 height)
+{
+    __atomic_add_fetch(&benchFallbacks, 1, __ATOMIC_RELAXED);
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  exa
+
+ExaDriverPtr exaDriverAlloc(void)
+{
+    return calloc(1, sizeof(ExaDriverRec));
+}
+
+
+Bool exaDriverInit(ScreenPtr pScreen, ExaDriverPtr pScreenInfo)
+{
+    if ((pScreenInfo->exa_major != EXA_VERSION_MAJOR) ||
+        (pScreenInfo->CreatePixmap2 == NULL))
+    {
+        return FALSE;
+    }
+
+    benchExaDrivers[pScreen->myNum] = pScreenInfo;
+
+    return TRUE;
+}
+
+
+void exaDriverFini(ScreenPtr pScreen)
+{
+    // the driver frees the record itself
+    benchExaDrivers[pScreen->myNum] = NULL;
+}
+
+
+void *exaGetPixmapDriverPrivate(PixmapPtr p)
+{
+    return ((struct bench_pixmap *) p)->driverPriv;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  glyphs are not benchmarked, loongson_glyphs.c needs the whole render
+//  glyph cache behind it
+
+Bool LS_GlyphsInit(ScreenPtr pScreen)
+{
+    return TRUE;
+}
+
+
+void LS_GlyphsFini(ScreenPtr pScreen)
+{
+}
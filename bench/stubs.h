@@ -0,0 +1,58 @@
+/*
+ * Copyright © 2026 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef BENCH_STUBS_H_
+#define BENCH_STUBS_H_
+
+#include <xorg-server.h>
+
+//
+// What the stand-in X server in stubs.c offers the benchmarks on top of
+// the calls the driver makes into it.
+//
+
+// a pixmap the way EXA keeps one for a driver that handles pixmaps
+struct bench_pixmap {
+    PixmapRec pixmap;
+    void *driverPriv;
+};
+
+// the driver record LS_InitExaLayer() handed to exaDriverInit()
+ExaDriverPtr bench_exa_driver(ScreenPtr pScreen);
+
+// calls that left the driver for fb, the stubs only count them
+unsigned long bench_fallbacks(void);
+
+// add the screen to xf86Screens, its scrnIndex and myNum get set
+void bench_add_screen(ScrnInfoPtr pScrn, ScreenPtr pScreen);
+
+// the crtcs XF86_CRTC_CONFIG_PTR() finds for the screen, none by default
+void bench_set_crtc_config(ScrnInfoPtr pScrn, xf86CrtcConfigPtr pConfig);
+
+// one round of the server's main loop: wait up to @timeout ms, -1 for
+// ever, for the fds of SetNotifyFd() and call the handlers of those that
+// are ready. Returns the number of handlers called, -1 on error.
+int bench_wait_for_something(int timeout);
+
+#endif
@@ -0,0 +1,533 @@
+/*
+ * Copyright © 2026 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+//
+// Checks the dma-buf access windows of loongson_pixmap.c against the
+// fake DRM device, which records every DMA_BUF_IOCTL_SYNC it gets. Each
+// case drives the EXA hooks on a dumb pixmap and compares the syncs
+// made on its BO with the ones expected; on top of that every START
+// must be closed by one END, before the next START, and the END may
+// only drop directions the START asked for.
+//
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <linux/dma-buf.h>
+
+#include <xf86.h>
+#include <exa.h>
+
+#include "driver.h"
+#include "dumb_bo.h"
+#include "fake_exa.h"
+#include "loongson_options.h"
+#include "loongson_pixmap.h"
+#include "loongson_simd.h"
+
+#include "fake_drm.h"
+#include "stubs.h"
+
+#define SYNC_MAX_LOG        256
+#define SYNC_WIDTH          64
+#define SYNC_HEIGHT         64
+
+#define SYNC_START_READ     (DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ)
+#define SYNC_START_RW       (DMA_BUF_SYNC_START | DMA_BUF_SYNC_RW)
+#define SYNC_END_READ       (DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ)
+#define SYNC_END_RW         (DMA_BUF_SYNC_END | DMA_BUF_SYNC_RW)
+
+struct sync_ctx {
+    ScrnInfoRec scrn;
+    ScreenRec screen;
+    modesettingPtr ms;
+    ExaDriverPtr pExa;
+
+    // client memory the pixmaps are uploaded from and downloaded to
+    uint32_t sys[SYNC_WIDTH * SYNC_HEIGHT];
+
+    struct fake_drm_sync log[SYNC_MAX_LOG];
+    int failed;
+};
+
+
+/////////////////////////////////////////////////////////////////////////
+//  pixmaps, the way the EXA core sets them up
+
+static PixmapPtr sync_create_pixmap(struct sync_ctx *pCtx, int width,
+                                    int height, unsigned usage_hint)
+{
+    struct bench_pixmap *pBench = calloc(1, sizeof(*pBench));
+    PixmapPtr pPix;
+    int pitch = 0;
+
+    if (pBench == NULL)
+    {
+        return NULL;
+    }
+
+    pBench->driverPriv = pCtx->pExa->CreatePixmap2(&pCtx->screen,
+                                                   width, height, 24,
+                                                   usage_hint, 32, &pitch);
+    if (pBench->driverPriv == NULL)
+    {
+        free(pBench);
+        return NULL;
+    }
+
+    pPix = &pBench->pixmap;
+    pPix->drawable.type = DRAWABLE_PIXMAP;
+    pPix->drawable.depth = 24;
+    pPix->drawable.bitsPerPixel = 32;
+    pPix->drawable.width = width;
+    pPix->drawable.height = height;
+    pPix->drawable.pScreen = &pCtx->screen;
+    pPix->drawable.serialNumber = 1;
+    pPix->refcnt = 1;
+    pPix->devKind = pitch;
+    pPix->usage_hint = usage_hint;
+
+    return pPix;
+}
+
+
+static Bool sync_destroy_pixmap(PixmapPtr pPix)
+{
+    struct bench_pixmap *pBench = (struct bench_pixmap *) pPix;
+
+    if (pPix && (--pPix->refcnt == 0))
+    {
+        bench_exa_driver(pPix->drawable.pScreen)->DestroyPixmap(
+                pPix->drawable.pScreen, pBench->driverPriv);
+        free(pBench);
+    }
+
+    return TRUE;
+}
+
+
+static PixmapPtr sync_get_screen_pixmap(ScreenPtr pScreen)
+{
+    return pScreen->devPrivate;
+}
+
+
+static uint32_t sync_handle(PixmapPtr pPix)
+{
+    struct ms_exa_pixmap_priv *priv = exaGetPixmapDriverPrivate(pPix);
+
+    return priv->bo ? priv->bo->handle : 0;
+}
+
+
+static void sync_upload(struct sync_ctx *pCtx, PixmapPtr pPix)
+{
+    pCtx->pExa->UploadToScreen(pPix, 0, 0, SYNC_WIDTH, SYNC_HEIGHT,
+                               (char *) pCtx->sys, SYNC_WIDTH * 4);
+}
+
+
+static void sync_download(struct sync_ctx *pCtx, PixmapPtr pPix)
+{
+    pCtx->pExa->DownloadFromScreen(pPix, 0, 0, SYNC_WIDTH, SYNC_HEIGHT,
+                                   (char *) pCtx->sys, SYNC_WIDTH * 4);
+}
+
+
+// the queue drained, without closing the windows
+static void sync_idle(struct sync_ctx *pCtx)
+{
+    pCtx->pExa->WaitMarker(&pCtx->screen, pCtx->pExa->MarkSync(&pCtx->screen));
+}
+
+
+// the end of a frame, every window still open is closed
+static void sync_frame(struct sync_ctx *pCtx)
+{
+    sync_idle(pCtx);
+    LS_PixmapSyncFlush();
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  checking what the device got
+
+static const char *sync_name(uint64_t flags)
+{
+    switch (flags)
+    {
+        case SYNC_START_READ:
+            return "START|READ";
+        case SYNC_START_RW:
+            return "START|RW";
+        case SYNC_END_READ:
+            return "END|READ";
+        case SYNC_END_RW:
+            return "END|RW";
+        case DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE:
+            return "START|WRITE";
+        case DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE:
+            return "END|WRITE";
+        default:
+            return "?";
+    }
+}
+
+
+//
+// Every START on a BO is followed by exactly one END before the next
+// START, and the END leaves no direction open the START did not ask for.
+//
+static Bool sync_check_pairs(const struct fake_drm_sync *log, int n)
+{
+    int i, j;
+
+    for (i = 0; i < n; i++)
+    {
+        const struct fake_drm_sync *pPrev = NULL;
+
+        for (j = i - 1; j >= 0; j--)
+        {
+            if (log[j].handle == log[i].handle)
+            {
+                pPrev = &log[j];
+                break;
+            }
+        }
+
+        if (log[i].flags & DMA_BUF_SYNC_END)
+        {
+            if ((pPrev == NULL) || (pPrev->flags & DMA_BUF_SYNC_END) ||
+                (log[i].flags & ~pPrev->flags & DMA_BUF_SYNC_RW))
+            {
+                fprintf(stderr, "  sync %d: %s on BO %u without a"
+                        " matching START\n", i, sync_name(log[i].flags),
+                        log[i].handle);
+                return FALSE;
+            }
+        }
+        else if (pPrev && !(pPrev->flags & DMA_BUF_SYNC_END))
+        {
+            fprintf(stderr, "  sync %d: %s on BO %u, the window is"
+                    " still open\n", i, sync_name(log[i].flags),
+                    log[i].handle);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
+//
+// Compare the syncs made on BO @handle since recording started with
+// @expect, and that the whole log pairs up. Starts a new log.
+//
+static void sync_check(struct sync_ctx *pCtx, const char *name,
+                       uint32_t handle, const uint64_t *expect, int nExpect)
+{
+    int n = fake_drm_recorded_syncs();
+    Bool ok = (n < SYNC_MAX_LOG);
+    int i, k = 0;
+
+    for (i = 0; ok && (i < n); i++)
+    {
+        if (pCtx->log[i].handle != handle)
+        {
+            continue;
+        }
+
+        if ((k == nExpect) || (pCtx->log[i].flags != expect[k]))
+        {
+            fprintf(stderr, "  sync %d on BO %u: got %s, expected %s\n",
+                    i, handle, sync_name(pCtx->log[i].flags),
+                    (k < nExpect) ? sync_name(expect[k]) : "nothing");
+            ok = FALSE;
+        }
+
+        k++;
+    }
+
+    if (ok && (k != nExpect))
+    {
+        fprintf(stderr, "  BO %u: %d syncs, expected %d\n",
+                handle, k, nExpect);
+        ok = FALSE;
+    }
+
+    ok = ok && sync_check_pairs(pCtx->log, n);
+
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", name);
+
+    if (!ok)
+    {
+        pCtx->failed++;
+    }
+
+    fake_drm_record_syncs(pCtx->log, SYNC_MAX_LOG);
+}
+
+
+// the window of @pPix is closed as far as the driver is concerned too
+static void sync_check_closed(struct sync_ctx *pCtx, const char *name,
+                              PixmapPtr pPix)
+{
+    struct ms_exa_pixmap_priv *priv = exaGetPixmapDriverPrivate(pPix);
+
+    if (priv->sync_flags != 0)
+    {
+        printf("FAIL: %s: the driver still has a window open\n", name);
+        pCtx->failed++;
+    }
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//  the cases
+
+// a read window is widened to read/write for an upload: closed as a
+// read one, then opened again for both
+static void sync_test_upgrade(struct sync_ctx *pCtx)
+{
+    static const uint64_t expect[] = {
+        SYNC_START_READ, SYNC_END_READ, SYNC_START_RW, SYNC_END_RW,
+    };
+    PixmapPtr pPix = sync_create_pixmap(pCtx, SYNC_WIDTH, SYNC_HEIGHT,
+                                        CREATE_PIXMAP_USAGE_SHARED);
+
+    sync_download(pCtx, pPix);
+    sync_upload(pCtx, pPix);
+    sync_frame(pCtx);
+
+    sync_check(pCtx, "read window upgraded to read/write", sync_handle(pPix),
+               expect, ARRAY_SIZE(expect));
+
+    sync_destroy_pixmap(pPix);
+    fake_drm_record_syncs(pCtx->log, SYNC_MAX_LOG);
+}
+
+
+// a window opened for writing that nothing was written through only
+// flushes reads when it closes
+static void sync_test_write_free(struct sync_ctx *pCtx)
+{
+    static const uint64_t expect[] = { SYNC_START_RW, SYNC_END_READ };
+    PixmapPtr pPix = sync_create_pixmap(pCtx, SYNC_WIDTH, SYNC_HEIGHT,
+                                        CREATE_PIXMAP_USAGE_SHARED);
+
+    if (pCtx->pExa->PrepareSolid(pPix, GXcopy, ~0, 0))
+    {
+        pCtx->pExa->DoneSolid(pPix);
+    }
+
+    sync_frame(pCtx);
+
+    sync_check(pCtx, "write-free window ends as a read one",
+               sync_handle(pPix), expect, ARRAY_SIZE(expect));
+
+    sync_destroy_pixmap(pPix);
+    fake_drm_record_syncs(pCtx->log, SYNC_MAX_LOG);
+}
+
+
+// the BO goes to another process, the window closes first
+static void sync_test_export(struct sync_ctx *pCtx)
+{
+    static const uint64_t expect[] = { SYNC_START_READ, SYNC_END_READ };
+    PixmapPtr pPix = sync_create_pixmap(pCtx, SYNC_WIDTH, SYNC_HEIGHT,
+                                        CREATE_PIXMAP_USAGE_SHARED);
+    uint32_t handle = sync_handle(pPix);
+    CARD16 stride;
+    CARD32 size;
+
+    sync_download(pCtx, pPix);
+    ms_exa_bo_from_pixmap(&pCtx->screen, pPix);
+
+    sync_check(pCtx, "window closed before the BO is exported", handle,
+               expect, ARRAY_SIZE(expect));
+    sync_check_closed(pCtx, "BO export", pPix);
+
+    sync_destroy_pixmap(pPix);
+
+    pPix = sync_create_pixmap(pCtx, SYNC_WIDTH, SYNC_HEIGHT,
+                              CREATE_PIXMAP_USAGE_SHARED);
+    handle = sync_handle(pPix);
+    fake_drm_record_syncs(pCtx->log, SYNC_MAX_LOG);
+
+    sync_download(pCtx, pPix);
+    ms_exa_shareable_fd_from_pixmap(&pCtx->screen, pPix, &stride, &size);
+
+    sync_check(pCtx, "window closed before the fd is exported", handle,
+               expect, ARRAY_SIZE(expect));
+    sync_check_closed(pCtx, "fd export", pPix);
+
+    sync_destroy_pixmap(pPix);
+    fake_drm_record_syncs(pCtx->log, SYNC_MAX_LOG);
+}
+
+
+// moving to system memory reads the BO back and gives up its dma-buf
+static void sync_test_migrate(struct sync_ctx *pCtx)
+{
+    static const uint64_t expect[] = { SYNC_START_RW, SYNC_END_RW };
+    PixmapPtr pPix = sync_create_pixmap(pCtx, SYNC_WIDTH, SYNC_HEIGHT,
+                                        CREATE_PIXMAP_USAGE_BACKING_PIXMAP);
+    uint32_t handle = sync_handle(pPix);
+
+    sync_upload(pCtx, pPix);
+    sync_idle(pCtx);
+    LS_MigrateToSystem(pPix, exaGetPixmapDriverPrivate(pPix));
+
+    sync_check(pCtx, "window closed before migrating to system memory",
+               handle, expect, ARRAY_SIZE(expect));
+    sync_check_closed(pCtx, "migration", pPix);
+
+    sync_destroy_pixmap(pPix);
+    fake_drm_record_syncs(pCtx->log, SYNC_MAX_LOG);
+}
+
+
+static void sync_test_destroy(struct sync_ctx *pCtx)
+{
+    static const uint64_t expect[] = { SYNC_START_RW, SYNC_END_RW };
+    PixmapPtr pPix = sync_create_pixmap(pCtx, SYNC_WIDTH, SYNC_HEIGHT,
+                                        CREATE_PIXMAP_USAGE_SHARED);
+    uint32_t handle = sync_handle(pPix);
+
+    sync_upload(pCtx, pPix);
+    sync_idle(pCtx);
+    sync_destroy_pixmap(pPix);
+
+    sync_check(pCtx, "window closed before the pixmap is destroyed",
+               handle, expect, ARRAY_SIZE(expect));
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+
+static Bool sync_setup(struct sync_ctx *pCtx, const char **options)
+{
+    ScrnInfoPtr pScrn = &pCtx->scrn;
+    ScreenPtr pScreen = &pCtx->screen;
+    modesettingPtr ms;
+
+    ms = pCtx->ms = calloc(1, sizeof(*ms));
+    if (ms == NULL)
+    {
+        return FALSE;
+    }
+
+    pScrn->driverPrivate = ms;
+    pScrn->options = options;
+    pScrn->bitsPerPixel = 32;
+    pScrn->depth = 24;
+    pScrn->virtualX = pScrn->displayWidth = SYNC_WIDTH;
+    pScrn->virtualY = SYNC_HEIGHT;
+    pScrn->vtSema = TRUE;
+
+    pScreen->width = pScrn->virtualX;
+    pScreen->height = pScrn->virtualY;
+    pScreen->rootDepth = pScrn->depth;
+    pScreen->DestroyPixmap = sync_destroy_pixmap;
+    pScreen->GetScreenPixmap = sync_get_screen_pixmap;
+
+    bench_add_screen(pScrn, pScreen);
+
+    ms->fd = ms->drmmode.fd = fake_drm_open();
+    if (ms->fd < 0)
+    {
+        perror("fake_drm_open");
+        return FALSE;
+    }
+
+    LS_ProcessOptions(pScrn, &ms->drmmode.Options);
+    try_enable_exa(pScrn);
+    LS_SimdInit();
+
+    if (!ms->drmmode.exa_enabled || !LS_InitExaLayer(pScreen))
+    {
+        fprintf(stderr, "EXA did not come up\n");
+        return FALSE;
+    }
+
+    pCtx->pExa = bench_exa_driver(pScreen);
+
+    pScreen->devPrivate = sync_create_pixmap(pCtx, pScreen->width,
+                                             pScreen->height,
+                                             CREATE_PIXMAP_USAGE_SCANOUT);
+
+    return pScreen->devPrivate != NULL;
+}
+
+
+static void sync_teardown(struct sync_ctx *pCtx)
+{
+    fake_drm_record_syncs(NULL, 0);
+
+    LS_DestroyExaLayer(&pCtx->screen);
+
+    fake_drm_close(pCtx->ms->drmmode.fd);
+    free(pCtx->ms->drmmode.Options);
+    free(pCtx->ms);
+}
+
+
+int main(void)
+{
+    // no mirrors, the pixmaps are drawn in their BOs
+    static const char *options[] = {
+        "AccelMethod=exa",
+        "ExaType=software",
+        "ExaMirrorBudget=0",
+        NULL,
+    };
+    static struct sync_ctx ctx;
+
+#ifndef HAVE_LINUX_DMA_BUF_H
+    // the driver was built without DMA_BUF_IOCTL_SYNC, skip
+    return 77;
+#endif
+
+    if (!sync_setup(&ctx, options))
+    {
+        return 1;
+    }
+
+    fake_drm_record_syncs(ctx.log, SYNC_MAX_LOG);
+
+    sync_test_upgrade(&ctx);
+    sync_test_write_free(&ctx);
+    sync_test_export(&ctx);
+    sync_test_migrate(&ctx);
+    sync_test_destroy(&ctx);
+
+    sync_teardown(&ctx);
+
+    return ctx.failed ? 1 : 0;
+}
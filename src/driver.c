@@ -62,13 +62,21 @@
 #include "driver.h"
 
 #include "fake_exa.h"
+#include "loongson_pixmap.h"
 
 #include "loongson_options.h"
 #include "loongson_debug.h"
 #include "loongson_helpers.h"
 #include "loongson_cursor.h"
 #include "loongson_shadow.h"
+#include "loongson_shadow_thread.h"
+#include "loongson_rotate.h"
+#include "loongson_tearfree.h"
 #include "loongson_entity.h"
+#include "loongson_simd.h"
+#include "loongson_exa_queue.h"
+#include "loongson_exa_stats.h"
+#include "loongson_thread_pool.h"
 
 #include "loongson_glamor.h"
 
@@ -350,6 +358,212 @@ static PixmapDirtyUpdatePtr ms_dirty_get_ent(ScreenPtr pScreen, PixmapPtr slave_
 }
 
 
+//
+// Everything rendered so far has to be in memory before it is scanned
+// out or copied to other GPUs.
+//
+static void ms_finish_rendering(ScreenPtr pScreen)
+{
+    modesettingPtr ms = modesettingPTR(xf86ScreenToScrn(pScreen));
+
+    if (ms->drmmode.exa_enabled)
+    {
+        LS_ExaQueueDrain();
+        LS_PixmapSyncFlush();
+    }
+}
+
+
+//
+// Make what was drawn visible. The shadow copy goes on in the
+// background unless the kernel has to be told which parts of the front
+// buffer changed, that has to wait for the copy.
+//
+static void ms_flush(ScreenPtr pScreen)
+{
+    modesettingPtr ms = modesettingPTR(xf86ScreenToScrn(pScreen));
+
+    if (ms->drmmode.shadow_enable)
+    {
+        if (ms->dirty_enabled)
+        {
+            LS_ShadowFlushWait(xf86ScreenToScrn(pScreen));
+        }
+
+        LS_TearFreeFlush(xf86ScreenToScrn(pScreen));
+    }
+
+    if (pScreen->isGPU && !ms->drmmode.reverse_prime_offload_mode)
+    {
+        dispatch_slave_dirty(pScreen);
+    }
+    else if (ms->dirty_enabled)
+    {
+        dispatch_dirty(pScreen);
+    }
+}
+
+
+//
+// Flush pacing, Option "FlushPacing". Damage is held back and flushed
+// once per refresh, MS_FLUSH_MARGIN_NS before the predicted vblank of
+// the crtc showing most of the screen. Nothing flushed for a whole
+// frame means the screen was idle, then the flush happens right away so
+// a single keystroke is echoed without waiting for the deadline.
+//
+#define MS_FLUSH_MARGIN_NS      (2 * 1000 * 1000)
+
+static Bool ms_flush_pending(ScreenPtr pScreen)
+{
+    modesettingPtr ms = modesettingPTR(xf86ScreenToScrn(pScreen));
+
+    if (ms->drmmode.shadow_enable &&
+        RegionNotEmpty(&ms->shadow_flush.pending))
+    {
+        return TRUE;
+    }
+
+    // damage a TearFree flip in flight made wait
+    if (ms->drmmode.tearfree.enabled &&
+        RegionNotEmpty(&ms->drmmode.tearfree.front_stale))
+    {
+        return TRUE;
+    }
+
+    return ms->dirty_enabled && RegionNotEmpty(DamageRegion(ms->damage));
+}
+
+static void ms_flush_paced_now(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    struct ms_flush_pacing *pacing = &ms->flush_pacing;
+    uint64_t now, latency;
+
+    if (ms->drmmode.shadow_enable)
+    {
+        LS_ShadowFlushPending(pScrn);
+    }
+
+    ms_flush(pScreen);
+
+    now = ms_monotonic_ns();
+
+    if (pacing->pending_ns)
+    {
+        latency = now - pacing->pending_ns;
+        pacing->flush_ns += latency;
+        pacing->flush_max_ns = max(pacing->flush_max_ns, latency);
+
+        // a flush that overran its vblank is shown a frame later
+        if (pacing->vblank_ns && pacing->frame_ns)
+        {
+            uint64_t shown = pacing->vblank_ns;
+
+            while (shown < now)
+            {
+                shown += pacing->frame_ns;
+            }
+
+            latency = shown - pacing->pending_ns;
+            pacing->photon_ns += latency;
+            pacing->photon_max_ns = max(pacing->photon_max_ns, latency);
+            pacing->photons++;
+        }
+    }
+
+    pacing->pending_ns = 0;
+    pacing->vblank_ns = 0;
+    pacing->last_ns = now;
+}
+
+static CARD32 ms_flush_timer(OsTimerPtr timer, CARD32 time, void *arg)
+{
+    ScreenPtr pScreen = arg;
+    modesettingPtr ms = modesettingPTR(xf86ScreenToScrn(pScreen));
+
+    // timers run ahead of the block handler, after requests may have
+    // queued rendering whose damage is already reported
+    ms_finish_rendering(pScreen);
+
+    ms->flush_pacing.paced++;
+    ms_flush_paced_now(pScreen);
+
+    return 0;
+}
+
+static void ms_flush_paced(ScreenPtr pScreen)
+{
+    modesettingPtr ms = modesettingPTR(xf86ScreenToScrn(pScreen));
+    struct ms_flush_pacing *pacing = &ms->flush_pacing;
+    uint64_t now, vblank;
+    CARD32 delay;
+
+    if (!ms_flush_pending(pScreen))
+    {
+        return;
+    }
+
+    now = ms_monotonic_ns();
+
+    if (pacing->pending_ns == 0)
+    {
+        pacing->pending_ns = now;
+    }
+
+    // armed already, the damage rides along
+    if (pacing->vblank_ns)
+    {
+        return;
+    }
+
+    vblank = ms_next_vblank_ns(pScreen, MS_FLUSH_MARGIN_NS,
+                               &pacing->frame_ns);
+
+    if ((vblank == 0) || (now - pacing->last_ns >= pacing->frame_ns))
+    {
+        pacing->immediate++;
+        ms_flush_paced_now(pScreen);
+        return;
+    }
+
+    delay = (vblank - MS_FLUSH_MARGIN_NS - now) / 1000000;
+
+    pacing->vblank_ns = vblank;
+    pacing->timer = TimerSet(pacing->timer, 0, max(delay, 1),
+                             ms_flush_timer, pScreen);
+}
+
+static void ms_flush_pacing_fini(ScrnInfoPtr pScrn)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+    struct ms_flush_pacing *pacing = &ms->flush_pacing;
+    unsigned long flushes = pacing->paced + pacing->immediate;
+
+    TimerFree(pacing->timer);
+
+    if (flushes)
+    {
+        xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                   "flush pacing: %lu paced, %lu immediate flushes, "
+                   "damage to flush %.2f ms avg %.2f ms max\n",
+                   pacing->paced, pacing->immediate,
+                   pacing->flush_ns / 1e6 / flushes,
+                   pacing->flush_max_ns / 1e6);
+    }
+
+    if (pacing->photons)
+    {
+        xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                   "flush pacing: damage to vblank %.2f ms avg %.2f ms max\n",
+                   pacing->photon_ns / 1e6 / pacing->photons,
+                   pacing->photon_max_ns / 1e6);
+    }
+
+    memset(pacing, 0, sizeof(*pacing));
+}
+
+
 static void msBlockHandler(ScreenPtr pScreen, void *timeout)
 {
     modesettingPtr ms = modesettingPTR(xf86ScreenToScrn(pScreen));
@@ -359,13 +573,26 @@ static void msBlockHandler(ScreenPtr pScreen, void *timeout)
     ms->BlockHandler = pScreen->BlockHandler;
     pScreen->BlockHandler = msBlockHandler;
 
-    if (pScreen->isGPU && !ms->drmmode.reverse_prime_offload_mode)
+    ms_finish_rendering(pScreen);
+
+    if (ms->drmmode.exa_enabled)
     {
-        dispatch_slave_dirty(pScreen);
+        LS_TrimBufPool(FALSE);
+        LS_ExaStatsPoll(xf86ScreenToScrn(pScreen));
+
+        if (ms->bo_cache)
+        {
+            dumb_bo_cache_expire(ms->bo_cache);
+        }
     }
-    else if (ms->dirty_enabled)
+
+    if (ms->flush_pacing.enabled)
     {
-        dispatch_dirty(pScreen);
+        ms_flush_paced(pScreen);
+    }
+    else
+    {
+        ms_flush(pScreen);
     }
 
     ms_dirty_update(pScreen, timeout);
@@ -1075,6 +1302,12 @@ static Bool CreateScreenResources(ScreenPtr pScreen)
         {
             return FALSE;
         }
+
+        // TearFree copies synchronously at flip time
+        if (!LS_TearFreeInit(pScrn))
+        {
+            LS_ShadowThreadInit(pScreen);
+        }
     }
 
     err = drmModeDirtyFB(ms->fd, ms->drmmode.fb_id, NULL, 0);
@@ -1354,6 +1587,8 @@ static Bool ScreenInit(ScreenPtr pScreen, int argc, char **argv)
         return FALSE;
     }
 
+    LS_SimdInit();
+
 #ifdef GLAMOR_HAS_GBM
     if (ms->drmmode.glamor)
     {
@@ -1453,6 +1688,19 @@ static Bool ScreenInit(ScreenPtr pScreen, int argc, char **argv)
 
             return FALSE;
         }
+
+        // the shadow flush runs on the same workers as EXA
+        LS_ThreadPoolInit(pScrn);
+        LS_ShadowFlushInit(pScrn);
+    }
+
+    if (!pScreen->isGPU &&
+        xf86ReturnOptValBool(ms->drmmode.Options, OPTION_FLUSH_PACING, FALSE))
+    {
+        ms->flush_pacing.enabled = TRUE;
+
+        xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+                   "Flushing damage once per refresh.\n");
     }
 
     /*
@@ -1515,6 +1763,9 @@ static Bool ScreenInit(ScreenPtr pScreen, int argc, char **argv)
         }
     }
 
+    // outside of EXA, so rotated crtc updates never reach its fallbacks
+    LS_RotateInit(pScreen);
+
 
     if ((serverGeneration == 1) && bgNoneRoot && ms->drmmode.glamor)
     {
@@ -1769,16 +2020,26 @@ static Bool CloseScreen(ScreenPtr pScreen)
     }
 
 
+    LS_RotateFini(pScreen);
+
     if (ms->drmmode.exa_enabled)
     {
         LS_DestroyExaLayer(pScreen);
     }
 
 
+    ms_flush_pacing_fini(pScrn);
+
     if (ms->drmmode.shadow_enable)
     {
+        LS_ShadowThreadFini(pScreen);
+
         ms->shadow.Remove(pScreen, pScreen->GetScreenPixmap(pScreen));
 
+        LS_ShadowFlushFini(pScrn);
+        LS_ThreadPoolFini(pScrn);
+        LS_TearFreeFini(pScrn);
+
         LS_ShadowFreeFB(pScrn);
 
         LS_ShadowFreeDoubleFB(pScrn);
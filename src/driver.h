@@ -65,6 +65,69 @@ struct ms_drm_queue {
     ScrnInfoPtr scrn;
     ms_drm_handler_proc handler;
     ms_drm_abort_proc abort;
+    /* when the entry was queued, and the kernel msc it waits for (0 when
+     * unknown, as for page flips) */
+    uint64_t queued_ns;
+    uint64_t target_msc;
+};
+
+/* Timing of the vblank/flip events of a screen, logged at CloseScreen */
+struct ms_kms_stats {
+    unsigned long ioctls;
+    unsigned long events;
+    unsigned long missed;
+    uint64_t missed_frames;
+    /* queue to kernel timestamp, and kernel timestamp to handler */
+    uint64_t queue_ns;
+    uint64_t queue_max_ns;
+    uint64_t dispatch_ns;
+    uint64_t dispatch_max_ns;
+};
+
+/* A shadow to front buffer copy running on the thread pool: the damaged
+ * boxes, in front buffer rows, and where to copy them from and to */
+struct ms_shadow_flush {
+    const BoxRec *rects;
+    BoxPtr boxes;
+    int nboxes;
+    int size;
+    int y1;
+    const uint8_t *src;
+    int src_stride;
+    int src_cpp;
+    uint8_t *dst;
+    int dst_stride;
+    int dst_cpp;
+    /* reports rendering to the screen pixmap to the copy thread */
+    DamagePtr band_damage;
+    /* damage held back by flush pacing */
+    RegionRec pending;
+    shadowBufPtr pBuf;
+    unsigned long flushes;
+    uint64_t bytes;
+    uint64_t first_ns;
+    uint64_t last_ns;
+};
+
+/* Option "FlushPacing": damage is held back and flushed once per refresh,
+ * shortly before the next vblank, unless nothing was flushed for a frame */
+struct ms_flush_pacing {
+    Bool enabled;
+    OsTimerPtr timer;
+    uint64_t frame_ns;
+    uint64_t last_ns;
+    /* oldest damage not flushed yet, 0 when there is none */
+    uint64_t pending_ns;
+    /* the vblank the armed timer aims for, 0 when not armed */
+    uint64_t vblank_ns;
+    unsigned long paced;
+    unsigned long immediate;
+    /* damage to flush, and damage to the vblank showing it */
+    uint64_t flush_ns;
+    uint64_t flush_max_ns;
+    uint64_t photon_ns;
+    uint64_t photon_max_ns;
+    unsigned long photons;
 };
 
 typedef struct _modesettingRec {
@@ -103,11 +166,18 @@ typedef struct _modesettingRec {
     Bool has_queue_sequence;
     Bool tried_queue_sequence;
 
+    struct ms_kms_stats kms_stats;
+
     Bool kms_has_modifiers;
 
 
     /* EXA API */
     ExaDriverPtr exaDrvPtr;
+    GlyphsProcPtr Glyphs;
+    CompositeProcPtr Composite;
+    struct dumb_bo_cache *bo_cache;
+    Bool lazy_pixmaps;
+    size_t mirror_budget;
 
     /* shadow API */
     struct ShadowAPI {
@@ -117,6 +187,8 @@ typedef struct _modesettingRec {
         void (*Update32to24)(ScreenPtr, shadowBufPtr);
         void (*UpdatePacked)(ScreenPtr, shadowBufPtr);
     } shadow;
+    struct ms_shadow_flush shadow_flush;
+    struct ms_flush_pacing flush_pacing;
 
 #ifdef GLAMOR_HAS_GBM
     /* glamor API */
@@ -177,6 +249,10 @@ RRCrtcPtr   ms_randr_crtc_covering_drawable(DrawablePtr pDraw);
 
 int ms_get_crtc_ust_msc(xf86CrtcPtr crtc, CARD64 *ust, CARD64 *msc);
 
+uint64_t ms_monotonic_ns(void);
+uint64_t ms_next_vblank_ns(ScreenPtr screen, uint64_t margin_ns,
+                           uint64_t *frame_ns);
+
 uint64_t ms_kernel_msc_to_crtc_msc(xf86CrtcPtr crtc, uint64_t sequence, Bool is64bit);
 
 
@@ -57,6 +57,8 @@
 
 #include "loongson_options.h"
 #include "loongson_entity.h"
+#include "loongson_shadow.h"
+#include "loongson_tearfree.h"
 
 
 static Bool drmmode_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height);
@@ -879,6 +881,8 @@ drmmode_crtc_flip(xf86CrtcPtr crtc, uint32_t fb_id, uint32_t flags, void *data)
     drmmode_crtc_private_ptr drmmode_crtc = crtc->driver_private;
     int ret;
 
+    ms->kms_stats.ioctls++;
+
     if (ms->atomic_modeset) {
         drmModeAtomicReq *req = drmModeAtomicAlloc();
 
@@ -3203,6 +3207,14 @@ drmmode_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
     if (scrn->virtualX == width && scrn->virtualY == height)
         return TRUE;
 
+    /* the shadow flush may still be reading the old buffers */
+    if (drmmode->shadow_enable)
+        LS_ShadowFlushWait(scrn);
+
+    /* waits for the flips in flight, which may swap front_bo */
+    if (drmmode->tearfree.enabled)
+        LS_TearFreeFreeBack(scrn);
+
     xf86DrvMsg(scrn->scrnIndex, X_INFO,
                "Allocate new frame buffer %dx%d stride\n", width, height);
 
@@ -3239,12 +3251,13 @@ drmmode_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
     }
 
     if (drmmode->shadow_enable2) {
-        uint32_t size = scrn->displayWidth * scrn->virtualY * cpp;
-        void *fb2 = calloc(1, size);
-        free(drmmode->shadow_fb2);
-        drmmode->shadow_fb2 = fb2;
+        LS_ShadowFreeDoubleFB(scrn);
+        LS_ShadowAllocDoubleFB(scrn);
     }
 
+    if (drmmode->tearfree.enabled && !LS_TearFreeAllocBack(scrn))
+        LS_TearFreeFini(scrn);
+
     screen->ModifyPixmapHeader(ppix, width, height, -1, -1,
                                scrn->displayWidth * cpp, new_pixels);
 
@@ -3278,6 +3291,10 @@ drmmode_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
     scrn->displayWidth = old_pitch / kcpp;
     drmmode->fb_id = old_fb_id;
 
+    if (drmmode->tearfree.enabled && !drmmode->tearfree.back_bo.dumb &&
+        !LS_TearFreeAllocBack(scrn))
+        LS_TearFreeFini(scrn);
+
     return FALSE;
 }
 
@@ -82,6 +82,24 @@ typedef struct {
 #endif
 } drmmode_bo;
 
+/* TearFree: the shadow goes to whichever of front_bo and back_bo is not
+ * being scanned out, which is then flipped to. The two are swapped when
+ * the flip completes, see loongson_tearfree.c */
+typedef struct {
+    Bool enabled;
+    drmmode_bo back_bo;
+    uint32_t back_fb_id;
+    /* damage each buffer has not received yet */
+    RegionRec front_stale;
+    RegionRec back_stale;
+    /* crtcs whose flip to back_bo hasn't completed */
+    int flips_pending;
+    /* some crtc couldn't flip, set every crtc again once the rest did */
+    Bool resync;
+    unsigned long flips;
+    unsigned long direct;
+} drmmode_tearfree_rec;
+
 typedef struct {
     int fd;
     unsigned fb_id;
@@ -108,6 +126,7 @@ typedef struct {
     enum ExaAccelType exa_acc_type;
     Bool shadow_enable;
     Bool shadow_enable2;
+    Bool shadow_hash_enable;
 
 
     /** Is Option "PageFlip" enabled? */
@@ -115,6 +134,10 @@ typedef struct {
     Bool force_24_32;
     void *shadow_fb;
     void *shadow_fb2;
+    /* per tile digests standing in for shadow_fb2, Option "ShadowHash" */
+    uint64_t *shadow_hash;
+    int shadow_hash_pitch;
+    drmmode_tearfree_rec tearfree;
     /* SCREEN SPECIFIC_PRIVATE_KEYS */
     DevPrivateKeyRec pixmapPrivateKeyRec;
     DevScreenPrivateKeyRec spritePrivateKeyRec;
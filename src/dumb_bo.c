@@ -36,6 +36,7 @@
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <time.h>
 #include <unistd.h>
 #include <xf86drm.h>
 
@@ -66,6 +67,7 @@ struct dumb_bo * dumb_bo_create(int fd,
     bo->handle = arg.handle;
     bo->size = arg.size;
     bo->pitch = arg.pitch;
+    bo->bpp = bpp;
 
     return bo;
  err_free:
@@ -150,3 +152,261 @@ struct dumb_bo * dumb_get_bo_from_fd(int fd, int handle, int pitch, int size)
 
     return bo;
 }
+
+/*
+ * BO cache: four buckets per power of two from 4 KiB to 64 MiB, each
+ * bucket keeps its free BOs oldest first. A BO sits in the bucket of its
+ * real size, an allocation looks in the bucket of the size it needs and
+ * the one above, as the kernel pads the pitch.
+ */
+#define DUMB_BO_CACHE_MIN_SHIFT  12
+#define DUMB_BO_CACHE_MAX_SHIFT  26
+#define DUMB_BO_CACHE_STEPS      4
+#define DUMB_BO_CACHE_BUCKETS    \
+    ((DUMB_BO_CACHE_MAX_SHIFT - DUMB_BO_CACHE_MIN_SHIFT) * DUMB_BO_CACHE_STEPS)
+
+/* free BOs nobody asked for within this time are destroyed */
+#define DUMB_BO_CACHE_EXPIRE_MS  2000
+
+/* upper bound of memory kept in free BOs */
+#define DUMB_BO_CACHE_MAX_BYTES  (64ULL << 20)
+
+struct dumb_bo_bucket {
+    struct dumb_bo *head;
+    struct dumb_bo *tail;
+};
+
+struct dumb_bo_cache {
+    int fd;
+    struct dumb_bo_bucket buckets[DUMB_BO_CACHE_BUCKETS];
+    struct dumb_bo_cache_stats stats;
+};
+
+static uint64_t dumb_bo_cache_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int dumb_bo_cache_bucket(uint64_t size)
+{
+    uint64_t p;
+    int shift;
+
+    if (size < (1ULL << DUMB_BO_CACHE_MIN_SHIFT))
+    {
+        return 0;
+    }
+
+    shift = 63 - __builtin_clzll(size);
+    if (shift >= DUMB_BO_CACHE_MAX_SHIFT)
+    {
+        return -1;
+    }
+
+    p = 1ULL << shift;
+
+    return (shift - DUMB_BO_CACHE_MIN_SHIFT) * DUMB_BO_CACHE_STEPS +
+           (int) ((size - p) / (p / DUMB_BO_CACHE_STEPS));
+}
+
+static void dumb_bo_cache_unlink(struct dumb_bo_cache *cache,
+                                 struct dumb_bo_bucket *bucket,
+                                 struct dumb_bo *bo)
+{
+    if (bo->cache_prev)
+        bo->cache_prev->cache_next = bo->cache_next;
+    else
+        bucket->head = bo->cache_next;
+
+    if (bo->cache_next)
+        bo->cache_next->cache_prev = bo->cache_prev;
+    else
+        bucket->tail = bo->cache_prev;
+
+    bo->cache_prev = NULL;
+    bo->cache_next = NULL;
+
+    cache->stats.bytes_cached -= bo->size;
+}
+
+static void dumb_bo_cache_evict(struct dumb_bo_cache *cache,
+                                struct dumb_bo_bucket *bucket,
+                                struct dumb_bo *bo)
+{
+    dumb_bo_cache_unlink(cache, bucket, bo);
+    cache->stats.evictions++;
+
+    dumb_bo_destroy(cache->fd, bo);
+}
+
+struct dumb_bo_cache * dumb_bo_cache_create(int fd)
+{
+    struct dumb_bo_cache *cache;
+
+    cache = calloc(1, sizeof(*cache));
+    if (cache == NULL)
+    {
+        return NULL;
+    }
+
+    cache->fd = fd;
+
+    return cache;
+}
+
+void dumb_bo_cache_destroy(struct dumb_bo_cache *cache)
+{
+    int i;
+
+    if (cache == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < DUMB_BO_CACHE_BUCKETS; i++)
+    {
+        struct dumb_bo_bucket *bucket = &cache->buckets[i];
+
+        while (bucket->head)
+        {
+            dumb_bo_cache_evict(cache, bucket, bucket->head);
+        }
+    }
+
+    free(cache);
+}
+
+struct dumb_bo * dumb_bo_cache_alloc(struct dumb_bo_cache *cache,
+               const unsigned width, const unsigned height, const unsigned bpp)
+{
+    uint32_t min_pitch = (width * bpp + 7) / 8;
+    struct dumb_bo *bo;
+    int first;
+    int i;
+
+    first = dumb_bo_cache_bucket((uint64_t) min_pitch * height);
+
+    for (i = first; (first >= 0) && (i <= first + 1) &&
+                    (i < DUMB_BO_CACHE_BUCKETS); i++)
+    {
+        struct dumb_bo_bucket *bucket = &cache->buckets[i];
+
+        /* most recently freed first, its pages are most likely resident */
+        for (bo = bucket->tail; bo; bo = bo->cache_prev)
+        {
+            if ((bo->bpp == bpp) && (bo->pitch >= min_pitch) &&
+                ((uint64_t) bo->pitch * height <= bo->size))
+            {
+                dumb_bo_cache_unlink(cache, bucket, bo);
+                cache->stats.hits++;
+                return bo;
+            }
+        }
+    }
+
+    cache->stats.misses++;
+
+    bo = dumb_bo_create(cache->fd, width, height, bpp);
+    if (bo)
+    {
+        bo->reusable = 1;
+    }
+
+    return bo;
+}
+
+void dumb_bo_cache_release(struct dumb_bo_cache *cache, struct dumb_bo *bo)
+{
+    struct dumb_bo_bucket *bucket;
+    int idx;
+
+    if (!bo->reusable)
+    {
+        dumb_bo_destroy(cache->fd, bo);
+        return;
+    }
+
+    idx = dumb_bo_cache_bucket(bo->size);
+    if ((idx < 0) || (bo->size > DUMB_BO_CACHE_MAX_BYTES))
+    {
+        dumb_bo_destroy(cache->fd, bo);
+        return;
+    }
+
+    bucket = &cache->buckets[idx];
+
+    bo->free_time = dumb_bo_cache_now();
+    bo->cache_next = NULL;
+    bo->cache_prev = bucket->tail;
+    if (bucket->tail)
+        bucket->tail->cache_next = bo;
+    else
+        bucket->head = bo;
+    bucket->tail = bo;
+
+    cache->stats.bytes_cached += bo->size;
+
+    dumb_bo_cache_expire(cache);
+
+    /* over budget, drop the oldest BOs whatever their size */
+    while (cache->stats.bytes_cached > DUMB_BO_CACHE_MAX_BYTES)
+    {
+        struct dumb_bo_bucket *oldest = NULL;
+        int i;
+
+        for (i = 0; i < DUMB_BO_CACHE_BUCKETS; i++)
+        {
+            struct dumb_bo_bucket *b = &cache->buckets[i];
+
+            if (b->head && (!oldest ||
+                            (b->head->free_time < oldest->head->free_time)))
+            {
+                oldest = b;
+            }
+        }
+
+        dumb_bo_cache_evict(cache, oldest, oldest->head);
+    }
+}
+
+void dumb_bo_cache_disown(struct dumb_bo *bo)
+{
+    if (bo)
+    {
+        bo->reusable = 0;
+    }
+}
+
+void dumb_bo_cache_expire(struct dumb_bo_cache *cache)
+{
+    uint64_t now;
+    int i;
+
+    if (cache->stats.bytes_cached == 0)
+    {
+        return;
+    }
+
+    now = dumb_bo_cache_now();
+
+    for (i = 0; i < DUMB_BO_CACHE_BUCKETS; i++)
+    {
+        struct dumb_bo_bucket *bucket = &cache->buckets[i];
+
+        while (bucket->head &&
+               (now - bucket->head->free_time > DUMB_BO_CACHE_EXPIRE_MS))
+        {
+            dumb_bo_cache_evict(cache, bucket, bucket->head);
+        }
+    }
+}
+
+void dumb_bo_cache_get_stats(struct dumb_bo_cache *cache,
+                             struct dumb_bo_cache_stats *stats)
+{
+    *stats = cache->stats;
+}
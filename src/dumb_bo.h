@@ -34,12 +34,46 @@ struct dumb_bo {
     uint32_t size;
     void *ptr;
     uint32_t pitch;
+
+    /* bookkeeping of struct dumb_bo_cache */
+    uint32_t bpp;
+    int reusable;
+    uint64_t free_time;
+    struct dumb_bo *cache_prev;
+    struct dumb_bo *cache_next;
+};
+
+struct dumb_bo_cache_stats {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    uint64_t bytes_cached;
 };
 
+struct dumb_bo_cache;
+
 struct dumb_bo *dumb_bo_create(int fd, const unsigned width,
                                const unsigned height, const unsigned bpp);
 int dumb_bo_map(int fd, struct dumb_bo *bo);
 int dumb_bo_destroy(int fd, struct dumb_bo *bo);
 struct dumb_bo *dumb_get_bo_from_fd(int fd, int handle, int pitch, int size);
 
+/*
+ * Freed BOs, together with their CPU mapping, are kept by size bucket
+ * and handed out again to allocations they can hold. Only BOs that came
+ * from dumb_bo_cache_alloc() and never left the server are recycled,
+ * call dumb_bo_cache_disown() before sharing one with anybody else.
+ */
+struct dumb_bo_cache *dumb_bo_cache_create(int fd);
+void dumb_bo_cache_destroy(struct dumb_bo_cache *cache);
+struct dumb_bo *dumb_bo_cache_alloc(struct dumb_bo_cache *cache,
+                                    const unsigned width,
+                                    const unsigned height,
+                                    const unsigned bpp);
+void dumb_bo_cache_release(struct dumb_bo_cache *cache, struct dumb_bo *bo);
+void dumb_bo_cache_disown(struct dumb_bo *bo);
+void dumb_bo_cache_expire(struct dumb_bo_cache *cache);
+void dumb_bo_cache_get_stats(struct dumb_bo_cache *cache,
+                             struct dumb_bo_cache_stats *stats);
+
 #endif
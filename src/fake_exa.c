@@ -31,6 +31,8 @@
 #include <exa.h>
 #include <xf86.h>
 #include <fbpict.h>
+#include <stddef.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
 
@@ -41,19 +43,83 @@
 
 #include "loongson_options.h"
 #include "loongson_pixmap.h"
+#include "loongson_simd.h"
+#include "loongson_composite.h"
+#include "loongson_thread_pool.h"
+#include "loongson_exa_queue.h"
+#include "loongson_exa_stats.h"
+#include "loongson_benchmark.h"
+#include "loongson_glyphs.h"
+
+
+//
+// Solid and Copy rectangles are queued between Prepare and Done and run
+// in one pass, so mapping the pixmaps and setting up the GC is paid once
+// per batch instead of once per rectangle.
+//
+// Batches taking the native paths are turned into self contained jobs
+// (raw pointers, no pixmaps) and handed to the EXA queue, which runs
+// them on its own thread when ExaAsync is on.
+//
+#define MS_EXA_BATCH_SIZE    256
+
+struct ms_exa_solid_job {
+    uint8_t *bits;
+    int stride;
+    int bpp;
+    Pixel fg;
+    int nBox;
+    BoxRec boxes[MS_EXA_BATCH_SIZE];
+};
+
+struct ms_exa_copy_rect {
+    int srcX;
+    int srcY;
+    int dstX;
+    int dstY;
+    int width;
+    int height;
+};
+
+struct ms_exa_copy_job {
+    const uint8_t *src_bits;
+    int src_stride;
+    uint8_t *dst_bits;
+    int dst_stride;
+    int bpp;
+    int xdir;
+    int ydir;
+    Bool same_pixmap;
+    int nRect;
+    struct ms_exa_copy_rect rects[MS_EXA_BATCH_SIZE];
+};
 
+struct ms_exa_composite_job {
+    int nRect;
+    struct LoongsonCompositeArgs rects[MS_EXA_BATCH_SIZE];
+};
 
 struct ms_exa_prepare_args {
     struct {
+        PixmapPtr pPixmap;
         int alu;
         Pixel planemask;
         Pixel fg;
+        Bool native;
+        GCPtr pGC;
+        struct ms_exa_solid_job job;
     } solid;
 
     struct {
         PixmapPtr pSrcPixmap;
+        PixmapPtr pDstPixmap;
         int alu;
         Pixel planemask;
+        Bool native;
+        // the source is a solid pixmap, run as a fill of the destination
+        Bool fill;
+        GCPtr pGC;
+        struct ms_exa_copy_job job;
     } copy;
 
     struct {
@@ -64,6 +130,11 @@ struct ms_exa_prepare_args {
         PixmapPtr pSrc;
         PixmapPtr pMask;
         PixmapPtr pDst;
+        struct LoongsonCompositePath *pPath;
+        Bool fill;
+        struct ms_exa_composite_job job;
+        // destination rectangles of the job, for mirror writeback
+        BoxRec boxes[MS_EXA_BATCH_SIZE];
 
         int rotate;
         Bool reflect_y;
@@ -72,24 +143,32 @@ struct ms_exa_prepare_args {
 
 static struct ms_exa_prepare_args exa_prepare_args = {{0}};
 
+static Bool ms_exa_map_pixmap(PixmapPtr pPix);
+static Bool ms_exa_access_pixmap(PixmapPtr pPix);
+static void ms_exa_pixmap_damage(PixmapPtr pPixmap,
+                                 const BoxRec *pBox, int nBox);
+
 
 /////////////////////////////////////////////////////////////////////////
 
 static Bool PrepareSolidFail(PixmapPtr pPixmap, int alu, Pixel planemask,
         Pixel fill_colour)
 {
+    LS_ExaStatsFallback(LS_EXA_STAT_SOLID);
     return FALSE;
 }
 
 static Bool PrepareCopyFail(PixmapPtr pSrc, PixmapPtr pDst, int xdir, int ydir,
         int alu, Pixel planemask)
 {
+    LS_ExaStatsFallback(LS_EXA_STAT_COPY);
     return FALSE;
 }
 
 static Bool CheckCompositeFail(int op, PicturePtr pSrcPicture, PicturePtr pMaskPicture,
         PicturePtr pDstPicture)
 {
+    LS_ExaStatsFallback(LS_EXA_STAT_COMPOSITE);
     return FALSE;
 }
 
@@ -102,45 +181,332 @@ static Bool PrepareCompositeFail(int op, PicturePtr pSrcPicture, PicturePtr pMas
 /////////////////////////////////////////////////////////////////////////
 
 
+//
+// Remember the last queued job that reads or writes the pixels of
+// @pPixmap, CPU access to it has to wait for that job to retire.
+//
+static void ms_exa_pixmap_mark(PixmapPtr pPixmap, uint64_t seq)
+{
+    struct ms_exa_pixmap_priv *priv = exaGetPixmapDriverPrivate(pPixmap);
+
+    if (priv && seq)
+    {
+        priv->seq = seq;
+    }
+}
+
+static void ms_exa_pixmap_wait(PixmapPtr pPixmap)
+{
+    struct ms_exa_pixmap_priv *priv = exaGetPixmapDriverPrivate(pPixmap);
+
+    if (priv)
+    {
+        LS_ExaQueueWait(priv->seq);
+    }
+}
+
+
+//
+// A pixmap in system memory whose last write covered all of it with one
+// colour is kept as that colour, its memory is only written once the
+// pixels are really needed. Copies and composites reading it turn into
+// fills of the destination.
+//
+static Bool ms_exa_pixmap_can_be_solid(PixmapPtr pPixmap)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pPixmap->drawable.pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    struct ms_exa_pixmap_priv *priv = exaGetPixmapDriverPrivate(pPixmap);
+
+    return ms->lazy_pixmaps && priv && !priv->is_dumb;
+}
+
+Bool ms_exa_pixmap_is_solid(PixmapPtr pPixmap, Pixel *pFg)
+{
+    struct ms_exa_pixmap_priv *priv = exaGetPixmapDriverPrivate(pPixmap);
+
+    if ((priv == NULL) || !priv->solid)
+    {
+        return FALSE;
+    }
+
+    *pFg = priv->solid_fg;
+
+    return TRUE;
+}
+
+
+//
+// Count how the CPU uses @pPixmap, and move it to system memory once it
+// turns out to be read far more than a write-combined BO can stand.
+// Only called where nothing of the pixmap is mapped or batched yet.
+// Also opens the dma-buf access window of a BO the CPU will touch.
+//
+static void ms_exa_pixmap_access(PixmapPtr pPixmap, Bool write)
+{
+    struct ms_exa_pixmap_priv *priv = exaGetPixmapDriverPrivate(pPixmap);
+
+    if (priv == NULL)
+    {
+        return;
+    }
+
+    if (write)
+    {
+        priv->cpu_writes++;
+    }
+    else
+    {
+        priv->cpu_reads++;
+    }
+
+    if (LS_PixmapWantsSystemMemory(priv))
+    {
+        ms_exa_pixmap_wait(pPixmap);
+        LS_MigrateToSystem(pPixmap, priv);
+    }
+    else if (!write && LS_PixmapWantsMirror(pPixmap, priv))
+    {
+        ms_exa_pixmap_wait(pPixmap);
+        LS_MirrorSync(pPixmap, priv);
+    }
+
+    // drawing into a mirror reaches the BO through ms_exa_pixmap_damage()
+    if (priv->is_dumb && !priv->mirror_valid)
+    {
+        LS_PixmapSyncBegin(priv, write);
+    }
+}
+
 
 //////////////////////////////////////////////////////////////////////////
 /////////////    solid    ////////////////////////////////////////////////
 
 
-static Bool ms_exa_prepare_solid(PixmapPtr pPixmap,
-                     int alu, Pixel planemask, Pixel fg)
+//
+// GXcopy with a full planemask is a plain store of the foreground pixel,
+// which is what nearly every window background and PolyFillRectangle is.
+// Hand those to the SIMD kernels, everything else still goes through fb.
+//
+static Bool ms_exa_is_plain_store(PixmapPtr pPixmap, int alu, Pixel planemask)
+{
+    int bpp = pPixmap->drawable.bitsPerPixel;
+
+    if (alu != GXcopy)
+    {
+        return FALSE;
+    }
+
+    if (!EXA_PM_IS_SOLID(&pPixmap->drawable, planemask))
+    {
+        return FALSE;
+    }
+
+    return (bpp == 8) || (bpp == 16) || (bpp == 32);
+}
+
+
+//
+// Set up the fills of ms_exa_solid(), shared by PrepareSolid() and the
+// copies and composites that turn into fills. Neither counts the access
+// nor starts the statistics, the caller has done both.
+//
+static Bool ms_exa_solid_setup(PixmapPtr pPixmap,
+                               int alu, Pixel planemask, Pixel fg)
 {
+    exa_prepare_args.solid.pPixmap = pPixmap;
     exa_prepare_args.solid.alu = alu;
     exa_prepare_args.solid.planemask = planemask;
     exa_prepare_args.solid.fg = fg;
+    exa_prepare_args.solid.native =
+        ms_exa_is_plain_store(pPixmap, alu, planemask);
+    exa_prepare_args.solid.pGC = NULL;
+    exa_prepare_args.solid.job.nBox = 0;
+
+    if (!exa_prepare_args.solid.native)
+    {
+        ScreenPtr screen = pPixmap->drawable.pScreen;
+        ChangeGCVal val[3];
+        GCPtr gc;
+
+        gc = GetScratchGC(pPixmap->drawable.depth, screen);
+        if (gc == NULL)
+        {
+            return FALSE;
+        }
+
+        val[0].val = alu;
+        val[1].val = planemask;
+        val[2].val = fg;
+        ChangeGC(NullClient, gc, GCFunction | GCPlaneMask | GCForeground, val);
+        ValidateGC(&pPixmap->drawable, gc);
+
+        exa_prepare_args.solid.pGC = gc;
+    }
 
     return TRUE;
 }
 
 
-static void ms_exa_solid(PixmapPtr pPixmap, int x1, int y1, int x2, int y2)
+static Bool ms_exa_prepare_solid(PixmapPtr pPixmap,
+                     int alu, Pixel planemask, Pixel fg)
+{
+    ms_exa_pixmap_access(pPixmap, TRUE);
+    LS_ExaStatsBegin(LS_EXA_STAT_SOLID);
+
+    if (!ms_exa_solid_setup(pPixmap, alu, planemask, fg))
+    {
+        LS_ExaStatsEnd(LS_EXA_STAT_SOLID);
+        return FALSE;
+    }
+
+    if (!exa_prepare_args.solid.native)
+    {
+        LS_ExaStatsSoftware(LS_EXA_STAT_SOLID);
+    }
+
+    return TRUE;
+}
+
+
+struct ms_exa_solid_band {
+    struct ms_exa_solid_job *pJob;
+    BoxPtr pBox;
+};
+
+static void ms_exa_solid_band(void *data, int y, int h)
+{
+    struct ms_exa_solid_band *pBand = data;
+    struct ms_exa_solid_job *pJob = pBand->pJob;
+    BoxPtr pBox = pBand->pBox;
+
+    lsSimd.FillRect(pJob->bits, pJob->stride, pJob->bpp,
+                    pBox->x1, pBox->y1 + y, pBox->x2 - pBox->x1, h,
+                    pJob->fg);
+}
+
+static void ms_exa_solid_run(void *data)
 {
-    ScreenPtr screen = pPixmap->drawable.pScreen;
-    GCPtr gc = GetScratchGC(pPixmap->drawable.depth, screen);
-    ChangeGCVal val[3];
+    struct ms_exa_solid_job *pJob = data;
+    int i;
 
-    val[0].val = exa_prepare_args.solid.alu;
-    val[1].val = exa_prepare_args.solid.planemask;
-    val[2].val = exa_prepare_args.solid.fg;
-    ChangeGC(NullClient, gc, GCFunction | GCPlaneMask | GCForeground, val);
-    ValidateGC(&pPixmap->drawable, gc);
+    for (i = 0; i < pJob->nBox; i++)
+    {
+        struct ms_exa_solid_band band = { pJob, &pJob->boxes[i] };
+        int width = pJob->boxes[i].x2 - pJob->boxes[i].x1;
+        int height = pJob->boxes[i].y2 - pJob->boxes[i].y1;
+
+        LS_RunBands(ms_exa_solid_band, &band, height, width * height);
+    }
+}
+
+
+static void ms_exa_fill_submit(PixmapPtr pPixmap,
+                               struct ms_exa_solid_job *pJob, Pixel fg)
+{
+    uint64_t seq;
+
+    if (!ms_exa_map_pixmap(pPixmap))
+    {
+        return;
+    }
+
+    pJob->bits = pPixmap->devPrivate.ptr;
+    pJob->stride = pPixmap->devKind;
+    pJob->bpp = pPixmap->drawable.bitsPerPixel;
+    pJob->fg = fg;
 
-    ms_exa_prepare_access(pPixmap, 0);
-    fbFill(&pPixmap->drawable, gc, x1, y1, x2 - x1, y2 - y1);
     ms_exa_finish_access(pPixmap, 0);
 
-    FreeScratchGC(gc);
+    seq = LS_ExaQueueSubmit(ms_exa_solid_run, pJob,
+            offsetof(struct ms_exa_solid_job, boxes) +
+            pJob->nBox * sizeof(BoxRec));
+
+    ms_exa_pixmap_mark(pPixmap, seq);
+}
+
+
+static void ms_exa_solid_flush(void)
+{
+    PixmapPtr pPixmap = exa_prepare_args.solid.pPixmap;
+    struct ms_exa_solid_job *pJob = &exa_prepare_args.solid.job;
+    BoxPtr pBox = pJob->boxes;
+    int i;
+
+    if (pJob->nBox == 0)
+    {
+        return;
+    }
+
+    if (exa_prepare_args.solid.native)
+    {
+        ms_exa_fill_submit(pPixmap, pJob, exa_prepare_args.solid.fg);
+        ms_exa_pixmap_damage(pPixmap, pBox, pJob->nBox);
+    }
+    else if (ms_exa_access_pixmap(pPixmap))
+    {
+        for (i = 0; i < pJob->nBox; i++)
+        {
+            fbFill(&pPixmap->drawable, exa_prepare_args.solid.pGC,
+                   pBox[i].x1, pBox[i].y1,
+                   pBox[i].x2 - pBox[i].x1,
+                   pBox[i].y2 - pBox[i].y1);
+        }
+
+        ms_exa_finish_access(pPixmap, 0);
+        ms_exa_pixmap_damage(pPixmap, pBox, pJob->nBox);
+    }
+
+    pJob->nBox = 0;
+}
+
+
+static void ms_exa_solid(PixmapPtr pPixmap, int x1, int y1, int x2, int y2)
+{
+    struct ms_exa_solid_job *pJob = &exa_prepare_args.solid.job;
+    BoxPtr pBox;
+
+    LS_ExaStatsRect(x2 - x1, y2 - y1);
+
+    // covering the whole pixmap overrides every box queued before,
+    // and may leave the pixmap as nothing but a colour
+    if (exa_prepare_args.solid.native &&
+        (x1 <= 0) && (y1 <= 0) &&
+        (x2 >= pPixmap->drawable.width) && (y2 >= pPixmap->drawable.height) &&
+        ms_exa_pixmap_can_be_solid(pPixmap))
+    {
+        struct ms_exa_pixmap_priv *priv = exaGetPixmapDriverPrivate(pPixmap);
+
+        priv->solid = TRUE;
+        priv->solid_fg = exa_prepare_args.solid.fg;
+        pJob->nBox = 0;
+        return;
+    }
+
+    if (pJob->nBox == MS_EXA_BATCH_SIZE)
+    {
+        ms_exa_solid_flush();
+    }
+
+    pBox = &pJob->boxes[pJob->nBox++];
+    pBox->x1 = x1;
+    pBox->y1 = y1;
+    pBox->x2 = x2;
+    pBox->y2 = y2;
 }
 
 
 static void ms_exa_solid_done(PixmapPtr pPixmap)
 {
+    ms_exa_solid_flush();
+
+    if (exa_prepare_args.solid.pGC)
+    {
+        FreeScratchGC(exa_prepare_args.solid.pGC);
+        exa_prepare_args.solid.pGC = NULL;
+    }
 
+    LS_ExaStatsEnd(LS_EXA_STAT_SOLID);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -154,44 +520,305 @@ static Bool ms_exa_prepare_copy(PixmapPtr pSrcPixmap,
                     PixmapPtr pDstPixmap,
                     int dx, int dy, int alu, Pixel planemask)
 {
+    Pixel fg;
+
+    ms_exa_pixmap_access(pSrcPixmap, FALSE);
+    ms_exa_pixmap_access(pDstPixmap, TRUE);
+    LS_ExaStatsBegin(LS_EXA_STAT_COPY);
+
     exa_prepare_args.copy.pSrcPixmap = pSrcPixmap;
+    exa_prepare_args.copy.pDstPixmap = pDstPixmap;
     exa_prepare_args.copy.alu = alu;
     exa_prepare_args.copy.planemask = planemask;
+    exa_prepare_args.copy.job.xdir = dx;
+    exa_prepare_args.copy.job.ydir = dy;
+    exa_prepare_args.copy.fill = FALSE;
+    exa_prepare_args.copy.pGC = NULL;
+    exa_prepare_args.copy.job.nRect = 0;
+
+    // a straight GXcopy between pixmaps of the same pixel size is a
+    // plain memory move, let the SIMD row movers do it.
+    exa_prepare_args.copy.native =
+        (pSrcPixmap->drawable.bitsPerPixel ==
+         pDstPixmap->drawable.bitsPerPixel) &&
+        ms_exa_is_plain_store(pDstPixmap, alu, planemask);
+
+    if (exa_prepare_args.copy.native && (pSrcPixmap != pDstPixmap) &&
+        ms_exa_pixmap_is_solid(pSrcPixmap, &fg))
+    {
+        exa_prepare_args.copy.fill = TRUE;
+
+        if (!ms_exa_solid_setup(pDstPixmap, alu, planemask, fg))
+        {
+            LS_ExaStatsEnd(LS_EXA_STAT_COPY);
+            return FALSE;
+        }
+
+        return TRUE;
+    }
+
+    if (!exa_prepare_args.copy.native)
+    {
+        ScreenPtr screen = pDstPixmap->drawable.pScreen;
+        ChangeGCVal val[2];
+        GCPtr gc;
+
+        LS_ExaStatsSoftware(LS_EXA_STAT_COPY);
+
+        gc = GetScratchGC(pDstPixmap->drawable.depth, screen);
+        if (gc == NULL)
+        {
+            LS_ExaStatsEnd(LS_EXA_STAT_COPY);
+            return FALSE;
+        }
+
+        val[0].val = alu;
+        val[1].val = planemask;
+        ChangeGC(NullClient, gc, GCFunction | GCPlaneMask, val);
+        ValidateGC(&pDstPixmap->drawable, gc);
+
+        exa_prepare_args.copy.pGC = gc;
+    }
 
     return TRUE;
 }
 
 
-static void ms_exa_copy(PixmapPtr pDstPixmap, int srcX, int srcY,
-            int dstX, int dstY, int width, int height)
+struct ms_exa_copy_band {
+    struct ms_exa_copy_job *pJob;
+    struct ms_exa_copy_rect *pRect;
+};
+
+static void ms_exa_copy_band(void *data, int y, int h)
+{
+    struct ms_exa_copy_band *pBand = data;
+    struct ms_exa_copy_job *pJob = pBand->pJob;
+    struct ms_exa_copy_rect *pRect = pBand->pRect;
+
+    LS_CopyRect(pJob->src_bits, pJob->src_stride,
+                pJob->dst_bits, pJob->dst_stride, pJob->bpp,
+                pRect->srcX, pRect->srcY + y, pRect->dstX, pRect->dstY + y,
+                pRect->width, h, pJob->xdir, pJob->ydir);
+}
+
+static void ms_exa_copy_run(void *data)
+{
+    struct ms_exa_copy_job *pJob = data;
+    int i;
+
+    for (i = 0; i < pJob->nRect; i++)
+    {
+        struct ms_exa_copy_rect *pRect = &pJob->rects[i];
+        struct ms_exa_copy_band band = { pJob, pRect };
+        int pixels = pRect->width * pRect->height;
+
+        // bands of a blit within one pixmap may overlap each other,
+        // those have to run in order on this thread.
+        if (pJob->same_pixmap &&
+            (abs(pRect->srcY - pRect->dstY) < pRect->height))
+        {
+            pixels = 0;
+        }
+
+        LS_RunBands(ms_exa_copy_band, &band, pRect->height, pixels);
+    }
+}
+
+
+//
+// Called with the boxes every operation wrote, once it is queued. They
+// go into the dma-buf access window of a dumb pixmap; one with a valid
+// mirror was drawn in the mirror, the boxes are copied to the BO in
+// order behind the drawing.
+//
+static void ms_exa_pixmap_damage(PixmapPtr pPixmap,
+                                 const BoxRec *pBox, int nBox)
+{
+    struct ms_exa_pixmap_priv *priv = exaGetPixmapDriverPrivate(pPixmap);
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pPixmap->drawable.pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    struct ms_exa_copy_job job;
+    uint64_t seq;
+    int i;
+
+    if ((priv == NULL) || !priv->is_dumb)
+    {
+        return;
+    }
+
+    if (priv->mirror_valid)
+    {
+        LS_PixmapSyncBegin(priv, TRUE);
+    }
+
+    LS_PixmapSyncDamage(priv, pBox, nBox);
+
+    if (!priv->mirror_valid || dumb_bo_map(ms->drmmode.fd, priv->bo))
+    {
+        return;
+    }
+
+    job.src_bits = priv->mirror.pDat;
+    job.src_stride = priv->mirror.pitch;
+    job.dst_bits = priv->bo->ptr;
+    job.dst_stride = priv->bo->pitch;
+    job.bpp = pPixmap->drawable.bitsPerPixel;
+    job.xdir = 1;
+    job.ydir = 1;
+    job.same_pixmap = FALSE;
+
+    while (nBox > 0)
+    {
+        job.nRect = min(nBox, MS_EXA_BATCH_SIZE);
+
+        for (i = 0; i < job.nRect; i++)
+        {
+            job.rects[i].srcX = job.rects[i].dstX = pBox[i].x1;
+            job.rects[i].srcY = job.rects[i].dstY = pBox[i].y1;
+            job.rects[i].width = pBox[i].x2 - pBox[i].x1;
+            job.rects[i].height = pBox[i].y2 - pBox[i].y1;
+        }
+
+        seq = LS_ExaQueueSubmit(ms_exa_copy_run, &job,
+                offsetof(struct ms_exa_copy_job, rects) +
+                job.nRect * sizeof(struct ms_exa_copy_rect));
+
+        ms_exa_pixmap_mark(pPixmap, seq);
+
+        pBox += job.nRect;
+        nBox -= job.nRect;
+    }
+}
+
+static void ms_exa_pixmap_damage_rects(PixmapPtr pPixmap,
+        const struct ms_exa_copy_rect *pRect, int nRect)
+{
+    BoxRec boxes[MS_EXA_BATCH_SIZE];
+    int i;
+
+    for (i = 0; i < nRect; i++)
+    {
+        boxes[i].x1 = pRect[i].dstX;
+        boxes[i].y1 = pRect[i].dstY;
+        boxes[i].x2 = pRect[i].dstX + pRect[i].width;
+        boxes[i].y2 = pRect[i].dstY + pRect[i].height;
+    }
+
+    ms_exa_pixmap_damage(pPixmap, boxes, nRect);
+}
+
+
+static void ms_exa_copy_flush(void)
 {
     PixmapPtr pSrcPixmap = exa_prepare_args.copy.pSrcPixmap;
-    ScreenPtr screen = pDstPixmap->drawable.pScreen;
-    ChangeGCVal val[2];
-    GCPtr gc;
+    PixmapPtr pDstPixmap = exa_prepare_args.copy.pDstPixmap;
+    struct ms_exa_copy_job *pJob = &exa_prepare_args.copy.job;
+    struct ms_exa_copy_rect *pRect = pJob->rects;
+    int i;
 
-    gc = GetScratchGC(pDstPixmap->drawable.depth, screen);
+    if (pJob->nRect == 0)
+    {
+        return;
+    }
+
+    if (exa_prepare_args.copy.native)
+    {
+        if (ms_exa_map_pixmap(pSrcPixmap) && ms_exa_map_pixmap(pDstPixmap))
+        {
+            uint64_t seq;
 
-    val[0].val = exa_prepare_args.copy.alu;
-    val[1].val = exa_prepare_args.copy.planemask;
-    ChangeGC(NullClient, gc, GCFunction | GCPlaneMask, val);
-    ValidateGC(&pDstPixmap->drawable, gc);
+            pJob->src_bits = pSrcPixmap->devPrivate.ptr;
+            pJob->src_stride = pSrcPixmap->devKind;
+            pJob->dst_bits = pDstPixmap->devPrivate.ptr;
+            pJob->dst_stride = pDstPixmap->devKind;
+            pJob->bpp = pDstPixmap->drawable.bitsPerPixel;
+            pJob->same_pixmap = (pSrcPixmap == pDstPixmap);
 
-    ms_exa_prepare_access(pSrcPixmap, 0);
-    ms_exa_prepare_access(pDstPixmap, 0);
+            seq = LS_ExaQueueSubmit(ms_exa_copy_run, pJob,
+                    offsetof(struct ms_exa_copy_job, rects) +
+                    pJob->nRect * sizeof(struct ms_exa_copy_rect));
 
-    fbCopyArea(&pSrcPixmap->drawable, &pDstPixmap->drawable, gc,
-               srcX, srcY, width, height, dstX, dstY);
+            ms_exa_pixmap_mark(pSrcPixmap, seq);
+            ms_exa_pixmap_mark(pDstPixmap, seq);
+        }
 
-    ms_exa_finish_access(pDstPixmap, 0);
-    ms_exa_finish_access(pSrcPixmap, 0);
+        ms_exa_finish_access(pDstPixmap, 0);
+        ms_exa_finish_access(pSrcPixmap, 0);
+    }
+    else if (ms_exa_access_pixmap(pSrcPixmap))
+    {
+        if ((pSrcPixmap == pDstPixmap) || ms_exa_access_pixmap(pDstPixmap))
+        {
+            for (i = 0; i < pJob->nRect; i++)
+            {
+                fbCopyArea(&pSrcPixmap->drawable, &pDstPixmap->drawable,
+                           exa_prepare_args.copy.pGC,
+                           pRect[i].srcX, pRect[i].srcY,
+                           pRect[i].width, pRect[i].height,
+                           pRect[i].dstX, pRect[i].dstY);
+            }
 
-    FreeScratchGC(gc);
+            if (pSrcPixmap != pDstPixmap)
+            {
+                ms_exa_finish_access(pDstPixmap, 0);
+            }
+        }
+
+        ms_exa_finish_access(pSrcPixmap, 0);
+    }
+
+    ms_exa_pixmap_damage_rects(pDstPixmap, pRect, pJob->nRect);
+
+    pJob->nRect = 0;
+}
+
+
+static void ms_exa_copy(PixmapPtr pDstPixmap, int srcX, int srcY,
+            int dstX, int dstY, int width, int height)
+{
+    struct ms_exa_copy_job *pJob = &exa_prepare_args.copy.job;
+    struct ms_exa_copy_rect *pRect;
+
+    if (exa_prepare_args.copy.fill)
+    {
+        ms_exa_solid(pDstPixmap, dstX, dstY, dstX + width, dstY + height);
+        return;
+    }
+
+    LS_ExaStatsRect(width, height);
+
+    if (pJob->nRect == MS_EXA_BATCH_SIZE)
+    {
+        ms_exa_copy_flush();
+    }
+
+    pRect = &pJob->rects[pJob->nRect++];
+    pRect->srcX = srcX;
+    pRect->srcY = srcY;
+    pRect->dstX = dstX;
+    pRect->dstY = dstY;
+    pRect->width = width;
+    pRect->height = height;
 }
 
 static void ms_exa_copy_done(PixmapPtr pPixmap)
 {
+    if (exa_prepare_args.copy.fill)
+    {
+        ms_exa_solid_done(pPixmap);
+    }
+    else
+    {
+        ms_exa_copy_flush();
+
+        if (exa_prepare_args.copy.pGC)
+        {
+            FreeScratchGC(exa_prepare_args.copy.pGC);
+            exa_prepare_args.copy.pGC = NULL;
+        }
+    }
 
+    LS_ExaStatsEnd(LS_EXA_STAT_COPY);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -206,7 +833,10 @@ static Bool ms_exa_check_composite(int op, PicturePtr pSrcPicture,
 {
 
     if (!pSrcPicture->pDrawable)
+    {
+        LS_ExaStatsFallback(LS_EXA_STAT_COMPOSITE);
         return FALSE;
+    }
 
     return TRUE;
 }
@@ -217,17 +847,103 @@ static Bool ms_exa_prepare_composite(int op,
                          PicturePtr pDstPicture,
                          PixmapPtr pSrc, PixmapPtr pMask, PixmapPtr pDst)
 {
+    struct LoongsonCompositePath *pPath;
+    uint32_t fill;
+    Pixel fg;
+
+    ms_exa_pixmap_access(pSrc, FALSE);
+    if (pMask)
+    {
+        ms_exa_pixmap_access(pMask, FALSE);
+    }
+    ms_exa_pixmap_access(pDst, TRUE);
+    LS_ExaStatsBegin(LS_EXA_STAT_COMPOSITE);
+    LS_ExaStatsComposite(op, pSrcPicture, pMaskPicture, pDstPicture);
+
     exa_prepare_args.composite.op = op;
     exa_prepare_args.composite.pSrcPicture = pSrcPicture;
     exa_prepare_args.composite.pMaskPicture = pMaskPicture;
     exa_prepare_args.composite.pDstPicture = pDstPicture;
     exa_prepare_args.composite.pSrc = pSrc;
     exa_prepare_args.composite.pMask = pMask;
+    exa_prepare_args.composite.pDst = pDst;
+    exa_prepare_args.composite.job.nRect = 0;
+    exa_prepare_args.composite.fill = FALSE;
+
+    pPath = LS_CompositeLookup(op, pSrcPicture, pMaskPicture, pDstPicture);
+    exa_prepare_args.composite.pPath = pPath;
+
+    if (pPath && (pMask == NULL) && (pSrc != pDst) &&
+        ms_exa_pixmap_is_solid(pSrc, &fg) &&
+        LS_CompositeSolidFill(pPath, fg, &fill))
+    {
+        exa_prepare_args.composite.fill = TRUE;
+        pPath->hits++;
+
+        if (!ms_exa_solid_setup(pDst, GXcopy, ~(Pixel) 0, fill))
+        {
+            LS_ExaStatsEnd(LS_EXA_STAT_COMPOSITE);
+            return FALSE;
+        }
+
+        if (!exa_prepare_args.solid.native)
+        {
+            LS_ExaStatsSoftware(LS_EXA_STAT_COMPOSITE);
+        }
+
+        return TRUE;
+    }
+
+    if (pPath == NULL)
+    {
+        LS_ExaStatsSoftware(LS_EXA_STAT_COMPOSITE);
+    }
 
     return TRUE;
 }
 
 
+static void ms_exa_composite_run(void *data)
+{
+    struct ms_exa_composite_job *pJob = data;
+    int i;
+
+    for (i = 0; i < pJob->nRect; i++)
+    {
+        LS_CompositeExec(&pJob->rects[i]);
+    }
+}
+
+
+static void ms_exa_composite_flush(void)
+{
+    struct ms_exa_composite_job *pJob = &exa_prepare_args.composite.job;
+    PixmapPtr pMask = exa_prepare_args.composite.pMask;
+    uint64_t seq;
+
+    if (pJob->nRect == 0)
+    {
+        return;
+    }
+
+    seq = LS_ExaQueueSubmit(ms_exa_composite_run, pJob,
+            offsetof(struct ms_exa_composite_job, rects) +
+            pJob->nRect * sizeof(struct LoongsonCompositeArgs));
+
+    ms_exa_pixmap_mark(exa_prepare_args.composite.pSrc, seq);
+    if (pMask)
+    {
+        ms_exa_pixmap_mark(pMask, seq);
+    }
+    ms_exa_pixmap_mark(exa_prepare_args.composite.pDst, seq);
+
+    ms_exa_pixmap_damage(exa_prepare_args.composite.pDst,
+                         exa_prepare_args.composite.boxes, pJob->nRect);
+
+    pJob->nRect = 0;
+}
+
+
 static void ms_exa_composite(PixmapPtr pDst, int srcX, int srcY,
                  int maskX, int maskY, int dstX, int dstY,
                  int width, int height)
@@ -237,18 +953,81 @@ static void ms_exa_composite(PixmapPtr pDst, int srcX, int srcY,
     PicturePtr pDstPicture = exa_prepare_args.composite.pDstPicture;
     PixmapPtr pSrc = exa_prepare_args.composite.pSrc;
     PixmapPtr pMask = exa_prepare_args.composite.pMask;
+    struct LoongsonCompositePath *pPath = exa_prepare_args.composite.pPath;
+    struct ms_exa_composite_job *pJob = &exa_prepare_args.composite.job;
     int op = exa_prepare_args.composite.op;
+    BoxRec box = { dstX, dstY, dstX + width, dstY + height };
+    Bool mapped;
 
-    if (pMask)
+    if (exa_prepare_args.composite.fill)
     {
-        ms_exa_prepare_access(pMask, 0);
+        if (LS_CompositeInBounds(pPath, pSrc, NULL, srcX, srcY, 0, 0,
+                                 width, height))
+        {
+            ms_exa_solid(pDst, dstX, dstY, dstX + width, dstY + height);
+            return;
+        }
+
+        // part of the rectangle lies outside the source, which has to
+        // stay transparent there instead of taking the colour
+        ms_exa_solid_flush();
+        pPath = NULL;
     }
 
-    ms_exa_prepare_access(pSrc, 0);
-    ms_exa_prepare_access(pDst, 0);
+    LS_ExaStatsRect(width, height);
 
-    fbComposite(op, pSrcPicture, pMaskPicture, pDstPicture,
-                srcX, srcY, maskX, maskY, dstX, dstY, width, height);
+    if (pPath &&
+        LS_CompositeInBounds(pPath, pSrc, pMask, srcX, srcY, maskX, maskY,
+                             width, height))
+    {
+        if (pJob->nRect == MS_EXA_BATCH_SIZE)
+        {
+            ms_exa_composite_flush();
+        }
+
+        mapped = ms_exa_map_pixmap(pSrc) &&
+                 ((pMask == NULL) || ms_exa_map_pixmap(pMask)) &&
+                 ms_exa_map_pixmap(pDst);
+
+        if (mapped)
+        {
+            exa_prepare_args.composite.boxes[pJob->nRect] = box;
+
+            LS_CompositeSetup(pPath, pSrc, pMask, pDst, srcX, srcY,
+                              maskX, maskY, dstX, dstY, width, height,
+                              &pJob->rects[pJob->nRect++]);
+        }
+
+        ms_exa_finish_access(pDst, 0);
+        if (pMask)
+        {
+            ms_exa_finish_access(pMask, 0);
+        }
+        ms_exa_finish_access(pSrc, 0);
+
+        // memory that could not be had now may still be had by fb below
+        if (mapped)
+        {
+            return;
+        }
+    }
+
+    LS_CompositeCountFallback();
+
+    // rectangles batched so far come first
+    ms_exa_composite_flush();
+
+    // a pixmap whose memory is only allocated now may not get it, draw
+    // nothing then rather than through a NULL pointer
+    mapped = ((pMask == NULL) || ms_exa_access_pixmap(pMask)) &&
+             ms_exa_access_pixmap(pSrc) &&
+             ms_exa_access_pixmap(pDst);
+
+    if (mapped)
+    {
+        fbComposite(op, pSrcPicture, pMaskPicture, pDstPicture,
+                    srcX, srcY, maskX, maskY, dstX, dstY, width, height);
+    }
 
     ms_exa_finish_access(pDst, 0);
     ms_exa_finish_access(pSrc, 0);
@@ -257,51 +1036,144 @@ static void ms_exa_composite(PixmapPtr pDst, int srcX, int srcY,
     {
         ms_exa_finish_access(pMask, 0);
     }
+
+    if (mapped)
+    {
+        ms_exa_pixmap_damage(pDst, &box, 1);
+    }
 }
 
 static void ms_exa_composite_done(PixmapPtr pPixmap)
 {
+    if (exa_prepare_args.composite.fill)
+    {
+        ms_exa_solid_done(pPixmap);
+    }
+    else
+    {
+        ms_exa_composite_flush();
+    }
 
+    LS_ExaStatsEnd(LS_EXA_STAT_COMPOSITE);
 }
 
 
 //////////////////////////////////////////////////////////////////////////
 
 
-/*
+//
+// PutImage/GetImage on dumb pixmaps. Their mapping is write-combined, so
+// the rows are moved with kernels that only touch whole aligned vectors
+// of the BO, instead of fb's small scattered accesses. Malloc'ed pixmaps
+// are plain cached memory, let EXA handle those.
+//
+static Bool ms_exa_is_wc_pixmap(PixmapPtr pPixmap)
+{
+    struct ms_exa_pixmap_priv *priv = exaGetPixmapDriverPrivate(pPixmap);
+    int bpp = pPixmap->drawable.bitsPerPixel;
+
+    if ((priv == NULL) || !priv->is_dumb)
+    {
+        return FALSE;
+    }
+
+    return (bpp >= 8) && ((bpp & 7) == 0);
+}
 
 static Bool
 ms_exa_upload_to_screen(PixmapPtr pDst, int x, int y, int w, int h,
                         char *src, int src_pitch)
 {
-    return FALSE;
+    int cpp = pDst->drawable.bitsPerPixel >> 3;
+    BoxRec box = { x, y, x + w, y + h };
+    uint8_t *dst;
+
+    if (!ms_exa_is_wc_pixmap(pDst))
+    {
+        return FALSE;
+    }
+
+    // the written box is known, a mirror can be kept up to date
+    ms_exa_pixmap_access(pDst, TRUE);
+
+    LS_ExaStatsBegin(LS_EXA_STAT_UPLOAD);
+    LS_ExaStatsRect(w, h);
+
+    if (!ms_exa_access_pixmap(pDst))
+    {
+        LS_ExaStatsEnd(LS_EXA_STAT_UPLOAD);
+        return FALSE;
+    }
+
+    dst = (uint8_t *) pDst->devPrivate.ptr + y * pDst->devKind + x * cpp;
+
+    while (h--)
+    {
+        lsSimd.UploadRow(dst, (const uint8_t *) src, w * cpp);
+        dst += pDst->devKind;
+        src += src_pitch;
+    }
+
+    ms_exa_finish_access(pDst, EXA_PREPARE_DEST);
+    ms_exa_pixmap_damage(pDst, &box, 1);
+
+    LS_ExaStatsEnd(LS_EXA_STAT_UPLOAD);
+
+    return TRUE;
 }
 
 static Bool
 ms_exa_download_from_screen(PixmapPtr pSrc, int x, int y, int w, int h,
                             char *dst, int dst_pitch)
 {
-    return FALSE;
-}
+    int cpp = pSrc->drawable.bitsPerPixel >> 3;
+    const uint8_t *src;
 
-*/
+    if (!ms_exa_is_wc_pixmap(pSrc))
+    {
+        return FALSE;
+    }
 
+    LS_ExaStatsBegin(LS_EXA_STAT_DOWNLOAD);
+    LS_ExaStatsRect(w, h);
 
+    if (!ms_exa_prepare_access(pSrc, EXA_PREPARE_SRC))
+    {
+        LS_ExaStatsEnd(LS_EXA_STAT_DOWNLOAD);
+        return FALSE;
+    }
+
+    src = (const uint8_t *) pSrc->devPrivate.ptr + y * pSrc->devKind + x * cpp;
+
+    while (h--)
+    {
+        lsSimd.DownloadRow((uint8_t *) dst, src, w * cpp);
+        src += pSrc->devKind;
+        dst += dst_pitch;
+    }
+
+    ms_exa_finish_access(pSrc, EXA_PREPARE_SRC);
+
+    LS_ExaStatsEnd(LS_EXA_STAT_DOWNLOAD);
+
+    return TRUE;
+}
+
+
+//
+// Markers are EXA queue sequence numbers. With ExaAsync off every job has
+// already run when Solid/Copy/Composite return, so both are free.
+//
 static void ms_exa_wait_marker(ScreenPtr pScreen, int marker)
 {
-    // TODO:
+    LS_ExaQueueWaitMarker(marker);
 }
 
-/*
-
 static int ms_exa_mark_sync(ScreenPtr pScreen)
 {
-    // TODO: return latest request(marker).
-    return 0;
+    return LS_ExaQueueMarker();
 }
 
-*/
-
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -372,7 +1244,42 @@ static const char * ms_exa_index_to_string(int index)
  * DownloadFromScreen() to migate the pixmap out.
  */
 
-Bool ms_exa_prepare_access(PixmapPtr pPix, int index)
+//
+// Give a lazily allocated pixmap its memory and write out the colour of
+// a solid pixmap. The fill is queued like any other job, so it is still
+// ordered after the ones already touching the pixmap.
+//
+static Bool ms_exa_realize_pixmap(PixmapPtr pPix)
+{
+    struct ms_exa_pixmap_priv *priv = exaGetPixmapDriverPrivate(pPix);
+    struct ms_exa_solid_job job;
+
+    if (!LS_CommitBuf(&priv->buf))
+    {
+        return FALSE;
+    }
+
+    if (priv->solid)
+    {
+        priv->solid = FALSE;
+
+        job.nBox = 1;
+        job.boxes[0].x1 = 0;
+        job.boxes[0].y1 = 0;
+        job.boxes[0].x2 = pPix->drawable.width;
+        job.boxes[0].y2 = pPix->drawable.height;
+
+        ms_exa_fill_submit(pPix, &job, priv->solid_fg);
+    }
+
+    return TRUE;
+}
+
+//
+// Map the pixels of @pPix without waiting for queued jobs, only used to
+// pick up the pointers handed to the queue itself.
+//
+static Bool ms_exa_map_pixmap(PixmapPtr pPix)
 {
     ScreenPtr screen = pPix->drawable.pScreen;
     ScrnInfoPtr pScrn = xf86ScreenToScrn(screen);
@@ -380,8 +1287,14 @@ Bool ms_exa_prepare_access(PixmapPtr pPix, int index)
 
     struct ms_exa_pixmap_priv *priv = exaGetPixmapDriverPrivate(pPix);
 
-    if ( LS_IsDumbPixmap(priv->usage_hint) )
+    if ( priv->is_dumb )
     {
+        if (priv->mirror_valid)
+        {
+            pPix->devPrivate.ptr = priv->mirror.pDat;
+            return TRUE;
+        }
+
         if (pPix->devPrivate.ptr)
         {
             return TRUE;
@@ -403,6 +1316,13 @@ Bool ms_exa_prepare_access(PixmapPtr pPix, int index)
     }
     else
     {
+        if ((priv->buf.size != 0) && !ms_exa_realize_pixmap(pPix))
+        {
+            xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+                    "failed to allocate %dx%d mem\n",
+                    pPix->drawable.width, pPix->drawable.height);
+        }
+
         pPix->devPrivate.ptr = priv->buf.pDat;
     }
 
@@ -411,6 +1331,56 @@ Bool ms_exa_prepare_access(PixmapPtr pPix, int index)
     return pPix->devPrivate.ptr != NULL;
 }
 
+//
+// Map @pPix for the CPU once every queued job touching it has retired.
+//
+static Bool ms_exa_access_pixmap(PixmapPtr pPix)
+{
+    // mapping may queue the fill of a solid pixmap, wait after it
+    if (!ms_exa_map_pixmap(pPix))
+    {
+        return FALSE;
+    }
+
+    // only the jobs touching this pixmap have to be finished
+    ms_exa_pixmap_wait(pPix);
+
+    return TRUE;
+}
+
+Bool ms_exa_prepare_access(PixmapPtr pPix, int index)
+{
+    struct ms_exa_pixmap_priv *priv = exaGetPixmapDriverPrivate(pPix);
+    Bool write = (index == EXA_PREPARE_DEST) || (index == EXA_PREPARE_AUX_DEST);
+
+    ms_exa_pixmap_access(pPix, write);
+
+    // nobody tells where fb is going to draw, it draws to the BO
+    if (write && priv && priv->mirror_valid)
+    {
+        ms_exa_pixmap_wait(pPix);
+        LS_MirrorInvalidate(priv);
+    }
+
+    if (write && priv && priv->is_dumb)
+    {
+        BoxRec box = { 0, 0, pPix->drawable.width, pPix->drawable.height };
+
+        LS_PixmapSyncBegin(priv, TRUE);
+        LS_PixmapSyncDamage(priv, &box, 1);
+    }
+
+    if (priv)
+    {
+        LS_ExaStatsAccess(priv->solid ? LS_EXA_STAT_SOLID_COLOUR :
+                          priv->mirror_valid ? LS_EXA_STAT_MIRROR :
+                          priv->is_dumb ? LS_EXA_STAT_DUMB : LS_EXA_STAT_SYSTEM,
+                          write);
+    }
+
+    return ms_exa_access_pixmap(pPix);
+}
+
 
 /**
  * FinishAccess() is called after CPU access to an offscreen pixmap.
@@ -431,11 +1401,9 @@ void ms_exa_finish_access(PixmapPtr pPixmap, int index)
         pPixmap->devPrivate.ptr = NULL;
     }
 
-    // NOTE:
-    // can we use EXA migration module to track which parts of the
-    // buffer was accessed by sw, and pass that info down to kernel
-    // to do a more precise cache flush...
-    //
+    // The dma-buf access window stays open past this point, the boxes
+    // written are collected by ms_exa_pixmap_damage() and it is closed
+    // by LS_PixmapSyncFlush() once a frame.
 }
 
 
@@ -443,7 +1411,10 @@ static void ms_exa_destroy_pixmap(ScreenPtr pScreen, void *driverPriv)
 {
     struct ms_exa_pixmap_priv *pPriv = (struct ms_exa_pixmap_priv *) driverPriv;
 
-    if ( LS_IsDumbPixmap(pPriv->usage_hint) )
+    LS_ExaQueueWait(pPriv->seq);
+    LS_ExaStatsPixmap(pPriv->usage_hint, FALSE);
+
+    if ( pPriv->is_dumb )
     {
         LS_DestroyDumbPixmap( pScreen, driverPriv );
     }
@@ -479,6 +1450,8 @@ static void * ms_exa_create_pixmap2(ScreenPtr pScreen,
         int width, int height, int depth, int usage_hint,
         int bitsPerPixel, int *new_fb_pitch)
 {
+    LS_ExaStatsPixmap(usage_hint, TRUE);
+
     if ( LS_IsDumbPixmap(usage_hint) )
     {
         return LS_CreateDumbPixmap( pScreen, width, height, depth,
@@ -519,13 +1492,14 @@ static Bool ms_exa_pixmap_is_offscreen(PixmapPtr pPixmap)
         return FALSE;
     }
 
-    if ( LS_IsDumbPixmap(priv->usage_hint) )
+    if ( priv->is_dumb )
     {
         return (priv->bo != NULL);
     }
     else
     {
-        return (priv->buf.pDat != NULL);
+        // lazy pixmaps get their memory in PrepareAccess
+        return (priv->buf.pDat != NULL) || (priv->buf.size != 0);
     }
 }
 
@@ -549,6 +1523,9 @@ Bool ms_exa_set_pixmap_bo(ScrnInfoPtr pScrn, PixmapPtr pPixmap,
         return FALSE;
     }
 
+    ms_exa_pixmap_wait(pPixmap);
+    LS_PixmapSyncEnd(priv);
+
     // destroy old backing memory, and update it with new.
     if (priv->fd > 0)
     {
@@ -557,7 +1534,14 @@ Bool ms_exa_set_pixmap_bo(ScrnInfoPtr pScrn, PixmapPtr pPixmap,
 
     if (priv->owned && priv->bo)
     {
-        dumb_bo_destroy(ms->drmmode.fd, priv->bo);
+        if (ms->bo_cache)
+        {
+            dumb_bo_cache_release(ms->bo_cache, priv->bo);
+        }
+        else
+        {
+            dumb_bo_destroy(ms->drmmode.fd, priv->bo);
+        }
     }
 
     ret = drmPrimeHandleToFD(ms->drmmode.fd, bo->handle, DRM_CLOEXEC, &prime_fd);
@@ -568,10 +1552,17 @@ Bool ms_exa_set_pixmap_bo(ScrnInfoPtr pScrn, PixmapPtr pPixmap,
         return FALSE;
     }
 
+    // whatever system memory the pixmap had is replaced as well
+    LS_FreeBuf(&priv->buf);
+    LS_MirrorFree(priv);
+
     priv->bo = bo;
     priv->fd = prime_fd;
     priv->pitch = bo->pitch;
     priv->owned = owned;
+    priv->is_dumb = TRUE;
+    priv->shared = TRUE;
+    priv->solid = FALSE;
 
     pPixmap->devPrivate.ptr = NULL;
     pPixmap->devKind = priv->pitch;
@@ -591,6 +1582,31 @@ struct dumb_bo * ms_exa_bo_from_pixmap(ScreenPtr screen, PixmapPtr pixmap)
         return NULL;
     }
 
+    // exporting needs a BO, a system memory pixmap is moved over,
+    // after writing out its colour if it is a solid one
+    if (!priv->is_dumb)
+    {
+        if (priv->solid && ms_exa_map_pixmap(pixmap))
+        {
+            ms_exa_finish_access(pixmap, 0);
+        }
+
+        ms_exa_pixmap_wait(pixmap);
+
+        if (!LS_MigrateToDumb(pixmap, priv))
+        {
+            return NULL;
+        }
+    }
+
+    // the bo is about to be used outside of EXA, and may be shared
+    // with clients, so it must not move or be recycled any more
+    ms_exa_pixmap_wait(pixmap);
+    LS_PixmapSyncEnd(priv);
+    priv->shared = TRUE;
+    dumb_bo_cache_disown(priv->bo);
+    LS_MirrorFree(priv);
+
     return priv->bo;
 }
 
@@ -601,6 +1617,14 @@ void ms_exa_exchange_buffers(PixmapPtr front, PixmapPtr back)
     struct ms_exa_pixmap_priv *back_priv = exaGetPixmapDriverPrivate(back);
     struct ms_exa_pixmap_priv tmp_priv;
 
+    ms_exa_pixmap_wait(front);
+    ms_exa_pixmap_wait(back);
+
+    // the privs are swapped by value, which must not take the links of
+    // open sync windows along
+    LS_PixmapSyncEnd(front_priv);
+    LS_PixmapSyncEnd(back_priv);
+
     tmp_priv = *front_priv;
     *front_priv = *back_priv;
     *back_priv = tmp_priv;
@@ -648,11 +1672,38 @@ int ms_exa_shareable_fd_from_pixmap(ScreenPtr screen,
     ScrnInfoPtr pScrn = xf86ScreenToScrn(screen);
     modesettingPtr ms = modesettingPTR(pScrn);
 
-    if ( (ms->exaDrvPtr == NULL) || (priv == NULL) || (priv->fd == 0))
+    if ( (ms->exaDrvPtr == NULL) || (priv == NULL) )
+    {
+        return -1;
+    }
+
+    // a pixmap moved to system memory gets its BO back to be exported
+    if (!priv->is_dumb)
+    {
+        if (priv->solid && ms_exa_map_pixmap(pixmap))
+        {
+            ms_exa_finish_access(pixmap, 0);
+        }
+
+        ms_exa_pixmap_wait(pixmap);
+
+        if (!LS_MigrateToDumb(pixmap, priv))
+        {
+            return -1;
+        }
+    }
+
+    if (priv->fd <= 0)
     {
         return -1;
     }
 
+    ms_exa_pixmap_wait(pixmap);
+    LS_PixmapSyncEnd(priv);
+    priv->shared = TRUE;
+    dumb_bo_cache_disown(priv->bo);
+    LS_MirrorFree(priv);
+
     return priv->fd;
 }
 
@@ -698,12 +1749,11 @@ static Bool ms_setup_exa(ScrnInfoPtr pScrn, ExaDriverPtr pExaDrv)
     pExaDrv->DoneComposite = ms_exa_composite_done;
 
 
-    /* TODO: Impl upload/download */
-    // pExaDrv->UploadToScreen = ms_exa_upload_to_screen;
-    // pExaDrv->DownloadFromScreen = ms_exa_download_from_screen;
+    pExaDrv->UploadToScreen = ms_exa_upload_to_screen;
+    pExaDrv->DownloadFromScreen = ms_exa_download_from_screen;
 
     pExaDrv->WaitMarker = ms_exa_wait_marker;
-    // pExaDrv->MarkSync = ms_exa_mark_sync;
+    pExaDrv->MarkSync = ms_exa_mark_sync;
     pExaDrv->DestroyPixmap = ms_exa_destroy_pixmap;
     pExaDrv->CreatePixmap2 = ms_exa_create_pixmap2;
     pExaDrv->PrepareAccess = ms_exa_prepare_access;
@@ -718,6 +1768,8 @@ static Bool ms_setup_exa(ScrnInfoPtr pScrn, ExaDriverPtr pExaDrv)
         pExaDrv->PrepareSolid = PrepareSolidFail;
         pExaDrv->CheckComposite = CheckCompositeFail;
         pExaDrv->PrepareComposite = PrepareCompositeFail;
+        pExaDrv->UploadToScreen = NULL;
+        pExaDrv->DownloadFromScreen = NULL;
     }
 
     return TRUE;
@@ -802,6 +1854,7 @@ Bool LS_InitExaLayer( ScreenPtr pScreen )
 {
     ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
     modesettingPtr ms = modesettingPTR(pScrn);
+    int mirror_budget;
 
     ExaDriverPtr pExaDrv = exaDriverAlloc();
 
@@ -826,6 +1879,30 @@ Bool LS_InitExaLayer( ScreenPtr pScreen )
 
         ms->exaDrvPtr = pExaDrv;
 
+        if (ms->drmmode.exa_acc_type != EXA_ACCEL_TYPE_FAKE)
+        {
+            LS_GlyphsInit(pScreen);
+        }
+
+        ms->bo_cache = dumb_bo_cache_create(ms->drmmode.fd);
+        ms->lazy_pixmaps = xf86ReturnOptValBool(ms->drmmode.Options,
+                                                OPTION_EXA_LAZY_PIXMAPS, TRUE);
+
+        mirror_budget = 32;
+        xf86GetOptValInteger(ms->drmmode.Options, OPTION_EXA_MIRROR_BUDGET,
+                             &mirror_budget);
+        ms->mirror_budget = (size_t) max(mirror_budget, 0) << 20;
+
+        LS_ThreadPoolInit(pScrn);
+        LS_ExaQueueInit(pScrn);
+        LS_ExaStatsInit(pScrn);
+
+        if (xf86ReturnOptValBool(ms->drmmode.Options,
+                                 OPTION_EXA_BENCHMARK, FALSE))
+        {
+            LS_RunBenchmarks(pScrn);
+        }
+
         return TRUE;
     }
 
@@ -851,6 +1928,8 @@ Bool LS_DestroyExaLayer( ScreenPtr pScreen )
             pScreen->devPrivate = NULL;
         }
 
+        LS_GlyphsFini(pScreen);
+
         exaDriverFini(pScreen);
 
         free(ms->exaDrvPtr);
@@ -858,6 +1937,29 @@ Bool LS_DestroyExaLayer( ScreenPtr pScreen )
         ms->exaDrvPtr = NULL;
 
         ms->drmmode.exa_enabled = FALSE;
+
+        LS_ExaStatsFini(pScrn);
+        LS_CompositeDumpStats(pScrn);
+        LS_DumpBufPoolStats(pScrn);
+        LS_DumpPixmapStats(pScrn);
+        LS_TrimBufPool(TRUE);
+
+        if (ms->bo_cache)
+        {
+            struct dumb_bo_cache_stats stats;
+
+            dumb_bo_cache_get_stats(ms->bo_cache, &stats);
+
+            xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                       "BO cache: %lu hits, %lu misses, %lu evictions\n",
+                       stats.hits, stats.misses, stats.evictions);
+
+            dumb_bo_cache_destroy(ms->bo_cache);
+            ms->bo_cache = NULL;
+        }
+
+        LS_ExaQueueFini(pScrn);
+        LS_ThreadPoolFini(pScrn);
     }
 
     xf86DrvMsg(pScrn->scrnIndex, X_INFO, "Shutdown EXA.\n");
@@ -56,6 +56,8 @@ struct dumb_bo * ms_exa_bo_from_pixmap(ScreenPtr screen, PixmapPtr pixmap);
 Bool ms_exa_prepare_access(PixmapPtr pPix, int index);
 void ms_exa_finish_access(PixmapPtr pPix, int index);
 
+Bool ms_exa_pixmap_is_solid(PixmapPtr pPixmap, Pixel *pFg);
+
 #ifdef DRI3
 Bool ms_exa_dri3_init(ScreenPtr screen);
 #endif
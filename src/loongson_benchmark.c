@@ -0,0 +1,598 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <xf86.h>
+
+#include "driver.h"
+#include "dumb_bo.h"
+#include "loongson_buffer.h"
+#include "loongson_simd.h"
+#include "loongson_benchmark.h"
+
+// every case runs at least MIN_RUNS times, then until TIME_NS is spent
+#define LS_BENCH_MIN_RUNS       5
+#define LS_BENCH_MAX_RUNS       256
+#define LS_BENCH_TIME_NS        (20 * 1000 * 1000ull)
+
+static const struct {
+    int width;
+    int height;
+} lsBenchSizes[] = {
+    { 16, 16 }, { 64, 64 }, { 256, 256 }, { 1024, 1024 },
+    // full screen operations
+    { 1920, 1080 }, { 3840, 2160 },
+};
+static const int lsBenchBpp[] = { 8, 16, 32 };
+
+struct ls_bench_surface {
+    uint8_t *bits;
+    int stride;
+
+    // where the memory came from, released by ls_bench_surface_free()
+    struct LoongsonBuf buf;
+    struct dumb_bo *bo;
+};
+
+struct ls_bench_ctx {
+    ScrnInfoPtr pScrn;
+    modesettingPtr ms;
+
+    int width;
+    int height;
+    int bpp;
+
+    struct ls_bench_surface dst;
+    struct ls_bench_surface src;
+};
+
+typedef void (*ls_bench_func)(struct ls_bench_ctx *pCtx);
+
+
+static uint64_t ls_bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+static int ls_bench_cmp(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+
+//
+// Run @func until the time budget of a case is spent and log the result.
+// @bytes is the memory traffic of one run, the sum of what is read and
+// written, used for the bandwidth figure.
+//
+static void ls_bench_run(struct ls_bench_ctx *pCtx, const char *kernel,
+                         const char *target, size_t bytes, ls_bench_func func)
+{
+    uint64_t samples[LS_BENCH_MAX_RUNS];
+    uint64_t total = 0;
+    uint64_t t0;
+    int n = 0;
+    int p99;
+
+    // warm the caches and fault the pages in
+    func(pCtx);
+
+    while ((n < LS_BENCH_MAX_RUNS) &&
+           ((n < LS_BENCH_MIN_RUNS) || (total < LS_BENCH_TIME_NS)))
+    {
+        t0 = ls_bench_now();
+        func(pCtx);
+        samples[n] = ls_bench_now() - t0;
+        total += samples[n++];
+    }
+
+    if (total == 0)
+    {
+        total = 1;
+    }
+
+    qsort(samples, n, sizeof(samples[0]), ls_bench_cmp);
+
+    p99 = min(n - 1, (n * 99) / 100);
+
+    xf86DrvMsg(pCtx->pScrn->scrnIndex, X_INFO,
+               "benchmark: {\"kernel\":\"%s\",\"impl\":\"%s\",\"target\":\"%s\","
+               "\"bpp\":%d,\"width\":%d,\"height\":%d,\"runs\":%d,"
+               "\"ops_per_s\":%.1f,\"gb_per_s\":%.3f,"
+               "\"p50_us\":%.2f,\"p99_us\":%.2f}\n",
+               kernel, lsSimd.name, target,
+               pCtx->bpp, pCtx->width, pCtx->height, n,
+               n * 1e9 / total, (double) bytes * n / total,
+               samples[n / 2] / 1e3, samples[p99] / 1e3);
+}
+
+
+static Bool ls_bench_surface_alloc(struct ls_bench_ctx *pCtx,
+                                   struct ls_bench_surface *pSurf,
+                                   Bool dumb, int bpp)
+{
+    memset(pSurf, 0, sizeof(*pSurf));
+
+    if (dumb)
+    {
+        pSurf->bo = dumb_bo_create(pCtx->ms->drmmode.fd,
+                                   pCtx->width, pCtx->height, bpp);
+        if (pSurf->bo == NULL)
+        {
+            return FALSE;
+        }
+
+        if (dumb_bo_map(pCtx->ms->drmmode.fd, pSurf->bo))
+        {
+            dumb_bo_destroy(pCtx->ms->drmmode.fd, pSurf->bo);
+            pSurf->bo = NULL;
+            return FALSE;
+        }
+
+        pSurf->bits = pSurf->bo->ptr;
+        pSurf->stride = pSurf->bo->pitch;
+    }
+    else
+    {
+        LS_AllocBuf(pCtx->width, pCtx->height, bpp, bpp, 0, &pSurf->buf);
+        if (pSurf->buf.pDat == NULL)
+        {
+            return FALSE;
+        }
+
+        pSurf->bits = pSurf->buf.pDat;
+        pSurf->stride = pSurf->buf.pitch;
+    }
+
+    // half transparent grey, so blending has real work to do
+    memset(pSurf->bits, 0x80, (size_t) pSurf->stride * pCtx->height);
+
+    return TRUE;
+}
+
+
+static void ls_bench_surface_free(struct ls_bench_ctx *pCtx,
+                                  struct ls_bench_surface *pSurf)
+{
+    if (pSurf->bo)
+    {
+        dumb_bo_destroy(pCtx->ms->drmmode.fd, pSurf->bo);
+    }
+
+    LS_FreeBuf(&pSurf->buf);
+    memset(pSurf, 0, sizeof(*pSurf));
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+
+static void ls_bench_fill(struct ls_bench_ctx *pCtx)
+{
+    lsSimd.FillRect(pCtx->dst.bits, pCtx->dst.stride, pCtx->bpp,
+                    0, 0, pCtx->width, pCtx->height, 0x5a5a5a5a);
+}
+
+static void ls_bench_copy(struct ls_bench_ctx *pCtx)
+{
+    LS_CopyRect(pCtx->src.bits, pCtx->src.stride,
+                pCtx->dst.bits, pCtx->dst.stride, pCtx->bpp,
+                0, 0, 0, 0, pCtx->width, pCtx->height, 1, 1);
+}
+
+static void ls_bench_upload(struct ls_bench_ctx *pCtx)
+{
+    int bytes = pCtx->width * pCtx->bpp / 8;
+    int y;
+
+    for (y = 0; y < pCtx->height; y++)
+    {
+        lsSimd.UploadRow(pCtx->dst.bits + y * pCtx->dst.stride,
+                         pCtx->src.bits + y * pCtx->src.stride, bytes);
+    }
+}
+
+static void ls_bench_download(struct ls_bench_ctx *pCtx)
+{
+    int bytes = pCtx->width * pCtx->bpp / 8;
+    int y;
+
+    for (y = 0; y < pCtx->height; y++)
+    {
+        lsSimd.DownloadRow(pCtx->dst.bits + y * pCtx->dst.stride,
+                           pCtx->src.bits + y * pCtx->src.stride, bytes);
+    }
+}
+
+//
+// Shadow flush cases, 32 bpp shadow to a front buffer of pCtx->bpp.
+// The fragmented variants copy every other tile of a 16x16 checkerboard,
+// like scattered damage does.
+//
+#define LS_BENCH_TILE   16
+
+static void ls_bench_shadow_row(struct ls_bench_ctx *pCtx, int x, int y,
+                                int w)
+{
+    uint8_t *d = pCtx->dst.bits + y * pCtx->dst.stride + x * pCtx->bpp / 8;
+    const uint8_t *s = pCtx->src.bits + y * pCtx->src.stride + x * 4;
+
+    if (pCtx->bpp == 24)
+    {
+        lsSimd.Pack24Row(d, s, w);
+    }
+    else
+    {
+        lsSimd.UploadRow(d, s, w * 4);
+    }
+}
+
+static void ls_bench_shadow_full(struct ls_bench_ctx *pCtx)
+{
+    int y;
+
+    for (y = 0; y < pCtx->height; y++)
+    {
+        ls_bench_shadow_row(pCtx, 0, y, pCtx->width);
+    }
+}
+
+static void ls_bench_shadow_tiles(struct ls_bench_ctx *pCtx)
+{
+    int x, y;
+
+    for (y = 0; y < pCtx->height; y++)
+    {
+        int first = ((y / LS_BENCH_TILE) & 1) * LS_BENCH_TILE;
+
+        for (x = first; x < pCtx->width; x += 2 * LS_BENCH_TILE)
+        {
+            ls_bench_shadow_row(pCtx, x, y,
+                                min(LS_BENCH_TILE, pCtx->width - x));
+        }
+    }
+}
+
+// a 1920x1080 shadow onto a portrait panel, pCtx->width is the panel's
+static void ls_bench_rotate_90(struct ls_bench_ctx *pCtx)
+{
+    const uint32_t *src = (const uint32_t *) pCtx->src.bits;
+
+    lsSimd.RotateRect32((uint32_t *) pCtx->dst.bits, pCtx->dst.stride,
+                        src + (pCtx->width - 1) * (pCtx->src.stride / 4),
+                        -(pCtx->src.stride / 4), 1,
+                        pCtx->width, pCtx->height);
+}
+
+static void ls_bench_rotate_0(struct ls_bench_ctx *pCtx)
+{
+    lsSimd.RotateRect32((uint32_t *) pCtx->dst.bits, pCtx->dst.stride,
+                        (const uint32_t *) pCtx->src.bits,
+                        1, pCtx->src.stride / 4,
+                        pCtx->width, pCtx->height);
+}
+
+static void ls_bench_over_8888(struct ls_bench_ctx *pCtx)
+{
+    lsSimd.CompositeOver8888((uint32_t *) pCtx->dst.bits, pCtx->dst.stride,
+                             (const uint32_t *) pCtx->src.bits,
+                             pCtx->src.stride, pCtx->width, pCtx->height);
+}
+
+static void ls_bench_over_n_8888(struct ls_bench_ctx *pCtx)
+{
+    lsSimd.CompositeOverN8888((uint32_t *) pCtx->dst.bits, pCtx->dst.stride,
+                              pCtx->src.bits, pCtx->src.stride,
+                              0x80402010, pCtx->width, pCtx->height);
+}
+
+static void ls_bench_add_8(struct ls_bench_ctx *pCtx)
+{
+    lsSimd.CompositeAdd8(pCtx->dst.bits, pCtx->dst.stride,
+                         pCtx->src.bits, pCtx->src.stride,
+                         pCtx->width, pCtx->height);
+}
+
+static void ls_bench_src_x888(struct ls_bench_ctx *pCtx)
+{
+    lsSimd.CompositeSrcX888((uint32_t *) pCtx->dst.bits, pCtx->dst.stride,
+                            (const uint32_t *) pCtx->src.bits,
+                            pCtx->src.stride, pCtx->width, pCtx->height);
+}
+
+static void ls_bench_alloc_buf(struct ls_bench_ctx *pCtx)
+{
+    struct LoongsonBuf buf;
+
+    LS_AllocBuf(pCtx->width, pCtx->height, pCtx->bpp, pCtx->bpp, 0, &buf);
+    LS_FreeBuf(&buf);
+}
+
+static void ls_bench_dumb_bo(struct ls_bench_ctx *pCtx)
+{
+    struct dumb_bo *bo = dumb_bo_create(pCtx->ms->drmmode.fd,
+                                        pCtx->width, pCtx->height, pCtx->bpp);
+
+    if (bo)
+    {
+        dumb_bo_destroy(pCtx->ms->drmmode.fd, bo);
+    }
+}
+
+static void ls_bench_dumb_bo_cache(struct ls_bench_ctx *pCtx)
+{
+    struct dumb_bo *bo = dumb_bo_cache_alloc(pCtx->ms->bo_cache,
+                                             pCtx->width, pCtx->height,
+                                             pCtx->bpp);
+
+    if (bo)
+    {
+        dumb_bo_cache_release(pCtx->ms->bo_cache, bo);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+
+//
+// One kernel reading @srcBpp pixels (none if 0) and writing @dstBpp
+// pixels, for every size, with the destination (or the source, with
+// @dumbSrc) placed in a dumb BO when @dumb is set.
+//
+static void ls_bench_sweep(struct ls_bench_ctx *pCtx, const char *kernel,
+                           ls_bench_func func, int srcBpp, int dstBpp,
+                           Bool dumb, Bool dumbSrc)
+{
+    const char *target = !dumb ? "system" : (srcBpp == 0) ? "dumb" :
+                         dumbSrc ? "dumb-to-system" : "system-to-dumb";
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(lsBenchSizes); i++)
+    {
+        size_t pixels;
+
+        pCtx->width = lsBenchSizes[i].width;
+        pCtx->height = lsBenchSizes[i].height;
+        pixels = (size_t) pCtx->width * pCtx->height;
+
+        if (!ls_bench_surface_alloc(pCtx, &pCtx->dst, dumb && !dumbSrc,
+                                    dstBpp))
+        {
+            continue;
+        }
+
+        if (srcBpp && !ls_bench_surface_alloc(pCtx, &pCtx->src,
+                                              dumb && dumbSrc, srcBpp))
+        {
+            ls_bench_surface_free(pCtx, &pCtx->dst);
+            continue;
+        }
+
+        pCtx->bpp = dstBpp;
+
+        ls_bench_run(pCtx, kernel, target,
+                     pixels * (srcBpp + dstBpp) / 8, func);
+
+        ls_bench_surface_free(pCtx, &pCtx->src);
+        ls_bench_surface_free(pCtx, &pCtx->dst);
+    }
+}
+
+
+//
+// FillRect into system memory and a dumb BO, first with the generic
+// kernel, which stores whole words like fbSolid() does and stands in for
+// the fbFill() path EXA Solid took before, then with the one picked for
+// this CPU.
+//
+static void ls_bench_fill_sweep(struct ls_bench_ctx *pCtx, int bpp)
+{
+    struct LoongsonSimdFuncs native = lsSimd;
+
+    LS_SimdSetupGeneric(&lsSimd);
+    ls_bench_sweep(pCtx, "FillRect", ls_bench_fill, 0, bpp, FALSE, FALSE);
+    ls_bench_sweep(pCtx, "FillRect", ls_bench_fill, 0, bpp, TRUE, FALSE);
+    lsSimd = native;
+
+    ls_bench_sweep(pCtx, "FillRect", ls_bench_fill, 0, bpp, FALSE, FALSE);
+    ls_bench_sweep(pCtx, "FillRect", ls_bench_fill, 0, bpp, TRUE, FALSE);
+}
+
+
+//
+// Full screen and fragmented shadow flushes to a dumb BO at 32 and 24
+// bpp, first with the generic kernels, which store whole words like
+// the shadow module's shadowUpdatePacked and shadowUpdate32to24, then
+// with the ones picked for this CPU.
+//
+static void ls_bench_shadow(struct ls_bench_ctx *pCtx)
+{
+    static const int bpp[] = { 32, 24 };
+    struct LoongsonSimdFuncs native = lsSimd;
+    unsigned int i, pass;
+
+    pCtx->width = 1920;
+    pCtx->height = 1080;
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        if (pass == 0)
+        {
+            LS_SimdSetupGeneric(&lsSimd);
+        }
+        else
+        {
+            lsSimd = native;
+        }
+
+        for (i = 0; i < ARRAY_SIZE(bpp); i++)
+        {
+            size_t pixels = (size_t) pCtx->width * pCtx->height;
+            const char *kernel = (bpp[i] == 24) ? "Pack24Row" : "UploadRow";
+            char name[32];
+
+            if (!ls_bench_surface_alloc(pCtx, &pCtx->dst, TRUE, bpp[i]))
+            {
+                continue;
+            }
+
+            if (!ls_bench_surface_alloc(pCtx, &pCtx->src, FALSE, 32))
+            {
+                ls_bench_surface_free(pCtx, &pCtx->dst);
+                continue;
+            }
+
+            pCtx->bpp = bpp[i];
+
+            snprintf(name, sizeof(name), "%s-shadow", kernel);
+            ls_bench_run(pCtx, name, "system-to-dumb",
+                         pixels * (32 + bpp[i]) / 8, ls_bench_shadow_full);
+
+            snprintf(name, sizeof(name), "%s-shadow-tiles", kernel);
+            ls_bench_run(pCtx, name, "system-to-dumb",
+                         pixels / 2 * (32 + bpp[i]) / 8,
+                         ls_bench_shadow_tiles);
+
+            ls_bench_surface_free(pCtx, &pCtx->src);
+            ls_bench_surface_free(pCtx, &pCtx->dst);
+        }
+    }
+}
+
+
+//
+// Rotated crtc updates against the unrotated copy of the same pixels,
+// both from system memory into a dumb BO.
+//
+static void ls_bench_rotate(struct ls_bench_ctx *pCtx)
+{
+    size_t bytes = (size_t) 1920 * 1080 * 8;
+
+    pCtx->bpp = 32;
+
+    pCtx->width = 1920;
+    pCtx->height = 1080;
+
+    if (ls_bench_surface_alloc(pCtx, &pCtx->src, FALSE, 32))
+    {
+        if (ls_bench_surface_alloc(pCtx, &pCtx->dst, TRUE, 32))
+        {
+            ls_bench_run(pCtx, "RotateRect32-0", "system-to-dumb", bytes,
+                         ls_bench_rotate_0);
+            ls_bench_surface_free(pCtx, &pCtx->dst);
+        }
+
+        // the source keeps its size, only the destination turns
+        pCtx->width = 1080;
+        pCtx->height = 1920;
+
+        if (ls_bench_surface_alloc(pCtx, &pCtx->dst, TRUE, 32))
+        {
+            ls_bench_run(pCtx, "RotateRect32-90", "system-to-dumb", bytes,
+                         ls_bench_rotate_90);
+            ls_bench_surface_free(pCtx, &pCtx->dst);
+        }
+
+        ls_bench_surface_free(pCtx, &pCtx->src);
+    }
+}
+
+
+void LS_RunBenchmarks(ScrnInfoPtr pScrn)
+{
+    struct ls_bench_ctx ctx;
+    unsigned int i, j;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.pScrn = pScrn;
+    ctx.ms = modesettingPTR(pScrn);
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+               "Running benchmarks with %s kernels, this takes a while\n",
+               lsSimd.name);
+
+    for (i = 0; i < ARRAY_SIZE(lsBenchBpp); i++)
+    {
+        int bpp = lsBenchBpp[i];
+
+        ls_bench_fill_sweep(&ctx, bpp);
+        ls_bench_sweep(&ctx, "CopyRect", ls_bench_copy, bpp, bpp, FALSE, FALSE);
+        ls_bench_sweep(&ctx, "CopyRect", ls_bench_copy, bpp, bpp, TRUE, FALSE);
+        ls_bench_sweep(&ctx, "CopyRect", ls_bench_copy, bpp, bpp, TRUE, TRUE);
+    }
+
+    ls_bench_sweep(&ctx, "UploadRow", ls_bench_upload, 32, 32, TRUE, FALSE);
+    ls_bench_sweep(&ctx, "DownloadRow", ls_bench_download, 32, 32, TRUE, TRUE);
+
+    ls_bench_shadow(&ctx);
+    ls_bench_rotate(&ctx);
+
+    ls_bench_sweep(&ctx, "CompositeOver8888", ls_bench_over_8888,
+                   32, 32, FALSE, FALSE);
+    ls_bench_sweep(&ctx, "CompositeOverN8888", ls_bench_over_n_8888,
+                   8, 32, FALSE, FALSE);
+    ls_bench_sweep(&ctx, "CompositeAdd8", ls_bench_add_8,
+                   8, 8, FALSE, FALSE);
+    ls_bench_sweep(&ctx, "CompositeSrcX888", ls_bench_src_x888,
+                   32, 32, FALSE, FALSE);
+    ls_bench_sweep(&ctx, "CompositeOver8888", ls_bench_over_8888,
+                   32, 32, TRUE, FALSE);
+
+    // allocation cost, no memory traffic to speak of
+    for (j = 0; j < ARRAY_SIZE(lsBenchSizes); j++)
+    {
+        ctx.width = lsBenchSizes[j].width;
+        ctx.height = lsBenchSizes[j].height;
+        ctx.bpp = 32;
+
+        ls_bench_run(&ctx, "LS_AllocBuf", "system", 0, ls_bench_alloc_buf);
+        ls_bench_run(&ctx, "dumb_bo_create", "dumb", 0, ls_bench_dumb_bo);
+
+        if (ctx.ms->bo_cache)
+        {
+            ls_bench_run(&ctx, "dumb_bo_cache_alloc", "dumb", 0,
+                         ls_bench_dumb_bo_cache);
+        }
+    }
+
+    LS_TrimBufPool(TRUE);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+
+#ifndef LOONGSON_BENCHMARK_H_
+#define LOONGSON_BENCHMARK_H_
+
+#include <xf86str.h>
+
+//
+// Time the pixel kernels, the pixmap memory allocator and the dumb BO
+// paths on the running machine, sweeping sizes, bpp and targets (cached
+// system memory and write-combined dumb BOs). One JSON object per case
+// is written to the log, prefixed with "benchmark: ", so runs on
+// different CPUs and kernels can be compared with a script.
+//
+// Run at EXA init when Option "ExaBenchmark" is set, takes a few seconds.
+//
+void LS_RunBenchmarks(ScrnInfoPtr pScrn);
+
+#endif
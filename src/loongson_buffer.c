@@ -26,41 +26,286 @@
 
 #include "config.h"
 
+#include <stdlib.h>
+#include <sys/mman.h>
+
 #include "driver.h"
 #include "loongson_buffer.h"
 
 
-void LS_AllocBuf(int width, int height,
+//
+// Pixmap memory is recycled through size classes instead of going to
+// malloc/free for every scratch pixmap. Classes are four steps per power
+// of two, from 64 bytes to 32 MiB, everything bigger is mapped directly.
+// Free blocks are kept on per-class lists; the ones that sat unused for
+// a whole trim interval are given back to the system at idle time.
+//
+#define LS_BUF_ALIGN            64
+#define LS_BUF_MIN_SHIFT        6
+#define LS_BUF_MAX_SHIFT        25
+#define LS_BUF_STEPS            4
+#define LS_BUF_CLASSES          ((LS_BUF_MAX_SHIFT - LS_BUF_MIN_SHIFT) * LS_BUF_STEPS + 1)
+
+// classes at least this big are backed by anonymous mappings
+#define LS_BUF_MMAP_THRESHOLD   (256 * 1024)
+
+// upper bound of free memory kept around
+#define LS_BUF_MAX_HELD         (64 << 20)
+
+#define LS_BUF_TRIM_INTERVAL    5000
+
+struct LoongsonBufFree {
+    struct LoongsonBufFree *next;
+};
+
+struct LoongsonBufClass {
+    struct LoongsonBufFree *free_list;
+    unsigned int nfree;
+    // fewest free blocks seen since the last trim
+    unsigned int low_water;
+};
+
+struct LoongsonBufPool {
+    struct LoongsonBufClass classes[LS_BUF_CLASSES];
+    unsigned long hits;
+    unsigned long misses;
+    size_t bytes_held;
+    CARD32 last_trim;
+};
+
+static struct LoongsonBufPool lsBufPool;
+
+
+static size_t ls_buf_class_size(int cls)
+{
+    size_t p = (size_t) 1 << (LS_BUF_MIN_SHIFT + cls / LS_BUF_STEPS);
+
+    return p + (p / LS_BUF_STEPS) * (cls % LS_BUF_STEPS);
+}
+
+// smallest class holding @size bytes, -1 if it is too big to be pooled
+static int ls_buf_class(size_t size)
+{
+    size_t p, step;
+    int shift;
+    int cls;
+
+    if (size <= ((size_t) 1 << LS_BUF_MIN_SHIFT))
+    {
+        return 0;
+    }
+
+    shift = (int) (sizeof(unsigned long) * 8 - 1) - __builtin_clzl(size - 1);
+    p = (size_t) 1 << shift;
+    step = p / LS_BUF_STEPS;
+
+    cls = (shift - LS_BUF_MIN_SHIFT) * LS_BUF_STEPS + (int) ((size - p + step - 1) / step);
+
+    return (cls < LS_BUF_CLASSES) ? cls : -1;
+}
+
+
+static void * ls_buf_map(size_t size)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return (ptr == MAP_FAILED) ? NULL : ptr;
+}
+
+static void * ls_buf_get(size_t size)
+{
+    void *ptr;
+
+    if (size >= LS_BUF_MMAP_THRESHOLD)
+    {
+        return ls_buf_map(size);
+    }
+
+    if (posix_memalign(&ptr, LS_BUF_ALIGN, size))
+    {
+        return NULL;
+    }
+
+    return ptr;
+}
+
+static void ls_buf_put(void *ptr, size_t size)
+{
+    if (size >= LS_BUF_MMAP_THRESHOLD)
+    {
+        munmap(ptr, size);
+    }
+    else
+    {
+        free(ptr);
+    }
+}
+
+static void ls_buf_release(struct LoongsonBufClass *pClass, int cls,
+                           unsigned int count)
+{
+    size_t size = ls_buf_class_size(cls);
+
+    while (count-- && pClass->free_list)
+    {
+        struct LoongsonBufFree *pFree = pClass->free_list;
+
+        pClass->free_list = pFree->next;
+        pClass->nfree--;
+        lsBufPool.bytes_held -= size;
+
+        ls_buf_put(pFree, size);
+    }
+}
+
+
+static void * ls_buf_alloc(size_t size)
+{
+    struct LoongsonBufPool *pPool = &lsBufPool;
+    struct LoongsonBufClass *pClass;
+    struct LoongsonBufFree *pFree;
+    int cls = ls_buf_class(size);
+
+    if (cls < 0)
+    {
+        return ls_buf_map((size + 4095) & ~(size_t) 4095);
+    }
+
+    pClass = &pPool->classes[cls];
+    pFree = pClass->free_list;
+
+    if (pFree == NULL)
+    {
+        pPool->misses++;
+        return ls_buf_get(ls_buf_class_size(cls));
+    }
+
+    pPool->hits++;
+    pPool->bytes_held -= ls_buf_class_size(cls);
+
+    pClass->free_list = pFree->next;
+    pClass->nfree--;
+    if (pClass->nfree < pClass->low_water)
+    {
+        pClass->low_water = pClass->nfree;
+    }
+
+    return pFree;
+}
+
+static void ls_buf_free(void *ptr, size_t size)
+{
+    struct LoongsonBufPool *pPool = &lsBufPool;
+    struct LoongsonBufClass *pClass;
+    struct LoongsonBufFree *pFree = ptr;
+    int cls = ls_buf_class(size);
+    size_t class_size;
+
+    if (cls < 0)
+    {
+        munmap(ptr, (size + 4095) & ~(size_t) 4095);
+        return;
+    }
+
+    class_size = ls_buf_class_size(cls);
+
+    if (pPool->bytes_held + class_size > LS_BUF_MAX_HELD)
+    {
+        ls_buf_put(ptr, class_size);
+        return;
+    }
+
+    pClass = &pPool->classes[cls];
+    pFree->next = pClass->free_list;
+    pClass->free_list = pFree;
+    pClass->nfree++;
+    pPool->bytes_held += class_size;
+}
+
+
+void LS_ReserveBuf(int width, int height,
         int depth, int bpp, int usage_hint, struct LoongsonBuf * pBuf)
 {
     //
     // depth and bpp is useless
     //
     unsigned int pitch = ((width * bpp + FB_MASK) >> FB_SHIFT) * sizeof(FbBits);
-    unsigned int size;
     // suijingfeng: make sure this align value is reasonable
     pitch = (pitch + 15) & ~(15);
-    size = pitch * height;
 
-    pBuf->pDat = malloc(size);
+    pBuf->pDat = NULL;
     pBuf->pitch = pitch;
-    pBuf->size = size;
+    pBuf->size = pitch * height;
     pBuf->width = width;
     pBuf->height = height;
 }
 
 
+Bool LS_CommitBuf(struct LoongsonBuf * pBuf)
+{
+    if (pBuf->pDat == NULL)
+    {
+        pBuf->pDat = ls_buf_alloc(pBuf->size);
+    }
+
+    return pBuf->pDat != NULL;
+}
+
+
+void LS_AllocBuf(int width, int height,
+        int depth, int bpp, int usage_hint, struct LoongsonBuf * pBuf)
+{
+    LS_ReserveBuf(width, height, depth, bpp, usage_hint, pBuf);
+    LS_CommitBuf(pBuf);
+}
+
+
 void LS_FreeBuf(struct LoongsonBuf * pBuf)
 {
     //	NULL_DBG_MSG("FreeBuf pDat:%p", pBuf->pDat);
     if ( pBuf->pDat != NULL)
     {
-        free( pBuf->pDat );
+        ls_buf_free( pBuf->pDat, pBuf->size );
+    }
+
+    // a lazy buffer may have its geometry without any memory
+    pBuf->pDat = NULL;
+    pBuf->pitch = 0;
+    pBuf->size = 0;
+    pBuf->width = 0;
+    pBuf->height = 0;
+}
+
+
+void LS_TrimBufPool(Bool all)
+{
+    struct LoongsonBufPool *pPool = &lsBufPool;
+    CARD32 now = GetTimeInMillis();
+    int i;
+
+    if (!all && ((CARD32) (now - pPool->last_trim) < LS_BUF_TRIM_INTERVAL))
+    {
+        return;
+    }
+
+    pPool->last_trim = now;
+
+    for (i = 0; i < LS_BUF_CLASSES; i++)
+    {
+        struct LoongsonBufClass *pClass = &pPool->classes[i];
 
-        pBuf->pDat = NULL;
-        pBuf->pitch = 0;
-        pBuf->size = 0;
-        pBuf->width = 0;
-        pBuf->height = 0;
+        ls_buf_release(pClass, i, all ? pClass->nfree : pClass->low_water);
+
+        pClass->low_water = pClass->nfree;
     }
 }
+
+
+void LS_DumpBufPoolStats(ScrnInfoPtr pScrn)
+{
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+               "Pixmap pool: %lu hits, %lu misses, %lu bytes held\n",
+               lsBufPool.hits, lsBufPool.misses,
+               (unsigned long) lsBufPool.bytes_held);
+}
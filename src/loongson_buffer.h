@@ -40,7 +40,18 @@ struct LoongsonBuf {
 void LS_AllocBuf(int width, int height,
         int depth, int bpp, int usage_hint, struct LoongsonBuf * pBuf);
 
+// fill in the geometry only, the memory is allocated by LS_CommitBuf()
+void LS_ReserveBuf(int width, int height,
+        int depth, int bpp, int usage_hint, struct LoongsonBuf * pBuf);
+
+Bool LS_CommitBuf(struct LoongsonBuf * pBuf);
+
 
 void LS_FreeBuf(struct LoongsonBuf * pBuf);
 
+// give unused pooled memory back, rate limited unless @all is set
+void LS_TrimBufPool(Bool all);
+
+void LS_DumpBufPoolStats(ScrnInfoPtr pScrn);
+
 #endif
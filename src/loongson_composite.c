@@ -0,0 +1,385 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <xf86.h>
+#include <picturestr.h>
+
+#include "loongson_composite.h"
+#include "loongson_simd.h"
+#include "loongson_thread_pool.h"
+
+
+static inline uint8_t * ls_pixel_addr(PixmapPtr pPix, int x, int y)
+{
+    return (uint8_t *) pPix->devPrivate.ptr + y * pPix->devKind +
+           x * (pPix->drawable.bitsPerPixel >> 3);
+}
+
+
+//
+// The kernels below only see the raw pointers captured by
+// LS_CompositeSetup(), they may run on another thread after the
+// pixmaps have been unmapped by the server.
+//
+
+static void ls_composite_over_8888_8888(
+        const struct LoongsonCompositeArgs *pArgs, int y, int h)
+{
+    lsSimd.CompositeOver8888(
+            (uint32_t *) (pArgs->dst + y * pArgs->dst_stride), pArgs->dst_stride,
+            (const uint32_t *) (pArgs->src + y * pArgs->src_stride), pArgs->src_stride,
+            pArgs->width, h);
+}
+
+static void ls_composite_over_n_8_8888(
+        const struct LoongsonCompositeArgs *pArgs, int y, int h)
+{
+    // read at run time, the 1x1 source may be filled by an earlier job
+    uint32_t src = *(const uint32_t *) pArgs->src;
+
+    // x8r8g8b8 sources have undefined alpha bits, they are opaque
+    if (pArgs->src_opaque)
+    {
+        src |= 0xff000000;
+    }
+
+    if (src == 0)
+    {
+        return;
+    }
+
+    lsSimd.CompositeOverN8888(
+            (uint32_t *) (pArgs->dst + y * pArgs->dst_stride), pArgs->dst_stride,
+            pArgs->mask + y * pArgs->mask_stride, pArgs->mask_stride,
+            src, pArgs->width, h);
+}
+
+static void ls_composite_add_8_8(
+        const struct LoongsonCompositeArgs *pArgs, int y, int h)
+{
+    lsSimd.CompositeAdd8(pArgs->dst + y * pArgs->dst_stride, pArgs->dst_stride,
+                         pArgs->src + y * pArgs->src_stride, pArgs->src_stride,
+                         pArgs->width, h);
+}
+
+static void ls_composite_src_x888_8888(
+        const struct LoongsonCompositeArgs *pArgs, int y, int h)
+{
+    lsSimd.CompositeSrcX888(
+            (uint32_t *) (pArgs->dst + y * pArgs->dst_stride), pArgs->dst_stride,
+            (const uint32_t *) (pArgs->src + y * pArgs->src_stride), pArgs->src_stride,
+            pArgs->width, h);
+}
+
+static void ls_composite_copy(
+        const struct LoongsonCompositeArgs *pArgs, int y, int h)
+{
+    LS_CopyRect(pArgs->src, pArgs->src_stride,
+                pArgs->dst, pArgs->dst_stride, pArgs->bpp,
+                0, y, 0, y, pArgs->width, h, pArgs->xdir, pArgs->ydir);
+}
+
+
+static struct LoongsonCompositePath composite_paths[] = {
+    { "over_8888_8888", PictOpOver, PICT_a8r8g8b8, 0, PICT_a8r8g8b8,
+      0, ls_composite_over_8888_8888, 0 },
+    { "over_8888_x888", PictOpOver, PICT_a8r8g8b8, 0, PICT_x8r8g8b8,
+      0, ls_composite_over_8888_8888, 0 },
+    { "over_8888_8888_bgr", PictOpOver, PICT_a8b8g8r8, 0, PICT_a8b8g8r8,
+      0, ls_composite_over_8888_8888, 0 },
+    { "over_8888_x888_bgr", PictOpOver, PICT_a8b8g8r8, 0, PICT_x8b8g8r8,
+      0, ls_composite_over_8888_8888, 0 },
+    { "over_x888_x888", PictOpOver, PICT_x8r8g8b8, 0, PICT_x8r8g8b8,
+      0, ls_composite_copy, 0 },
+
+    { "over_n_8_8888", PictOpOver, PICT_a8r8g8b8, PICT_a8, PICT_a8r8g8b8,
+      LS_COMPOSITE_SRC_SOLID, ls_composite_over_n_8_8888, 0 },
+    { "over_n_8_x888", PictOpOver, PICT_a8r8g8b8, PICT_a8, PICT_x8r8g8b8,
+      LS_COMPOSITE_SRC_SOLID, ls_composite_over_n_8_8888, 0 },
+    { "over_x_8_x888", PictOpOver, PICT_x8r8g8b8, PICT_a8, PICT_x8r8g8b8,
+      LS_COMPOSITE_SRC_SOLID, ls_composite_over_n_8_8888, 0 },
+
+    { "add_8_8", PictOpAdd, PICT_a8, 0, PICT_a8,
+      0, ls_composite_add_8_8, 0 },
+
+    { "src_8888_8888", PictOpSrc, PICT_a8r8g8b8, 0, PICT_a8r8g8b8,
+      0, ls_composite_copy, 0 },
+    { "src_8888_x888", PictOpSrc, PICT_a8r8g8b8, 0, PICT_x8r8g8b8,
+      0, ls_composite_copy, 0 },
+    { "src_x888_x888", PictOpSrc, PICT_x8r8g8b8, 0, PICT_x8r8g8b8,
+      0, ls_composite_copy, 0 },
+    { "src_x888_8888", PictOpSrc, PICT_x8r8g8b8, 0, PICT_a8r8g8b8,
+      0, ls_composite_src_x888_8888, 0 },
+    { "src_8888_8888_bgr", PictOpSrc, PICT_a8b8g8r8, 0, PICT_a8b8g8r8,
+      0, ls_composite_copy, 0 },
+    { "src_0565_0565", PictOpSrc, PICT_r5g6b5, 0, PICT_r5g6b5,
+      0, ls_composite_copy, 0 },
+    { "src_8_8", PictOpSrc, PICT_a8, 0, PICT_a8,
+      0, ls_composite_copy, 0 },
+};
+
+static unsigned long composite_fallbacks;
+
+
+static Bool ls_picture_is_plain(PicturePtr pPict)
+{
+    return (pPict->pDrawable != NULL) &&
+           (pPict->transform == NULL) &&
+           (pPict->alphaMap == NULL);
+}
+
+static Bool ls_picture_is_solid(PicturePtr pPict)
+{
+    return pPict->repeat &&
+           (pPict->repeatType == RepeatNormal) &&
+           (pPict->pDrawable->width == 1) &&
+           (pPict->pDrawable->height == 1);
+}
+
+
+struct LoongsonCompositePath * LS_CompositeLookup(int op,
+        PicturePtr pSrcPicture, PicturePtr pMaskPicture,
+        PicturePtr pDstPicture)
+{
+    Bool src_solid;
+    unsigned int i;
+
+    if (!ls_picture_is_plain(pSrcPicture) || !ls_picture_is_plain(pDstPicture))
+    {
+        return NULL;
+    }
+
+    if (pMaskPicture)
+    {
+        if (!ls_picture_is_plain(pMaskPicture) ||
+            pMaskPicture->repeat || pMaskPicture->componentAlpha)
+        {
+            return NULL;
+        }
+    }
+
+    src_solid = ls_picture_is_solid(pSrcPicture);
+
+    // a repeating source other than a solid colour needs tiling
+    if (pSrcPicture->repeat && !src_solid)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(composite_paths); i++)
+    {
+        struct LoongsonCompositePath *pPath = &composite_paths[i];
+
+        if ((pPath->op != op) ||
+            (pPath->src_format != pSrcPicture->format) ||
+            (pPath->dst_format != pDstPicture->format))
+        {
+            continue;
+        }
+
+        if (pPath->mask_format)
+        {
+            if (!pMaskPicture || (pPath->mask_format != pMaskPicture->format))
+            {
+                continue;
+            }
+        }
+        else if (pMaskPicture)
+        {
+            continue;
+        }
+
+        if (!!(pPath->flags & LS_COMPOSITE_SRC_SOLID) != src_solid)
+        {
+            continue;
+        }
+
+        return pPath;
+    }
+
+    return NULL;
+}
+
+
+void LS_CompositeSetup(struct LoongsonCompositePath *pPath,
+        PixmapPtr pSrc, PixmapPtr pMask, PixmapPtr pDst,
+        int srcX, int srcY, int maskX, int maskY,
+        int dstX, int dstY, int width, int height,
+        struct LoongsonCompositeArgs *pArgs)
+{
+    pPath->hits++;
+
+    pArgs->func = pPath->func;
+    pArgs->bpp = pDst->drawable.bitsPerPixel;
+    pArgs->width = width;
+    pArgs->height = height;
+    pArgs->xdir = 1;
+    pArgs->ydir = 1;
+    pArgs->serial = FALSE;
+
+    pArgs->dst = ls_pixel_addr(pDst, dstX, dstY);
+    pArgs->dst_stride = pDst->devKind;
+
+    if (pPath->flags & LS_COMPOSITE_SRC_SOLID)
+    {
+        pArgs->src = pSrc->devPrivate.ptr;
+        pArgs->src_opaque = (pSrc->drawable.depth == 24);
+    }
+    else
+    {
+        pArgs->src = ls_pixel_addr(pSrc, srcX, srcY);
+        pArgs->src_opaque = FALSE;
+    }
+    pArgs->src_stride = pSrc->devKind;
+
+    if (pMask)
+    {
+        pArgs->mask = ls_pixel_addr(pMask, maskX, maskY);
+        pArgs->mask_stride = pMask->devKind;
+    }
+    else
+    {
+        pArgs->mask = NULL;
+        pArgs->mask_stride = 0;
+    }
+
+    // reading and writing the same pixmap has to stay in row order
+    if ((pSrc == pDst) || (pMask == pDst))
+    {
+        pArgs->xdir = (dstX > srcX) ? -1 : 1;
+        pArgs->ydir = (dstY > srcY) ? -1 : 1;
+        pArgs->serial = TRUE;
+    }
+}
+
+
+static Bool ls_rect_in_pixmap(PixmapPtr pPix, int x, int y, int w, int h)
+{
+    return (x >= 0) && (y >= 0) &&
+           (x + w <= pPix->drawable.width) &&
+           (y + h <= pPix->drawable.height);
+}
+
+
+Bool LS_CompositeInBounds(const struct LoongsonCompositePath *pPath,
+        PixmapPtr pSrc, PixmapPtr pMask,
+        int srcX, int srcY, int maskX, int maskY, int width, int height)
+{
+    // a solid source repeats, every position reads its one pixel
+    if (!(pPath->flags & LS_COMPOSITE_SRC_SOLID) &&
+        !ls_rect_in_pixmap(pSrc, srcX, srcY, width, height))
+    {
+        return FALSE;
+    }
+
+    if (pMask && !ls_rect_in_pixmap(pMask, maskX, maskY, width, height))
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+static void ls_composite_band(void *data, int y, int h)
+{
+    const struct LoongsonCompositeArgs *pArgs = data;
+
+    pArgs->func(pArgs, y, h);
+}
+
+
+void LS_CompositeExec(struct LoongsonCompositeArgs *pArgs)
+{
+    int pixels = pArgs->width * pArgs->height;
+
+    if (pArgs->serial)
+    {
+        pixels = 0;
+    }
+
+    LS_RunBands(ls_composite_band, pArgs, pArgs->height, pixels);
+}
+
+
+Bool LS_CompositeSolidFill(const struct LoongsonCompositePath *pPath,
+                           uint32_t src, uint32_t *fill)
+{
+    if (pPath->mask_format)
+    {
+        return FALSE;
+    }
+
+    if (pPath->func == ls_composite_copy)
+    {
+        *fill = src;
+        return TRUE;
+    }
+
+    if (pPath->func == ls_composite_src_x888_8888)
+    {
+        *fill = src | 0xff000000;
+        return TRUE;
+    }
+
+    // an opaque source hides the destination
+    if ((pPath->func == ls_composite_over_8888_8888) && ((src >> 24) == 0xff))
+    {
+        *fill = src;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+void LS_CompositeCountFallback(void)
+{
+    composite_fallbacks++;
+}
+
+
+void LS_CompositeDumpStats(ScrnInfoPtr pScrn)
+{
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(composite_paths); i++)
+    {
+        if (composite_paths[i].hits)
+        {
+            xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                    "Composite fast path %s: %lu hits\n",
+                    composite_paths[i].name, composite_paths[i].hits);
+        }
+    }
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+            "Composite fallbacks to fb: %lu\n", composite_fallbacks);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifndef LOONGSON_COMPOSITE_H_
+#define LOONGSON_COMPOSITE_H_
+
+#include <xf86.h>
+#include <picturestr.h>
+
+/* the source is a 1x1 repeating picture, i.e. a solid colour */
+#define LS_COMPOSITE_SRC_SOLID    (1 << 0)
+
+struct LoongsonCompositeArgs;
+
+typedef void (*LS_CompositeFunc)(const struct LoongsonCompositeArgs *pArgs,
+        int y, int h);
+
+//
+// One rectangle of a matched composite, with the pixel pointers already
+// pointing at its first pixel. Filled from mapped pixmaps by
+// LS_CompositeSetup(), it doesn't reference the pixmaps themselves.
+//
+struct LoongsonCompositeArgs {
+    LS_CompositeFunc func;
+    const uint8_t *src;
+    const uint8_t *mask;
+    uint8_t *dst;
+    int src_stride;
+    int mask_stride;
+    int dst_stride;
+    int bpp;
+    int width;
+    int height;
+    int xdir;
+    int ydir;
+    Bool src_opaque;
+    Bool serial;
+};
+
+//
+// One Render fast path, matched on (op, src, mask, dst, repeat).
+// mask_format is 0 for paths without a mask.
+//
+struct LoongsonCompositePath {
+    const char *name;
+    CARD8 op;
+    CARD32 src_format;
+    CARD32 mask_format;
+    CARD32 dst_format;
+    unsigned int flags;
+    LS_CompositeFunc func;
+    unsigned long hits;
+};
+
+struct LoongsonCompositePath * LS_CompositeLookup(int op,
+        PicturePtr pSrcPicture, PicturePtr pMaskPicture,
+        PicturePtr pDstPicture);
+
+void LS_CompositeSetup(struct LoongsonCompositePath *pPath,
+        PixmapPtr pSrc, PixmapPtr pMask, PixmapPtr pDst,
+        int srcX, int srcY, int maskX, int maskY,
+        int dstX, int dstY, int width, int height,
+        struct LoongsonCompositeArgs *pArgs);
+
+//
+// Whether the source and mask rectangles of one composite lie within
+// their pixmaps. Nothing clips them to it, and outside a non-repeating
+// picture is transparent, which only fbComposite gets right.
+//
+Bool LS_CompositeInBounds(const struct LoongsonCompositePath *pPath,
+        PixmapPtr pSrc, PixmapPtr pMask,
+        int srcX, int srcY, int maskX, int maskY, int width, int height);
+
+void LS_CompositeExec(struct LoongsonCompositeArgs *pArgs);
+
+//
+// With a source of a single colour @src and no mask, some paths come
+// down to storing one pixel value: return TRUE and that value in @fill.
+//
+Bool LS_CompositeSolidFill(const struct LoongsonCompositePath *pPath,
+                           uint32_t src, uint32_t *fill);
+
+void LS_CompositeCountFallback(void);
+
+void LS_CompositeDumpStats(ScrnInfoPtr pScrn);
+
+#endif
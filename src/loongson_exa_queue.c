@@ -0,0 +1,279 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xf86.h>
+
+#include "driver.h"
+#include "loongson_options.h"
+#include "loongson_exa_queue.h"
+
+// jobs queued before the submitter has to wait for the worker
+#define LS_QUEUE_DEPTH    64
+
+struct LoongsonExaJob {
+    struct LoongsonExaJob *next;
+    LS_ExaJobFunc func;
+    uint64_t seq;
+    uint64_t payload[];
+};
+
+struct LoongsonExaQueue {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t retire;
+
+    pthread_t thread;
+    int refcnt;
+    Bool running;
+    Bool quit;
+
+    struct LoongsonExaJob *head;
+    struct LoongsonExaJob *tail;
+    int nJobs;
+
+    uint64_t submitted;
+    uint64_t retired;
+};
+
+static struct LoongsonExaQueue lsQueue = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .retire = PTHREAD_COND_INITIALIZER,
+};
+
+
+static void * ls_queue_worker(void *arg)
+{
+    struct LoongsonExaQueue *pQueue = arg;
+
+    pthread_mutex_lock(&pQueue->lock);
+
+    for (;;)
+    {
+        struct LoongsonExaJob *pJob = pQueue->head;
+
+        if (pJob == NULL)
+        {
+            if (pQueue->quit)
+            {
+                break;
+            }
+
+            pthread_cond_wait(&pQueue->work, &pQueue->lock);
+            continue;
+        }
+
+        pQueue->head = pJob->next;
+        if (pQueue->head == NULL)
+        {
+            pQueue->tail = NULL;
+        }
+
+        pthread_mutex_unlock(&pQueue->lock);
+
+        pJob->func(pJob->payload);
+
+        pthread_mutex_lock(&pQueue->lock);
+
+        pQueue->retired = pJob->seq;
+        pQueue->nJobs--;
+        pthread_cond_broadcast(&pQueue->retire);
+
+        free(pJob);
+    }
+
+    pthread_mutex_unlock(&pQueue->lock);
+
+    return NULL;
+}
+
+
+Bool LS_ExaQueueInit(ScrnInfoPtr pScrn)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+    struct LoongsonExaQueue *pQueue = &lsQueue;
+    sigset_t blocked, saved;
+    int ret;
+
+    if (pQueue->refcnt++)
+    {
+        return TRUE;
+    }
+
+    if (!xf86ReturnOptValBool(ms->drmmode.Options, OPTION_EXA_ASYNC, FALSE))
+    {
+        return TRUE;
+    }
+
+    pQueue->quit = FALSE;
+
+    sigfillset(&blocked);
+    pthread_sigmask(SIG_BLOCK, &blocked, &saved);
+    ret = pthread_create(&pQueue->thread, NULL, ls_queue_worker, pQueue);
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    if (ret)
+    {
+        xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                   "Failed to start the EXA thread, running synchronously.\n");
+        return TRUE;
+    }
+
+    pQueue->running = TRUE;
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO, "Asynchronous EXA enabled.\n");
+
+    return TRUE;
+}
+
+
+void LS_ExaQueueFini(ScrnInfoPtr pScrn)
+{
+    struct LoongsonExaQueue *pQueue = &lsQueue;
+
+    if ((pQueue->refcnt == 0) || --pQueue->refcnt)
+    {
+        return;
+    }
+
+    if (!pQueue->running)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pQueue->lock);
+    pQueue->quit = TRUE;
+    pthread_cond_signal(&pQueue->work);
+    pthread_mutex_unlock(&pQueue->lock);
+
+    pthread_join(pQueue->thread, NULL);
+
+    pQueue->running = FALSE;
+}
+
+
+uint64_t LS_ExaQueueSubmit(LS_ExaJobFunc func, const void *payload, size_t size)
+{
+    struct LoongsonExaQueue *pQueue = &lsQueue;
+    struct LoongsonExaJob *pJob;
+    uint64_t seq;
+
+    if (!pQueue->running)
+    {
+        func((void *) payload);
+        return 0;
+    }
+
+    pJob = malloc(sizeof(struct LoongsonExaJob) + size);
+    if (pJob == NULL)
+    {
+        // keep the ordering, then run it here
+        LS_ExaQueueDrain();
+        func((void *) payload);
+        return 0;
+    }
+
+    pJob->next = NULL;
+    pJob->func = func;
+    memcpy(pJob->payload, payload, size);
+
+    pthread_mutex_lock(&pQueue->lock);
+
+    while (pQueue->nJobs >= LS_QUEUE_DEPTH)
+    {
+        pthread_cond_wait(&pQueue->retire, &pQueue->lock);
+    }
+
+    seq = ++pQueue->submitted;
+    pJob->seq = seq;
+
+    if (pQueue->tail)
+    {
+        pQueue->tail->next = pJob;
+    }
+    else
+    {
+        pQueue->head = pJob;
+    }
+
+    pQueue->tail = pJob;
+    pQueue->nJobs++;
+
+    pthread_cond_signal(&pQueue->work);
+    pthread_mutex_unlock(&pQueue->lock);
+
+    return seq;
+}
+
+
+void LS_ExaQueueWait(uint64_t seq)
+{
+    struct LoongsonExaQueue *pQueue = &lsQueue;
+
+    if (!pQueue->running || (seq == 0))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pQueue->lock);
+
+    while (pQueue->retired < seq)
+    {
+        pthread_cond_wait(&pQueue->retire, &pQueue->lock);
+    }
+
+    pthread_mutex_unlock(&pQueue->lock);
+}
+
+
+void LS_ExaQueueDrain(void)
+{
+    LS_ExaQueueWait(lsQueue.submitted);
+}
+
+
+int LS_ExaQueueMarker(void)
+{
+    return (int) (uint32_t) lsQueue.submitted;
+}
+
+
+void LS_ExaQueueWaitMarker(int marker)
+{
+    uint64_t submitted = lsQueue.submitted;
+
+    // markers are never older than 2^32 jobs, rebuild the full number
+    LS_ExaQueueWait(submitted - (uint32_t) ((uint32_t) submitted - (uint32_t) marker));
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifndef LOONGSON_EXA_QUEUE_H_
+#define LOONGSON_EXA_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <xf86str.h>
+
+//
+// In-order command queue for the software EXA paths. Jobs are run on a
+// dedicated thread, every submitted job gets a sequence number which
+// callers store per pixmap and wait on before touching the pixels with
+// the CPU.
+//
+// When the queue isn't running (ExaAsync off) jobs are run inline by
+// LS_ExaQueueSubmit() and every sequence number is 0, so waiting is free.
+//
+typedef void (*LS_ExaJobFunc)(void *payload);
+
+Bool LS_ExaQueueInit(ScrnInfoPtr pScrn);
+void LS_ExaQueueFini(ScrnInfoPtr pScrn);
+
+// @payload is copied, the caller may reuse it right away
+uint64_t LS_ExaQueueSubmit(LS_ExaJobFunc func,
+                           const void *payload, size_t size);
+
+void LS_ExaQueueWait(uint64_t seq);
+void LS_ExaQueueDrain(void);
+
+// EXA MarkSync/WaitMarker, markers are the low bits of a sequence number
+int LS_ExaQueueMarker(void);
+void LS_ExaQueueWaitMarker(int marker);
+
+#endif
@@ -0,0 +1,448 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+
+#include <xf86.h>
+#include <os.h>
+
+#include "driver.h"
+#include "loongson_options.h"
+#include "loongson_pixmap.h"
+#include "loongson_exa_stats.h"
+
+// bucket i holds latencies below 2^i microseconds, the last one the rest
+#define LS_STATS_BUCKETS        20
+
+// distinct op/format combinations remembered for Composite
+#define LS_STATS_COMPOSITE_MAX  64
+
+// usage hints with a row of their own, anything else is "other"
+#define LS_STATS_USAGE_MAX      8
+
+struct LoongsonExaOpStats {
+    unsigned long ops;
+    unsigned long rects;
+    unsigned long long pixels;
+    unsigned long software;
+    unsigned long fallbacks;
+    unsigned long latency[LS_STATS_BUCKETS];
+};
+
+struct LoongsonCompositeStats {
+    int op;
+    CARD32 src;
+    CARD32 mask;
+    CARD32 dst;
+    unsigned long ops;
+};
+
+static struct {
+    Bool enabled;
+    int refcnt;
+
+    // the operation between Prepare and Done, and when it started
+    int current;
+    uint64_t start;
+
+    struct LoongsonExaOpStats ops[LS_EXA_STAT_NUM_OPS];
+    struct LoongsonCompositeStats composite[LS_STATS_COMPOSITE_MAX];
+    unsigned long composite_other;
+    unsigned long access[LS_EXA_STAT_NUM_PLACES][2];
+    unsigned long created[LS_STATS_USAGE_MAX + 1];
+    unsigned long destroyed[LS_STATS_USAGE_MAX + 1];
+} lsStats = { .current = -1 };
+
+static volatile sig_atomic_t lsStatsDumpPending;
+static OsSigHandlerPtr lsStatsOldHandler;
+
+static const char * const lsStatOpNames[LS_EXA_STAT_NUM_OPS] = {
+    "Solid",
+    "Copy",
+    "Composite",
+    "UploadToScreen",
+    "DownloadFromScreen",
+};
+
+static const char * const lsStatPlaceNames[LS_EXA_STAT_NUM_PLACES] = {
+    "system memory",
+    "dumb BO",
+    "mirror",
+    "solid colour",
+};
+
+
+static uint64_t ls_stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+static void ls_stats_sigusr2(int sig)
+{
+    lsStatsDumpPending = 1;
+}
+
+
+void LS_ExaStatsInit(ScrnInfoPtr pScrn)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+
+    if (!xf86ReturnOptValBool(ms->drmmode.Options, OPTION_EXA_STATS, TRUE))
+    {
+        return;
+    }
+
+    // the counters are shared by every screen
+    if (lsStats.refcnt++ == 0)
+    {
+        lsStats.enabled = TRUE;
+        lsStatsOldHandler = OsSignal(SIGUSR2, ls_stats_sigusr2);
+    }
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+               "EXA statistics enabled, send SIGUSR2 to dump them\n");
+}
+
+
+void LS_ExaStatsFini(ScrnInfoPtr pScrn)
+{
+    if (lsStats.refcnt == 0)
+    {
+        return;
+    }
+
+    LS_ExaStatsDump(pScrn);
+
+    if (--lsStats.refcnt == 0)
+    {
+        OsSignal(SIGUSR2, lsStatsOldHandler);
+        lsStats.enabled = FALSE;
+    }
+}
+
+
+void LS_ExaStatsBegin(enum LoongsonExaStatOp op)
+{
+    if (!lsStats.enabled || (lsStats.current >= 0))
+    {
+        return;
+    }
+
+    lsStats.current = op;
+    lsStats.start = ls_stats_now();
+    lsStats.ops[op].ops++;
+}
+
+
+void LS_ExaStatsEnd(enum LoongsonExaStatOp op)
+{
+    uint64_t us;
+    int i;
+
+    if (!lsStats.enabled || (lsStats.current != (int) op))
+    {
+        return;
+    }
+
+    us = (ls_stats_now() - lsStats.start) / 1000;
+
+    for (i = 0; (i < LS_STATS_BUCKETS - 1) && (us >= (1ull << i)); i++)
+    {
+        ;
+    }
+
+    lsStats.ops[op].latency[i]++;
+    lsStats.current = -1;
+}
+
+
+void LS_ExaStatsRect(int width, int height)
+{
+    struct LoongsonExaOpStats *pOp;
+
+    if (!lsStats.enabled || (lsStats.current < 0))
+    {
+        return;
+    }
+
+    pOp = &lsStats.ops[lsStats.current];
+    pOp->rects++;
+    pOp->pixels += (unsigned long long) width * height;
+}
+
+
+void LS_ExaStatsSoftware(enum LoongsonExaStatOp op)
+{
+    if (lsStats.enabled)
+    {
+        lsStats.ops[op].software++;
+    }
+}
+
+
+void LS_ExaStatsFallback(enum LoongsonExaStatOp op)
+{
+    if (lsStats.enabled)
+    {
+        lsStats.ops[op].fallbacks++;
+    }
+}
+
+
+void LS_ExaStatsComposite(int op, PicturePtr pSrcPicture,
+                          PicturePtr pMaskPicture, PicturePtr pDstPicture)
+{
+    CARD32 src = pSrcPicture->format;
+    CARD32 mask = pMaskPicture ? pMaskPicture->format : 0;
+    CARD32 dst = pDstPicture->format;
+    struct LoongsonCompositeStats *pEntry;
+    int i;
+
+    if (!lsStats.enabled)
+    {
+        return;
+    }
+
+    for (i = 0; i < LS_STATS_COMPOSITE_MAX; i++)
+    {
+        pEntry = &lsStats.composite[i];
+
+        if (pEntry->ops == 0)
+        {
+            pEntry->op = op;
+            pEntry->src = src;
+            pEntry->mask = mask;
+            pEntry->dst = dst;
+        }
+        else if ((pEntry->op != op) || (pEntry->src != src) ||
+                 (pEntry->mask != mask) || (pEntry->dst != dst))
+        {
+            continue;
+        }
+
+        pEntry->ops++;
+
+        // keep the busy ones in front, the lookup ends early for them
+        if ((i > 0) && (pEntry[-1].ops < pEntry->ops))
+        {
+            struct LoongsonCompositeStats tmp = pEntry[-1];
+
+            pEntry[-1] = *pEntry;
+            *pEntry = tmp;
+        }
+
+        return;
+    }
+
+    lsStats.composite_other++;
+}
+
+
+void LS_ExaStatsAccess(enum LoongsonExaStatPlace place, Bool write)
+{
+    if (lsStats.enabled)
+    {
+        lsStats.access[place][write ? 1 : 0]++;
+    }
+}
+
+
+void LS_ExaStatsPixmap(int usage_hint, Bool create)
+{
+    unsigned int i;
+
+    if (!lsStats.enabled)
+    {
+        return;
+    }
+
+    i = usage_hint & ~CREATE_PIXMAP_USAGE_SCANOUT;
+    if (i > LS_STATS_USAGE_MAX)
+    {
+        i = LS_STATS_USAGE_MAX;
+    }
+
+    if (create)
+    {
+        lsStats.created[i]++;
+    }
+    else
+    {
+        lsStats.destroyed[i]++;
+    }
+}
+
+
+void LS_ExaStatsPoll(ScrnInfoPtr pScrn)
+{
+    if (lsStatsDumpPending)
+    {
+        lsStatsDumpPending = 0;
+        LS_ExaStatsDump(pScrn);
+    }
+}
+
+
+static const char * ls_stats_format(CARD32 format, char *buf, size_t size)
+{
+    switch (format)
+    {
+        case 0:
+            return "none";
+        case PICT_a8r8g8b8:
+            return "a8r8g8b8";
+        case PICT_x8r8g8b8:
+            return "x8r8g8b8";
+        case PICT_a8b8g8r8:
+            return "a8b8g8r8";
+        case PICT_x8b8g8r8:
+            return "x8b8g8r8";
+        case PICT_r5g6b5:
+            return "r5g6b5";
+        case PICT_a8:
+            return "a8";
+        case PICT_a1:
+            return "a1";
+        default:
+            snprintf(buf, size, "0x%08x", (unsigned int) format);
+            return buf;
+    }
+}
+
+
+void LS_ExaStatsDump(ScrnInfoPtr pScrn)
+{
+    char line[512];
+    char fmt[3][16];
+    int i, j, n;
+
+    if (!lsStats.enabled)
+    {
+        return;
+    }
+
+    for (i = 0; i < LS_EXA_STAT_NUM_OPS; i++)
+    {
+        struct LoongsonExaOpStats *pOp = &lsStats.ops[i];
+
+        if ((pOp->ops == 0) && (pOp->fallbacks == 0))
+        {
+            continue;
+        }
+
+        xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                   "EXA %s: %lu ops, %lu rects, %llu pixels, "
+                   "%lu drawn by fb, %lu refused\n",
+                   lsStatOpNames[i], pOp->ops, pOp->rects, pOp->pixels,
+                   pOp->software, pOp->fallbacks);
+
+        n = 0;
+        for (j = 0; j < LS_STATS_BUCKETS; j++)
+        {
+            if (pOp->latency[j] == 0)
+            {
+                continue;
+            }
+
+            n += snprintf(line + n, sizeof(line) - n, " %s%lluus:%lu",
+                          (j == LS_STATS_BUCKETS - 1) ? ">=" : "<",
+                          (j == LS_STATS_BUCKETS - 1) ?
+                              (1ull << (j - 1)) : (1ull << j),
+                          pOp->latency[j]);
+
+            if (n >= (int) sizeof(line))
+            {
+                break;
+            }
+        }
+
+        if (n > 0)
+        {
+            xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                       "EXA %s latency:%s\n", lsStatOpNames[i], line);
+        }
+    }
+
+    for (i = 0; i < LS_STATS_COMPOSITE_MAX; i++)
+    {
+        struct LoongsonCompositeStats *pEntry = &lsStats.composite[i];
+
+        if (pEntry->ops == 0)
+        {
+            break;
+        }
+
+        xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                   "EXA Composite op %d %s, %s -> %s: %lu ops\n",
+                   pEntry->op,
+                   ls_stats_format(pEntry->src, fmt[0], sizeof(fmt[0])),
+                   ls_stats_format(pEntry->mask, fmt[1], sizeof(fmt[1])),
+                   ls_stats_format(pEntry->dst, fmt[2], sizeof(fmt[2])),
+                   pEntry->ops);
+    }
+
+    if (lsStats.composite_other)
+    {
+        xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                   "EXA Composite, other combinations: %lu ops\n",
+                   lsStats.composite_other);
+    }
+
+    for (i = 0; i < LS_EXA_STAT_NUM_PLACES; i++)
+    {
+        if (lsStats.access[i][0] || lsStats.access[i][1])
+        {
+            xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                       "EXA PrepareAccess on %s: %lu reads, %lu writes\n",
+                       lsStatPlaceNames[i],
+                       lsStats.access[i][0], lsStats.access[i][1]);
+        }
+    }
+
+    for (i = 0; i <= LS_STATS_USAGE_MAX; i++)
+    {
+        if (lsStats.created[i] || lsStats.destroyed[i])
+        {
+            xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                       "EXA pixmaps with usage hint %s%d: "
+                       "%lu created, %lu destroyed\n",
+                       (i == LS_STATS_USAGE_MAX) ? ">=" : "", i,
+                       lsStats.created[i], lsStats.destroyed[i]);
+        }
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+
+#ifndef LOONGSON_EXA_STATS_H_
+#define LOONGSON_EXA_STATS_H_
+
+#include <stdint.h>
+
+#include <xf86str.h>
+#include <picturestr.h>
+
+//
+// Counters for the EXA hooks: how often each one runs, how many pixels
+// it touches, how often it ends up in fb (in the driver, or because EXA
+// was refused, as ExaType "fake" always does) and a log2 histogram of the
+// time from Prepare to Done. Everything is updated on the server thread
+// only and costs a couple of clock reads per operation, so it is on by
+// default. Dumped to the log at CloseScreen and on SIGUSR2.
+//
+// Latency is what the server thread spends in the operation, with ExaAsync
+// the jobs themselves run later on the queue thread.
+//
+enum LoongsonExaStatOp {
+    LS_EXA_STAT_SOLID,
+    LS_EXA_STAT_COPY,
+    LS_EXA_STAT_COMPOSITE,
+    LS_EXA_STAT_UPLOAD,
+    LS_EXA_STAT_DOWNLOAD,
+    LS_EXA_STAT_NUM_OPS,
+};
+
+// where the pixels of a pixmap are when the CPU asks for them
+enum LoongsonExaStatPlace {
+    LS_EXA_STAT_SYSTEM,
+    LS_EXA_STAT_DUMB,
+    LS_EXA_STAT_MIRROR,
+    LS_EXA_STAT_SOLID_COLOUR,
+    LS_EXA_STAT_NUM_PLACES,
+};
+
+void LS_ExaStatsInit(ScrnInfoPtr pScrn);
+void LS_ExaStatsFini(ScrnInfoPtr pScrn);
+
+// Prepare/Done of one operation, nested operations (a copy turned into a
+// fill) are accounted to the outer one
+void LS_ExaStatsBegin(enum LoongsonExaStatOp op);
+void LS_ExaStatsEnd(enum LoongsonExaStatOp op);
+void LS_ExaStatsRect(int width, int height);
+
+// the operation is drawn by fb in the driver
+void LS_ExaStatsSoftware(enum LoongsonExaStatOp op);
+// the operation was refused, EXA falls back to fb itself
+void LS_ExaStatsFallback(enum LoongsonExaStatOp op);
+
+void LS_ExaStatsComposite(int op, PicturePtr pSrcPicture,
+                          PicturePtr pMaskPicture, PicturePtr pDstPicture);
+
+void LS_ExaStatsAccess(enum LoongsonExaStatPlace place, Bool write);
+
+void LS_ExaStatsPixmap(int usage_hint, Bool create);
+
+// dump if SIGUSR2 was received since the last call
+void LS_ExaStatsPoll(ScrnInfoPtr pScrn);
+void LS_ExaStatsDump(ScrnInfoPtr pScrn);
+
+#endif
@@ -0,0 +1,714 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <xf86.h>
+#include <fb.h>
+#include <picturestr.h>
+#include <glyphstr.h>
+#include <list.h>
+
+#include "driver.h"
+#include "fake_exa.h"
+#include "loongson_glyphs.h"
+#include "loongson_simd.h"
+
+#define LS_ATLAS_SIZE         1024
+#define LS_ATLAS_PAGES        4
+#define LS_ATLAS_MAX_GLYPH    128
+#define LS_ATLAS_HASH_SIZE    4096
+
+// larger runs use more scratch memory than they are worth
+#define LS_GLYPH_MAX_MASK     (4096 * 256)
+
+struct LoongsonAtlasEntry {
+    struct xorg_list hash;
+    struct xorg_list page;
+    unsigned char sha1[20];
+    int x, y;
+    int width, height;
+    int index;
+};
+
+//
+// Pages are filled shelf by shelf and evicted as a whole, least
+// recently used first.
+//
+struct LoongsonAtlasPage {
+    uint8_t *bits;
+    int shelf_x;
+    int shelf_y;
+    int shelf_h;
+    unsigned long stamp;
+    struct xorg_list entries;
+};
+
+struct LoongsonAtlas {
+    struct LoongsonAtlasPage pages[LS_ATLAS_PAGES];
+    struct xorg_list hash[LS_ATLAS_HASH_SIZE];
+    unsigned long stamp;
+    int refcnt;
+
+    uint8_t *mask;
+    size_t mask_size;
+};
+
+static struct LoongsonAtlas lsAtlas;
+
+
+static unsigned int ls_atlas_hash(const unsigned char *sha1)
+{
+    unsigned int h;
+
+    memcpy(&h, sha1, sizeof(h));
+
+    return h & (LS_ATLAS_HASH_SIZE - 1);
+}
+
+
+static void ls_atlas_evict_page(struct LoongsonAtlasPage *pPage)
+{
+    struct LoongsonAtlasEntry *pEntry, *tmp;
+
+    xorg_list_for_each_entry_safe(pEntry, tmp, &pPage->entries, page)
+    {
+        xorg_list_del(&pEntry->hash);
+        xorg_list_del(&pEntry->page);
+        free(pEntry);
+    }
+
+    pPage->shelf_x = 0;
+    pPage->shelf_y = 0;
+    pPage->shelf_h = 0;
+}
+
+
+static Bool ls_atlas_page_alloc(struct LoongsonAtlasPage *pPage,
+                                int w, int h, int *x, int *y)
+{
+    if (pPage->bits == NULL)
+    {
+        pPage->bits = malloc(LS_ATLAS_SIZE * LS_ATLAS_SIZE);
+        if (pPage->bits == NULL)
+        {
+            return FALSE;
+        }
+    }
+
+    // start a new shelf if the glyph doesn't fit on the current one
+    if ((pPage->shelf_x + w > LS_ATLAS_SIZE) || (h > pPage->shelf_h))
+    {
+        if ((pPage->shelf_x != 0) || (pPage->shelf_h != 0))
+        {
+            pPage->shelf_y += pPage->shelf_h;
+            pPage->shelf_x = 0;
+            pPage->shelf_h = 0;
+        }
+
+        if (pPage->shelf_y + h > LS_ATLAS_SIZE)
+        {
+            return FALSE;
+        }
+
+        pPage->shelf_h = h;
+    }
+
+    *x = pPage->shelf_x;
+    *y = pPage->shelf_y;
+    pPage->shelf_x += w;
+
+    return TRUE;
+}
+
+
+static struct LoongsonAtlasEntry *
+ls_atlas_insert(ScreenPtr pScreen, GlyphPtr pGlyph)
+{
+    struct LoongsonAtlas *pAtlas = &lsAtlas;
+    PicturePtr pPicture = GetGlyphPicture(pGlyph, pScreen);
+    PixmapPtr pPixmap = (PixmapPtr) pPicture->pDrawable;
+    struct LoongsonAtlasEntry *pEntry;
+    struct LoongsonAtlasPage *pPage = NULL;
+    int w = pGlyph->info.width;
+    int h = pGlyph->info.height;
+    const uint8_t *src;
+    uint8_t *dst;
+    int x, y;
+    int i;
+
+    // first page with room left, otherwise evict the one that was
+    // used least recently
+    for (i = 0; i < LS_ATLAS_PAGES; i++)
+    {
+        struct LoongsonAtlasPage *pCandidate = &pAtlas->pages[i];
+
+        if (ls_atlas_page_alloc(pCandidate, w, h, &x, &y))
+        {
+            pPage = pCandidate;
+            break;
+        }
+    }
+
+    if (pPage == NULL)
+    {
+        pPage = &pAtlas->pages[0];
+        for (i = 1; i < LS_ATLAS_PAGES; i++)
+        {
+            if (pAtlas->pages[i].stamp < pPage->stamp)
+            {
+                pPage = &pAtlas->pages[i];
+            }
+        }
+
+        ls_atlas_evict_page(pPage);
+
+        if (!ls_atlas_page_alloc(pPage, w, h, &x, &y))
+        {
+            return NULL;
+        }
+    }
+
+    pEntry = malloc(sizeof(struct LoongsonAtlasEntry));
+    if (pEntry == NULL)
+    {
+        return NULL;
+    }
+
+    if (!ms_exa_prepare_access(pPixmap, EXA_PREPARE_SRC))
+    {
+        free(pEntry);
+        return NULL;
+    }
+
+    src = pPixmap->devPrivate.ptr;
+    dst = pPage->bits + y * LS_ATLAS_SIZE + x;
+
+    for (i = 0; i < h; i++)
+    {
+        memcpy(dst, src, w);
+        src += pPixmap->devKind;
+        dst += LS_ATLAS_SIZE;
+    }
+
+    ms_exa_finish_access(pPixmap, 0);
+
+    memcpy(pEntry->sha1, pGlyph->sha1, sizeof(pEntry->sha1));
+    pEntry->x = x;
+    pEntry->y = y;
+    pEntry->width = w;
+    pEntry->height = h;
+    pEntry->index = pPage - pAtlas->pages;
+
+    xorg_list_add(&pEntry->hash, &pAtlas->hash[ls_atlas_hash(pGlyph->sha1)]);
+    xorg_list_add(&pEntry->page, &pPage->entries);
+
+    return pEntry;
+}
+
+
+static struct LoongsonAtlasEntry *
+ls_atlas_lookup(ScreenPtr pScreen, GlyphPtr pGlyph)
+{
+    struct LoongsonAtlas *pAtlas = &lsAtlas;
+    struct xorg_list *pBucket = &pAtlas->hash[ls_atlas_hash(pGlyph->sha1)];
+    struct LoongsonAtlasEntry *pEntry;
+
+    xorg_list_for_each_entry(pEntry, pBucket, hash)
+    {
+        if (memcmp(pEntry->sha1, pGlyph->sha1, sizeof(pEntry->sha1)) == 0)
+        {
+            pAtlas->pages[pEntry->index].stamp = pAtlas->stamp;
+            return pEntry;
+        }
+    }
+
+    pEntry = ls_atlas_insert(pScreen, pGlyph);
+    if (pEntry)
+    {
+        pAtlas->pages[pEntry->index].stamp = pAtlas->stamp;
+    }
+
+    return pEntry;
+}
+
+static inline const uint8_t *
+ls_atlas_bits(const struct LoongsonAtlasEntry *pEntry, int dx, int dy)
+{
+    return lsAtlas.pages[pEntry->index].bits +
+           (pEntry->y + dy) * LS_ATLAS_SIZE + pEntry->x + dx;
+}
+
+
+//
+// Solid colour of @pSrc as premultiplied a8r8g8b8, either a SolidFill
+// source picture or a 1x1 repeating drawable.
+//
+static Bool ls_glyphs_solid_source(PicturePtr pSrc, uint32_t *pixel)
+{
+    PixmapPtr pPixmap;
+    Pixel fg;
+
+    if (pSrc->pSourcePict)
+    {
+        if (pSrc->pSourcePict->type != SourcePictTypeSolidFill)
+        {
+            return FALSE;
+        }
+
+        *pixel = pSrc->pSourcePict->solidFill.color;
+        return TRUE;
+    }
+
+    if (!pSrc->pDrawable || !pSrc->repeat || pSrc->alphaMap ||
+        (pSrc->pDrawable->width != 1) || (pSrc->pDrawable->height != 1) ||
+        (pSrc->pDrawable->type != DRAWABLE_PIXMAP))
+    {
+        return FALSE;
+    }
+
+    if ((pSrc->format != PICT_a8r8g8b8) && (pSrc->format != PICT_x8r8g8b8))
+    {
+        return FALSE;
+    }
+
+    pPixmap = (PixmapPtr) pSrc->pDrawable;
+
+    if (ms_exa_pixmap_is_solid(pPixmap, &fg))
+    {
+        *pixel = fg;
+    }
+    else
+    {
+        if (!ms_exa_prepare_access(pPixmap, EXA_PREPARE_SRC))
+        {
+            return FALSE;
+        }
+
+        *pixel = *(uint32_t *) pPixmap->devPrivate.ptr;
+
+        ms_exa_finish_access(pPixmap, 0);
+    }
+
+    if (pSrc->format == PICT_x8r8g8b8)
+    {
+        *pixel |= 0xff000000;
+    }
+
+    return TRUE;
+}
+
+
+static Bool ls_glyphs_supported(CARD8 op, PicturePtr pDst,
+                                PictFormatPtr maskFormat,
+                                int nlist, GlyphListPtr list, GlyphPtr *glyphs)
+{
+    int n;
+
+    if (op != PictOpOver)
+    {
+        return FALSE;
+    }
+
+    if (!pDst->pDrawable || pDst->alphaMap ||
+        (pDst->pDrawable->bitsPerPixel != 32) ||
+        ((pDst->format != PICT_a8r8g8b8) && (pDst->format != PICT_x8r8g8b8)))
+    {
+        return FALSE;
+    }
+
+    if (maskFormat && (maskFormat->format != PICT_a8))
+    {
+        return FALSE;
+    }
+
+    while (nlist--)
+    {
+        if (list->format->format != PICT_a8)
+        {
+            return FALSE;
+        }
+
+        n = list->len;
+        while (n--)
+        {
+            GlyphPtr pGlyph = *glyphs++;
+
+            if ((pGlyph->info.width > LS_ATLAS_MAX_GLYPH) ||
+                (pGlyph->info.height > LS_ATLAS_MAX_GLYPH))
+            {
+                return FALSE;
+            }
+        }
+
+        list++;
+    }
+
+    return TRUE;
+}
+
+
+//
+// Draw the a8 @mask (@mw x @mh, placed at @mx, @my in absolute drawable
+// coordinates) over @pDst, clipped to its composite clip.
+//
+static void ls_glyphs_over(PicturePtr pDst, PixmapPtr pPixmap,
+                           int xoff, int yoff, uint32_t src,
+                           const uint8_t *mask, int mask_stride,
+                           int mx, int my, int mw, int mh)
+{
+    RegionPtr pClip = pDst->pCompositeClip;
+    BoxPtr pBox = RegionRects(pClip);
+    int nBox = RegionNumRects(pClip);
+
+    while (nBox--)
+    {
+        int x1 = max(mx, pBox->x1);
+        int y1 = max(my, pBox->y1);
+        int x2 = min(mx + mw, pBox->x2);
+        int y2 = min(my + mh, pBox->y2);
+
+        pBox++;
+
+        if ((x1 >= x2) || (y1 >= y2))
+        {
+            continue;
+        }
+
+        lsSimd.CompositeOverN8888(
+            (uint32_t *) ((uint8_t *) pPixmap->devPrivate.ptr +
+                          (y1 + yoff) * pPixmap->devKind) + x1 + xoff,
+            pPixmap->devKind,
+            mask + (y1 - my) * mask_stride + (x1 - mx), mask_stride,
+            src, x2 - x1, y2 - y1);
+    }
+}
+
+
+static Bool ls_glyphs_mask_reserve(struct LoongsonAtlas *pAtlas, size_t size)
+{
+    uint8_t *mask;
+
+    if (size > LS_GLYPH_MAX_MASK)
+    {
+        return FALSE;
+    }
+
+    if (size <= pAtlas->mask_size)
+    {
+        return TRUE;
+    }
+
+    mask = realloc(pAtlas->mask, size);
+    if (mask == NULL)
+    {
+        return FALSE;
+    }
+
+    pAtlas->mask = mask;
+    pAtlas->mask_size = size;
+
+    return TRUE;
+}
+
+
+static void ls_glyphs(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
+                      PictFormatPtr maskFormat, INT16 xSrc, INT16 ySrc,
+                      int nlist, GlyphListPtr list, GlyphPtr *glyphs);
+
+static void ls_glyphs_fallback(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
+                               PictFormatPtr maskFormat,
+                               INT16 xSrc, INT16 ySrc,
+                               int nlist, GlyphListPtr list, GlyphPtr *glyphs)
+{
+    ScreenPtr pScreen = pDst->pDrawable->pScreen;
+    modesettingPtr ms = modesettingPTR(xf86ScreenToScrn(pScreen));
+    PictureScreenPtr ps = GetPictureScreen(pScreen);
+
+    ps->Glyphs = ms->Glyphs;
+    ps->Glyphs(op, pSrc, pDst, maskFormat, xSrc, ySrc, nlist, list, glyphs);
+    ps->Glyphs = ls_glyphs;
+}
+
+
+static void ls_glyphs(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
+                      PictFormatPtr maskFormat, INT16 xSrc, INT16 ySrc,
+                      int nlist, GlyphListPtr list, GlyphPtr *glyphs)
+{
+    ScreenPtr pScreen = pDst->pDrawable ? pDst->pDrawable->pScreen : NULL;
+    struct LoongsonAtlas *pAtlas = &lsAtlas;
+    PixmapPtr pPixmap;
+    RegionRec region;
+    BoxRec box;
+    GlyphListPtr l;
+    GlyphPtr *g;
+    uint32_t src;
+    int xoff, yoff;
+    int x1, y1, x2, y2;
+    int x, y;
+    int nl, n;
+
+    if (pScreen == NULL)
+    {
+        return;
+    }
+
+    if (!ls_glyphs_supported(op, pDst, maskFormat, nlist, list, glyphs) ||
+        !ls_glyphs_solid_source(pSrc, &src))
+    {
+        ls_glyphs_fallback(op, pSrc, pDst, maskFormat, xSrc, ySrc,
+                           nlist, list, glyphs);
+        return;
+    }
+
+    if (src == 0)
+    {
+        return;
+    }
+
+    pAtlas->stamp++;
+
+    // glyph extents, relative to the drawable
+    x1 = y1 = MAXSHORT;
+    x2 = y2 = MINSHORT;
+    x = y = 0;
+
+    for (l = list, g = glyphs, nl = nlist; nl--; l++)
+    {
+        x += l->xOff;
+        y += l->yOff;
+
+        for (n = l->len; n--; g++)
+        {
+            GlyphPtr pGlyph = *g;
+
+            if (pGlyph->info.width && pGlyph->info.height)
+            {
+                x1 = min(x1, x - pGlyph->info.x);
+                y1 = min(y1, y - pGlyph->info.y);
+                x2 = max(x2, x - pGlyph->info.x + pGlyph->info.width);
+                y2 = max(y2, y - pGlyph->info.y + pGlyph->info.height);
+            }
+
+            x += pGlyph->info.xOff;
+            y += pGlyph->info.yOff;
+        }
+    }
+
+    if ((x1 >= x2) || (y1 >= y2))
+    {
+        return;
+    }
+
+    // Glyphs sharing a mask must be added up before they are blended,
+    // leave runs the scratch mask can't hold to the wrapped code.
+    if (maskFormat &&
+        !ls_glyphs_mask_reserve(pAtlas, (size_t) (x2 - x1) * (y2 - y1)))
+    {
+        ls_glyphs_fallback(op, pSrc, pDst, maskFormat, xSrc, ySrc,
+                           nlist, list, glyphs);
+        return;
+    }
+
+    fbGetDrawablePixmap(pDst->pDrawable, pPixmap, xoff, yoff);
+
+    if (!ms_exa_prepare_access(pPixmap, 0))
+    {
+        return;
+    }
+
+    x1 += pDst->pDrawable->x;
+    x2 += pDst->pDrawable->x;
+    y1 += pDst->pDrawable->y;
+    y2 += pDst->pDrawable->y;
+
+    // We sit above the damage layer's Glyphs hook, so the drawn area
+    // has to be reported here, before the pixels change.
+    box.x1 = x1;
+    box.y1 = y1;
+    box.x2 = x2;
+    box.y2 = y2;
+    RegionInit(&region, &box, 1);
+    RegionIntersect(&region, &region, pDst->pCompositeClip);
+    DamageRegionAppend(pDst->pDrawable, &region);
+    RegionUninit(&region);
+
+    if (maskFormat)
+    {
+        // Accumulate the glyphs into one a8 mask covering the run,
+        // then composite the source through it once.
+        int mw = x2 - x1;
+        int mh = y2 - y1;
+        size_t size = (size_t) mw * mh;
+
+        memset(pAtlas->mask, 0, size);
+
+        x = pDst->pDrawable->x;
+        y = pDst->pDrawable->y;
+
+        for (l = list, g = glyphs, nl = nlist; nl--; l++)
+        {
+            x += l->xOff;
+            y += l->yOff;
+
+            for (n = l->len; n--; g++)
+            {
+                GlyphPtr pGlyph = *g;
+                struct LoongsonAtlasEntry *pEntry;
+
+                if (pGlyph->info.width && pGlyph->info.height &&
+                    (pEntry = ls_atlas_lookup(pScreen, pGlyph)))
+                {
+                    int gx = x - pGlyph->info.x - x1;
+                    int gy = y - pGlyph->info.y - y1;
+
+                    lsSimd.CompositeAdd8(pAtlas->mask + gy * mw + gx, mw,
+                                         ls_atlas_bits(pEntry, 0, 0),
+                                         LS_ATLAS_SIZE,
+                                         pEntry->width, pEntry->height);
+                }
+
+                x += pGlyph->info.xOff;
+                y += pGlyph->info.yOff;
+            }
+        }
+
+        ls_glyphs_over(pDst, pPixmap, xoff, yoff, src,
+                       pAtlas->mask, mw, x1, y1, mw, mh);
+    }
+    else
+    {
+        // No mask, every glyph is composited on its own.
+        x = pDst->pDrawable->x;
+        y = pDst->pDrawable->y;
+
+        for (l = list, g = glyphs, nl = nlist; nl--; l++)
+        {
+            x += l->xOff;
+            y += l->yOff;
+
+            for (n = l->len; n--; g++)
+            {
+                GlyphPtr pGlyph = *g;
+                struct LoongsonAtlasEntry *pEntry;
+
+                if (pGlyph->info.width && pGlyph->info.height &&
+                    (pEntry = ls_atlas_lookup(pScreen, pGlyph)))
+                {
+                    ls_glyphs_over(pDst, pPixmap, xoff, yoff, src,
+                                   ls_atlas_bits(pEntry, 0, 0), LS_ATLAS_SIZE,
+                                   x - pGlyph->info.x, y - pGlyph->info.y,
+                                   pEntry->width, pEntry->height);
+                }
+
+                x += pGlyph->info.xOff;
+                y += pGlyph->info.yOff;
+            }
+        }
+    }
+
+    ms_exa_finish_access(pPixmap, 0);
+
+    DamageRegionProcessPending(pDst->pDrawable);
+}
+
+
+Bool LS_GlyphsInit(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    PictureScreenPtr ps = GetPictureScreenIfSet(pScreen);
+    struct LoongsonAtlas *pAtlas = &lsAtlas;
+    int i;
+
+    if (ps == NULL)
+    {
+        return FALSE;
+    }
+
+    if (pAtlas->refcnt++ == 0)
+    {
+        for (i = 0; i < LS_ATLAS_HASH_SIZE; i++)
+        {
+            xorg_list_init(&pAtlas->hash[i]);
+        }
+
+        for (i = 0; i < LS_ATLAS_PAGES; i++)
+        {
+            xorg_list_init(&pAtlas->pages[i].entries);
+        }
+    }
+
+    ms->Glyphs = ps->Glyphs;
+    ps->Glyphs = ls_glyphs;
+
+    return TRUE;
+}
+
+
+void LS_GlyphsFini(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    PictureScreenPtr ps = GetPictureScreenIfSet(pScreen);
+    struct LoongsonAtlas *pAtlas = &lsAtlas;
+    int i;
+
+    if (ms->Glyphs == NULL)
+    {
+        return;
+    }
+
+    if (ps)
+    {
+        ps->Glyphs = ms->Glyphs;
+    }
+
+    ms->Glyphs = NULL;
+
+    if (--pAtlas->refcnt)
+    {
+        return;
+    }
+
+    for (i = 0; i < LS_ATLAS_PAGES; i++)
+    {
+        ls_atlas_evict_page(&pAtlas->pages[i]);
+        free(pAtlas->pages[i].bits);
+        pAtlas->pages[i].bits = NULL;
+        pAtlas->pages[i].stamp = 0;
+    }
+
+    free(pAtlas->mask);
+    pAtlas->mask = NULL;
+    pAtlas->mask_size = 0;
+    pAtlas->stamp = 0;
+}
@@ -40,8 +40,18 @@ static const OptionInfoRec Options[] = {
     {OPTION_PAGEFLIP, "PageFlip", OPTV_BOOLEAN, {0}, FALSE},
     {OPTION_ZAPHOD_HEADS, "ZaphodHeads", OPTV_STRING, {0}, FALSE},
     {OPTION_DOUBLE_SHADOW, "DoubleShadow", OPTV_BOOLEAN, {0}, FALSE},
+    {OPTION_SHADOW_HASH, "ShadowHash", OPTV_BOOLEAN, {0}, FALSE},
+    {OPTION_FLUSH_PACING, "FlushPacing", OPTV_BOOLEAN, {0}, FALSE},
+    {OPTION_TEAR_FREE, "TearFree", OPTV_BOOLEAN, {0}, FALSE},
     {OPTION_ATOMIC, "Atomic", OPTV_BOOLEAN, {0}, FALSE},
     {OPTION_DEBUG, "Debug", OPTV_BOOLEAN, {0}, FALSE},
+    {OPTION_EXA_THREADS, "ExaThreads", OPTV_INTEGER, {0}, FALSE},
+    {OPTION_EXA_THREAD_THRESHOLD, "ExaThreadThreshold", OPTV_INTEGER, {0}, FALSE},
+    {OPTION_EXA_ASYNC, "ExaAsync", OPTV_BOOLEAN, {0}, FALSE},
+    {OPTION_EXA_LAZY_PIXMAPS, "ExaLazyPixmaps", OPTV_BOOLEAN, {0}, FALSE},
+    {OPTION_EXA_MIRROR_BUDGET, "ExaMirrorBudget", OPTV_INTEGER, {0}, FALSE},
+    {OPTION_EXA_STATS, "ExaStats", OPTV_BOOLEAN, {0}, FALSE},
+    {OPTION_EXA_BENCHMARK, "ExaBenchmark", OPTV_BOOLEAN, {0}, FALSE},
     {-1, NULL, OPTV_NONE, {0}, FALSE}
 };
 
@@ -40,8 +40,18 @@ typedef enum {
     OPTION_PAGEFLIP,
     OPTION_ZAPHOD_HEADS,
     OPTION_DOUBLE_SHADOW,
+    OPTION_SHADOW_HASH,
+    OPTION_FLUSH_PACING,
+    OPTION_TEAR_FREE,
     OPTION_ATOMIC,
     OPTION_DEBUG,
+    OPTION_EXA_THREADS,
+    OPTION_EXA_THREAD_THRESHOLD,
+    OPTION_EXA_ASYNC,
+    OPTION_EXA_LAZY_PIXMAPS,
+    OPTION_EXA_MIRROR_BUDGET,
+    OPTION_EXA_STATS,
+    OPTION_EXA_BENCHMARK,
 } modesettingOpts;
 
 
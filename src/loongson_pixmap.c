@@ -28,14 +28,21 @@
 #include "config.h"
 #endif
 
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <xf86.h>
 
+#ifdef HAVE_LINUX_DMA_BUF_H
+#include <linux/dma-buf.h>
+#endif
+
 #include "driver.h"
 #include "loongson_buffer.h"
 #include "loongson_debug.h"
+#include "loongson_exa_queue.h"
 #include "loongson_pixmap.h"
+#include "loongson_simd.h"
 
 
 
@@ -83,6 +90,520 @@ Bool LS_IsDumbPixmap( int usage_hint )
 }
 
 
+//
+// The usage hint is only a first guess. Dumb BOs are write-combined,
+// reading them back with the CPU is very slow, so a window pixmap that
+// is mostly read moves to system memory as long as nobody outside of
+// EXA knows its BO. Exporting a system memory pixmap moves it back.
+//
+#define LS_MIGRATE_MIN_READS    16
+
+static struct {
+    unsigned long to_dumb;
+    unsigned long to_system;
+    unsigned long long bytes;
+} lsMigrateStats;
+
+//
+// Dumb pixmaps that cannot move (scanout, PRIME) but are read a lot get
+// a mirror in cached memory instead, as long as the budget allows. A
+// mirror that keeps getting invalidated by writes nobody can track is
+// given up.
+//
+#define LS_MIRROR_MIN_READS     8
+#define LS_MIRROR_MAX_DROPS     8
+
+static struct {
+    size_t bytes_held;
+    unsigned long created;
+    unsigned long syncs;
+    unsigned long dropped;
+} lsMirrorStats;
+
+//
+// CPU access to a dumb BO that has a dma-buf is bracketed with
+// DMA_BUF_IOCTL_SYNC. A window is opened the first time the CPU touches
+// the BO and stays open until the block handler has drained the queue,
+// so a pixmap drawn a hundred times a frame costs one pair of ioctls.
+// The ioctl takes no range; the boxes written in the window decide the
+// direction it is closed with, a window that wrote nothing ends as a
+// read and the exporter has nothing to clean.
+//
+static struct xorg_list lsSyncList = { &lsSyncList, &lsSyncList };
+
+static struct {
+    unsigned long windows;
+    unsigned long written;
+    unsigned long upgrades;
+    unsigned long long damaged;
+} lsSyncStats;
+
+
+Bool LS_PixmapWantsSystemMemory(const struct ms_exa_pixmap_priv *priv)
+{
+    if (!priv->is_dumb || priv->shared || !priv->owned || (priv->bo == NULL))
+    {
+        return FALSE;
+    }
+
+    // scanout and PRIME pixmaps have to stay where the kernel sees them
+    if (priv->usage_hint != CREATE_PIXMAP_USAGE_BACKING_PIXMAP)
+    {
+        return FALSE;
+    }
+
+    return (priv->cpu_reads >= LS_MIGRATE_MIN_READS) &&
+           (priv->cpu_reads >= priv->cpu_writes);
+}
+
+
+Bool LS_PixmapWantsMirror(PixmapPtr pPixmap,
+                          const struct ms_exa_pixmap_priv *priv)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pPixmap->drawable.pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    size_t size;
+
+    // others may write a shared BO, a copy of it could go stale
+    if (!priv->is_dumb || priv->shared || (priv->bo == NULL) ||
+        priv->mirror_valid)
+    {
+        return FALSE;
+    }
+
+    if ((priv->cpu_reads < LS_MIRROR_MIN_READS) ||
+        (priv->mirror_drops >= LS_MIRROR_MAX_DROPS))
+    {
+        return FALSE;
+    }
+
+    // moving the pixmap to system memory beats keeping two copies
+    if (LS_PixmapWantsSystemMemory(priv))
+    {
+        return FALSE;
+    }
+
+    // an invalidated mirror keeps its memory
+    if (priv->mirror.pDat)
+    {
+        return TRUE;
+    }
+
+    size = (size_t) priv->bo->pitch * pPixmap->drawable.height;
+
+    return lsMirrorStats.bytes_held + size <= ms->mirror_budget;
+}
+
+
+Bool LS_MirrorSync(PixmapPtr pPixmap, struct ms_exa_pixmap_priv *priv)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pPixmap->drawable.pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    int height = pPixmap->drawable.height;
+    int bytes = (pPixmap->drawable.width * pPixmap->drawable.bitsPerPixel + 7) / 8;
+    struct LoongsonBuf *pMirror = &priv->mirror;
+    int y;
+
+    if (dumb_bo_map(ms->drmmode.fd, priv->bo))
+    {
+        return FALSE;
+    }
+
+    if (pMirror->pDat == NULL)
+    {
+        pMirror->pitch = priv->bo->pitch;
+        pMirror->size = priv->bo->pitch * height;
+        pMirror->width = pPixmap->drawable.width;
+        pMirror->height = height;
+
+        if (!LS_CommitBuf(pMirror))
+        {
+            LS_FreeBuf(pMirror);
+            return FALSE;
+        }
+
+        lsMirrorStats.bytes_held += pMirror->size;
+        lsMirrorStats.created++;
+    }
+
+    LS_PixmapSyncBegin(priv, FALSE);
+
+    for (y = 0; y < height; y++)
+    {
+        lsSimd.DownloadRow((uint8_t *) pMirror->pDat + y * pMirror->pitch,
+                           (const uint8_t *) priv->bo->ptr + y * priv->bo->pitch,
+                           bytes);
+    }
+
+    priv->mirror_valid = TRUE;
+    lsMirrorStats.syncs++;
+
+    DEBUG_MSG("pixmap %p (%dx%d) mirrored", pPixmap,
+              pPixmap->drawable.width, height);
+
+    return TRUE;
+}
+
+
+void LS_MirrorFree(struct ms_exa_pixmap_priv *priv)
+{
+    if (priv->mirror.pDat)
+    {
+        lsMirrorStats.bytes_held -= priv->mirror.size;
+        lsMirrorStats.dropped++;
+    }
+
+    LS_FreeBuf(&priv->mirror);
+    priv->mirror_valid = FALSE;
+}
+
+
+void LS_MirrorInvalidate(struct ms_exa_pixmap_priv *priv)
+{
+    if (!priv->mirror_valid)
+    {
+        return;
+    }
+
+    priv->mirror_valid = FALSE;
+
+    if (++priv->mirror_drops >= LS_MIRROR_MAX_DROPS)
+    {
+        LS_MirrorFree(priv);
+    }
+}
+
+
+#ifdef HAVE_LINUX_DMA_BUF_H
+static Bool lsSyncBroken;
+
+static Bool ls_dma_buf_sync(struct ms_exa_pixmap_priv *priv, unsigned int flags)
+{
+    struct dma_buf_sync sync = { .flags = flags };
+
+    if (drmIoctl(priv->fd, DMA_BUF_IOCTL_SYNC, &sync) == 0)
+    {
+        return TRUE;
+    }
+
+    // kernels older than 4.6 don't know the ioctl, stop asking
+    if ((errno == ENOTTY) || (errno == EINVAL))
+    {
+        lsSyncBroken = TRUE;
+    }
+
+    return FALSE;
+}
+#endif
+
+
+void LS_PixmapSyncBegin(struct ms_exa_pixmap_priv *priv, Bool write)
+{
+#ifdef HAVE_LINUX_DMA_BUF_H
+    unsigned int flags = write ? DMA_BUF_SYNC_RW : DMA_BUF_SYNC_READ;
+
+    if (lsSyncBroken || !priv->is_dumb || (priv->fd <= 0))
+    {
+        return;
+    }
+
+    if ((priv->sync_flags & flags) == flags)
+    {
+        return;
+    }
+
+    if (priv->sync_flags)
+    {
+        // a read window turns into a read/write one, queued jobs may
+        // still be reading under the old one
+        LS_ExaQueueWait(priv->seq);
+        ls_dma_buf_sync(priv, DMA_BUF_SYNC_END | priv->sync_flags);
+        lsSyncStats.upgrades++;
+    }
+    else
+    {
+        xorg_list_add(&priv->sync_link, &lsSyncList);
+        priv->sync_damage.x1 = priv->sync_damage.y1 = 0;
+        priv->sync_damage.x2 = priv->sync_damage.y2 = 0;
+        lsSyncStats.windows++;
+    }
+
+    if (!ls_dma_buf_sync(priv, DMA_BUF_SYNC_START | flags))
+    {
+        xorg_list_del(&priv->sync_link);
+        priv->sync_flags = 0;
+        return;
+    }
+
+    priv->sync_flags = flags;
+#endif
+}
+
+
+void LS_PixmapSyncDamage(struct ms_exa_pixmap_priv *priv,
+                         const BoxRec *pBox, int nBox)
+{
+    BoxPtr pExt = &priv->sync_damage;
+    int i;
+
+    if (priv->sync_flags == 0)
+    {
+        return;
+    }
+
+    for (i = 0; i < nBox; i++)
+    {
+        if ((pBox[i].x1 >= pBox[i].x2) || (pBox[i].y1 >= pBox[i].y2))
+        {
+            continue;
+        }
+
+        if (pExt->x1 >= pExt->x2)
+        {
+            *pExt = pBox[i];
+            continue;
+        }
+
+        pExt->x1 = min(pExt->x1, pBox[i].x1);
+        pExt->y1 = min(pExt->y1, pBox[i].y1);
+        pExt->x2 = max(pExt->x2, pBox[i].x2);
+        pExt->y2 = max(pExt->y2, pBox[i].y2);
+    }
+}
+
+
+void LS_PixmapSyncEnd(struct ms_exa_pixmap_priv *priv)
+{
+#ifdef HAVE_LINUX_DMA_BUF_H
+    BoxPtr pExt = &priv->sync_damage;
+    unsigned int flags = priv->sync_flags;
+
+    if (flags == 0)
+    {
+        return;
+    }
+
+    if (flags & DMA_BUF_SYNC_WRITE)
+    {
+        if (pExt->x1 < pExt->x2)
+        {
+            lsSyncStats.written++;
+            lsSyncStats.damaged += (unsigned long long)
+                (pExt->x2 - pExt->x1) * (pExt->y2 - pExt->y1);
+        }
+        else
+        {
+            flags = DMA_BUF_SYNC_READ;
+        }
+    }
+
+    ls_dma_buf_sync(priv, DMA_BUF_SYNC_END | flags);
+
+    xorg_list_del(&priv->sync_link);
+    priv->sync_flags = 0;
+#endif
+}
+
+
+void LS_PixmapSyncFlush(void)
+{
+    struct ms_exa_pixmap_priv *priv, *tmp;
+
+    xorg_list_for_each_entry_safe(priv, tmp, &lsSyncList, sync_link)
+    {
+        LS_PixmapSyncEnd(priv);
+    }
+}
+
+
+Bool LS_MigrateToDumb(PixmapPtr pPixmap, struct ms_exa_pixmap_priv *priv)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pPixmap->drawable.pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    int width = pPixmap->drawable.width;
+    int height = pPixmap->drawable.height;
+    int bpp = pPixmap->drawable.bitsPerPixel;
+    int bytes = (width * bpp + 7) / 8;
+    struct dumb_bo *bo;
+    int prime_fd;
+    int y;
+
+    if (ms->bo_cache)
+    {
+        bo = dumb_bo_cache_alloc(ms->bo_cache, width, height, bpp);
+    }
+    else
+    {
+        bo = dumb_bo_create(ms->drmmode.fd, width, height, bpp);
+    }
+
+    if (bo == NULL)
+    {
+        return FALSE;
+    }
+
+    if (dumb_bo_map(ms->drmmode.fd, bo))
+    {
+        if (ms->bo_cache)
+        {
+            dumb_bo_cache_release(ms->bo_cache, bo);
+        }
+        else
+        {
+            dumb_bo_destroy(ms->drmmode.fd, bo);
+        }
+
+        return FALSE;
+    }
+
+    // a lazy pixmap never written has nothing to carry over
+    if (priv->buf.pDat)
+    {
+        for (y = 0; y < height; y++)
+        {
+            lsSimd.UploadRow((uint8_t *) bo->ptr + y * bo->pitch,
+                             (const uint8_t *) priv->buf.pDat + y * priv->buf.pitch,
+                             bytes);
+        }
+
+        lsMigrateStats.bytes += (unsigned long long) bytes * height;
+    }
+
+    LS_FreeBuf(&priv->buf);
+
+    // the dma-buf closed when the pixmap left its last BO, exports and
+    // the sync windows need one
+    if (drmPrimeHandleToFD(ms->drmmode.fd, bo->handle,
+                           DRM_CLOEXEC, &prime_fd) == 0)
+    {
+        priv->fd = prime_fd;
+    }
+    else
+    {
+        xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                "failed to get dmabuf fd of migrated pixmap\n");
+    }
+
+    priv->bo = bo;
+    priv->owned = TRUE;
+    priv->pitch = bo->pitch;
+    priv->is_dumb = TRUE;
+    priv->cpu_reads = 0;
+    priv->cpu_writes = 0;
+
+    pPixmap->devPrivate.ptr = NULL;
+    pPixmap->devKind = priv->pitch;
+
+    lsMigrateStats.to_dumb++;
+
+    DEBUG_MSG("pixmap %p (%dx%d) moved to dumb bo", pPixmap, width, height);
+
+    return TRUE;
+}
+
+
+Bool LS_MigrateToSystem(PixmapPtr pPixmap, struct ms_exa_pixmap_priv *priv)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pPixmap->drawable.pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    int width = pPixmap->drawable.width;
+    int height = pPixmap->drawable.height;
+    int bpp = pPixmap->drawable.bitsPerPixel;
+    int bytes = (width * bpp + 7) / 8;
+    struct LoongsonBuf buf;
+    int y;
+
+    if (priv->mirror_valid)
+    {
+        // the mirror already holds the pixels, it becomes the pixmap
+        buf = priv->mirror;
+        lsMirrorStats.bytes_held -= buf.size;
+        memset(&priv->mirror, 0, sizeof(priv->mirror));
+        priv->mirror_valid = FALSE;
+    }
+    else
+    {
+        LS_MirrorFree(priv);
+
+        if (dumb_bo_map(ms->drmmode.fd, priv->bo))
+        {
+            return FALSE;
+        }
+
+        LS_PixmapSyncBegin(priv, FALSE);
+
+        LS_AllocBuf(width, height, pPixmap->drawable.depth, bpp,
+                    priv->usage_hint, &buf);
+        if (buf.pDat == NULL)
+        {
+            return FALSE;
+        }
+
+        for (y = 0; y < height; y++)
+        {
+            lsSimd.DownloadRow((uint8_t *) buf.pDat + y * buf.pitch,
+                               (const uint8_t *) priv->bo->ptr + y * priv->bo->pitch,
+                               bytes);
+        }
+
+        lsMigrateStats.bytes += (unsigned long long) bytes * height;
+    }
+
+    LS_PixmapSyncEnd(priv);
+
+    // the dma-buf would keep the BO alive in the cache
+    if (priv->fd > 0)
+    {
+        close(priv->fd);
+        priv->fd = 0;
+    }
+
+    if (ms->bo_cache)
+    {
+        dumb_bo_cache_release(ms->bo_cache, priv->bo);
+    }
+    else
+    {
+        dumb_bo_destroy(ms->drmmode.fd, priv->bo);
+    }
+
+    priv->bo = NULL;
+    priv->buf = buf;
+    priv->pitch = buf.pitch;
+    priv->is_dumb = FALSE;
+    priv->cpu_reads = 0;
+    priv->cpu_writes = 0;
+
+    pPixmap->devPrivate.ptr = NULL;
+    pPixmap->devKind = priv->pitch;
+
+    lsMigrateStats.to_system++;
+
+    DEBUG_MSG("pixmap %p (%dx%d) moved to system memory", pPixmap, width, height);
+
+    return TRUE;
+}
+
+
+void LS_DumpPixmapStats(ScrnInfoPtr pScrn)
+{
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+               "Pixmap migration: %lu to dumb, %lu to system memory, %llu bytes\n",
+               lsMigrateStats.to_dumb, lsMigrateStats.to_system,
+               lsMigrateStats.bytes);
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+               "Pixmap mirrors: %lu created, %lu syncs, %lu dropped, %lu bytes held\n",
+               lsMirrorStats.created, lsMirrorStats.syncs,
+               lsMirrorStats.dropped, (unsigned long) lsMirrorStats.bytes_held);
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+               "dma-buf sync: %lu windows, %lu written, %lu widened, %llu pixels damaged\n",
+               lsSyncStats.windows, lsSyncStats.written,
+               lsSyncStats.upgrades, lsSyncStats.damaged);
+}
+
+
 
 ////////////////////////////////////////////////////////////////////////////
 //                Only allocate DRI2/DRI3 pixmaps with GEM
@@ -117,8 +638,7 @@ void * LS_CreateExaPixmap(ScreenPtr pScreen,
         int *new_fb_pitch)
 {
     ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
-
-    // modesettingPtr ms = modesettingPTR(pScrn);
+    modesettingPtr ms = modesettingPTR(pScrn);
 
     // TRACE_ENTER();
 
@@ -131,6 +651,7 @@ void * LS_CreateExaPixmap(ScreenPtr pScreen,
     }
 
     priv->usage_hint = usage_hint;
+    priv->is_dumb = FALSE;
 
     pBuf = &priv->buf;
 
@@ -139,15 +660,24 @@ void * LS_CreateExaPixmap(ScreenPtr pScreen,
         // DEBUG_MSG ( "Create Exa Pixmap %dx%d %d %d",
         //        width, height, depth, bitsPerPixel);
 
-        LS_AllocBuf( width, height, depth, bitsPerPixel, usage_hint, pBuf );
-
-        if ( NULL == pBuf->pDat )
+        // with lazy pixmaps the memory is allocated on first access,
+        // many pixmaps are only ever filled with a colour or not drawn
+        if (ms->lazy_pixmaps)
+        {
+            LS_ReserveBuf( width, height, depth, bitsPerPixel, usage_hint, pBuf );
+        }
+        else
         {
-            xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
-                    "failed to allocate %dx%d mem", width, height);
+            LS_AllocBuf( width, height, depth, bitsPerPixel, usage_hint, pBuf );
 
-            free(pBuf);
-            return NULL;
+            if ( NULL == pBuf->pDat )
+            {
+                xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+                        "failed to allocate %dx%d mem", width, height);
+
+                free(priv);
+                return NULL;
+            }
         }
     }
 
@@ -210,13 +740,21 @@ void * LS_CreateDumbPixmap(ScreenPtr pScreen,
     }
 
     priv->usage_hint = usage_hint;
+    priv->is_dumb = TRUE;
 
     if ((0 == width) && (0 == height))
     {
         return priv;
     }
 
-    priv->bo = dumb_bo_create(ms->drmmode.fd, width, height, bitsPerPixel);
+    if (ms->bo_cache)
+    {
+        priv->bo = dumb_bo_cache_alloc(ms->bo_cache, width, height, bitsPerPixel);
+    }
+    else
+    {
+        priv->bo = dumb_bo_create(ms->drmmode.fd, width, height, bitsPerPixel);
+    }
 
     if (NULL == priv->bo)
     {
@@ -238,6 +776,7 @@ void * LS_CreateDumbPixmap(ScreenPtr pScreen,
         return FALSE;
     }
 
+    priv->fd = prime_fd;
     priv->pitch = priv->bo->pitch;
 
     if (new_fb_pitch)
@@ -256,14 +795,25 @@ void LS_DestroyDumbPixmap(ScreenPtr pScreen, void *driverPriv)
     struct ms_exa_pixmap_priv *priv =
         (struct ms_exa_pixmap_priv *)driverPriv;
 
+    LS_PixmapSyncEnd(priv);
+
     if (priv->fd > 0)
     {
         close(priv->fd);
     }
 
+    LS_MirrorFree(priv);
+
     if ( (priv->owned == TRUE) && (priv->bo != NULL) )
     {
-        dumb_bo_destroy(ms->drmmode.fd, priv->bo);
+        if (ms->bo_cache)
+        {
+            dumb_bo_cache_release(ms->bo_cache, priv->bo);
+        }
+        else
+        {
+            dumb_bo_destroy(ms->drmmode.fd, priv->bo);
+        }
 
 #ifdef FAKE_EXA_DEBUG
         INFO_MSG("DestroyPixmap bo:%p", priv->bo);
@@ -11,11 +11,68 @@ struct ms_exa_pixmap_priv {
     Bool owned;
     struct LoongsonBuf buf;
     int usage_hint;
+    // last EXA queue job reading or writing the pixels
+    uint64_t seq;
+    // the whole pixmap is solid_fg, the memory (if any) is stale
+    Bool solid;
+    Pixel solid_fg;
+    // where the pixels live now, starts as LS_IsDumbPixmap(usage_hint)
+    // and may change with LS_MigrateToDumb()/LS_MigrateToSystem()
+    Bool is_dumb;
+    // the BO is known outside of EXA, the pixmap can no longer move
+    Bool shared;
+    unsigned int cpu_reads;
+    unsigned int cpu_writes;
+    // cached copy of a dumb pixmap for CPU reads, with the pitch of the
+    // BO; while valid the pixmap is drawn there and written back to
+    // the BO by rectangle
+    struct LoongsonBuf mirror;
+    Bool mirror_valid;
+    unsigned int mirror_drops;
+    // DMA_BUF_SYNC_* direction of the open CPU access window on the
+    // dma-buf, 0 if none, and the extents written since it was opened
+    unsigned int sync_flags;
+    BoxRec sync_damage;
+    struct xorg_list sync_link;
 };
 
 
 Bool LS_IsDumbPixmap( int usage_hint );
 
+Bool LS_PixmapWantsSystemMemory(const struct ms_exa_pixmap_priv *priv);
+
+//
+// Move the pixels between malloc'ed and dumb BO memory. The pixmap
+// must be idle, and not be a solid colour.
+//
+Bool LS_MigrateToDumb(PixmapPtr pPixmap, struct ms_exa_pixmap_priv *priv);
+Bool LS_MigrateToSystem(PixmapPtr pPixmap, struct ms_exa_pixmap_priv *priv);
+
+Bool LS_PixmapWantsMirror(PixmapPtr pPixmap,
+                          const struct ms_exa_pixmap_priv *priv);
+
+// (re)load the mirror from the BO, the pixmap must be idle
+Bool LS_MirrorSync(PixmapPtr pPixmap, struct ms_exa_pixmap_priv *priv);
+
+void LS_MirrorFree(struct ms_exa_pixmap_priv *priv);
+
+// the BO was written behind the mirror's back, the pixmap must be idle
+void LS_MirrorInvalidate(struct ms_exa_pixmap_priv *priv);
+
+//
+// Bracket CPU access to the BO of a dumb pixmap with DMA_BUF_IOCTL_SYNC.
+// Begin opens (or widens) the window, Damage records what was written,
+// End closes it; the pixmap must be idle. Flush ends every open window,
+// called once the EXA queue is drained.
+//
+void LS_PixmapSyncBegin(struct ms_exa_pixmap_priv *priv, Bool write);
+void LS_PixmapSyncDamage(struct ms_exa_pixmap_priv *priv,
+                         const BoxRec *pBox, int nBox);
+void LS_PixmapSyncEnd(struct ms_exa_pixmap_priv *priv);
+void LS_PixmapSyncFlush(void);
+
+void LS_DumpPixmapStats(ScrnInfoPtr pScrn);
+
 void * LS_CreateExaPixmap(ScreenPtr pScreen,
         int width, int height, int depth,
         int usage_hint, int bitsPerPixel,
@@ -0,0 +1,290 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include <xf86.h>
+#include <xf86Crtc.h>
+#include <picturestr.h>
+
+#include "driver.h"
+#include "loongson_rotate.h"
+#include "loongson_simd.h"
+#include "loongson_thread_pool.h"
+
+struct LoongsonRotateArgs {
+    uint32_t *dst;
+    int dst_stride;
+    const uint32_t *src;
+    int xstep;
+    int ystep;
+    int width;
+};
+
+static unsigned long rotate_hits;
+static unsigned long rotate_fallbacks;
+
+
+static void ls_rotate_band(void *data, int y, int h)
+{
+    const struct LoongsonRotateArgs *pArgs = data;
+
+    lsSimd.RotateRect32((uint32_t *) ((uint8_t *) pArgs->dst +
+                                      y * pArgs->dst_stride),
+                        pArgs->dst_stride, pArgs->src + y * pArgs->ystep,
+                        pArgs->xstep, pArgs->ystep, pArgs->width, h);
+}
+
+//
+// A matrix row of the transform, for a rotation or reflection it has a
+// single entry of +-1. Returns FALSE for anything else, on success
+// @pX and @pY are the coefficients of x and y.
+//
+static Bool ls_rotate_row(const pixman_fixed_t *row, int *pX, int *pY)
+{
+    int x = row[0] / pixman_fixed_1;
+    int y = row[1] / pixman_fixed_1;
+
+    if ((row[0] % pixman_fixed_1) || (row[1] % pixman_fixed_1) ||
+        (row[2] % pixman_fixed_1))
+    {
+        return FALSE;
+    }
+
+    if ((abs(x) + abs(y) != 1) || (abs(x) > 1) || (abs(y) > 1))
+    {
+        return FALSE;
+    }
+
+    *pX = x;
+    *pY = y;
+
+    return TRUE;
+}
+
+static xf86CrtcPtr ls_rotate_crtc(ScrnInfoPtr pScrn, DrawablePtr pDrawable)
+{
+    xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(pScrn);
+    int i;
+
+    if (pDrawable->type != DRAWABLE_PIXMAP)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < config->num_crtc; i++)
+    {
+        xf86CrtcPtr crtc = config->crtc[i];
+        drmmode_crtc_private_ptr drmmode_crtc = crtc->driver_private;
+
+        if ((crtc->rotatedPixmap == (PixmapPtr) pDrawable) &&
+            drmmode_crtc->rotate_bo.dumb)
+        {
+            return crtc;
+        }
+    }
+
+    return NULL;
+}
+
+//
+// Match xf86RotateCrtcRedisplay(): PictOpSrc from the root window with
+// the crtc's transform, no mask, into the rotate pixmap. With a pure
+// rotation or reflection every destination pixel centre maps onto a
+// source pixel centre, so nearest and bilinear filtering both come down
+// to fetching that pixel.
+//
+static Bool ls_rotate_composite(ScreenPtr pScreen, CARD8 op,
+                                PicturePtr pSrc, PicturePtr pMask,
+                                PicturePtr pDst, INT16 xSrc, INT16 ySrc,
+                                INT16 xDst, INT16 yDst,
+                                CARD16 width, CARD16 height)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    PixmapPtr pShadow = pScreen->GetScreenPixmap(pScreen);
+    PictTransformPtr t = pSrc->transform;
+    struct LoongsonRotateArgs args;
+    drmmode_crtc_private_ptr drmmode_crtc;
+    xf86CrtcPtr crtc;
+    int ax, ay, bx, by;
+    int sx, sy, ex, ey, x1, y1, x2, y2;
+
+    if ((op != PictOpSrc) || pMask || (pSrc->transform == NULL) ||
+        (pSrc->pDrawable == NULL) || pSrc->alphaMap || pDst->alphaMap ||
+        pSrc->repeat || pDst->clientClip ||
+        (pSrc->format != pDst->format) ||
+        (pSrc->filter > PictFilterGood))
+    {
+        return FALSE;
+    }
+
+    if ((pSrc->pDrawable->type != DRAWABLE_WINDOW) ||
+        (pSrc->pDrawable != &pScreen->root->drawable) ||
+        (pShadow->drawable.bitsPerPixel != 32) ||
+        (pDst->pDrawable->bitsPerPixel != 32))
+    {
+        return FALSE;
+    }
+
+    crtc = ls_rotate_crtc(pScrn, pDst->pDrawable);
+    if (crtc == NULL)
+    {
+        return FALSE;
+    }
+
+    if ((t->matrix[2][0] != 0) || (t->matrix[2][1] != 0) ||
+        (t->matrix[2][2] != pixman_fixed_1) ||
+        !ls_rotate_row(t->matrix[0], &ax, &ay) ||
+        !ls_rotate_row(t->matrix[1], &bx, &by) ||
+        ((ax != 0) == (bx != 0)))
+    {
+        return FALSE;
+    }
+
+    // the destination rectangle, clipped to the rotate pixmap
+    x1 = max(xDst, 0);
+    y1 = max(yDst, 0);
+    x2 = min(xDst + width, pDst->pDrawable->width);
+    y2 = min(yDst + height, pDst->pDrawable->height);
+
+    if ((x1 >= x2) || (y1 >= y2))
+    {
+        return TRUE;
+    }
+
+    //
+    // the source pixel of destination pixel (x, y) holds the transformed
+    // centre (x + 0.5, y + 0.5), shifted by the source origin
+    //
+    sx = ax * (x1 - xDst + xSrc) + ay * (y1 - yDst + ySrc) +
+         t->matrix[0][2] / pixman_fixed_1 - ((ax + ay) < 0);
+    sy = bx * (x1 - xDst + xSrc) + by * (y1 - yDst + ySrc) +
+         t->matrix[1][2] / pixman_fixed_1 - ((bx + by) < 0);
+
+    // outside the screen the source is transparent, leave that to fb
+    ex = sx + ax * (x2 - x1 - 1) + ay * (y2 - y1 - 1);
+    ey = sy + bx * (x2 - x1 - 1) + by * (y2 - y1 - 1);
+
+    if ((min(sx, ex) < 0) || (max(sx, ex) >= pShadow->drawable.width) ||
+        (min(sy, ey) < 0) || (max(sy, ey) >= pShadow->drawable.height))
+    {
+        return FALSE;
+    }
+
+    drmmode_crtc = crtc->driver_private;
+
+    args.dst_stride = drmmode_bo_get_pitch(&drmmode_crtc->rotate_bo);
+    args.dst = (uint32_t *) ((uint8_t *) drmmode_crtc->rotate_bo.dumb->ptr +
+                             y1 * args.dst_stride) + x1;
+    args.xstep = ax + bx * (pShadow->devKind / 4);
+    args.ystep = ay + by * (pShadow->devKind / 4);
+    args.src = (const uint32_t *) ((const uint8_t *) ms->drmmode.shadow_fb +
+                                   sy * pShadow->devKind) + sx;
+    args.width = x2 - x1;
+
+    LS_RunBands(ls_rotate_band, &args, y2 - y1, (x2 - x1) * (y2 - y1));
+
+    return TRUE;
+}
+
+static void ls_composite(CARD8 op, PicturePtr pSrc, PicturePtr pMask,
+                         PicturePtr pDst, INT16 xSrc, INT16 ySrc,
+                         INT16 xMask, INT16 yMask, INT16 xDst, INT16 yDst,
+                         CARD16 width, CARD16 height)
+{
+    ScreenPtr pScreen = pDst->pDrawable->pScreen;
+    modesettingPtr ms = modesettingPTR(xf86ScreenToScrn(pScreen));
+    PictureScreenPtr ps = GetPictureScreen(pScreen);
+
+    if (ls_rotate_composite(pScreen, op, pSrc, pMask, pDst, xSrc, ySrc,
+                            xDst, yDst, width, height))
+    {
+        rotate_hits++;
+        return;
+    }
+
+    if (pSrc->transform && pDst->pDrawable &&
+        ls_rotate_crtc(xf86ScreenToScrn(pScreen), pDst->pDrawable))
+    {
+        rotate_fallbacks++;
+    }
+
+    ps->Composite = ms->Composite;
+    ps->Composite(op, pSrc, pMask, pDst, xSrc, ySrc, xMask, yMask,
+                  xDst, yDst, width, height);
+    ms->Composite = ps->Composite;
+    ps->Composite = ls_composite;
+}
+
+
+Bool LS_RotateInit(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    PictureScreenPtr ps = GetPictureScreenIfSet(pScreen);
+
+    if ((ps == NULL) || !ms->drmmode.shadow_enable)
+    {
+        return FALSE;
+    }
+
+    ms->Composite = ps->Composite;
+    ps->Composite = ls_composite;
+
+    return TRUE;
+}
+
+
+void LS_RotateFini(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    PictureScreenPtr ps = GetPictureScreenIfSet(pScreen);
+
+    if (ms->Composite == NULL)
+    {
+        return;
+    }
+
+    if (ps)
+    {
+        ps->Composite = ms->Composite;
+    }
+
+    ms->Composite = NULL;
+
+    if (rotate_hits || rotate_fallbacks)
+    {
+        xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                   "Rotated crtc updates: %lu with %s kernels, %lu by fb\n",
+                   rotate_hits, lsSimd.name, rotate_fallbacks);
+    }
+}
@@ -22,8 +22,15 @@
 
 #include "loongson_options.h"
 #include "loongson_shadow.h"
+#include "loongson_simd.h"
+#include "loongson_thread_pool.h"
+#include "loongson_shadow_thread.h"
+#include "loongson_tearfree.h"
 #include "driver.h"
 
+/* somewhat arbitrary tile size, in pixels */
+#define LS_SHADOW_TILE  16
+
 Bool LS_ShadowAllocFB(ScrnInfoPtr pScrn)
 {
     modesettingPtr ms = modesettingPTR(pScrn);
@@ -55,6 +62,17 @@ Bool LS_ShadowAllocDoubleFB(ScrnInfoPtr pScrn)
 
     unsigned int bit2byte = (pScrn->bitsPerPixel + 7) >> 3;
 
+    if (ms->drmmode.shadow_hash_enable)
+    {
+        int pitch = (pScrn->displayWidth + LS_SHADOW_TILE - 1) / LS_SHADOW_TILE;
+        int rows = (pScrn->virtualY + LS_SHADOW_TILE - 1) / LS_SHADOW_TILE;
+
+        // all zero, so every tile is dirty the first time it is looked at
+        ms->drmmode.shadow_hash = calloc(pitch * rows, sizeof(uint64_t));
+        ms->drmmode.shadow_hash_pitch = pitch;
+
+        return ms->drmmode.shadow_hash != NULL;
+    }
 
     ms->drmmode.shadow_fb2 = calloc(1,
             pScrn->displayWidth * pScrn->virtualY * bit2byte);
@@ -73,6 +91,9 @@ void LS_ShadowFreeDoubleFB(ScrnInfoPtr pScrn)
 
     free(ms->drmmode.shadow_fb2);
     ms->drmmode.shadow_fb2 = NULL;
+
+    free(ms->drmmode.shadow_hash);
+    ms->drmmode.shadow_hash = NULL;
 }
 
 
@@ -141,6 +162,16 @@ void LS_TryEnableShadow(ScrnInfoPtr pScrn)
 
     ms->drmmode.shadow_enable2 = ms->drmmode.shadow_enable ?
         LS_ShadowShouldDouble(pScrn, ms) : FALSE;
+
+    // a digest per tile instead of a second copy of the framebuffer
+    if (ms->drmmode.shadow_enable2 &&
+        xf86ReturnOptValBool(ms->drmmode.Options, OPTION_SHADOW_HASH, FALSE))
+    {
+        ms->drmmode.shadow_hash_enable = TRUE;
+
+        xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+                   "Double-buffered shadow updates: using tile hashes\n");
+    }
 }
 
 
@@ -156,11 +187,15 @@ void * LS_ShadowWindow(ScreenPtr pScreen, CARD32 row, CARD32 offset,
 }
 
 
+//
+// Bring shadow_fb2 up to date with shadow_fb within @box, compare and
+// copy in one pass per line. @prect gets the bounding box of the pixels
+// that really changed, not the whole tile, so the scanout sees less.
+//
 static Bool msUpdateIntersect(modesettingPtr ms,
         shadowBufPtr pBuf, BoxPtr box, xRectangle *prect)
 {
     int i;
-    Bool dirty = FALSE;
     const unsigned int stride = pBuf->pPixmap->devKind;
     const unsigned int cpp = ms->drmmode.cpp;
     const unsigned int width = (box->x2 - box->x1) * cpp;
@@ -172,48 +207,309 @@ static Bool msUpdateIntersect(modesettingPtr ms,
 
     unsigned int go_to_start = (box->y1 * stride) + (box->x1 * cpp);
 
+    int x1 = width, x2 = 0;
+    int y1 = -1, y2 = 0;
+
     old += go_to_start;
     new += go_to_start;
 
     for (i = 0; i < num_lines; ++i)
     {
-        // unsigned char *o = old + i * stride;
-        // unsigned char *n = new + i * stride;
-        if (memcmp(old, new, width) != 0)
+        int start, end;
+
+        if (lsSimd.CompareCopyRow(old, new, width, &start, &end))
         {
-            dirty = TRUE;
-            memcpy(old, new, width);
+            if (y1 < 0)
+            {
+                y1 = i;
+            }
+            y2 = i + 1;
+
+            if (start < x1)
+            {
+                x1 = start;
+            }
+            if (end > x2)
+            {
+                x2 = end;
+            }
         }
 
         old += stride;
         new += stride;
     }
 
-    if (dirty)
+    if (y1 < 0)
+    {
+        return FALSE;
+    }
+
+    // byte range to whole pixels
+    x1 /= cpp;
+    x2 = (x2 + cpp - 1) / cpp;
+
+    prect->x = box->x1 + x1;
+    prect->y = box->y1 + y1;
+    prect->width = x2 - x1;
+    prect->height = y2 - y1;
+
+    return TRUE;
+}
+
+
+//
+// Hash mode of the double shadow. @box is damaged, rehash the whole tile
+// (@tx, @ty) it lies in and call it dirty when the digest changed. Every
+// change to the shadow is damaged, so rehashing damaged tiles only is
+// enough to keep the digests current.
+//
+static Bool msUpdateHash(modesettingPtr ms, shadowBufPtr pBuf,
+        int tx, int ty, BoxPtr box, xRectangle *prect)
+{
+    PixmapPtr pPixmap = pBuf->pPixmap;
+    const unsigned int stride = pPixmap->devKind;
+    const unsigned int cpp = ms->drmmode.cpp;
+    int x1 = tx * LS_SHADOW_TILE;
+    int y1 = ty * LS_SHADOW_TILE;
+    int x2 = min(x1 + LS_SHADOW_TILE, pPixmap->drawable.width);
+    int y2 = min(y1 + LS_SHADOW_TILE, pPixmap->drawable.height);
+    uint64_t *pHash;
+    uint64_t hash;
+
+    hash = lsSimd.HashRect((const uint8_t *) ms->drmmode.shadow_fb +
+                           y1 * stride + x1 * cpp,
+                           stride, (x2 - x1) * cpp, y2 - y1);
+
+    pHash = &ms->drmmode.shadow_hash[ty * ms->drmmode.shadow_hash_pitch + tx];
+    if (*pHash == hash)
     {
-        prect->x = box->x1;
-        prect->y = box->y1;
-        prect->width = box->x2 - box->x1;
-        prect->height = box->y2 - box->y1;
+        return FALSE;
     }
 
-    return dirty;
+    *pHash = hash;
+
+    prect->x = box->x1;
+    prect->y = box->y1;
+    prect->width = box->x2 - box->x1;
+    prect->height = box->y2 - box->y1;
+
+    return TRUE;
 }
 
 
-void LS_ShadowUpdatePacked(ScreenPtr pScreen, shadowBufPtr pBuf)
+//
+// The shadow flush: damaged boxes are copied to the front BO by the
+// shadow copy thread while the server goes on processing requests.
+// Anything that needs the front BO complete, DirtyFB, a resize or
+// CloseScreen, has to call LS_ShadowFlushWait() first.
+//
+static void ls_shadow_flush_band(void *data, int y, int h)
 {
-/* somewhat arbitrary tile size, in pixels */
-#define TILE 16
+    struct ms_shadow_flush *pFlush = data;
+    int y1 = pFlush->y1 + y;
+    int y2 = y1 + h;
+    int i;
 
-    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    for (i = 0; i < pFlush->nboxes; i++)
+    {
+        const BoxRec *pBox = &pFlush->rects[i];
+        int top = max(pBox->y1, y1);
+        int bottom = min(pBox->y2, y2);
+        int w = pBox->x2 - pBox->x1;
+        const uint8_t *src;
+        uint8_t *dst;
+
+        // region boxes are sorted by y1
+        if (pBox->y1 >= y2)
+        {
+            break;
+        }
+
+        if (top >= bottom)
+        {
+            continue;
+        }
+
+        src = pFlush->src + top * pFlush->src_stride +
+              pBox->x1 * pFlush->src_cpp;
+        dst = pFlush->dst + top * pFlush->dst_stride +
+              pBox->x1 * pFlush->dst_cpp;
+
+        for (; top < bottom; top++)
+        {
+            if (pFlush->dst_cpp != pFlush->src_cpp)
+            {
+                lsSimd.Pack24Row(dst, src, w);
+            }
+            else
+            {
+                lsSimd.UploadRow(dst, src, w * pFlush->src_cpp);
+            }
+
+            src += pFlush->src_stride;
+            dst += pFlush->dst_stride;
+        }
+    }
+}
+
+static void ls_shadow_copy(ScrnInfoPtr pScrn, PixmapPtr pShadow,
+                           RegionPtr damage, uint8_t *dst, int dst_stride,
+                           Bool async)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+    struct ms_shadow_flush *pFlush = &ms->shadow_flush;
+    BoxPtr extents = RegionExtents(damage);
+    int nboxes = RegionNumRects(damage);
+    int pixels = 0;
+    int i;
+
+    // the last flush may still be reading its boxes
+    LS_ShadowFlushWait(pScrn);
+
+    if (nboxes == 0)
+    {
+        return;
+    }
+
+    pFlush->rects = RegionRects(damage);
+    pFlush->nboxes = nboxes;
+
+    for (i = 0; i < nboxes; i++)
+    {
+        const BoxRec *pBox = &pFlush->rects[i];
+
+        pixels += (pBox->x2 - pBox->x1) * (pBox->y2 - pBox->y1);
+    }
+
+    pFlush->y1 = extents->y1;
+    pFlush->src = pShadow->devPrivate.ptr;
+    pFlush->src_stride = pShadow->devKind;
+    pFlush->src_cpp = pShadow->drawable.bitsPerPixel / 8;
+    pFlush->dst = dst;
+    pFlush->dst_stride = dst_stride;
+    pFlush->dst_cpp = ms->drmmode.kbpp / 8;
+
+    pFlush->flushes++;
+    pFlush->bytes += (uint64_t) pixels * pFlush->dst_cpp;
+    pFlush->last_ns = ms_monotonic_ns();
+    if (pFlush->first_ns == 0)
+    {
+        pFlush->first_ns = pFlush->last_ns;
+    }
+
+    if (async && (nboxes > pFlush->size))
+    {
+        BoxPtr boxes = realloc(pFlush->boxes, nboxes * sizeof(BoxRec));
+
+        // no room to keep the boxes for later, copy right away
+        if (boxes == NULL)
+        {
+            async = FALSE;
+        }
+        else
+        {
+            pFlush->boxes = boxes;
+            pFlush->size = nboxes;
+        }
+    }
+
+    if (!async)
+    {
+        LS_RunBands(ls_shadow_flush_band, pFlush,
+                    extents->y2 - extents->y1, pixels);
+        return;
+    }
+
+    memcpy(pFlush->boxes, pFlush->rects, nboxes * sizeof(BoxRec));
+    pFlush->rects = pFlush->boxes;
+
+    if (!LS_ShadowThreadQueue(ls_shadow_flush_band, pFlush,
+                              extents->y1, extents->y2 - extents->y1,
+                              pixels))
+    {
+        LS_RunBands(ls_shadow_flush_band, pFlush,
+                    extents->y2 - extents->y1, pixels);
+    }
+}
+
+static void ls_shadow_flush(ScrnInfoPtr pScrn, shadowBufPtr pBuf,
+                            RegionPtr damage)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+
+    // TearFree copies at flip time, into whichever buffer is hidden
+    if (ms->drmmode.tearfree.enabled)
+    {
+        LS_TearFreeDamage(pScrn, damage);
+        return;
+    }
+
+    ls_shadow_copy(pScrn, pBuf->pPixmap, damage,
+                   ms->drmmode.front_bo.dumb->ptr,
+                   (pScrn->displayWidth * ms->drmmode.kbpp) / 8, TRUE);
+}
+
+
+void LS_ShadowCopyRegion(ScrnInfoPtr pScrn, RegionPtr region,
+                         void *dst, int dst_stride)
+{
+    ScreenPtr pScreen = xf86ScrnToScreen(pScrn);
+
+    ls_shadow_copy(pScrn, pScreen->GetScreenPixmap(pScreen), region,
+                   dst, dst_stride, FALSE);
+}
+
+
+void LS_ShadowFlushWait(ScrnInfoPtr pScrn)
+{
+    LS_ShadowThreadWait();
+}
+
+
+void LS_ShadowFlushInit(ScrnInfoPtr pScrn)
+{
     modesettingPtr ms = modesettingPTR(pScrn);
-    Bool use_3224 = ms->drmmode.force_24_32 && (pScrn->bitsPerPixel == 32);
 
-    if (ms->drmmode.shadow_enable2 && ms->drmmode.shadow_fb2)
+    RegionNull(&ms->shadow_flush.pending);
+}
+
+
+void LS_ShadowFlushFini(ScrnInfoPtr pScrn)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+    struct ms_shadow_flush *pFlush = &ms->shadow_flush;
+
+    LS_ShadowFlushWait(pScrn);
+
+    if (pFlush->last_ns > pFlush->first_ns)
+    {
+        double secs = (pFlush->last_ns - pFlush->first_ns) / 1e9;
+
+        xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                   "shadow flush: %lu flushes, %.1f MiB copied, "
+                   "%.1f flushes/s %.1f MiB/s\n",
+                   pFlush->flushes, pFlush->bytes / 1048576.0,
+                   pFlush->flushes / secs, pFlush->bytes / 1048576.0 / secs);
+    }
+
+    RegionUninit(&pFlush->pending);
+    free(pFlush->boxes);
+    memset(pFlush, 0, sizeof(*pFlush));
+}
+
+
+static void ls_shadow_update(ScrnInfoPtr pScrn, shadowBufPtr pBuf,
+                             RegionPtr damage)
+{
+#define TILE LS_SHADOW_TILE
+
+    modesettingPtr ms = modesettingPTR(pScrn);
+
+    if (ms->drmmode.shadow_enable2 &&
+        (ms->drmmode.shadow_fb2 || ms->drmmode.shadow_hash))
     {
         do {
-            RegionPtr damage = DamageRegion(pBuf->pDamage), tiles;
+            RegionPtr tiles;
             BoxPtr extents = RegionExtents(damage);
             xRectangle *prect;
             int nrects;
@@ -238,13 +534,20 @@ void LS_ShadowUpdatePacked(ScreenPtr pScreen, shadowBufPtr pBuf)
                     box.x2 = min((i+1) * TILE, extents->x2);
                     box.y2 = min((j+1) * TILE, extents->y2);
 
-                    if (RegionContainsRect(damage, &box) != rgnOUT)
+                    if (RegionContainsRect(damage, &box) == rgnOUT)
+                        continue;
+
+                    if (ms->drmmode.shadow_hash)
                     {
-                        if (msUpdateIntersect(ms, pBuf, &box, prect + nrects))
+                        if (msUpdateHash(ms, pBuf, i, j, &box, prect + nrects))
                         {
                             nrects++;
                         }
                     }
+                    else if (msUpdateIntersect(ms, pBuf, &box, prect + nrects))
+                    {
+                        nrects++;
+                    }
                 }
             }
 
@@ -255,15 +558,62 @@ void LS_ShadowUpdatePacked(ScreenPtr pScreen, shadowBufPtr pBuf)
         } while (0);
     }
 
-    if (use_3224)
-        ms->shadow.Update32to24(pScreen, pBuf);
-    else
-        ms->shadow.UpdatePacked(pScreen, pBuf);
+    ls_shadow_flush(pScrn, pBuf, damage);
 
 #undef TILE
 }
 
 
+void LS_ShadowUpdatePacked(ScreenPtr pScreen, shadowBufPtr pBuf)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    struct ms_shadow_flush *pFlush = &ms->shadow_flush;
+
+    // paced: keep the damage until the flush deadline, shadow empties
+    // its own region when we return
+    if (ms->flush_pacing.enabled)
+    {
+        RegionUnion(&pFlush->pending, &pFlush->pending,
+                    DamageRegion(pBuf->pDamage));
+        pFlush->pBuf = pBuf;
+        return;
+    }
+
+    ls_shadow_update(pScrn, pBuf, DamageRegion(pBuf->pDamage));
+}
+
+
+Bool LS_ShadowFlushPending(ScrnInfoPtr pScrn)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+    struct ms_shadow_flush *pFlush = &ms->shadow_flush;
+    PixmapPtr pPixmap;
+    RegionRec screen;
+    BoxRec box;
+
+    if (!RegionNotEmpty(&pFlush->pending))
+    {
+        return FALSE;
+    }
+
+    // the screen may have shrunk since the damage was taken
+    pPixmap = pFlush->pBuf->pPixmap;
+    box.x1 = 0;
+    box.y1 = 0;
+    box.x2 = pPixmap->drawable.width;
+    box.y2 = pPixmap->drawable.height;
+    RegionInit(&screen, &box, 1);
+    RegionIntersect(&pFlush->pending, &pFlush->pending, &screen);
+    RegionUninit(&screen);
+
+    ls_shadow_update(pScrn, pFlush->pBuf, &pFlush->pending);
+    RegionEmpty(&pFlush->pending);
+
+    return TRUE;
+}
+
+
 
 Bool LS_ShadowLoadAPI(ScrnInfoPtr pScrn)
 {
@@ -22,4 +22,16 @@ void * LS_ShadowWindow(ScreenPtr pScreen, CARD32 row, CARD32 offset,
 
 void LS_ShadowUpdatePacked(ScreenPtr pScreen, shadowBufPtr pBuf);
 
+// the front BO is only complete after this, see LS_ShadowUpdatePacked()
+void LS_ShadowFlushWait(ScrnInfoPtr pScrn);
+void LS_ShadowFlushInit(ScrnInfoPtr pScrn);
+void LS_ShadowFlushFini(ScrnInfoPtr pScrn);
+
+// start the flush of the damage held back by flush pacing, FALSE if none
+Bool LS_ShadowFlushPending(ScrnInfoPtr pScrn);
+
+// copy @region of the shadow to a scanout buffer and wait for it
+void LS_ShadowCopyRegion(ScrnInfoPtr pScrn, RegionPtr region,
+                         void *dst, int dst_stride);
+
 #endif
@@ -0,0 +1,295 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#include "config.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <xf86.h>
+#include <damage.h>
+
+#include "driver.h"
+#include "loongson_shadow_thread.h"
+
+// rows released to the renderers at a time, each is split into bands
+// across the thread pool; 32 rows of a 1080p screen are below the
+// pool's threshold and would be copied by this thread alone
+#define LS_SHADOW_CHUNK_HEIGHT  128
+
+struct LoongsonShadowThread {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+
+    pthread_t thread;
+    int refcnt;
+    Bool running;
+    Bool quit;
+
+    // the job being copied, protected by @lock: rows [y1, y2) holding
+    // @pixels pixels, the rows above @next_y are done. The rest is only
+    // written while @busy is clear.
+    Bool busy;
+    LS_BandFunc func;
+    void *data;
+    int y1;
+    int y2;
+    int pixels;
+    int next_y;
+
+    unsigned long jobs;
+    unsigned long stalls;
+};
+
+static struct LoongsonShadowThread lsShadowThread = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+
+struct ls_shadow_chunk {
+    struct LoongsonShadowThread *pThread;
+    // first row of the chunk, relative to the job
+    int y;
+};
+
+static void ls_shadow_chunk_band(void *data, int y, int h)
+{
+    struct ls_shadow_chunk *pChunk = data;
+
+    pChunk->pThread->func(pChunk->pThread->data, pChunk->y + y, h);
+}
+
+static void * ls_shadow_thread_main(void *arg)
+{
+    struct LoongsonShadowThread *pThread = arg;
+
+    pthread_mutex_lock(&pThread->lock);
+
+    while (!pThread->quit)
+    {
+        if (!pThread->busy)
+        {
+            pthread_cond_wait(&pThread->work, &pThread->lock);
+            continue;
+        }
+
+        while (pThread->next_y < pThread->y2)
+        {
+            int y = pThread->next_y;
+            int h = min(LS_SHADOW_CHUNK_HEIGHT, pThread->y2 - y);
+            struct ls_shadow_chunk chunk = { pThread, y - pThread->y1 };
+            int pixels = (int) ((int64_t) pThread->pixels * h /
+                                (pThread->y2 - pThread->y1));
+
+            pthread_mutex_unlock(&pThread->lock);
+            LS_RunBands(ls_shadow_chunk_band, &chunk, h, pixels);
+            pthread_mutex_lock(&pThread->lock);
+
+            pThread->next_y = y + h;
+            pthread_cond_broadcast(&pThread->done);
+        }
+
+        pThread->busy = FALSE;
+        pthread_cond_broadcast(&pThread->done);
+    }
+
+    pthread_mutex_unlock(&pThread->lock);
+
+    return NULL;
+}
+
+//
+// Damage is reported before the rendering happens, hold it back while
+// the copy still has to read the rows it is about to change.
+//
+static void ls_shadow_thread_report(DamagePtr pDamage, RegionPtr pRegion,
+                                    void *closure)
+{
+    struct LoongsonShadowThread *pThread = &lsShadowThread;
+    BoxPtr extents = RegionExtents(pRegion);
+    Bool stalled = FALSE;
+
+    pthread_mutex_lock(&pThread->lock);
+
+    while (pThread->busy && (extents->y1 < pThread->y2) &&
+           (extents->y2 > pThread->next_y))
+    {
+        stalled = TRUE;
+        pthread_cond_wait(&pThread->done, &pThread->lock);
+    }
+
+    pThread->stalls += stalled;
+
+    pthread_mutex_unlock(&pThread->lock);
+}
+
+
+Bool LS_ShadowThreadInit(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    struct LoongsonShadowThread *pThread = &lsShadowThread;
+    PixmapPtr pRoot = pScreen->GetScreenPixmap(pScreen);
+    sigset_t blocked, saved;
+
+    // with a single CPU the copy would only compete with the server
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2)
+    {
+        return FALSE;
+    }
+
+    ms->shadow_flush.band_damage =
+        DamageCreate(ls_shadow_thread_report, NULL, DamageReportRawRegion,
+                     TRUE, pScreen, NULL);
+    if (ms->shadow_flush.band_damage == NULL)
+    {
+        return FALSE;
+    }
+
+    DamageRegister(&pRoot->drawable, ms->shadow_flush.band_damage);
+
+    if (pThread->refcnt++)
+    {
+        return TRUE;
+    }
+
+    pThread->quit = FALSE;
+    pThread->busy = FALSE;
+    pThread->jobs = 0;
+    pThread->stalls = 0;
+
+    // like the pool workers, it must never take the server's signals
+    sigfillset(&blocked);
+    pthread_sigmask(SIG_BLOCK, &blocked, &saved);
+
+    pThread->running = !pthread_create(&pThread->thread, NULL,
+                                       ls_shadow_thread_main, pThread);
+
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    if (!pThread->running)
+    {
+        xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                   "Failed to start the shadow copy thread\n");
+        return FALSE;
+    }
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+               "Copying the shadow framebuffer on a thread of its own\n");
+
+    return TRUE;
+}
+
+
+void LS_ShadowThreadFini(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    struct LoongsonShadowThread *pThread = &lsShadowThread;
+
+    if (ms->shadow_flush.band_damage == NULL)
+    {
+        return;
+    }
+
+    LS_ShadowThreadWait();
+
+    DamageUnregister(ms->shadow_flush.band_damage);
+    DamageDestroy(ms->shadow_flush.band_damage);
+    ms->shadow_flush.band_damage = NULL;
+
+    if ((pThread->refcnt == 0) || --pThread->refcnt)
+    {
+        return;
+    }
+
+    if (pThread->running)
+    {
+        pthread_mutex_lock(&pThread->lock);
+        pThread->quit = TRUE;
+        pthread_cond_broadcast(&pThread->work);
+        pthread_mutex_unlock(&pThread->lock);
+
+        pthread_join(pThread->thread, NULL);
+        pThread->running = FALSE;
+
+        xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                   "shadow copy thread: %lu jobs, %lu renders stalled\n",
+                   pThread->jobs, pThread->stalls);
+    }
+}
+
+
+Bool LS_ShadowThreadQueue(LS_BandFunc func, void *data, int y, int height,
+                          int pixels)
+{
+    struct LoongsonShadowThread *pThread = &lsShadowThread;
+
+    if (!pThread->running)
+    {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&pThread->lock);
+
+    while (pThread->busy)
+    {
+        pthread_cond_wait(&pThread->done, &pThread->lock);
+    }
+
+    pThread->func = func;
+    pThread->data = data;
+    pThread->y1 = y;
+    pThread->y2 = y + height;
+    pThread->pixels = pixels;
+    pThread->next_y = y;
+    pThread->busy = TRUE;
+    pThread->jobs++;
+    pthread_cond_signal(&pThread->work);
+
+    pthread_mutex_unlock(&pThread->lock);
+
+    return TRUE;
+}
+
+
+void LS_ShadowThreadWait(void)
+{
+    struct LoongsonShadowThread *pThread = &lsShadowThread;
+
+    pthread_mutex_lock(&pThread->lock);
+
+    while (pThread->busy)
+    {
+        pthread_cond_wait(&pThread->done, &pThread->lock);
+    }
+
+    pthread_mutex_unlock(&pThread->lock);
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifndef LOONGSON_SHADOW_THREAD_H_
+#define LOONGSON_SHADOW_THREAD_H_
+
+#include <xf86str.h>
+
+#include "loongson_thread_pool.h"
+
+//
+// A thread of its own copying the shadow framebuffer to the front BO,
+// so the copy overlaps with request processing. The job is copied in
+// chunks from top to bottom, each split across the thread pool by
+// LS_RunBands(); rendering into rows the copy hasn't reached yet waits
+// until it has, so every flush shows the shadow as it was when the
+// flush started.
+//
+Bool LS_ShadowThreadInit(ScreenPtr pScreen);
+void LS_ShadowThreadFini(ScreenPtr pScreen);
+
+//
+// Start copying rows [@y, @y + @height) holding @pixels pixels, @func
+// is called for each band with rows relative to @y. Waits for the
+// previous job first, returns FALSE when there is no copy thread and
+// nothing was queued.
+//
+Bool LS_ShadowThreadQueue(LS_BandFunc func, void *data, int y, int height,
+                          int pixels);
+void LS_ShadowThreadWait(void);
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <xf86.h>
+
+#if defined(__loongarch__)
+#include <sys/auxv.h>
+#endif
+
+#include "loongson_simd.h"
+
+#if defined(__loongarch__)
+#ifndef HWCAP_LOONGARCH_LSX
+#define HWCAP_LOONGARCH_LSX     (1 << 4)
+#endif
+#ifndef HWCAP_LOONGARCH_LASX
+#define HWCAP_LOONGARCH_LASX    (1 << 5)
+#endif
+#endif
+
+
+struct LoongsonSimdFuncs lsSimd;
+
+
+//
+// Pick the best kernels the running CPU supports. The compiler only
+// tells us what we *can* build, the auxv/cpuid tells us what we can
+// run, distro packages are built once for every CPU generation.
+//
+void LS_SimdInit(void)
+{
+    if (lsSimd.name != NULL)
+    {
+        return;
+    }
+
+    LS_SimdSetupGeneric(&lsSimd);
+
+#if defined(__loongarch__)
+    {
+        unsigned long hwcap = getauxval(AT_HWCAP);
+
+#ifdef USE_LSX
+        if (hwcap & HWCAP_LOONGARCH_LSX)
+        {
+            LS_SimdSetupLSX(&lsSimd);
+        }
+#endif
+
+#ifdef USE_LASX
+        if (hwcap & HWCAP_LOONGARCH_LASX)
+        {
+            LS_SimdSetupLASX(&lsSimd);
+        }
+#endif
+        (void) hwcap;
+    }
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_cpu_init();
+
+#ifdef USE_SSE2
+    if (__builtin_cpu_supports("sse2"))
+    {
+        LS_SimdSetupSSE2(&lsSimd);
+    }
+#endif
+
+#ifdef USE_AVX2
+    if (__builtin_cpu_supports("avx2"))
+    {
+        LS_SimdSetupAVX2(&lsSimd);
+    }
+#endif
+#endif
+
+    xf86Msg(X_INFO, "loongson: using %s pixel kernels.\n", lsSimd.name);
+}
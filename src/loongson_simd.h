@@ -0,0 +1,126 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifndef LOONGSON_SIMD_H_
+#define LOONGSON_SIMD_H_
+
+#include <stdint.h>
+
+//
+// Pixel kernels used by the software EXA paths. Every entry is filled
+// with a plain C version first, then overridden by whatever the running
+// CPU supports (SSE2/AVX2 on x86, LSX/LASX on LoongArch).
+//
+// All kernels work on raw pixel memory: @bits is the start of the
+// pixmap, @stride its pitch in bytes, @bpp is 8, 16 or 32.
+//
+struct LoongsonSimdFuncs {
+    const char *name;
+
+    void (*FillRect)(void *bits, int stride, int bpp,
+                     int x, int y, int w, int h, uint32_t pixel);
+
+    // forward is safe for dst <= src, backward for dst >= src
+    void (*CopyRow)(uint8_t *dst, const uint8_t *src, int bytes);
+    void (*CopyRowBackward)(uint8_t *dst, const uint8_t *src, int bytes);
+
+    // row movers for write-combined dumb BO mappings: UploadRow only
+    // writes whole aligned vectors, with streaming stores where the CPU
+    // has them, DownloadRow only reads with aligned wide loads.
+    void (*UploadRow)(uint8_t *dst, const uint8_t *src, int bytes);
+    void (*DownloadRow)(uint8_t *dst, const uint8_t *src, int bytes);
+
+    // shadow flush to a 24 bpp front buffer: pack @w 32 bpp pixels into
+    // @dst, written like UploadRow as whole aligned vectors
+    void (*Pack24Row)(uint8_t *dst, const uint8_t *src, int w);
+
+    // rotated crtcs: pixel (x, y) of the @w x @h destination rectangle
+    // is src[x * xstep + y * ystep], steps in pixels. Either |xstep| is
+    // 1, a plain or mirrored copy, or |ystep| is 1, a transpose.
+    void (*RotateRect32)(uint32_t *dst, int dst_stride,
+                         const uint32_t *src, int xstep, int ystep,
+                         int w, int h);
+
+    // double shadow diffing: bring @dst up to date with @src in one pass,
+    // writing only what differs. Returns 0 if the rows were equal, else
+    // the changed bytes are within [*pStart, *pEnd) and that range is
+    // exact at both ends.
+    int (*CompareCopyRow)(uint8_t *dst, const uint8_t *src, int bytes,
+                          int *pStart, int *pEnd);
+
+    // 64 bit digest of @h rows of @bytes each, only used to tell whether
+    // a shadow tile changed, so any strong enough hash will do
+    uint64_t (*HashRect)(const uint8_t *p, int stride, int bytes, int h);
+
+    // Render fast paths, pixel pointers point at the first pixel
+    // of the rectangle, strides are in bytes.
+    void (*CompositeOver8888)(uint32_t *dst, int dst_stride,
+                              const uint32_t *src, int src_stride,
+                              int w, int h);
+    void (*CompositeOverN8888)(uint32_t *dst, int dst_stride,
+                               const uint8_t *mask, int mask_stride,
+                               uint32_t src, int w, int h);
+    void (*CompositeAdd8)(uint8_t *dst, int dst_stride,
+                          const uint8_t *src, int src_stride,
+                          int w, int h);
+    void (*CompositeSrcX888)(uint32_t *dst, int dst_stride,
+                             const uint32_t *src, int src_stride,
+                             int w, int h);
+};
+
+extern struct LoongsonSimdFuncs lsSimd;
+
+//
+// Blit a rectangle, @xdir/@ydir as given to EXA PrepareCopy: negative
+// means walk right to left / bottom to top, which keeps overlapping
+// blits within one pixmap correct without a temporary buffer.
+//
+void LS_CopyRect(const void *src_bits, int src_stride,
+                 void *dst_bits, int dst_stride, int bpp,
+                 int sx, int sy, int dx, int dy, int w, int h,
+                 int xdir, int ydir);
+
+void LS_SimdInit(void);
+
+void LS_SimdSetupGeneric(struct LoongsonSimdFuncs *pFuncs);
+
+#ifdef USE_SSE2
+void LS_SimdSetupSSE2(struct LoongsonSimdFuncs *pFuncs);
+#endif
+
+#ifdef USE_AVX2
+void LS_SimdSetupAVX2(struct LoongsonSimdFuncs *pFuncs);
+#endif
+
+#ifdef USE_LSX
+void LS_SimdSetupLSX(struct LoongsonSimdFuncs *pFuncs);
+#endif
+
+#ifdef USE_LASX
+void LS_SimdSetupLASX(struct LoongsonSimdFuncs *pFuncs);
+#endif
+
+#endif
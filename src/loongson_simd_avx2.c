@@ -0,0 +1,563 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <immintrin.h>
+
+#include "loongson_simd_priv.h"
+
+
+static void ls_fill_rect_avx2(void *bits, int stride, int bpp,
+        int x, int y, int w, int h, uint32_t pixel)
+{
+    const int cpp = bpp >> 3;
+    const uint32_t pattern = ls_replicate_pixel(pixel, bpp);
+    const __m256i v = _mm256_set1_epi32((int) pattern);
+    uint8_t *row = (uint8_t *) bits + y * stride + x * cpp;
+
+    while (h--)
+    {
+        int bytes = w * cpp;
+        uint8_t *d = ls_fill_head(row, &bytes, pattern, 32);
+
+        while (bytes >= 128)
+        {
+            _mm256_store_si256((__m256i *) (d +  0), v);
+            _mm256_store_si256((__m256i *) (d + 32), v);
+            _mm256_store_si256((__m256i *) (d + 64), v);
+            _mm256_store_si256((__m256i *) (d + 96), v);
+            d += 128;
+            bytes -= 128;
+        }
+
+        while (bytes >= 32)
+        {
+            _mm256_store_si256((__m256i *) d, v);
+            d += 32;
+            bytes -= 32;
+        }
+
+        ls_fill_tail(d, bytes, pattern);
+
+        row += stride;
+    }
+}
+
+
+
+static void ls_copy_row_avx2(uint8_t *d, const uint8_t *s, int bytes)
+{
+    while (((uintptr_t) d & 31) && bytes)
+    {
+        *d++ = *s++;
+        bytes--;
+    }
+
+    while (bytes >= 128)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *) s);
+        __m256i b = _mm256_loadu_si256((const __m256i *) (s + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i *) (s + 64));
+        __m256i e = _mm256_loadu_si256((const __m256i *) (s + 96));
+
+        _mm256_store_si256((__m256i *) d, a);
+        _mm256_store_si256((__m256i *) (d + 32), b);
+        _mm256_store_si256((__m256i *) (d + 64), c);
+        _mm256_store_si256((__m256i *) (d + 96), e);
+        d += 128;
+        s += 128;
+        bytes -= 128;
+    }
+
+    while (bytes >= 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *) s);
+
+        _mm256_store_si256((__m256i *) d, a);
+        d += 32;
+        s += 32;
+        bytes -= 32;
+    }
+
+    while (bytes--)
+    {
+        *d++ = *s++;
+    }
+}
+
+static void ls_copy_row_backward_avx2(uint8_t *d, const uint8_t *s, int bytes)
+{
+    d += bytes;
+    s += bytes;
+
+    while (((uintptr_t) d & 31) && bytes)
+    {
+        *--d = *--s;
+        bytes--;
+    }
+
+    while (bytes >= 128)
+    {
+        __m256i a, b, c, e;
+
+        d -= 128;
+        s -= 128;
+        a = _mm256_loadu_si256((const __m256i *) s);
+        b = _mm256_loadu_si256((const __m256i *) (s + 32));
+        c = _mm256_loadu_si256((const __m256i *) (s + 64));
+        e = _mm256_loadu_si256((const __m256i *) (s + 96));
+
+        _mm256_store_si256((__m256i *) d, a);
+        _mm256_store_si256((__m256i *) (d + 32), b);
+        _mm256_store_si256((__m256i *) (d + 64), c);
+        _mm256_store_si256((__m256i *) (d + 96), e);
+        bytes -= 128;
+    }
+
+    while (bytes >= 32)
+    {
+        __m256i a;
+
+        d -= 32;
+        s -= 32;
+        a = _mm256_loadu_si256((const __m256i *) s);
+        _mm256_store_si256((__m256i *) d, a);
+        bytes -= 32;
+    }
+
+    while (bytes--)
+    {
+        *--d = *--s;
+    }
+}
+
+
+static void ls_upload_row_avx2(uint8_t *d, const uint8_t *s, int bytes)
+{
+    while (((uintptr_t) d & 31) && bytes)
+    {
+        *d++ = *s++;
+        bytes--;
+    }
+
+    while (bytes >= 128)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *) s);
+        __m256i b = _mm256_loadu_si256((const __m256i *) (s + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i *) (s + 64));
+        __m256i e = _mm256_loadu_si256((const __m256i *) (s + 96));
+
+        _mm256_stream_si256((__m256i *) d, a);
+        _mm256_stream_si256((__m256i *) (d + 32), b);
+        _mm256_stream_si256((__m256i *) (d + 64), c);
+        _mm256_stream_si256((__m256i *) (d + 96), e);
+        d += 128;
+        s += 128;
+        bytes -= 128;
+    }
+
+    while (bytes >= 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *) s);
+
+        _mm256_stream_si256((__m256i *) d, a);
+        d += 32;
+        s += 32;
+        bytes -= 32;
+    }
+
+    while (bytes--)
+    {
+        *d++ = *s++;
+    }
+
+    _mm_sfence();
+}
+
+//
+// 32 to 24 bpp with PSHUFB. VPSHUFB only shuffles within 128 bit lanes
+// and a 24 byte group straddles them, so this stays on xmm registers:
+// 16 pixels, three streaming stores.
+//
+static void ls_pack24_row_avx2(uint8_t *d, const uint8_t *s, int w)
+{
+    const __m128i idx = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10,
+                                      12, 13, 14, -1, -1, -1, -1);
+    int n = ls_pack24_head(d, w, 16);
+
+    ls_pack24_pixels(d, s, n);
+    d += 3 * n;
+    s += 4 * n;
+    w -= n;
+
+    while (w >= 16)
+    {
+        __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) s), idx);
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (s + 16)), idx);
+        __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (s + 32)), idx);
+        __m128i e = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (s + 48)), idx);
+
+        _mm_stream_si128((__m128i *) d,
+                         _mm_or_si128(a, _mm_slli_si128(b, 12)));
+        _mm_stream_si128((__m128i *) (d + 16),
+                         _mm_or_si128(_mm_srli_si128(b, 4),
+                                      _mm_slli_si128(c, 8)));
+        _mm_stream_si128((__m128i *) (d + 32),
+                         _mm_or_si128(_mm_srli_si128(c, 8),
+                                      _mm_slli_si128(e, 4)));
+        d += 48;
+        s += 64;
+        w -= 16;
+    }
+
+    ls_pack24_pixels(d, s, w);
+
+    _mm_sfence();
+}
+
+// MOVNTDQA, reads write-combined memory a full line at a time
+static void ls_download_row_avx2(uint8_t *d, const uint8_t *s, int bytes)
+{
+    while (((uintptr_t) s & 31) && bytes)
+    {
+        *d++ = *s++;
+        bytes--;
+    }
+
+    while (bytes >= 128)
+    {
+        __m256i a = _mm256_stream_load_si256((const __m256i *) s);
+        __m256i b = _mm256_stream_load_si256((const __m256i *) (s + 32));
+        __m256i c = _mm256_stream_load_si256((const __m256i *) (s + 64));
+        __m256i e = _mm256_stream_load_si256((const __m256i *) (s + 96));
+
+        _mm256_storeu_si256((__m256i *) d, a);
+        _mm256_storeu_si256((__m256i *) (d + 32), b);
+        _mm256_storeu_si256((__m256i *) (d + 64), c);
+        _mm256_storeu_si256((__m256i *) (d + 96), e);
+        d += 128;
+        s += 128;
+        bytes -= 128;
+    }
+
+    while (bytes >= 32)
+    {
+        __m256i a = _mm256_stream_load_si256((const __m256i *) s);
+
+        _mm256_storeu_si256((__m256i *) d, a);
+        d += 32;
+        s += 32;
+        bytes -= 32;
+    }
+
+    while (bytes--)
+    {
+        *d++ = *s++;
+    }
+}
+
+//
+// Double shadow diff, same scheme as the SSE2 version with 32 byte chunks.
+//
+static inline void ls_cmp_copy_chunk_avx2(uint8_t *d, const uint8_t *s,
+                                          int off, int *pStart, int *pEnd)
+{
+    __m256i a = _mm256_load_si256((const __m256i *) d);
+    __m256i b = _mm256_loadu_si256((const __m256i *) s);
+
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) != -1)
+    {
+        ls_cmp_mark(d, s, 32, off, pStart, pEnd);
+        _mm256_store_si256((__m256i *) d, b);
+    }
+}
+
+static int ls_compare_copy_row_avx2(uint8_t *d, const uint8_t *s, int bytes,
+                                    int *pStart, int *pEnd)
+{
+    int off = (int) (-(uintptr_t) d & 31);
+    int i;
+
+    *pStart = -1;
+    *pEnd = 0;
+
+    if (off > bytes)
+    {
+        off = bytes;
+    }
+    ls_cmp_copy_bytes(d, s, off, 0, pStart, pEnd);
+
+    for (; bytes - off >= 128; off += 128)
+    {
+        const __m256i *pa = (const __m256i *) (d + off);
+        const __m256i *pb = (const __m256i *) (s + off);
+        __m256i e0 = _mm256_cmpeq_epi8(_mm256_load_si256(pa),
+                                       _mm256_loadu_si256(pb));
+        __m256i e1 = _mm256_cmpeq_epi8(_mm256_load_si256(pa + 1),
+                                       _mm256_loadu_si256(pb + 1));
+        __m256i e2 = _mm256_cmpeq_epi8(_mm256_load_si256(pa + 2),
+                                       _mm256_loadu_si256(pb + 2));
+        __m256i e3 = _mm256_cmpeq_epi8(_mm256_load_si256(pa + 3),
+                                       _mm256_loadu_si256(pb + 3));
+        __m256i eq = _mm256_and_si256(_mm256_and_si256(e0, e1),
+                                      _mm256_and_si256(e2, e3));
+
+        if (_mm256_movemask_epi8(eq) != -1)
+        {
+            for (i = 0; i < 128; i += 32)
+            {
+                ls_cmp_copy_chunk_avx2(d + off + i, s + off + i, off + i,
+                                       pStart, pEnd);
+            }
+        }
+    }
+
+    for (; bytes - off >= 32; off += 32)
+    {
+        ls_cmp_copy_chunk_avx2(d + off, s + off, off, pStart, pEnd);
+    }
+
+    ls_cmp_copy_bytes(d + off, s + off, bytes - off, off, pStart, pEnd);
+
+    return *pStart >= 0;
+}
+
+
+static inline __m256i ls_mul_16_avx2(__m256i x, __m256i a)
+{
+    const __m256i round = _mm256_set1_epi16(0x0080);
+    const __m256i div = _mm256_set1_epi16(0x0101);
+
+    return _mm256_mulhi_epu16(_mm256_adds_epu16(_mm256_mullo_epi16(x, a), round), div);
+}
+
+static inline __m256i ls_alpha_16_avx2(__m256i x)
+{
+    x = _mm256_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm256_shufflehi_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+static inline __m256i ls_over_8_avx2(__m256i s, __m256i d)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i mask_00ff = _mm256_set1_epi16(0x00ff);
+    __m256i ilo = _mm256_xor_si256(ls_alpha_16_avx2(_mm256_unpacklo_epi8(s, zero)), mask_00ff);
+    __m256i ihi = _mm256_xor_si256(ls_alpha_16_avx2(_mm256_unpackhi_epi8(s, zero)), mask_00ff);
+    __m256i dlo = ls_mul_16_avx2(_mm256_unpacklo_epi8(d, zero), ilo);
+    __m256i dhi = ls_mul_16_avx2(_mm256_unpackhi_epi8(d, zero), ihi);
+
+    return _mm256_adds_epu8(s, _mm256_packus_epi16(dlo, dhi));
+}
+
+static void ls_composite_over_8888_avx2(uint32_t *dst, int dst_stride,
+        const uint32_t *src, int src_stride, int w, int h)
+{
+    const __m256i opaque = _mm256_set1_epi32((int) 0xff000000);
+
+    while (h--)
+    {
+        uint32_t *d = dst;
+        const uint32_t *s = src;
+        int n = w;
+
+        while (n >= 8)
+        {
+            __m256i vs = _mm256_loadu_si256((const __m256i *) s);
+
+            if (_mm256_testc_si256(vs, opaque))
+            {
+                _mm256_storeu_si256((__m256i *) d, vs);
+            }
+            else if (!_mm256_testz_si256(vs, vs))
+            {
+                __m256i vd = _mm256_loadu_si256((const __m256i *) d);
+
+                _mm256_storeu_si256((__m256i *) d, ls_over_8_avx2(vs, vd));
+            }
+
+            d += 8;
+            s += 8;
+            n -= 8;
+        }
+
+        while (n--)
+        {
+            if ((*s >> 24) == 0xff)
+                *d = *s;
+            else if (*s)
+                *d = ls_over_8888(*s, *d);
+            d++;
+            s++;
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        src = (const uint32_t *) ((const uint8_t *) src + src_stride);
+    }
+}
+
+static void ls_composite_over_n_8_8888_avx2(uint32_t *dst, int dst_stride,
+        const uint8_t *mask, int mask_stride, uint32_t src, int w, int h)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i vsrc = _mm256_set1_epi32((int) src);
+    const __m256i src16 = _mm256_unpacklo_epi8(vsrc, zero);
+    const __m256i replicate = _mm256_set1_epi32(0x01010101);
+    const int opaque = (src >> 24) == 0xff;
+
+    while (h--)
+    {
+        uint32_t *d = dst;
+        const uint8_t *m = mask;
+        int n = w;
+
+        while (n >= 8)
+        {
+            uint64_t m8;
+
+            memcpy(&m8, m, 8);
+
+            if (opaque && (m8 == ~(uint64_t) 0))
+            {
+                _mm256_storeu_si256((__m256i *) d, vsrc);
+            }
+            else if (m8)
+            {
+                __m256i vm = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) m));
+                __m256i vd = _mm256_loadu_si256((const __m256i *) d);
+                __m256i slo, shi;
+
+                vm = _mm256_mullo_epi32(vm, replicate);
+                slo = ls_mul_16_avx2(src16, _mm256_unpacklo_epi8(vm, zero));
+                shi = ls_mul_16_avx2(src16, _mm256_unpackhi_epi8(vm, zero));
+
+                _mm256_storeu_si256((__m256i *) d,
+                        ls_over_8_avx2(_mm256_packus_epi16(slo, shi), vd));
+            }
+
+            d += 8;
+            m += 8;
+            n -= 8;
+        }
+
+        while (n--)
+        {
+            if (opaque && (*m == 0xff))
+                *d = src;
+            else if (*m)
+                *d = ls_over_8888(ls_mul_un8x4(src, *m), *d);
+            d++;
+            m++;
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        mask += mask_stride;
+    }
+}
+
+static void ls_composite_add_8_avx2(uint8_t *dst, int dst_stride,
+        const uint8_t *src, int src_stride, int w, int h)
+{
+    while (h--)
+    {
+        uint8_t *d = dst;
+        const uint8_t *s = src;
+        int n = w;
+
+        while (n >= 32)
+        {
+            __m256i vs = _mm256_loadu_si256((const __m256i *) s);
+            __m256i vd = _mm256_loadu_si256((const __m256i *) d);
+
+            _mm256_storeu_si256((__m256i *) d, _mm256_adds_epu8(vs, vd));
+            d += 32;
+            s += 32;
+            n -= 32;
+        }
+
+        while (n--)
+        {
+            *d = ls_add_un8(*d, *s);
+            d++;
+            s++;
+        }
+
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+static void ls_composite_src_x888_8888_avx2(uint32_t *dst, int dst_stride,
+        const uint32_t *src, int src_stride, int w, int h)
+{
+    const __m256i alpha = _mm256_set1_epi32((int) 0xff000000);
+
+    while (h--)
+    {
+        uint32_t *d = dst;
+        const uint32_t *s = src;
+        int n = w;
+
+        while (n >= 8)
+        {
+            __m256i vs = _mm256_loadu_si256((const __m256i *) s);
+
+            _mm256_storeu_si256((__m256i *) d, _mm256_or_si256(vs, alpha));
+            d += 8;
+            s += 8;
+            n -= 8;
+        }
+
+        while (n--)
+        {
+            *d++ = *s++ | 0xff000000;
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        src = (const uint32_t *) ((const uint8_t *) src + src_stride);
+    }
+}
+
+
+void LS_SimdSetupAVX2(struct LoongsonSimdFuncs *pFuncs)
+{
+    pFuncs->name = "avx2";
+    pFuncs->FillRect = ls_fill_rect_avx2;
+    pFuncs->CopyRow = ls_copy_row_avx2;
+    pFuncs->CopyRowBackward = ls_copy_row_backward_avx2;
+    pFuncs->UploadRow = ls_upload_row_avx2;
+    pFuncs->Pack24Row = ls_pack24_row_avx2;
+    // RotateRect32 stays with SSE2, transposes are bound by the column
+    // reads rather than the shuffles
+    pFuncs->DownloadRow = ls_download_row_avx2;
+    pFuncs->CompareCopyRow = ls_compare_copy_row_avx2;
+    pFuncs->CompositeOver8888 = ls_composite_over_8888_avx2;
+    pFuncs->CompositeOverN8888 = ls_composite_over_n_8_8888_avx2;
+    pFuncs->CompositeAdd8 = ls_composite_add_8_avx2;
+    pFuncs->CompositeSrcX888 = ls_composite_src_x888_8888_avx2;
+}
@@ -0,0 +1,524 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#if defined(__loongarch64)
+#include <larchintrin.h>
+#endif
+
+#include "loongson_simd_priv.h"
+
+//
+// Plain C kernels, the reference every other ISA must match
+// bit for bit. These are also what runs on CPUs without SIMD.
+//
+
+static void ls_fill_rect_generic(void *bits, int stride, int bpp,
+        int x, int y, int w, int h, uint32_t pixel)
+{
+    const int cpp = bpp >> 3;
+    const uint32_t pattern = ls_replicate_pixel(pixel, bpp);
+    const uint64_t pattern64 = ((uint64_t) pattern << 32) | pattern;
+    uint8_t *row = (uint8_t *) bits + y * stride + x * cpp;
+
+    while (h--)
+    {
+        int bytes = w * cpp;
+        uint8_t *d = ls_fill_head(row, &bytes, pattern, 8);
+
+        while (bytes >= 32)
+        {
+            ((uint64_t *) d)[0] = pattern64;
+            ((uint64_t *) d)[1] = pattern64;
+            ((uint64_t *) d)[2] = pattern64;
+            ((uint64_t *) d)[3] = pattern64;
+            d += 32;
+            bytes -= 32;
+        }
+
+        while (bytes >= 8)
+        {
+            *(uint64_t *) d = pattern64;
+            d += 8;
+            bytes -= 8;
+        }
+
+        ls_fill_tail(d, bytes, pattern);
+
+        row += stride;
+    }
+}
+
+
+//
+// Row movers. The forward one is safe as long as dst <= src, the
+// backward one as long as dst >= src, which is all an overlapping
+// blit within one scanline needs.
+//
+static void ls_copy_row_generic(uint8_t *d, const uint8_t *s, int bytes)
+{
+    while (((uintptr_t) d & 7) && bytes)
+    {
+        *d++ = *s++;
+        bytes--;
+    }
+
+    while (bytes >= 8)
+    {
+        uint64_t t;
+
+        memcpy(&t, s, 8);
+        *(uint64_t *) d = t;
+        d += 8;
+        s += 8;
+        bytes -= 8;
+    }
+
+    while (bytes--)
+    {
+        *d++ = *s++;
+    }
+}
+
+static void ls_copy_row_backward_generic(uint8_t *d, const uint8_t *s, int bytes)
+{
+    d += bytes;
+    s += bytes;
+
+    while (((uintptr_t) d & 7) && bytes)
+    {
+        *--d = *--s;
+        bytes--;
+    }
+
+    while (bytes >= 8)
+    {
+        uint64_t t;
+
+        d -= 8;
+        s -= 8;
+        memcpy(&t, s, 8);
+        *(uint64_t *) d = t;
+        bytes -= 8;
+    }
+
+    while (bytes--)
+    {
+        *--d = *--s;
+    }
+}
+
+//
+// Double shadow diff, one word compare per 8 bytes and a store only
+// where the words differ.
+//
+static int ls_compare_copy_row_generic(uint8_t *d, const uint8_t *s,
+                                       int bytes, int *pStart, int *pEnd)
+{
+    int off = (int) (-(uintptr_t) d & 7);
+
+    *pStart = -1;
+    *pEnd = 0;
+
+    if (off > bytes)
+    {
+        off = bytes;
+    }
+    ls_cmp_copy_bytes(d, s, off, 0, pStart, pEnd);
+
+    for (; bytes - off >= 8; off += 8)
+    {
+        uint64_t t;
+
+        memcpy(&t, s + off, 8);
+        if (*(const uint64_t *) (d + off) != t)
+        {
+            ls_cmp_mark(d + off, s + off, 8, off, pStart, pEnd);
+            *(uint64_t *) (d + off) = t;
+        }
+    }
+
+    ls_cmp_copy_bytes(d + off, s + off, bytes - off, off, pStart, pEnd);
+
+    return *pStart >= 0;
+}
+
+
+//
+// 32 to 24 bpp, four pixels make three words so every store is a full
+// aligned word. The shifts assume a little endian word layout.
+//
+static void ls_pack24_row_generic(uint8_t *d, const uint8_t *s, int w)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    int n = ls_pack24_head(d, w, 4);
+
+    ls_pack24_pixels(d, s, n);
+    d += 3 * n;
+    s += 4 * n;
+    w -= n;
+
+    while (w >= 4)
+    {
+        const uint32_t *p = (const uint32_t *) s;
+        uint32_t *q = (uint32_t *) d;
+
+        q[0] = (p[0] & 0x00ffffff) | (p[1] << 24);
+        q[1] = ((p[1] >> 8) & 0x0000ffff) | (p[2] << 16);
+        q[2] = ((p[2] >> 16) & 0x000000ff) | (p[3] << 8);
+        d += 12;
+        s += 16;
+        w -= 4;
+    }
+#endif
+
+    ls_pack24_pixels(d, s, w);
+}
+
+
+//
+// Rotation, one pixel at a time. Transposes go in strips of a few
+// destination rows, so the source lines read down a column are still
+// cached when the next rows come back for the pixels next to them.
+//
+#define LS_ROTATE_STRIP     8
+
+static void ls_rotate_rect32_generic(uint32_t *dst, int dst_stride,
+                                     const uint32_t *src, int xstep,
+                                     int ystep, int w, int h)
+{
+    int x, y, y1;
+
+    if (xstep == 1)
+    {
+        for (y = 0; y < h; y++)
+        {
+            ls_copy_row_generic((uint8_t *) dst + y * dst_stride,
+                                (const uint8_t *) (src + y * ystep), w * 4);
+        }
+        return;
+    }
+
+    for (y1 = 0; y1 < h; y1 += LS_ROTATE_STRIP)
+    {
+        int y2 = (h - y1 > LS_ROTATE_STRIP) ? y1 + LS_ROTATE_STRIP : h;
+
+        for (x = 0; x < w; x += LS_ROTATE_STRIP)
+        {
+            int n = (w - x > LS_ROTATE_STRIP) ? LS_ROTATE_STRIP : w - x;
+
+            for (y = y1; y < y2; y++)
+            {
+                ls_rotate_pixels((uint32_t *) ((uint8_t *) dst + y * dst_stride) + x,
+                                 src + x * xstep + y * ystep, xstep, n);
+            }
+        }
+    }
+}
+
+
+#if !defined(__loongarch64)
+//
+// Tile hash, xxHash64 rounds on four lanes of 8 bytes. The lanes carry
+// over from row to row, rows of a shadow tile are only 64 bytes.
+//
+#define LS_PRIME64_1    0x9e3779b185ebca87ULL
+#define LS_PRIME64_2    0xc2b2ae3d27d4eb4fULL
+#define LS_PRIME64_3    0x165667b19e3779f9ULL
+
+static inline uint64_t ls_rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t ls_hash_round(uint64_t acc, const uint8_t *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, 8);
+    acc += v * LS_PRIME64_2;
+    return ls_rotl64(acc, 31) * LS_PRIME64_1;
+}
+
+static uint64_t ls_hash_rect_generic(const uint8_t *p, int stride,
+                                     int bytes, int h)
+{
+    uint64_t v0 = LS_PRIME64_1 + LS_PRIME64_2;
+    uint64_t v1 = LS_PRIME64_2;
+    uint64_t v2 = 0;
+    uint64_t v3 = -LS_PRIME64_1;
+    uint64_t hash;
+
+    for (; h > 0; h--, p += stride)
+    {
+        int i = 0;
+
+        for (; i + 32 <= bytes; i += 32)
+        {
+            v0 = ls_hash_round(v0, p + i);
+            v1 = ls_hash_round(v1, p + i + 8);
+            v2 = ls_hash_round(v2, p + i + 16);
+            v3 = ls_hash_round(v3, p + i + 24);
+        }
+
+        for (; i + 8 <= bytes; i += 8)
+        {
+            v0 = ls_hash_round(v0, p + i);
+        }
+
+        for (; i < bytes; i++)
+        {
+            v1 = ls_rotl64(v1 ^ (p[i] * LS_PRIME64_3), 11) * LS_PRIME64_1;
+        }
+    }
+
+    hash = ls_rotl64(v0, 1) + ls_rotl64(v1, 7) +
+           ls_rotl64(v2, 12) + ls_rotl64(v3, 18);
+
+    hash ^= hash >> 33;
+    hash *= LS_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= LS_PRIME64_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+#else
+//
+// LA64 always has the CRC instructions. CRC32C and CRC32 together act
+// as one 64 bit CRC, the two polynomials share no factor, so a change
+// slipping through both is as unlikely as with a 64 bit hash.
+//
+static uint64_t ls_hash_rect_crc(const uint8_t *p, int stride,
+                                 int bytes, int h)
+{
+    int c = -1;
+    int d = -1;
+
+    for (; h > 0; h--, p += stride)
+    {
+        int i = 0;
+
+        for (; i + 8 <= bytes; i += 8)
+        {
+            long v;
+
+            memcpy(&v, p + i, 8);
+            c = __crcc_w_d_w(v, c);
+            d = __crc_w_d_w(v, d);
+        }
+
+        for (; i < bytes; i++)
+        {
+            c = __crcc_w_b_w((char) p[i], c);
+            d = __crc_w_b_w((char) p[i], d);
+        }
+    }
+
+    return ((uint64_t) (uint32_t) c << 32) | (uint32_t) d;
+}
+#endif
+
+
+static void ls_composite_over_8888_generic(uint32_t *dst, int dst_stride,
+        const uint32_t *src, int src_stride, int w, int h)
+{
+    while (h--)
+    {
+        int i;
+
+        for (i = 0; i < w; i++)
+        {
+            uint32_t s = src[i];
+            uint32_t a = s >> 24;
+
+            if (a == 0xff)
+            {
+                dst[i] = s;
+            }
+            else if (s)
+            {
+                dst[i] = ls_over_8888(s, dst[i]);
+            }
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        src = (const uint32_t *) ((const uint8_t *) src + src_stride);
+    }
+}
+
+static void ls_composite_over_n_8_8888_generic(uint32_t *dst, int dst_stride,
+        const uint8_t *mask, int mask_stride, uint32_t src, int w, int h)
+{
+    const uint32_t sa = src >> 24;
+
+    while (h--)
+    {
+        int i;
+
+        for (i = 0; i < w; i++)
+        {
+            uint32_t m = mask[i];
+
+            if ((m == 0xff) && (sa == 0xff))
+            {
+                dst[i] = src;
+            }
+            else if (m)
+            {
+                dst[i] = ls_over_8888(ls_mul_un8x4(src, m), dst[i]);
+            }
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        mask += mask_stride;
+    }
+}
+
+static void ls_composite_add_8_generic(uint8_t *dst, int dst_stride,
+        const uint8_t *src, int src_stride, int w, int h)
+{
+    while (h--)
+    {
+        int i;
+
+        for (i = 0; i < w; i++)
+        {
+            dst[i] = ls_add_un8(dst[i], src[i]);
+        }
+
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+static void ls_composite_src_x888_8888_generic(uint32_t *dst, int dst_stride,
+        const uint32_t *src, int src_stride, int w, int h)
+{
+    while (h--)
+    {
+        int i;
+
+        for (i = 0; i < w; i++)
+        {
+            dst[i] = src[i] | 0xff000000;
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        src = (const uint32_t *) ((const uint8_t *) src + src_stride);
+    }
+}
+
+void LS_CopyRect(const void *src_bits, int src_stride,
+                 void *dst_bits, int dst_stride, int bpp,
+                 int sx, int sy, int dx, int dy, int w, int h,
+                 int xdir, int ydir)
+{
+    const int cpp = bpp >> 3;
+    const int bytes = w * cpp;
+    const uint8_t *s = (const uint8_t *) src_bits + sy * src_stride + sx * cpp;
+    uint8_t *d = (uint8_t *) dst_bits + dy * dst_stride + dx * cpp;
+    void (*copy_row)(uint8_t *, const uint8_t *, int) = lsSimd.CopyRow;
+
+    if ((w <= 0) || (h <= 0))
+    {
+        return;
+    }
+
+    if (xdir < 0)
+    {
+        copy_row = lsSimd.CopyRowBackward;
+    }
+
+    //
+    // Vertical scroll of whole scanlines: the rows are contiguous in
+    // memory, so move the block in one go, in the direction that does
+    // not overwrite lines not yet read.
+    //
+    if ((src_bits == dst_bits) && (sx == dx) && (src_stride == dst_stride) &&
+        (bytes == src_stride))
+    {
+        if (ydir < 0)
+        {
+            lsSimd.CopyRowBackward(d, s, bytes * h);
+        }
+        else
+        {
+            lsSimd.CopyRow(d, s, bytes * h);
+        }
+
+        return;
+    }
+
+    if (ydir < 0)
+    {
+        s += (h - 1) * src_stride;
+        d += (h - 1) * dst_stride;
+
+        while (h--)
+        {
+            copy_row(d, s, bytes);
+            s -= src_stride;
+            d -= dst_stride;
+        }
+    }
+    else
+    {
+        while (h--)
+        {
+            copy_row(d, s, bytes);
+            s += src_stride;
+            d += dst_stride;
+        }
+    }
+}
+
+
+void LS_SimdSetupGeneric(struct LoongsonSimdFuncs *pFuncs)
+{
+    pFuncs->name = "generic";
+    pFuncs->FillRect = ls_fill_rect_generic;
+    pFuncs->CopyRow = ls_copy_row_generic;
+    pFuncs->CopyRowBackward = ls_copy_row_backward_generic;
+    pFuncs->UploadRow = ls_copy_row_generic;
+    pFuncs->DownloadRow = ls_copy_row_generic;
+    pFuncs->Pack24Row = ls_pack24_row_generic;
+    pFuncs->RotateRect32 = ls_rotate_rect32_generic;
+    pFuncs->CompareCopyRow = ls_compare_copy_row_generic;
+#if defined(__loongarch64)
+    pFuncs->HashRect = ls_hash_rect_crc;
+#else
+    pFuncs->HashRect = ls_hash_rect_generic;
+#endif
+    pFuncs->CompositeOver8888 = ls_composite_over_8888_generic;
+    pFuncs->CompositeOverN8888 = ls_composite_over_n_8_8888_generic;
+    pFuncs->CompositeAdd8 = ls_composite_add_8_generic;
+    pFuncs->CompositeSrcX888 = ls_composite_src_x888_8888_generic;
+}
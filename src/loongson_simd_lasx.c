@@ -0,0 +1,466 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <lasxintrin.h>
+
+#include "loongson_simd_priv.h"
+
+
+static void ls_fill_rect_lasx(void *bits, int stride, int bpp,
+        int x, int y, int w, int h, uint32_t pixel)
+{
+    const int cpp = bpp >> 3;
+    const uint32_t pattern = ls_replicate_pixel(pixel, bpp);
+    const __m256i v = __lasx_xvreplgr2vr_w((int) pattern);
+    uint8_t *row = (uint8_t *) bits + y * stride + x * cpp;
+
+    while (h--)
+    {
+        int bytes = w * cpp;
+        uint8_t *d = ls_fill_head(row, &bytes, pattern, 32);
+
+        while (bytes >= 128)
+        {
+            __lasx_xvst(v, d, 0);
+            __lasx_xvst(v, d, 32);
+            __lasx_xvst(v, d, 64);
+            __lasx_xvst(v, d, 96);
+            d += 128;
+            bytes -= 128;
+        }
+
+        while (bytes >= 32)
+        {
+            __lasx_xvst(v, d, 0);
+            d += 32;
+            bytes -= 32;
+        }
+
+        ls_fill_tail(d, bytes, pattern);
+
+        row += stride;
+    }
+}
+
+
+
+static void ls_copy_row_lasx(uint8_t *d, const uint8_t *s, int bytes)
+{
+    while (((uintptr_t) d & 31) && bytes)
+    {
+        *d++ = *s++;
+        bytes--;
+    }
+
+    while (bytes >= 128)
+    {
+        __m256i a = __lasx_xvld(s, 0);
+        __m256i b = __lasx_xvld(s, 32);
+        __m256i c = __lasx_xvld(s, 64);
+        __m256i e = __lasx_xvld(s, 96);
+
+        __lasx_xvst(a, d, 0);
+        __lasx_xvst(b, d, 32);
+        __lasx_xvst(c, d, 64);
+        __lasx_xvst(e, d, 96);
+        d += 128;
+        s += 128;
+        bytes -= 128;
+    }
+
+    while (bytes >= 32)
+    {
+        __m256i a = __lasx_xvld(s, 0);
+
+        __lasx_xvst(a, d, 0);
+        d += 32;
+        s += 32;
+        bytes -= 32;
+    }
+
+    while (bytes--)
+    {
+        *d++ = *s++;
+    }
+}
+
+static void ls_copy_row_backward_lasx(uint8_t *d, const uint8_t *s, int bytes)
+{
+    d += bytes;
+    s += bytes;
+
+    while (((uintptr_t) d & 31) && bytes)
+    {
+        *--d = *--s;
+        bytes--;
+    }
+
+    while (bytes >= 128)
+    {
+        __m256i a, b, c, e;
+
+        d -= 128;
+        s -= 128;
+        a = __lasx_xvld(s, 0);
+        b = __lasx_xvld(s, 32);
+        c = __lasx_xvld(s, 64);
+        e = __lasx_xvld(s, 96);
+
+        __lasx_xvst(a, d, 0);
+        __lasx_xvst(b, d, 32);
+        __lasx_xvst(c, d, 64);
+        __lasx_xvst(e, d, 96);
+        bytes -= 128;
+    }
+
+    while (bytes >= 32)
+    {
+        __m256i a;
+
+        d -= 32;
+        s -= 32;
+        a = __lasx_xvld(s, 0);
+        __lasx_xvst(a, d, 0);
+        bytes -= 32;
+    }
+
+    while (bytes--)
+    {
+        *--d = *--s;
+    }
+}
+
+
+// the source is the BO here, keep the loads aligned instead
+static void ls_download_row_lasx(uint8_t *d, const uint8_t *s, int bytes)
+{
+    while (((uintptr_t) s & 31) && bytes)
+    {
+        *d++ = *s++;
+        bytes--;
+    }
+
+    while (bytes >= 128)
+    {
+        __m256i a = __lasx_xvld(s, 0);
+        __m256i b = __lasx_xvld(s, 32);
+        __m256i c = __lasx_xvld(s, 64);
+        __m256i e = __lasx_xvld(s, 96);
+
+        __lasx_xvst(a, d, 0);
+        __lasx_xvst(b, d, 32);
+        __lasx_xvst(c, d, 64);
+        __lasx_xvst(e, d, 96);
+        d += 128;
+        s += 128;
+        bytes -= 128;
+    }
+
+    while (bytes >= 32)
+    {
+        __m256i a = __lasx_xvld(s, 0);
+
+        __lasx_xvst(a, d, 0);
+        d += 32;
+        s += 32;
+        bytes -= 32;
+    }
+
+    while (bytes--)
+    {
+        *d++ = *s++;
+    }
+}
+
+//
+// Double shadow diff, same scheme as the LSX version with 32 byte chunks.
+//
+static inline void ls_cmp_copy_chunk_lasx(uint8_t *d, const uint8_t *s,
+                                          int off, int *pStart, int *pEnd)
+{
+    __m256i b = __lasx_xvld(s, 0);
+
+    if (__lasx_xbnz_v(__lasx_xvxor_v(__lasx_xvld(d, 0), b)))
+    {
+        ls_cmp_mark(d, s, 32, off, pStart, pEnd);
+        __lasx_xvst(b, d, 0);
+    }
+}
+
+static int ls_compare_copy_row_lasx(uint8_t *d, const uint8_t *s, int bytes,
+                                    int *pStart, int *pEnd)
+{
+    int off = (int) (-(uintptr_t) d & 31);
+    int i;
+
+    *pStart = -1;
+    *pEnd = 0;
+
+    if (off > bytes)
+    {
+        off = bytes;
+    }
+    ls_cmp_copy_bytes(d, s, off, 0, pStart, pEnd);
+
+    for (; bytes - off >= 128; off += 128)
+    {
+        const uint8_t *pa = d + off;
+        const uint8_t *pb = s + off;
+        __m256i x0 = __lasx_xvxor_v(__lasx_xvld(pa, 0), __lasx_xvld(pb, 0));
+        __m256i x1 = __lasx_xvxor_v(__lasx_xvld(pa, 32), __lasx_xvld(pb, 32));
+        __m256i x2 = __lasx_xvxor_v(__lasx_xvld(pa, 64), __lasx_xvld(pb, 64));
+        __m256i x3 = __lasx_xvxor_v(__lasx_xvld(pa, 96), __lasx_xvld(pb, 96));
+
+        if (__lasx_xbnz_v(__lasx_xvor_v(__lasx_xvor_v(x0, x1),
+                                        __lasx_xvor_v(x2, x3))))
+        {
+            for (i = 0; i < 128; i += 32)
+            {
+                ls_cmp_copy_chunk_lasx(d + off + i, s + off + i, off + i,
+                                       pStart, pEnd);
+            }
+        }
+    }
+
+    for (; bytes - off >= 32; off += 32)
+    {
+        ls_cmp_copy_chunk_lasx(d + off, s + off, off, pStart, pEnd);
+    }
+
+    ls_cmp_copy_bytes(d + off, s + off, bytes - off, off, pStart, pEnd);
+
+    return *pStart >= 0;
+}
+
+
+static inline __m256i ls_mul_16_lasx(__m256i x, __m256i a)
+{
+    __m256i t = __lasx_xvadd_h(__lasx_xvmul_h(x, a), __lasx_xvreplgr2vr_h(0x80));
+
+    return __lasx_xvsrli_h(__lasx_xvadd_h(t, __lasx_xvsrli_h(t, 8)), 8);
+}
+
+static inline __m256i ls_over_8_lasx(__m256i s, __m256i d)
+{
+    const __m256i zero = __lasx_xvreplgr2vr_w(0);
+    const __m256i mask_00ff = __lasx_xvreplgr2vr_h(0xff);
+    __m256i ilo = __lasx_xvxor_v(__lasx_xvshuf4i_h(__lasx_xvilvl_b(zero, s), 0xff), mask_00ff);
+    __m256i ihi = __lasx_xvxor_v(__lasx_xvshuf4i_h(__lasx_xvilvh_b(zero, s), 0xff), mask_00ff);
+    __m256i dlo = ls_mul_16_lasx(__lasx_xvilvl_b(zero, d), ilo);
+    __m256i dhi = ls_mul_16_lasx(__lasx_xvilvh_b(zero, d), ihi);
+
+    return __lasx_xvsadd_bu(s, __lasx_xvpickev_b(dhi, dlo));
+}
+
+static void ls_composite_over_8888_lasx(uint32_t *dst, int dst_stride,
+        const uint32_t *src, int src_stride, int w, int h)
+{
+    while (h--)
+    {
+        uint32_t *d = dst;
+        const uint32_t *s = src;
+        int n = w;
+
+        while (n >= 8)
+        {
+            uint32_t and = s[0] & s[1] & s[2] & s[3] & s[4] & s[5] & s[6] & s[7];
+            uint32_t or = s[0] | s[1] | s[2] | s[3] | s[4] | s[5] | s[6] | s[7];
+            __m256i vs = __lasx_xvld(s, 0);
+
+            if (and >= 0xff000000)
+            {
+                __lasx_xvst(vs, d, 0);
+            }
+            else if (or)
+            {
+                __lasx_xvst(ls_over_8_lasx(vs, __lasx_xvld(d, 0)), d, 0);
+            }
+
+            d += 8;
+            s += 8;
+            n -= 8;
+        }
+
+        while (n--)
+        {
+            if ((*s >> 24) == 0xff)
+                *d = *s;
+            else if (*s)
+                *d = ls_over_8888(*s, *d);
+            d++;
+            s++;
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        src = (const uint32_t *) ((const uint8_t *) src + src_stride);
+    }
+}
+
+static void ls_composite_over_n_8_8888_lasx(uint32_t *dst, int dst_stride,
+        const uint8_t *mask, int mask_stride, uint32_t src, int w, int h)
+{
+    const __m256i zero = __lasx_xvreplgr2vr_w(0);
+    const __m256i vsrc = __lasx_xvreplgr2vr_w((int) src);
+    const __m256i src16 = __lasx_xvilvl_b(zero, vsrc);
+    const int opaque = (src >> 24) == 0xff;
+
+    while (h--)
+    {
+        uint32_t *d = dst;
+        const uint8_t *m = mask;
+        int n = w;
+
+        while (n >= 8)
+        {
+            uint64_t m8;
+
+            memcpy(&m8, m, 8);
+
+            if (opaque && (m8 == ~(uint64_t) 0))
+            {
+                __lasx_xvst(vsrc, d, 0);
+            }
+            else if (m8)
+            {
+                uint32_t expand[8] __attribute__((aligned(32)));
+                __m256i vm, slo, shi;
+                int i;
+
+                for (i = 0; i < 8; i++)
+                {
+                    expand[i] = m[i] * 0x01010101u;
+                }
+
+                vm = __lasx_xvld(expand, 0);
+                slo = ls_mul_16_lasx(src16, __lasx_xvilvl_b(zero, vm));
+                shi = ls_mul_16_lasx(src16, __lasx_xvilvh_b(zero, vm));
+
+                __lasx_xvst(ls_over_8_lasx(__lasx_xvpickev_b(shi, slo),
+                                           __lasx_xvld(d, 0)), d, 0);
+            }
+
+            d += 8;
+            m += 8;
+            n -= 8;
+        }
+
+        while (n--)
+        {
+            if (opaque && (*m == 0xff))
+                *d = src;
+            else if (*m)
+                *d = ls_over_8888(ls_mul_un8x4(src, *m), *d);
+            d++;
+            m++;
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        mask += mask_stride;
+    }
+}
+
+static void ls_composite_add_8_lasx(uint8_t *dst, int dst_stride,
+        const uint8_t *src, int src_stride, int w, int h)
+{
+    while (h--)
+    {
+        uint8_t *d = dst;
+        const uint8_t *s = src;
+        int n = w;
+
+        while (n >= 32)
+        {
+            __lasx_xvst(__lasx_xvsadd_bu(__lasx_xvld(s, 0), __lasx_xvld(d, 0)), d, 0);
+            d += 32;
+            s += 32;
+            n -= 32;
+        }
+
+        while (n--)
+        {
+            *d = ls_add_un8(*d, *s);
+            d++;
+            s++;
+        }
+
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+static void ls_composite_src_x888_8888_lasx(uint32_t *dst, int dst_stride,
+        const uint32_t *src, int src_stride, int w, int h)
+{
+    const __m256i alpha = __lasx_xvreplgr2vr_w((int) 0xff000000);
+
+    while (h--)
+    {
+        uint32_t *d = dst;
+        const uint32_t *s = src;
+        int n = w;
+
+        while (n >= 8)
+        {
+            __lasx_xvst(__lasx_xvor_v(__lasx_xvld(s, 0), alpha), d, 0);
+            d += 8;
+            s += 8;
+            n -= 8;
+        }
+
+        while (n--)
+        {
+            *d++ = *s++ | 0xff000000;
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        src = (const uint32_t *) ((const uint8_t *) src + src_stride);
+    }
+}
+
+
+void LS_SimdSetupLASX(struct LoongsonSimdFuncs *pFuncs)
+{
+    pFuncs->name = "lasx";
+    pFuncs->FillRect = ls_fill_rect_lasx;
+    pFuncs->CopyRow = ls_copy_row_lasx;
+    pFuncs->CopyRowBackward = ls_copy_row_backward_lasx;
+    // no streaming stores in LASX, the forward mover already writes
+    // whole aligned vectors
+    pFuncs->UploadRow = ls_copy_row_lasx;
+    // Pack24Row stays with LSX, XVSHUF.B can't cross the 128 bit lanes
+    // a 24 byte group straddles. So does RotateRect32, transposes are
+    // bound by the column reads rather than the shuffles.
+    pFuncs->DownloadRow = ls_download_row_lasx;
+    pFuncs->CompareCopyRow = ls_compare_copy_row_lasx;
+    pFuncs->CompositeOver8888 = ls_composite_over_8888_lasx;
+    pFuncs->CompositeOverN8888 = ls_composite_over_n_8_8888_lasx;
+    pFuncs->CompositeAdd8 = ls_composite_add_8_lasx;
+    pFuncs->CompositeSrcX888 = ls_composite_src_x888_8888_lasx;
+}
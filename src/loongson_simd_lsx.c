@@ -0,0 +1,592 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <lsxintrin.h>
+
+#include "loongson_simd_priv.h"
+
+
+static void ls_fill_rect_lsx(void *bits, int stride, int bpp,
+        int x, int y, int w, int h, uint32_t pixel)
+{
+    const int cpp = bpp >> 3;
+    const uint32_t pattern = ls_replicate_pixel(pixel, bpp);
+    const __m128i v = __lsx_vreplgr2vr_w((int) pattern);
+    uint8_t *row = (uint8_t *) bits + y * stride + x * cpp;
+
+    while (h--)
+    {
+        int bytes = w * cpp;
+        uint8_t *d = ls_fill_head(row, &bytes, pattern, 16);
+
+        while (bytes >= 64)
+        {
+            __lsx_vst(v, d, 0);
+            __lsx_vst(v, d, 16);
+            __lsx_vst(v, d, 32);
+            __lsx_vst(v, d, 48);
+            d += 64;
+            bytes -= 64;
+        }
+
+        while (bytes >= 16)
+        {
+            __lsx_vst(v, d, 0);
+            d += 16;
+            bytes -= 16;
+        }
+
+        ls_fill_tail(d, bytes, pattern);
+
+        row += stride;
+    }
+}
+
+
+
+static void ls_copy_row_lsx(uint8_t *d, const uint8_t *s, int bytes)
+{
+    while (((uintptr_t) d & 15) && bytes)
+    {
+        *d++ = *s++;
+        bytes--;
+    }
+
+    while (bytes >= 64)
+    {
+        __m128i a = __lsx_vld(s, 0);
+        __m128i b = __lsx_vld(s, 16);
+        __m128i c = __lsx_vld(s, 32);
+        __m128i e = __lsx_vld(s, 48);
+
+        __lsx_vst(a, d, 0);
+        __lsx_vst(b, d, 16);
+        __lsx_vst(c, d, 32);
+        __lsx_vst(e, d, 48);
+        d += 64;
+        s += 64;
+        bytes -= 64;
+    }
+
+    while (bytes >= 16)
+    {
+        __m128i a = __lsx_vld(s, 0);
+
+        __lsx_vst(a, d, 0);
+        d += 16;
+        s += 16;
+        bytes -= 16;
+    }
+
+    while (bytes--)
+    {
+        *d++ = *s++;
+    }
+}
+
+static void ls_copy_row_backward_lsx(uint8_t *d, const uint8_t *s, int bytes)
+{
+    d += bytes;
+    s += bytes;
+
+    while (((uintptr_t) d & 15) && bytes)
+    {
+        *--d = *--s;
+        bytes--;
+    }
+
+    while (bytes >= 64)
+    {
+        __m128i a, b, c, e;
+
+        d -= 64;
+        s -= 64;
+        a = __lsx_vld(s, 0);
+        b = __lsx_vld(s, 16);
+        c = __lsx_vld(s, 32);
+        e = __lsx_vld(s, 48);
+
+        __lsx_vst(a, d, 0);
+        __lsx_vst(b, d, 16);
+        __lsx_vst(c, d, 32);
+        __lsx_vst(e, d, 48);
+        bytes -= 64;
+    }
+
+    while (bytes >= 16)
+    {
+        __m128i a;
+
+        d -= 16;
+        s -= 16;
+        a = __lsx_vld(s, 0);
+        __lsx_vst(a, d, 0);
+        bytes -= 16;
+    }
+
+    while (bytes--)
+    {
+        *--d = *--s;
+    }
+}
+
+
+//
+// 32 to 24 bpp, VSHUF.B picks the twelve colour bytes of four pixels
+// and the unused top word is cleared. 16 pixels are regrouped into
+// three aligned vectors with byte shifts.
+//
+static inline __m128i ls_pack24_lsx(__m128i x, __m128i idx)
+{
+    return __lsx_vinsgr2vr_w(__lsx_vshuf_b(x, x, idx), 0, 3);
+}
+
+static void ls_pack24_row_lsx(uint8_t *d, const uint8_t *s, int w)
+{
+    static const uint8_t order[16] = {
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 0, 0, 0, 0
+    };
+    const __m128i idx = __lsx_vld(order, 0);
+    int n = ls_pack24_head(d, w, 16);
+
+    ls_pack24_pixels(d, s, n);
+    d += 3 * n;
+    s += 4 * n;
+    w -= n;
+
+    while (w >= 16)
+    {
+        __m128i a = ls_pack24_lsx(__lsx_vld(s, 0), idx);
+        __m128i b = ls_pack24_lsx(__lsx_vld(s, 16), idx);
+        __m128i c = ls_pack24_lsx(__lsx_vld(s, 32), idx);
+        __m128i e = ls_pack24_lsx(__lsx_vld(s, 48), idx);
+
+        __lsx_vst(__lsx_vor_v(a, __lsx_vbsll_v(b, 12)), d, 0);
+        __lsx_vst(__lsx_vor_v(__lsx_vbsrl_v(b, 4), __lsx_vbsll_v(c, 8)), d, 16);
+        __lsx_vst(__lsx_vor_v(__lsx_vbsrl_v(c, 8), __lsx_vbsll_v(e, 4)), d, 32);
+        d += 48;
+        s += 64;
+        w -= 16;
+    }
+
+    ls_pack24_pixels(d, s, w);
+}
+
+// the source is the BO here, keep the loads aligned instead
+static void ls_download_row_lsx(uint8_t *d, const uint8_t *s, int bytes)
+{
+    while (((uintptr_t) s & 15) && bytes)
+    {
+        *d++ = *s++;
+        bytes--;
+    }
+
+    while (bytes >= 64)
+    {
+        __m128i a = __lsx_vld(s, 0);
+        __m128i b = __lsx_vld(s, 16);
+        __m128i c = __lsx_vld(s, 32);
+        __m128i e = __lsx_vld(s, 48);
+
+        __lsx_vst(a, d, 0);
+        __lsx_vst(b, d, 16);
+        __lsx_vst(c, d, 32);
+        __lsx_vst(e, d, 48);
+        d += 64;
+        s += 64;
+        bytes -= 64;
+    }
+
+    while (bytes >= 16)
+    {
+        __m128i a = __lsx_vld(s, 0);
+
+        __lsx_vst(a, d, 0);
+        d += 16;
+        s += 16;
+        bytes -= 16;
+    }
+
+    while (bytes--)
+    {
+        *d++ = *s++;
+    }
+}
+
+//
+// Double shadow diff. Rows are mostly unchanged between two flushes, so
+// four vectors are compared at once and only a group that differs is
+// walked chunk by chunk; equal chunks are never stored.
+//
+static inline void ls_cmp_copy_chunk_lsx(uint8_t *d, const uint8_t *s,
+                                         int off, int *pStart, int *pEnd)
+{
+    __m128i b = __lsx_vld(s, 0);
+
+    if (__lsx_bnz_v(__lsx_vxor_v(__lsx_vld(d, 0), b)))
+    {
+        ls_cmp_mark(d, s, 16, off, pStart, pEnd);
+        __lsx_vst(b, d, 0);
+    }
+}
+
+static int ls_compare_copy_row_lsx(uint8_t *d, const uint8_t *s, int bytes,
+                                   int *pStart, int *pEnd)
+{
+    int off = (int) (-(uintptr_t) d & 15);
+    int i;
+
+    *pStart = -1;
+    *pEnd = 0;
+
+    if (off > bytes)
+    {
+        off = bytes;
+    }
+    ls_cmp_copy_bytes(d, s, off, 0, pStart, pEnd);
+
+    for (; bytes - off >= 64; off += 64)
+    {
+        const uint8_t *pa = d + off;
+        const uint8_t *pb = s + off;
+        __m128i x0 = __lsx_vxor_v(__lsx_vld(pa, 0), __lsx_vld(pb, 0));
+        __m128i x1 = __lsx_vxor_v(__lsx_vld(pa, 16), __lsx_vld(pb, 16));
+        __m128i x2 = __lsx_vxor_v(__lsx_vld(pa, 32), __lsx_vld(pb, 32));
+        __m128i x3 = __lsx_vxor_v(__lsx_vld(pa, 48), __lsx_vld(pb, 48));
+
+        if (__lsx_bnz_v(__lsx_vor_v(__lsx_vor_v(x0, x1),
+                                    __lsx_vor_v(x2, x3))))
+        {
+            for (i = 0; i < 64; i += 16)
+            {
+                ls_cmp_copy_chunk_lsx(d + off + i, s + off + i, off + i,
+                                      pStart, pEnd);
+            }
+        }
+    }
+
+    for (; bytes - off >= 16; off += 16)
+    {
+        ls_cmp_copy_chunk_lsx(d + off, s + off, off, pStart, pEnd);
+    }
+
+    ls_cmp_copy_bytes(d + off, s + off, bytes - off, off, pStart, pEnd);
+
+    return *pStart >= 0;
+}
+
+
+//
+// Render helpers, pixels are unpacked to 16 bit lanes so the
+// x * a / 255 products keep pixman's rounding.
+//
+static inline __m128i ls_mul_16_lsx(__m128i x, __m128i a)
+{
+    __m128i t = __lsx_vadd_h(__lsx_vmul_h(x, a), __lsx_vreplgr2vr_h(0x80));
+
+    return __lsx_vsrli_h(__lsx_vadd_h(t, __lsx_vsrli_h(t, 8)), 8);
+}
+
+static inline __m128i ls_over_4_lsx(__m128i s, __m128i d)
+{
+    const __m128i zero = __lsx_vreplgr2vr_w(0);
+    const __m128i mask_00ff = __lsx_vreplgr2vr_h(0xff);
+    __m128i ilo = __lsx_vxor_v(__lsx_vshuf4i_h(__lsx_vilvl_b(zero, s), 0xff), mask_00ff);
+    __m128i ihi = __lsx_vxor_v(__lsx_vshuf4i_h(__lsx_vilvh_b(zero, s), 0xff), mask_00ff);
+    __m128i dlo = ls_mul_16_lsx(__lsx_vilvl_b(zero, d), ilo);
+    __m128i dhi = ls_mul_16_lsx(__lsx_vilvh_b(zero, d), ihi);
+
+    return __lsx_vsadd_bu(s, __lsx_vpickev_b(dhi, dlo));
+}
+
+static void ls_composite_over_8888_lsx(uint32_t *dst, int dst_stride,
+        const uint32_t *src, int src_stride, int w, int h)
+{
+    while (h--)
+    {
+        uint32_t *d = dst;
+        const uint32_t *s = src;
+        int n = w;
+
+        while (n >= 4)
+        {
+            uint32_t and = s[0] & s[1] & s[2] & s[3];
+            uint32_t or = s[0] | s[1] | s[2] | s[3];
+            __m128i vs = __lsx_vld(s, 0);
+
+            if (and >= 0xff000000)
+            {
+                __lsx_vst(vs, d, 0);
+            }
+            else if (or)
+            {
+                __lsx_vst(ls_over_4_lsx(vs, __lsx_vld(d, 0)), d, 0);
+            }
+
+            d += 4;
+            s += 4;
+            n -= 4;
+        }
+
+        while (n--)
+        {
+            if ((*s >> 24) == 0xff)
+                *d = *s;
+            else if (*s)
+                *d = ls_over_8888(*s, *d);
+            d++;
+            s++;
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        src = (const uint32_t *) ((const uint8_t *) src + src_stride);
+    }
+}
+
+static void ls_composite_over_n_8_8888_lsx(uint32_t *dst, int dst_stride,
+        const uint8_t *mask, int mask_stride, uint32_t src, int w, int h)
+{
+    const __m128i zero = __lsx_vreplgr2vr_w(0);
+    const __m128i vsrc = __lsx_vreplgr2vr_w((int) src);
+    const __m128i src16 = __lsx_vilvl_b(zero, vsrc);
+    const int opaque = (src >> 24) == 0xff;
+
+    while (h--)
+    {
+        uint32_t *d = dst;
+        const uint8_t *m = mask;
+        int n = w;
+
+        while (n >= 4)
+        {
+            uint32_t m4;
+
+            memcpy(&m4, m, 4);
+
+            if (opaque && (m4 == 0xffffffff))
+            {
+                __lsx_vst(vsrc, d, 0);
+            }
+            else if (m4)
+            {
+                __m128i vm = __lsx_vinsgr2vr_w(zero, (int) m4, 0);
+                __m128i slo, shi;
+
+                vm = __lsx_vilvl_b(vm, vm);
+                vm = __lsx_vilvl_h(vm, vm);
+                slo = ls_mul_16_lsx(src16, __lsx_vilvl_b(zero, vm));
+                shi = ls_mul_16_lsx(src16, __lsx_vilvh_b(zero, vm));
+
+                __lsx_vst(ls_over_4_lsx(__lsx_vpickev_b(shi, slo),
+                                        __lsx_vld(d, 0)), d, 0);
+            }
+
+            d += 4;
+            m += 4;
+            n -= 4;
+        }
+
+        while (n--)
+        {
+            if (opaque && (*m == 0xff))
+                *d = src;
+            else if (*m)
+                *d = ls_over_8888(ls_mul_un8x4(src, *m), *d);
+            d++;
+            m++;
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        mask += mask_stride;
+    }
+}
+
+static void ls_composite_add_8_lsx(uint8_t *dst, int dst_stride,
+        const uint8_t *src, int src_stride, int w, int h)
+{
+    while (h--)
+    {
+        uint8_t *d = dst;
+        const uint8_t *s = src;
+        int n = w;
+
+        while (n >= 16)
+        {
+            __lsx_vst(__lsx_vsadd_bu(__lsx_vld(s, 0), __lsx_vld(d, 0)), d, 0);
+            d += 16;
+            s += 16;
+            n -= 16;
+        }
+
+        while (n--)
+        {
+            *d = ls_add_un8(*d, *s);
+            d++;
+            s++;
+        }
+
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+static void ls_composite_src_x888_8888_lsx(uint32_t *dst, int dst_stride,
+        const uint32_t *src, int src_stride, int w, int h)
+{
+    const __m128i alpha = __lsx_vreplgr2vr_w((int) 0xff000000);
+
+    while (h--)
+    {
+        uint32_t *d = dst;
+        const uint32_t *s = src;
+        int n = w;
+
+        while (n >= 4)
+        {
+            __lsx_vst(__lsx_vor_v(__lsx_vld(s, 0), alpha), d, 0);
+            d += 4;
+            s += 4;
+            n -= 4;
+        }
+
+        while (n--)
+        {
+            *d++ = *s++ | 0xff000000;
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        src = (const uint32_t *) ((const uint8_t *) src + src_stride);
+    }
+}
+
+
+//
+// Rotation, as the SSE2 version: VSHUF4I.W reverses mirrored rows, and
+// 4x4 blocks are transposed with word then doubleword interleaves.
+//
+static void ls_rotate_row_lsx(uint32_t *d, const uint32_t *s,
+                               int xstep, int w)
+{
+    int x;
+
+    if (xstep == 1)
+    {
+        ls_copy_row_lsx((uint8_t *) d, (const uint8_t *) s, w * 4);
+        return;
+    }
+
+    for (x = 0; x + 4 <= w; x += 4)
+    {
+        __m128i v = __lsx_vld(s - x - 3, 0);
+
+        __lsx_vst(__lsx_vshuf4i_w(v, 0x1b), d + x, 0);
+    }
+
+    ls_rotate_pixels(d + x, s - x, -1, w - x);
+}
+
+static void ls_rotate_rect32_lsx(uint32_t *dst, int dst_stride,
+                                  const uint32_t *src, int xstep, int ystep,
+                                  int w, int h)
+{
+    int x, y, r;
+
+    if ((xstep == 1) || (xstep == -1))
+    {
+        for (y = 0; y < h; y++)
+        {
+            ls_rotate_row_lsx((uint32_t *) ((uint8_t *) dst + y * dst_stride),
+                               src + y * ystep, xstep, w);
+        }
+        return;
+    }
+
+    for (y = 0; y + 4 <= h; y += 4)
+    {
+        uint32_t *d[4];
+        // lowest address first, a column going up comes in reversed
+        const uint32_t *s = src + y * ystep - ((ystep < 0) ? 3 : 0);
+
+        for (r = 0; r < 4; r++)
+        {
+            d[(ystep < 0) ? 3 - r : r] =
+                (uint32_t *) ((uint8_t *) dst + (y + r) * dst_stride);
+        }
+
+        for (x = 0; x + 4 <= w; x += 4)
+        {
+            __m128i c0 = __lsx_vld(s + x * xstep, 0);
+            __m128i c1 = __lsx_vld(s + (x + 1) * xstep, 0);
+            __m128i c2 = __lsx_vld(s + (x + 2) * xstep, 0);
+            __m128i c3 = __lsx_vld(s + (x + 3) * xstep, 0);
+            __m128i t0 = __lsx_vilvl_w(c1, c0);
+            __m128i t1 = __lsx_vilvl_w(c3, c2);
+            __m128i t2 = __lsx_vilvh_w(c1, c0);
+            __m128i t3 = __lsx_vilvh_w(c3, c2);
+
+            __lsx_vst(__lsx_vilvl_d(t1, t0), d[0] + x, 0);
+            __lsx_vst(__lsx_vilvh_d(t1, t0), d[1] + x, 0);
+            __lsx_vst(__lsx_vilvl_d(t3, t2), d[2] + x, 0);
+            __lsx_vst(__lsx_vilvh_d(t3, t2), d[3] + x, 0);
+        }
+
+        for (r = 0; (r < 4) && (x < w); r++)
+        {
+            ls_rotate_pixels((uint32_t *) ((uint8_t *) dst + (y + r) * dst_stride) + x,
+                             src + x * xstep + (y + r) * ystep, xstep, w - x);
+        }
+    }
+
+    for (; y < h; y++)
+    {
+        ls_rotate_pixels((uint32_t *) ((uint8_t *) dst + y * dst_stride),
+                         src + y * ystep, xstep, w);
+    }
+}
+
+
+void LS_SimdSetupLSX(struct LoongsonSimdFuncs *pFuncs)
+{
+    pFuncs->name = "lsx";
+    pFuncs->FillRect = ls_fill_rect_lsx;
+    pFuncs->CopyRow = ls_copy_row_lsx;
+    pFuncs->CopyRowBackward = ls_copy_row_backward_lsx;
+    // no streaming stores in LSX, the forward mover already writes
+    // whole aligned vectors
+    pFuncs->UploadRow = ls_copy_row_lsx;
+    pFuncs->Pack24Row = ls_pack24_row_lsx;
+    pFuncs->RotateRect32 = ls_rotate_rect32_lsx;
+    pFuncs->DownloadRow = ls_download_row_lsx;
+    pFuncs->CompareCopyRow = ls_compare_copy_row_lsx;
+    pFuncs->CompositeOver8888 = ls_composite_over_8888_lsx;
+    pFuncs->CompositeOverN8888 = ls_composite_over_n_8_8888_lsx;
+    pFuncs->CompositeAdd8 = ls_composite_add_8_lsx;
+    pFuncs->CompositeSrcX888 = ls_composite_src_x888_8888_lsx;
+}
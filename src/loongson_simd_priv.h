@@ -0,0 +1,242 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifndef LOONGSON_SIMD_PRIV_H_
+#define LOONGSON_SIMD_PRIV_H_
+
+//
+// Helpers shared by the per-ISA kernel files. Nothing in here may
+// depend on the X server headers, the kernels are plain memory movers.
+//
+
+#include <stdint.h>
+#include <string.h>
+
+#include "loongson_simd.h"
+
+static inline uint32_t ls_replicate_pixel(uint32_t pixel, int bpp)
+{
+    switch (bpp)
+    {
+        case 8:
+            pixel &= 0xff;
+            return pixel * 0x01010101u;
+        case 16:
+            pixel &= 0xffff;
+            return pixel | (pixel << 16);
+        default:
+            return pixel;
+    }
+}
+
+//
+// Store the replicated pattern until @d reaches @align bytes alignment.
+// @d is always pixel aligned, so the narrow stores below can only be
+// taken by pixel formats at least that narrow.
+//
+static inline uint8_t * ls_fill_head(uint8_t *d, int *bytes,
+                                     uint32_t pattern, uintptr_t align)
+{
+    if (((uintptr_t) d & 1) && (*bytes >= 1))
+    {
+        *d = (uint8_t) pattern;
+        d += 1;
+        *bytes -= 1;
+    }
+
+    if (((uintptr_t) d & 2) && (*bytes >= 2))
+    {
+        *(uint16_t *) d = (uint16_t) pattern;
+        d += 2;
+        *bytes -= 2;
+    }
+
+    while (((uintptr_t) d & (align - 1)) && (*bytes >= 4))
+    {
+        *(uint32_t *) d = pattern;
+        d += 4;
+        *bytes -= 4;
+    }
+
+    return d;
+}
+
+static inline void ls_fill_tail(uint8_t *d, int bytes, uint32_t pattern)
+{
+    while (bytes >= 4)
+    {
+        *(uint32_t *) d = pattern;
+        d += 4;
+        bytes -= 4;
+    }
+
+    if (bytes >= 2)
+    {
+        *(uint16_t *) d = (uint16_t) pattern;
+        d += 2;
+        bytes -= 2;
+    }
+
+    if (bytes)
+    {
+        *d = (uint8_t) pattern;
+    }
+}
+
+//
+// Compare-and-copy helpers. Bytes of @s that differ from @d are copied
+// and widen [*pStart, *pEnd), @off is the position of @d in the row.
+//
+static inline void ls_cmp_copy_bytes(uint8_t *d, const uint8_t *s, int n,
+                                     int off, int *pStart, int *pEnd)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        if (d[i] != s[i])
+        {
+            d[i] = s[i];
+
+            if (*pStart < 0)
+            {
+                *pStart = off + i;
+            }
+            *pEnd = off + i + 1;
+        }
+    }
+}
+
+//
+// A vector compare found a difference in the @n bytes at @off, find its
+// exact ends before the chunk is stored. Only the first changed chunk of
+// a row scans for the start.
+//
+static inline void ls_cmp_mark(const uint8_t *d, const uint8_t *s, int n,
+                               int off, int *pStart, int *pEnd)
+{
+    int i;
+
+    if (*pStart < 0)
+    {
+        for (i = 0; d[i] == s[i]; i++)
+        {
+            ;
+        }
+        *pStart = off + i;
+    }
+
+    for (i = n; d[i - 1] == s[i - 1]; i--)
+    {
+        ;
+    }
+    *pEnd = off + i;
+}
+
+//
+// 32 to 24 bpp packing: the low three bytes of each source pixel are
+// stored, lowest first. @n pixels one at a time, for heads and tails.
+//
+static inline void ls_pack24_pixels(uint8_t *d, const uint8_t *s, int n)
+{
+    const uint32_t *p = (const uint32_t *) s;
+
+    while (n--)
+    {
+        uint32_t v = *p++;
+
+        d[0] = v;
+        d[1] = v >> 8;
+        d[2] = v >> 16;
+        d += 3;
+    }
+}
+
+// pixels to pack one at a time before @d is aligned to @align bytes
+static inline int ls_pack24_head(const uint8_t *d, int w, uintptr_t align)
+{
+    int n = 0;
+
+    while ((((uintptr_t) d + 3 * n) & (align - 1)) && (n < w))
+    {
+        n++;
+    }
+
+    return n;
+}
+
+// @n rotated pixels one at a time, @xstep apart in the source
+static inline void ls_rotate_pixels(uint32_t *d, const uint32_t *s,
+                                    int xstep, int n)
+{
+    while (n--)
+    {
+        *d++ = *s;
+        s += xstep;
+    }
+}
+
+//
+// Per channel arithmetic on packed a8r8g8b8, same rounding as pixman
+// so the SIMD paths and the fb fallback produce identical pixels.
+//
+static inline uint32_t ls_mul_un8x4(uint32_t x, uint32_t a)
+{
+    uint32_t rb = (x & 0x00ff00ff) * a + 0x00800080;
+    uint32_t ag = ((x >> 8) & 0x00ff00ff) * a + 0x00800080;
+
+    rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+    ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+
+    return rb | ag;
+}
+
+static inline uint32_t ls_add_un8x4(uint32_t x, uint32_t y)
+{
+    uint32_t rb = (x & 0x00ff00ff) + (y & 0x00ff00ff);
+    uint32_t ag = ((x >> 8) & 0x00ff00ff) + ((y >> 8) & 0x00ff00ff);
+
+    rb |= 0x01000100 - ((rb >> 8) & 0x00ff00ff);
+    ag |= 0x01000100 - ((ag >> 8) & 0x00ff00ff);
+
+    return (rb & 0x00ff00ff) | ((ag & 0x00ff00ff) << 8);
+}
+
+static inline uint32_t ls_over_8888(uint32_t src, uint32_t dst)
+{
+    uint32_t ia = ~src >> 24;
+
+    return ls_add_un8x4(src, ls_mul_un8x4(dst, ia));
+}
+
+static inline uint8_t ls_add_un8(uint8_t x, uint8_t y)
+{
+    unsigned int t = x + y;
+
+    return (uint8_t) (t | (0 - (t >> 8)));
+}
+
+#endif
@@ -0,0 +1,662 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <emmintrin.h>
+
+#include "loongson_simd_priv.h"
+
+
+static void ls_fill_rect_sse2(void *bits, int stride, int bpp,
+        int x, int y, int w, int h, uint32_t pixel)
+{
+    const int cpp = bpp >> 3;
+    const uint32_t pattern = ls_replicate_pixel(pixel, bpp);
+    const __m128i v = _mm_set1_epi32((int) pattern);
+    uint8_t *row = (uint8_t *) bits + y * stride + x * cpp;
+
+    while (h--)
+    {
+        int bytes = w * cpp;
+        uint8_t *d = ls_fill_head(row, &bytes, pattern, 16);
+
+        while (bytes >= 64)
+        {
+            _mm_store_si128((__m128i *) (d +  0), v);
+            _mm_store_si128((__m128i *) (d + 16), v);
+            _mm_store_si128((__m128i *) (d + 32), v);
+            _mm_store_si128((__m128i *) (d + 48), v);
+            d += 64;
+            bytes -= 64;
+        }
+
+        while (bytes >= 16)
+        {
+            _mm_store_si128((__m128i *) d, v);
+            d += 16;
+            bytes -= 16;
+        }
+
+        ls_fill_tail(d, bytes, pattern);
+
+        row += stride;
+    }
+}
+
+
+
+static void ls_copy_row_sse2(uint8_t *d, const uint8_t *s, int bytes)
+{
+    while (((uintptr_t) d & 15) && bytes)
+    {
+        *d++ = *s++;
+        bytes--;
+    }
+
+    while (bytes >= 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *) s);
+        __m128i b = _mm_loadu_si128((const __m128i *) (s + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *) (s + 32));
+        __m128i e = _mm_loadu_si128((const __m128i *) (s + 48));
+
+        _mm_store_si128((__m128i *) d, a);
+        _mm_store_si128((__m128i *) (d + 16), b);
+        _mm_store_si128((__m128i *) (d + 32), c);
+        _mm_store_si128((__m128i *) (d + 48), e);
+        d += 64;
+        s += 64;
+        bytes -= 64;
+    }
+
+    while (bytes >= 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *) s);
+
+        _mm_store_si128((__m128i *) d, a);
+        d += 16;
+        s += 16;
+        bytes -= 16;
+    }
+
+    while (bytes--)
+    {
+        *d++ = *s++;
+    }
+}
+
+static void ls_copy_row_backward_sse2(uint8_t *d, const uint8_t *s, int bytes)
+{
+    d += bytes;
+    s += bytes;
+
+    while (((uintptr_t) d & 15) && bytes)
+    {
+        *--d = *--s;
+        bytes--;
+    }
+
+    while (bytes >= 64)
+    {
+        __m128i a, b, c, e;
+
+        d -= 64;
+        s -= 64;
+        a = _mm_loadu_si128((const __m128i *) s);
+        b = _mm_loadu_si128((const __m128i *) (s + 16));
+        c = _mm_loadu_si128((const __m128i *) (s + 32));
+        e = _mm_loadu_si128((const __m128i *) (s + 48));
+
+        _mm_store_si128((__m128i *) d, a);
+        _mm_store_si128((__m128i *) (d + 16), b);
+        _mm_store_si128((__m128i *) (d + 32), c);
+        _mm_store_si128((__m128i *) (d + 48), e);
+        bytes -= 64;
+    }
+
+    while (bytes >= 16)
+    {
+        __m128i a;
+
+        d -= 16;
+        s -= 16;
+        a = _mm_loadu_si128((const __m128i *) s);
+        _mm_store_si128((__m128i *) d, a);
+        bytes -= 16;
+    }
+
+    while (bytes--)
+    {
+        *--d = *--s;
+    }
+}
+
+
+static void ls_upload_row_sse2(uint8_t *d, const uint8_t *s, int bytes)
+{
+    while (((uintptr_t) d & 15) && bytes)
+    {
+        *d++ = *s++;
+        bytes--;
+    }
+
+    while (bytes >= 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *) s);
+        __m128i b = _mm_loadu_si128((const __m128i *) (s + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *) (s + 32));
+        __m128i e = _mm_loadu_si128((const __m128i *) (s + 48));
+
+        _mm_stream_si128((__m128i *) d, a);
+        _mm_stream_si128((__m128i *) (d + 16), b);
+        _mm_stream_si128((__m128i *) (d + 32), c);
+        _mm_stream_si128((__m128i *) (d + 48), e);
+        d += 64;
+        s += 64;
+        bytes -= 64;
+    }
+
+    while (bytes >= 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *) s);
+
+        _mm_stream_si128((__m128i *) d, a);
+        d += 16;
+        s += 16;
+        bytes -= 16;
+    }
+
+    while (bytes--)
+    {
+        *d++ = *s++;
+    }
+
+    _mm_sfence();
+}
+
+//
+// Four pixels to twelve bytes in the low end of the register, the top
+// four bytes cleared. SSE2 has no byte shuffle, the 64 bit lanes are
+// packed with shifts and the upper one moved down next to the lower.
+//
+static inline __m128i ls_pack24_sse2(__m128i x)
+{
+    const __m128i lo = _mm_set1_epi64x(0x0000000000ffffffLL);
+    const __m128i hi = _mm_set1_epi64x(0x00ffffff00000000LL);
+    __m128i q = _mm_or_si128(_mm_and_si128(x, lo),
+                             _mm_srli_epi64(_mm_and_si128(x, hi), 8));
+
+    return _mm_or_si128(_mm_move_epi64(q),
+                        _mm_slli_si128(_mm_srli_si128(q, 8), 6));
+}
+
+// 16 pixels make three full vectors, stored with streaming stores
+static void ls_pack24_row_sse2(uint8_t *d, const uint8_t *s, int w)
+{
+    int n = ls_pack24_head(d, w, 16);
+
+    ls_pack24_pixels(d, s, n);
+    d += 3 * n;
+    s += 4 * n;
+    w -= n;
+
+    while (w >= 16)
+    {
+        __m128i a = ls_pack24_sse2(_mm_loadu_si128((const __m128i *) s));
+        __m128i b = ls_pack24_sse2(_mm_loadu_si128((const __m128i *) (s + 16)));
+        __m128i c = ls_pack24_sse2(_mm_loadu_si128((const __m128i *) (s + 32)));
+        __m128i e = ls_pack24_sse2(_mm_loadu_si128((const __m128i *) (s + 48)));
+
+        _mm_stream_si128((__m128i *) d,
+                         _mm_or_si128(a, _mm_slli_si128(b, 12)));
+        _mm_stream_si128((__m128i *) (d + 16),
+                         _mm_or_si128(_mm_srli_si128(b, 4),
+                                      _mm_slli_si128(c, 8)));
+        _mm_stream_si128((__m128i *) (d + 32),
+                         _mm_or_si128(_mm_srli_si128(c, 8),
+                                      _mm_slli_si128(e, 4)));
+        d += 48;
+        s += 64;
+        w -= 16;
+    }
+
+    ls_pack24_pixels(d, s, w);
+
+    _mm_sfence();
+}
+
+static void ls_download_row_sse2(uint8_t *d, const uint8_t *s, int bytes)
+{
+    while (((uintptr_t) s & 15) && bytes)
+    {
+        *d++ = *s++;
+        bytes--;
+    }
+
+    while (bytes >= 64)
+    {
+        __m128i a = _mm_load_si128((const __m128i *) s);
+        __m128i b = _mm_load_si128((const __m128i *) (s + 16));
+        __m128i c = _mm_load_si128((const __m128i *) (s + 32));
+        __m128i e = _mm_load_si128((const __m128i *) (s + 48));
+
+        _mm_storeu_si128((__m128i *) d, a);
+        _mm_storeu_si128((__m128i *) (d + 16), b);
+        _mm_storeu_si128((__m128i *) (d + 32), c);
+        _mm_storeu_si128((__m128i *) (d + 48), e);
+        d += 64;
+        s += 64;
+        bytes -= 64;
+    }
+
+    while (bytes >= 16)
+    {
+        __m128i a = _mm_load_si128((const __m128i *) s);
+
+        _mm_storeu_si128((__m128i *) d, a);
+        d += 16;
+        s += 16;
+        bytes -= 16;
+    }
+
+    while (bytes--)
+    {
+        *d++ = *s++;
+    }
+}
+
+//
+// Double shadow diff. Rows are mostly unchanged between two flushes, so
+// four vectors are compared at once and only a group that differs is
+// walked chunk by chunk; equal chunks are never stored.
+//
+static inline void ls_cmp_copy_chunk_sse2(uint8_t *d, const uint8_t *s,
+                                          int off, int *pStart, int *pEnd)
+{
+    __m128i a = _mm_load_si128((const __m128i *) d);
+    __m128i b = _mm_loadu_si128((const __m128i *) s);
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xffff)
+    {
+        ls_cmp_mark(d, s, 16, off, pStart, pEnd);
+        _mm_store_si128((__m128i *) d, b);
+    }
+}
+
+static int ls_compare_copy_row_sse2(uint8_t *d, const uint8_t *s, int bytes,
+                                    int *pStart, int *pEnd)
+{
+    int off = (int) (-(uintptr_t) d & 15);
+    int i;
+
+    *pStart = -1;
+    *pEnd = 0;
+
+    if (off > bytes)
+    {
+        off = bytes;
+    }
+    ls_cmp_copy_bytes(d, s, off, 0, pStart, pEnd);
+
+    for (; bytes - off >= 64; off += 64)
+    {
+        const __m128i *pa = (const __m128i *) (d + off);
+        const __m128i *pb = (const __m128i *) (s + off);
+        __m128i e0 = _mm_cmpeq_epi8(_mm_load_si128(pa), _mm_loadu_si128(pb));
+        __m128i e1 = _mm_cmpeq_epi8(_mm_load_si128(pa + 1),
+                                    _mm_loadu_si128(pb + 1));
+        __m128i e2 = _mm_cmpeq_epi8(_mm_load_si128(pa + 2),
+                                    _mm_loadu_si128(pb + 2));
+        __m128i e3 = _mm_cmpeq_epi8(_mm_load_si128(pa + 3),
+                                    _mm_loadu_si128(pb + 3));
+        __m128i eq = _mm_and_si128(_mm_and_si128(e0, e1),
+                                   _mm_and_si128(e2, e3));
+
+        if (_mm_movemask_epi8(eq) != 0xffff)
+        {
+            for (i = 0; i < 64; i += 16)
+            {
+                ls_cmp_copy_chunk_sse2(d + off + i, s + off + i, off + i,
+                                       pStart, pEnd);
+            }
+        }
+    }
+
+    for (; bytes - off >= 16; off += 16)
+    {
+        ls_cmp_copy_chunk_sse2(d + off, s + off, off, pStart, pEnd);
+    }
+
+    ls_cmp_copy_bytes(d + off, s + off, bytes - off, off, pStart, pEnd);
+
+    return *pStart >= 0;
+}
+
+
+//
+// Render helpers, pixels are unpacked to 16 bit lanes so the
+// x * a / 255 products keep pixman's rounding.
+//
+static inline __m128i ls_mul_16_sse2(__m128i x, __m128i a)
+{
+    const __m128i round = _mm_set1_epi16(0x0080);
+    const __m128i div = _mm_set1_epi16(0x0101);
+
+    return _mm_mulhi_epu16(_mm_adds_epu16(_mm_mullo_epi16(x, a), round), div);
+}
+
+static inline __m128i ls_alpha_16_sse2(__m128i x)
+{
+    x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_shufflehi_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+static inline __m128i ls_over_4_sse2(__m128i s, __m128i d)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask_00ff = _mm_set1_epi16(0x00ff);
+    __m128i ilo = _mm_xor_si128(ls_alpha_16_sse2(_mm_unpacklo_epi8(s, zero)), mask_00ff);
+    __m128i ihi = _mm_xor_si128(ls_alpha_16_sse2(_mm_unpackhi_epi8(s, zero)), mask_00ff);
+    __m128i dlo = ls_mul_16_sse2(_mm_unpacklo_epi8(d, zero), ilo);
+    __m128i dhi = ls_mul_16_sse2(_mm_unpackhi_epi8(d, zero), ihi);
+
+    return _mm_adds_epu8(s, _mm_packus_epi16(dlo, dhi));
+}
+
+static void ls_composite_over_8888_sse2(uint32_t *dst, int dst_stride,
+        const uint32_t *src, int src_stride, int w, int h)
+{
+    while (h--)
+    {
+        uint32_t *d = dst;
+        const uint32_t *s = src;
+        int n = w;
+
+        while (n >= 4)
+        {
+            uint32_t and = s[0] & s[1] & s[2] & s[3];
+            uint32_t or = s[0] | s[1] | s[2] | s[3];
+            __m128i vs = _mm_loadu_si128((const __m128i *) s);
+
+            if (and >= 0xff000000)
+            {
+                _mm_storeu_si128((__m128i *) d, vs);
+            }
+            else if (or)
+            {
+                __m128i vd = _mm_loadu_si128((const __m128i *) d);
+
+                _mm_storeu_si128((__m128i *) d, ls_over_4_sse2(vs, vd));
+            }
+
+            d += 4;
+            s += 4;
+            n -= 4;
+        }
+
+        while (n--)
+        {
+            if ((*s >> 24) == 0xff)
+                *d = *s;
+            else if (*s)
+                *d = ls_over_8888(*s, *d);
+            d++;
+            s++;
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        src = (const uint32_t *) ((const uint8_t *) src + src_stride);
+    }
+}
+
+static void ls_composite_over_n_8_8888_sse2(uint32_t *dst, int dst_stride,
+        const uint8_t *mask, int mask_stride, uint32_t src, int w, int h)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vsrc = _mm_set1_epi32((int) src);
+    const __m128i src16 = _mm_unpacklo_epi8(vsrc, zero);
+    const int opaque = (src >> 24) == 0xff;
+
+    while (h--)
+    {
+        uint32_t *d = dst;
+        const uint8_t *m = mask;
+        int n = w;
+
+        while (n >= 4)
+        {
+            uint32_t m4;
+
+            memcpy(&m4, m, 4);
+
+            if (opaque && (m4 == 0xffffffff))
+            {
+                _mm_storeu_si128((__m128i *) d, vsrc);
+            }
+            else if (m4)
+            {
+                __m128i vm = _mm_cvtsi32_si128((int) m4);
+                __m128i vd = _mm_loadu_si128((const __m128i *) d);
+                __m128i slo, shi;
+
+                vm = _mm_unpacklo_epi8(vm, vm);
+                vm = _mm_unpacklo_epi16(vm, vm);
+                slo = ls_mul_16_sse2(src16, _mm_unpacklo_epi8(vm, zero));
+                shi = ls_mul_16_sse2(src16, _mm_unpackhi_epi8(vm, zero));
+
+                _mm_storeu_si128((__m128i *) d,
+                        ls_over_4_sse2(_mm_packus_epi16(slo, shi), vd));
+            }
+
+            d += 4;
+            m += 4;
+            n -= 4;
+        }
+
+        while (n--)
+        {
+            if (opaque && (*m == 0xff))
+                *d = src;
+            else if (*m)
+                *d = ls_over_8888(ls_mul_un8x4(src, *m), *d);
+            d++;
+            m++;
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        mask += mask_stride;
+    }
+}
+
+static void ls_composite_add_8_sse2(uint8_t *dst, int dst_stride,
+        const uint8_t *src, int src_stride, int w, int h)
+{
+    while (h--)
+    {
+        uint8_t *d = dst;
+        const uint8_t *s = src;
+        int n = w;
+
+        while (n >= 16)
+        {
+            __m128i vs = _mm_loadu_si128((const __m128i *) s);
+            __m128i vd = _mm_loadu_si128((const __m128i *) d);
+
+            _mm_storeu_si128((__m128i *) d, _mm_adds_epu8(vs, vd));
+            d += 16;
+            s += 16;
+            n -= 16;
+        }
+
+        while (n--)
+        {
+            *d = ls_add_un8(*d, *s);
+            d++;
+            s++;
+        }
+
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+static void ls_composite_src_x888_8888_sse2(uint32_t *dst, int dst_stride,
+        const uint32_t *src, int src_stride, int w, int h)
+{
+    const __m128i alpha = _mm_set1_epi32((int) 0xff000000);
+
+    while (h--)
+    {
+        uint32_t *d = dst;
+        const uint32_t *s = src;
+        int n = w;
+
+        while (n >= 4)
+        {
+            __m128i vs = _mm_loadu_si128((const __m128i *) s);
+
+            _mm_storeu_si128((__m128i *) d, _mm_or_si128(vs, alpha));
+            d += 4;
+            s += 4;
+            n -= 4;
+        }
+
+        while (n--)
+        {
+            *d++ = *s++ | 0xff000000;
+        }
+
+        dst = (uint32_t *) ((uint8_t *) dst + dst_stride);
+        src = (const uint32_t *) ((const uint8_t *) src + src_stride);
+    }
+}
+
+
+//
+// Rotation. Mirrored rows reverse four pixels per vector. Transposes
+// load four pixels from each of four source columns, transpose them in
+// registers and store them to a strip of four destination rows.
+//
+static void ls_rotate_row_sse2(uint32_t *d, const uint32_t *s,
+                               int xstep, int w)
+{
+    int x;
+
+    if (xstep == 1)
+    {
+        ls_copy_row_sse2((uint8_t *) d, (const uint8_t *) s, w * 4);
+        return;
+    }
+
+    for (x = 0; x + 4 <= w; x += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (s - x - 3));
+
+        _mm_storeu_si128((__m128i *) (d + x), _mm_shuffle_epi32(v, 0x1b));
+    }
+
+    ls_rotate_pixels(d + x, s - x, -1, w - x);
+}
+
+static void ls_rotate_rect32_sse2(uint32_t *dst, int dst_stride,
+                                  const uint32_t *src, int xstep, int ystep,
+                                  int w, int h)
+{
+    int x, y, r;
+
+    if ((xstep == 1) || (xstep == -1))
+    {
+        for (y = 0; y < h; y++)
+        {
+            ls_rotate_row_sse2((uint32_t *) ((uint8_t *) dst + y * dst_stride),
+                               src + y * ystep, xstep, w);
+        }
+        return;
+    }
+
+    for (y = 0; y + 4 <= h; y += 4)
+    {
+        uint32_t *d[4];
+        // lowest address first, a column going up comes in reversed
+        const uint32_t *s = src + y * ystep - ((ystep < 0) ? 3 : 0);
+
+        for (r = 0; r < 4; r++)
+        {
+            d[(ystep < 0) ? 3 - r : r] =
+                (uint32_t *) ((uint8_t *) dst + (y + r) * dst_stride);
+        }
+
+        for (x = 0; x + 4 <= w; x += 4)
+        {
+            __m128i c0 = _mm_loadu_si128((const __m128i *) (s + x * xstep));
+            __m128i c1 = _mm_loadu_si128((const __m128i *) (s + (x + 1) * xstep));
+            __m128i c2 = _mm_loadu_si128((const __m128i *) (s + (x + 2) * xstep));
+            __m128i c3 = _mm_loadu_si128((const __m128i *) (s + (x + 3) * xstep));
+            __m128i t0 = _mm_unpacklo_epi32(c0, c1);
+            __m128i t1 = _mm_unpacklo_epi32(c2, c3);
+            __m128i t2 = _mm_unpackhi_epi32(c0, c1);
+            __m128i t3 = _mm_unpackhi_epi32(c2, c3);
+
+            _mm_storeu_si128((__m128i *) (d[0] + x), _mm_unpacklo_epi64(t0, t1));
+            _mm_storeu_si128((__m128i *) (d[1] + x), _mm_unpackhi_epi64(t0, t1));
+            _mm_storeu_si128((__m128i *) (d[2] + x), _mm_unpacklo_epi64(t2, t3));
+            _mm_storeu_si128((__m128i *) (d[3] + x), _mm_unpackhi_epi64(t2, t3));
+        }
+
+        for (r = 0; (r < 4) && (x < w); r++)
+        {
+            ls_rotate_pixels((uint32_t *) ((uint8_t *) dst + (y + r) * dst_stride) + x,
+                             src + x * xstep + (y + r) * ystep, xstep, w - x);
+        }
+    }
+
+    for (; y < h; y++)
+    {
+        ls_rotate_pixels((uint32_t *) ((uint8_t *) dst + y * dst_stride),
+                         src + y * ystep, xstep, w);
+    }
+}
+
+
+void LS_SimdSetupSSE2(struct LoongsonSimdFuncs *pFuncs)
+{
+    pFuncs->name = "sse2";
+    pFuncs->FillRect = ls_fill_rect_sse2;
+    pFuncs->CopyRow = ls_copy_row_sse2;
+    pFuncs->CopyRowBackward = ls_copy_row_backward_sse2;
+    pFuncs->UploadRow = ls_upload_row_sse2;
+    pFuncs->Pack24Row = ls_pack24_row_sse2;
+    pFuncs->RotateRect32 = ls_rotate_rect32_sse2;
+    pFuncs->DownloadRow = ls_download_row_sse2;
+    pFuncs->CompareCopyRow = ls_compare_copy_row_sse2;
+    pFuncs->CompositeOver8888 = ls_composite_over_8888_sse2;
+    pFuncs->CompositeOverN8888 = ls_composite_over_n_8_8888_sse2;
+    pFuncs->CompositeAdd8 = ls_composite_add_8_sse2;
+    pFuncs->CompositeSrcX888 = ls_composite_src_x888_8888_sse2;
+}
@@ -0,0 +1,387 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <xf86.h>
+#include <xf86Crtc.h>
+#include <xf86drm.h>
+
+#include "driver.h"
+#include "dumb_bo.h"
+#include "loongson_options.h"
+#include "loongson_shadow.h"
+#include "loongson_tearfree.h"
+
+//
+// front_bo and fb_id always name the buffer being scanned out, the
+// shadow is copied to back_bo and the two are swapped once every crtc
+// has flipped. Each buffer keeps the damage it missed while it was on
+// screen, so a flip only copies what changed since that buffer was
+// last brought up to date.
+//
+
+// how long a resize or CloseScreen waits for the flips in flight, in ms
+#define LS_TEARFREE_WAIT_MS     1000
+
+
+static void ls_tearfree_swap(drmmode_ptr drmmode)
+{
+    drmmode_tearfree_rec *tf = &drmmode->tearfree;
+    drmmode_bo bo = drmmode->front_bo;
+    uint32_t fb_id = drmmode->fb_id;
+    RegionRec stale = tf->front_stale;
+
+    drmmode->front_bo = tf->back_bo;
+    drmmode->fb_id = tf->back_fb_id;
+    tf->front_stale = tf->back_stale;
+
+    tf->back_bo = bo;
+    tf->back_fb_id = fb_id;
+    tf->back_stale = stale;
+}
+
+static void ls_tearfree_flip_handler(uint64_t msc, uint64_t ust, void *data)
+{
+    ScrnInfoPtr pScrn = data;
+    modesettingPtr ms = modesettingPTR(pScrn);
+    drmmode_tearfree_rec *tf = &ms->drmmode.tearfree;
+
+    if (--tf->flips_pending > 0)
+    {
+        return;
+    }
+
+    ls_tearfree_swap(&ms->drmmode);
+
+    // a crtc refused the flip and still shows the old front buffer
+    if (tf->resync)
+    {
+        tf->resync = FALSE;
+        drmmode_set_desired_modes(pScrn, &ms->drmmode, TRUE);
+    }
+}
+
+static void ls_tearfree_flip_abort(void *data)
+{
+    ScrnInfoPtr pScrn = data;
+    modesettingPtr ms = modesettingPTR(pScrn);
+
+    ms->drmmode.tearfree.flips_pending--;
+}
+
+static void ls_tearfree_wait(ScrnInfoPtr pScrn)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+    drmmode_tearfree_rec *tf = &ms->drmmode.tearfree;
+
+    while (tf->flips_pending > 0)
+    {
+        struct pollfd p = { .fd = ms->fd, .events = POLLIN };
+        int r = poll(&p, 1, LS_TEARFREE_WAIT_MS);
+
+        if ((r < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+        {
+            continue;
+        }
+
+        if ((r <= 0) || (drmHandleEvent(ms->fd, &ms->event_context) < 0))
+        {
+            xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                       "TearFree: %d flip(s) never completed\n",
+                       tf->flips_pending);
+            tf->flips_pending = 0;
+            return;
+        }
+    }
+}
+
+//
+// Every enabled crtc must scan out the front buffer as a whole, a
+// rotated or PRIME crtc shows a buffer of its own.
+//
+static Bool ls_tearfree_can_flip(ScrnInfoPtr pScrn)
+{
+    xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(pScrn);
+    int num_on = 0;
+    int i;
+
+    if (!pScrn->vtSema)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < config->num_crtc; i++)
+    {
+        xf86CrtcPtr crtc = config->crtc[i];
+        drmmode_crtc_private_ptr drmmode_crtc = crtc->driver_private;
+
+        if (!crtc->enabled)
+        {
+            continue;
+        }
+
+        if (!ms_crtc_on(crtc) || drmmode_crtc->rotate_fb_id ||
+            drmmode_crtc->prime_pixmap)
+        {
+            return FALSE;
+        }
+
+        num_on++;
+    }
+
+    return num_on > 0;
+}
+
+static void ls_tearfree_copy_front(ScrnInfoPtr pScrn)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+    drmmode_ptr drmmode = &ms->drmmode;
+    drmmode_tearfree_rec *tf = &drmmode->tearfree;
+
+    LS_ShadowCopyRegion(pScrn, &tf->front_stale,
+                        drmmode->front_bo.dumb->ptr,
+                        drmmode->front_bo.dumb->pitch);
+
+    // back_stale keeps it, the back buffer missed this damage too
+    RegionEmpty(&tf->front_stale);
+    tf->direct++;
+}
+
+static int ls_tearfree_queue_flips(ScrnInfoPtr pScrn)
+{
+    xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(pScrn);
+    modesettingPtr ms = modesettingPTR(pScrn);
+    drmmode_tearfree_rec *tf = &ms->drmmode.tearfree;
+    int i;
+
+    for (i = 0; i < config->num_crtc; i++)
+    {
+        xf86CrtcPtr crtc = config->crtc[i];
+        uint32_t seq;
+
+        if (!crtc->enabled)
+        {
+            continue;
+        }
+
+        seq = ms_drm_queue_alloc(crtc, pScrn, ls_tearfree_flip_handler,
+                                 ls_tearfree_flip_abort);
+        if (seq == 0)
+        {
+            tf->resync = TRUE;
+            break;
+        }
+
+        tf->flips_pending++;
+
+        if (drmmode_crtc_flip(crtc, tf->back_fb_id, DRM_MODE_PAGE_FLIP_EVENT,
+                              (void *) (uintptr_t) seq))
+        {
+            xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                       "TearFree: flip failed: %s\n", strerror(errno));
+            // drops flips_pending again
+            ms_drm_abort_seq(pScrn, seq);
+            tf->resync = TRUE;
+            break;
+        }
+    }
+
+    return tf->flips_pending;
+}
+
+
+void LS_TearFreeDamage(ScrnInfoPtr pScrn, RegionPtr damage)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+    drmmode_tearfree_rec *tf = &ms->drmmode.tearfree;
+
+    RegionUnion(&tf->front_stale, &tf->front_stale, damage);
+    RegionUnion(&tf->back_stale, &tf->back_stale, damage);
+}
+
+//
+// Called once the shadow damage of this round has been handed over.
+// While a flip is in flight new damage just piles up in both stale
+// regions, the next flush after the flip completed picks it up, so
+// the flips pace themselves to the refresh rate.
+//
+void LS_TearFreeFlush(ScrnInfoPtr pScrn)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+    drmmode_ptr drmmode = &ms->drmmode;
+    drmmode_tearfree_rec *tf = &drmmode->tearfree;
+
+    if (!tf->enabled || (tf->flips_pending > 0) ||
+        !RegionNotEmpty(&tf->front_stale))
+    {
+        return;
+    }
+
+    if (!ls_tearfree_can_flip(pScrn))
+    {
+        ls_tearfree_copy_front(pScrn);
+        return;
+    }
+
+    LS_ShadowCopyRegion(pScrn, &tf->back_stale,
+                        tf->back_bo.dumb->ptr, tf->back_bo.dumb->pitch);
+    RegionEmpty(&tf->back_stale);
+
+    if (ls_tearfree_queue_flips(pScrn) == 0)
+    {
+        // nothing flipped, the back buffer is complete but not shown
+        tf->resync = FALSE;
+        ls_tearfree_copy_front(pScrn);
+        return;
+    }
+
+    tf->flips++;
+}
+
+
+Bool LS_TearFreeAllocBack(ScrnInfoPtr pScrn)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+    drmmode_ptr drmmode = &ms->drmmode;
+    drmmode_tearfree_rec *tf = &drmmode->tearfree;
+    BoxRec box = { 0, 0, pScrn->virtualX, pScrn->virtualY };
+
+    tf->back_bo.width = pScrn->virtualX;
+    tf->back_bo.height = pScrn->virtualY;
+    tf->back_bo.dumb = dumb_bo_create(drmmode->fd, pScrn->virtualX,
+                                      pScrn->virtualY, drmmode->kbpp);
+    if (tf->back_bo.dumb == NULL)
+    {
+        goto fail;
+    }
+
+    if (dumb_bo_map(drmmode->fd, tf->back_bo.dumb))
+    {
+        goto fail;
+    }
+
+    if (drmmode_bo_import(drmmode, &tf->back_bo, &tf->back_fb_id) < 0)
+    {
+        goto fail;
+    }
+
+    // the back buffer starts blank and the front one may not match the
+    // shadow, so the first flip copies the whole screen
+    RegionReset(&tf->front_stale, &box);
+    RegionReset(&tf->back_stale, &box);
+
+    return TRUE;
+
+fail:
+    xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+               "TearFree: failed to allocate the back buffer\n");
+    drmmode_bo_destroy(drmmode, &tf->back_bo);
+    tf->back_fb_id = 0;
+
+    return FALSE;
+}
+
+void LS_TearFreeFreeBack(ScrnInfoPtr pScrn)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+    drmmode_ptr drmmode = &ms->drmmode;
+    drmmode_tearfree_rec *tf = &drmmode->tearfree;
+
+    // a completing flip swaps the buffers, let it happen first
+    ls_tearfree_wait(pScrn);
+
+    if (tf->back_fb_id)
+    {
+        drmModeRmFB(drmmode->fd, tf->back_fb_id);
+        tf->back_fb_id = 0;
+    }
+
+    drmmode_bo_destroy(drmmode, &tf->back_bo);
+}
+
+
+Bool LS_TearFreeInit(ScrnInfoPtr pScrn)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+    drmmode_ptr drmmode = &ms->drmmode;
+    drmmode_tearfree_rec *tf = &drmmode->tearfree;
+
+    if (!drmmode->shadow_enable || (drmmode->front_bo.dumb == NULL))
+    {
+        return FALSE;
+    }
+
+    if (!xf86ReturnOptValBool(drmmode->Options, OPTION_TEAR_FREE, FALSE))
+    {
+        return FALSE;
+    }
+
+    RegionNull(&tf->front_stale);
+    RegionNull(&tf->back_stale);
+
+    if (!LS_TearFreeAllocBack(pScrn))
+    {
+        RegionUninit(&tf->front_stale);
+        RegionUninit(&tf->back_stale);
+        return FALSE;
+    }
+
+    tf->enabled = TRUE;
+    tf->flips = 0;
+    tf->direct = 0;
+
+    xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+               "TearFree: flipping between two front buffers\n");
+
+    return TRUE;
+}
+
+void LS_TearFreeFini(ScrnInfoPtr pScrn)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+    drmmode_tearfree_rec *tf = &ms->drmmode.tearfree;
+
+    if (!tf->enabled)
+    {
+        return;
+    }
+
+    LS_TearFreeFreeBack(pScrn);
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+               "TearFree: %lu flips, %lu direct copies\n",
+               tf->flips, tf->direct);
+
+    RegionUninit(&tf->front_stale);
+    RegionUninit(&tf->back_stale);
+    tf->enabled = FALSE;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifndef LOONGSON_TEARFREE_H_
+#define LOONGSON_TEARFREE_H_
+
+#include <xf86str.h>
+#include <regionstr.h>
+
+//
+// TearFree for the shadow framebuffer, Option "TearFree". Shadow damage
+// only marks both scanout buffers stale, LS_TearFreeFlush() brings the
+// hidden one up to date and flips every crtc to it on the next vblank.
+//
+Bool LS_TearFreeInit(ScrnInfoPtr pScrn);
+void LS_TearFreeFini(ScrnInfoPtr pScrn);
+
+// the back buffer follows the front one through a resize
+void LS_TearFreeFreeBack(ScrnInfoPtr pScrn);
+Bool LS_TearFreeAllocBack(ScrnInfoPtr pScrn);
+
+void LS_TearFreeDamage(ScrnInfoPtr pScrn, RegionPtr damage);
+void LS_TearFreeFlush(ScrnInfoPtr pScrn);
+
+#endif
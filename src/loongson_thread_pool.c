@@ -0,0 +1,313 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <xf86.h>
+
+#include "driver.h"
+#include "loongson_options.h"
+#include "loongson_thread_pool.h"
+
+#define LS_MAX_THREADS              16
+#define LS_DEFAULT_MAX_THREADS      4
+#define LS_DEFAULT_BAND_THRESHOLD   (256 * 256)
+
+// bands thinner than this cost more in wakeups than they save
+#define LS_MIN_BAND_HEIGHT          16
+
+struct LoongsonThreadPool {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+
+    pthread_t workers[LS_MAX_THREADS];
+    int nWorkers;
+    int refcnt;
+    int threshold;
+    Bool quit;
+
+    // the job currently being run, protected by @lock. @busy is set while
+    // a job owns the slot, the EXA queue thread may run bands at the
+    // same time as the server thread.
+    Bool busy;
+    unsigned int generation;
+    LS_BandFunc func;
+    void *data;
+    int height;
+    int nBands;
+    int nextBand;
+    int pending;
+};
+
+static struct LoongsonThreadPool lsPool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+
+static inline void ls_band_range(int band, int nBands, int height,
+                                 int *y, int *h)
+{
+    int y1 = height * band / nBands;
+    int y2 = height * (band + 1) / nBands;
+
+    *y = y1;
+    *h = y2 - y1;
+}
+
+//
+// Take bands of the current job until none are left, called with
+// @lock held and returns with it held.
+//
+static void ls_pool_run_bands(struct LoongsonThreadPool *pPool)
+{
+    while (pPool->nextBand < pPool->nBands)
+    {
+        int band = pPool->nextBand++;
+        int y, h;
+
+        ls_band_range(band, pPool->nBands, pPool->height, &y, &h);
+
+        pthread_mutex_unlock(&pPool->lock);
+        pPool->func(pPool->data, y, h);
+        pthread_mutex_lock(&pPool->lock);
+
+        if (--pPool->pending == 0)
+        {
+            pthread_cond_broadcast(&pPool->done);
+        }
+    }
+}
+
+static void * ls_pool_worker(void *arg)
+{
+    struct LoongsonThreadPool *pPool = arg;
+    unsigned int seen = 0;
+
+    pthread_mutex_lock(&pPool->lock);
+
+    while (!pPool->quit)
+    {
+        if (seen == pPool->generation)
+        {
+            pthread_cond_wait(&pPool->work, &pPool->lock);
+            continue;
+        }
+
+        seen = pPool->generation;
+
+        ls_pool_run_bands(pPool);
+    }
+
+    pthread_mutex_unlock(&pPool->lock);
+
+    return NULL;
+}
+
+
+// wait for the job slot, called with @lock held
+static void ls_pool_acquire(struct LoongsonThreadPool *pPool)
+{
+    while (pPool->busy)
+    {
+        pthread_cond_wait(&pPool->done, &pPool->lock);
+    }
+
+    pPool->busy = TRUE;
+}
+
+static void ls_pool_queue(struct LoongsonThreadPool *pPool,
+                          LS_BandFunc func, void *data,
+                          int height, int nBands)
+{
+    pPool->func = func;
+    pPool->data = data;
+    pPool->height = height;
+    pPool->nBands = nBands;
+    pPool->nextBand = 0;
+    pPool->pending = nBands;
+    pPool->generation++;
+
+    pthread_cond_broadcast(&pPool->work);
+}
+
+static int ls_pool_num_bands(struct LoongsonThreadPool *pPool,
+                             int height, int pixels)
+{
+    int nBands;
+
+    if ((pPool->nWorkers == 0) || (pixels < pPool->threshold))
+    {
+        return 1;
+    }
+
+    nBands = pPool->nWorkers + 1;
+    if (height / nBands < LS_MIN_BAND_HEIGHT)
+    {
+        nBands = height / LS_MIN_BAND_HEIGHT;
+    }
+
+    return nBands;
+}
+
+
+static int ls_pool_default_threads(void)
+{
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (ncpu < 1)
+    {
+        return 1;
+    }
+
+    return (ncpu > LS_DEFAULT_MAX_THREADS) ? LS_DEFAULT_MAX_THREADS : ncpu;
+}
+
+
+Bool LS_ThreadPoolInit(ScrnInfoPtr pScrn)
+{
+    modesettingPtr ms = modesettingPTR(pScrn);
+    struct LoongsonThreadPool *pPool = &lsPool;
+    sigset_t blocked, saved;
+    int nThreads;
+    int threshold;
+    int i;
+
+    if (pPool->refcnt++)
+    {
+        return TRUE;
+    }
+
+    if (!xf86GetOptValInteger(ms->drmmode.Options,
+                              OPTION_EXA_THREADS, &nThreads))
+    {
+        nThreads = ls_pool_default_threads();
+    }
+
+    if (nThreads < 1)
+    {
+        nThreads = 1;
+    }
+    else if (nThreads > LS_MAX_THREADS + 1)
+    {
+        nThreads = LS_MAX_THREADS + 1;
+    }
+
+    if (!xf86GetOptValInteger(ms->drmmode.Options,
+                              OPTION_EXA_THREAD_THRESHOLD, &threshold))
+    {
+        threshold = LS_DEFAULT_BAND_THRESHOLD;
+    }
+
+    pPool->threshold = threshold;
+    pPool->quit = FALSE;
+    pPool->nWorkers = 0;
+
+    // the workers must never take the server's signals
+    sigfillset(&blocked);
+    pthread_sigmask(SIG_BLOCK, &blocked, &saved);
+
+    // the calling thread runs a band too, so one less worker is needed
+    for (i = 0; i < nThreads - 1; i++)
+    {
+        if (pthread_create(&pPool->workers[i], NULL, ls_pool_worker, pPool))
+        {
+            break;
+        }
+
+        pPool->nWorkers++;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+               "Running large operations on %d threads, threshold %d pixels.\n",
+               pPool->nWorkers + 1, pPool->threshold);
+
+    return TRUE;
+}
+
+
+void LS_ThreadPoolFini(ScrnInfoPtr pScrn)
+{
+    struct LoongsonThreadPool *pPool = &lsPool;
+    int i;
+
+    if ((pPool->refcnt == 0) || --pPool->refcnt)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pPool->lock);
+    pPool->quit = TRUE;
+    pthread_cond_broadcast(&pPool->work);
+    pthread_mutex_unlock(&pPool->lock);
+
+    for (i = 0; i < pPool->nWorkers; i++)
+    {
+        pthread_join(pPool->workers[i], NULL);
+    }
+
+    pPool->nWorkers = 0;
+}
+
+
+void LS_RunBands(LS_BandFunc func, void *data, int height, int pixels)
+{
+    struct LoongsonThreadPool *pPool = &lsPool;
+    int nBands = ls_pool_num_bands(pPool, height, pixels);
+
+    if (nBands < 2)
+    {
+        func(data, 0, height);
+        return;
+    }
+
+    pthread_mutex_lock(&pPool->lock);
+
+    ls_pool_acquire(pPool);
+    ls_pool_queue(pPool, func, data, height, nBands);
+
+    ls_pool_run_bands(pPool);
+
+    while (pPool->pending)
+    {
+        pthread_cond_wait(&pPool->done, &pPool->lock);
+    }
+
+    pPool->busy = FALSE;
+    pthread_cond_broadcast(&pPool->done);
+
+    pthread_mutex_unlock(&pPool->lock);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright © 2020 Loongson Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Authors:
+ *    Sui Jingfeng <suijingfeng@loongson.cn>
+ */
+
+#ifndef LOONGSON_THREAD_POOL_H_
+#define LOONGSON_THREAD_POOL_H_
+
+#include <xf86str.h>
+
+//
+// Run a large pixel operation as horizontal bands on a small pool of
+// worker threads, the calling thread takes one band itself. @func is
+// called with a band [y, y + h) relative to the start of the operation
+// and must only touch the rows of that band.
+//
+typedef void (*LS_BandFunc)(void *data, int y, int h);
+
+Bool LS_ThreadPoolInit(ScrnInfoPtr pScrn);
+void LS_ThreadPoolFini(ScrnInfoPtr pScrn);
+
+//
+// Split @height rows into bands if @pixels is above the configured
+// threshold, otherwise call @func inline with the whole range.
+//
+void LS_RunBands(LS_BandFunc func, void *data, int height, int pixels);
+
+#endif
@@ -137,6 +137,7 @@ ms_pageflip_handler(uint64_t msc, uint64_t ust, void *data)
                                 flipdata->fe_usec,
                                 flipdata->event);
 
+        ms->kms_stats.ioctls++;
         drmModeRmFB(ms->fd, flipdata->old_fb_id);
     }
     ms_pageflip_free(flip);
@@ -284,6 +285,7 @@ ms_do_pageflip(ScreenPtr screen,
 
     new_front_bo.width = new_front->drawable.width;
     new_front_bo.height = new_front->drawable.height;
+    ms->kms_stats.ioctls++;
     if (drmmode_bo_import(&ms->drmmode, &new_front_bo,
                           &ms->drmmode.fb_id)) {
         if (!ms->drmmode.flip_bo_import_failed) {
@@ -27,6 +27,8 @@
 
 #include "config.h"
 
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <xf86.h>
 #include <xf86Crtc.h>
@@ -48,6 +50,28 @@
 static struct xorg_list ms_drm_queue;
 static uint32_t ms_drm_seq;
 
+uint64_t
+ms_monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Length of one refresh of the crtc's current mode, 0 if unknown */
+static uint64_t
+ms_crtc_frame_ns(xf86CrtcPtr crtc)
+{
+    DisplayModePtr mode = &crtc->mode;
+
+    if (mode->Clock <= 0 || mode->HTotal <= 0 || mode->VTotal <= 0)
+        return 0;
+
+    return (uint64_t) mode->HTotal * mode->VTotal * 1000000 / mode->Clock;
+}
+
 static void ms_box_intersect(BoxPtr dest, BoxPtr a, BoxPtr b)
 {
     dest->x1 = a->x1 > b->x1 ? a->x1 : b->x1;
@@ -330,6 +354,7 @@ ms_get_kernel_ust_msc(xf86CrtcPtr crtc,
         uint64_t ns;
         ms->tried_queue_sequence = TRUE;
 
+        ms->kms_stats.ioctls++;
         ret = drmCrtcGetSequence(ms->fd, drmmode_crtc->mode_crtc->crtc_id,
                                  msc, &ns);
         if (ret != -1 || (errno != ENOTTY && errno != EINVAL)) {
@@ -343,6 +368,7 @@ ms_get_kernel_ust_msc(xf86CrtcPtr crtc,
     vbl.request.type = DRM_VBLANK_RELATIVE | drmmode_crtc->vblank_pipe;
     vbl.request.sequence = 0;
     vbl.request.signal = 0;
+    ms->kms_stats.ioctls++;
     ret = drmWaitVBlank(ms->fd, &vbl);
     if (ret) {
         *msc = 0;
@@ -355,6 +381,52 @@ ms_get_kernel_ust_msc(xf86CrtcPtr crtc,
     }
 }
 
+/*
+ * Predict the next vblank, at least margin_ns from now, of the crtc
+ * showing most of the screen. In CLOCK_MONOTONIC ns like the kernel's
+ * vblank timestamps; 0 when no crtc is on or its timing is unknown.
+ */
+uint64_t
+ms_next_vblank_ns(ScreenPtr screen, uint64_t margin_ns, uint64_t *frame_ns)
+{
+    ScrnInfoPtr scrn = xf86ScreenToScrn(screen);
+    BoxRec box = { 0, 0, scrn->virtualX, scrn->virtualY };
+    xf86CrtcPtr crtc = ms_covering_xf86_crtc(screen, &box, TRUE);
+    uint64_t msc, ust, next, earliest, period;
+
+    if (!crtc)
+        return 0;
+
+    period = ms_crtc_frame_ns(crtc);
+    if (!period || !ms_get_kernel_ust_msc(crtc, &msc, &ust))
+        return 0;
+
+    next = ust * 1000 + period;
+    earliest = ms_monotonic_ns() + margin_ns;
+    if (next < earliest)
+        next += ((earliest - next) / period + 1) * period;
+
+    *frame_ns = period;
+    return next;
+}
+
+/*
+ * Remember which kernel msc a queued entry waits for, so a late event
+ * can be counted as missed frames
+ */
+static void
+ms_drm_queue_set_target(uint32_t seq, uint64_t msc)
+{
+    struct ms_drm_queue *q;
+
+    xorg_list_for_each_entry(q, &ms_drm_queue, list) {
+        if (q->seq == seq) {
+            q->target_msc = msc;
+            break;
+        }
+    }
+}
+
 Bool
 ms_queue_vblank(xf86CrtcPtr crtc, ms_queue_flag flags,
                 uint64_t msc, uint64_t *msc_queued, uint32_t seq)
@@ -379,9 +451,12 @@ ms_queue_vblank(xf86CrtcPtr crtc, ms_queue_flag flags,
             if (flags & MS_QUEUE_NEXT_ON_MISS)
                 drm_flags |= DRM_CRTC_SEQUENCE_NEXT_ON_MISS;
 
+            ms->kms_stats.ioctls++;
             ret = drmCrtcQueueSequence(ms->fd, drmmode_crtc->mode_crtc->crtc_id,
                                        drm_flags, msc, &kernel_queued, seq);
             if (ret == 0) {
+                ms_drm_queue_set_target(seq, (flags & MS_QUEUE_RELATIVE) ?
+                                        kernel_queued : msc);
                 if (msc_queued)
                     *msc_queued = ms_kernel_msc_to_crtc_msc(crtc, kernel_queued, TRUE);
                 ms->has_queue_sequence = TRUE;
@@ -403,8 +478,11 @@ ms_queue_vblank(xf86CrtcPtr crtc, ms_queue_flag flags,
 
         vbl.request.sequence = msc;
         vbl.request.signal = seq;
+        ms->kms_stats.ioctls++;
         ret = drmWaitVBlank(ms->fd, &vbl);
         if (ret == 0) {
+            ms_drm_queue_set_target(seq, (flags & MS_QUEUE_RELATIVE) ?
+                                    vbl.reply.sequence : msc);
             if (msc_queued)
                 *msc_queued = ms_kernel_msc_to_crtc_msc(crtc, vbl.reply.sequence, FALSE);
             return TRUE;
@@ -518,6 +596,7 @@ ms_drm_queue_alloc(xf86CrtcPtr crtc,
     q->data = data;
     q->handler = handler;
     q->abort = abort;
+    q->queued_ns = ms_monotonic_ns();
 
     xorg_list_add(&q->list, &ms_drm_queue);
 
@@ -586,6 +665,51 @@ ms_drm_abort(ScrnInfoPtr scrn, Bool (*match)(void *data, void *match_data),
     }
 }
 
+/*
+ * Account one delivered event: how long it took from being queued to the
+ * vblank it reports, how long from that vblank to us handling it, and
+ * whether it came later than asked for. Events without a target msc (page
+ * flips) are late when they took longer than one refresh.
+ */
+static void
+ms_drm_queue_account(struct ms_drm_queue *q, uint64_t frame, uint64_t ns,
+                     Bool is64bit)
+{
+    modesettingPtr ms = modesettingPTR(q->scrn);
+    struct ms_kms_stats *stats = &ms->kms_stats;
+    uint64_t now = ms_monotonic_ns();
+    int64_t late = 0;
+
+    stats->events++;
+
+    if (ns > q->queued_ns) {
+        stats->queue_ns += ns - q->queued_ns;
+        stats->queue_max_ns = max(stats->queue_max_ns, ns - q->queued_ns);
+    }
+
+    if (now > ns) {
+        stats->dispatch_ns += now - ns;
+        stats->dispatch_max_ns = max(stats->dispatch_max_ns, now - ns);
+    }
+
+    if (q->target_msc) {
+        if (is64bit)
+            late = (int64_t) (frame - q->target_msc);
+        else
+            late = (int32_t) ((uint32_t) frame - (uint32_t) q->target_msc);
+    } else {
+        uint64_t frame_ns = ms_crtc_frame_ns(q->crtc);
+
+        if (frame_ns && ns > q->queued_ns)
+            late = (ns - q->queued_ns) / frame_ns;
+    }
+
+    if (late > 0) {
+        stats->missed++;
+        stats->missed_frames += late;
+    }
+}
+
 /*
  * General DRM kernel handler. Looks for the matching sequence number in the
  * drm event queue and calls the handler for it.
@@ -600,6 +724,7 @@ ms_drm_sequence_handler(int fd, uint64_t frame, uint64_t ns, Bool is64bit, uint6
         if (q->seq == seq) {
             uint64_t msc;
 
+            ms_drm_queue_account(q, frame, ns, is64bit);
             msc = ms_kernel_msc_to_crtc_msc(q->crtc, frame, is64bit);
             xorg_list_del(&q->list);
             q->handler(msc, ns / 1000, q->data);
@@ -652,6 +777,31 @@ ms_vblank_screen_init(ScreenPtr screen)
     return TRUE;
 }
 
+static void
+ms_vblank_dump_stats(ScrnInfoPtr scrn)
+{
+    modesettingPtr ms = modesettingPTR(scrn);
+    struct ms_kms_stats *stats = &ms->kms_stats;
+
+    if (stats->events == 0)
+        return;
+
+    xf86DrvMsg(scrn->scrnIndex, X_INFO,
+               "vblank/flip events: %lu, %lu late by %llu frames in total, "
+               "%.2f ioctls per event\n",
+               stats->events, stats->missed,
+               (unsigned long long) stats->missed_frames,
+               (double) stats->ioctls / stats->events);
+
+    xf86DrvMsg(scrn->scrnIndex, X_INFO,
+               "vblank/flip latency: queue to event %.2f ms avg %.2f ms max, "
+               "event to handler %.3f ms avg %.3f ms max\n",
+               stats->queue_ns / 1e6 / stats->events,
+               stats->queue_max_ns / 1e6,
+               stats->dispatch_ns / 1e6 / stats->events,
+               stats->dispatch_max_ns / 1e6);
+}
+
 void
 ms_vblank_close_screen(ScreenPtr screen)
 {
@@ -659,6 +809,8 @@ ms_vblank_close_screen(ScreenPtr screen)
     modesettingPtr ms = modesettingPTR(scrn);
 
     ms_drm_abort_scrn(scrn);
+    ms_vblank_dump_stats(scrn);
+    memset(&ms->kms_stats, 0, sizeof(ms->kms_stats));
 
     if ( ( serverGeneration == LS_EntityGetFd_wakeup(scrn) ) &&
          ( 0 == LS_EntityDecRef_weakeup(scrn) ) ) {